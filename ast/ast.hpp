@@ -0,0 +1,283 @@
+#ifndef AST_H
+#define AST_H
+
+#include "../lexer/token.hpp"
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace sema {
+class Type;
+}
+
+namespace ast {
+
+using lexer::Position;
+
+// Syntactic type as written in the source, e.g. `struct bruh *x[2][3]`.
+// Resolved into an interned sema::Type during semantic analysis.
+enum class BaseType { INT, CHAR, VOID, STRUCT };
+
+struct TypeSpec {
+  BaseType base{BaseType::INT};
+  std::string structName;
+  int pointerDepth{0};
+  std::vector<int> arrayDims;
+};
+
+enum class ExprKind {
+  INT_LITERAL,
+  CHAR_LITERAL,
+  STRING_LITERAL,
+  VAR,
+  FUN_CALL,
+  BIN_OP,
+  ARRAY_ACCESS,
+  FIELD_ACCESS,
+  VALUE_AT,
+  ADDRESS_OF,
+  SIZEOF,
+  TYPECAST,
+};
+
+enum class BinOpKind {
+  ADD,
+  SUB,
+  MUL,
+  DIV,
+  MOD,
+  GT,
+  LT,
+  GE,
+  LE,
+  NE,
+  EQ,
+  OR,
+  AND,
+};
+
+enum class StmtKind { BLOCK, WHILE, IF, RETURN, ASSIGN, EXPR };
+
+struct VarDecl;
+struct FunDecl;
+
+struct Expr {
+  const ExprKind kind;
+  const Position pos;
+  // Filled in by semantic analysis.
+  const sema::Type *type{nullptr};
+
+  Expr(ExprKind kind, Position pos) : kind(kind), pos(pos) {}
+  virtual ~Expr() = default;
+
+  template <class T> T &as() { return static_cast<T &>(*this); }
+  template <class T> const T &as() const {
+    return static_cast<const T &>(*this);
+  }
+};
+
+using ExprPtr = std::unique_ptr<Expr>;
+
+struct IntLiteral : Expr {
+  int64_t value;
+  IntLiteral(int64_t value, Position pos)
+      : Expr(ExprKind::INT_LITERAL, pos), value(value) {}
+};
+
+struct CharLiteral : Expr {
+  char value;
+  CharLiteral(char value, Position pos)
+      : Expr(ExprKind::CHAR_LITERAL, pos), value(value) {}
+};
+
+struct StringLiteral : Expr {
+  std::string value;
+  StringLiteral(std::string value, Position pos)
+      : Expr(ExprKind::STRING_LITERAL, pos), value(std::move(value)) {}
+};
+
+struct VarExpr : Expr {
+  std::string name;
+  VarDecl *decl{nullptr};
+  VarExpr(std::string name, Position pos)
+      : Expr(ExprKind::VAR, pos), name(std::move(name)) {}
+};
+
+struct FunCall : Expr {
+  std::string name;
+  std::vector<ExprPtr> args;
+  FunDecl *decl{nullptr};
+  FunCall(std::string name, std::vector<ExprPtr> args, Position pos)
+      : Expr(ExprKind::FUN_CALL, pos), name(std::move(name)),
+        args(std::move(args)) {}
+};
+
+struct BinOp : Expr {
+  BinOpKind op;
+  ExprPtr lhs;
+  ExprPtr rhs;
+  BinOp(BinOpKind op, ExprPtr lhs, ExprPtr rhs, Position pos)
+      : Expr(ExprKind::BIN_OP, pos), op(op), lhs(std::move(lhs)),
+        rhs(std::move(rhs)) {}
+};
+
+struct ArrayAccess : Expr {
+  ExprPtr array;
+  ExprPtr index;
+  ArrayAccess(ExprPtr array, ExprPtr index, Position pos)
+      : Expr(ExprKind::ARRAY_ACCESS, pos), array(std::move(array)),
+        index(std::move(index)) {}
+};
+
+struct FieldAccess : Expr {
+  ExprPtr object;
+  std::string field;
+  // Index of the field within its struct, filled in by semantic analysis.
+  int fieldIndex{-1};
+  FieldAccess(ExprPtr object, std::string field, Position pos)
+      : Expr(ExprKind::FIELD_ACCESS, pos), object(std::move(object)),
+        field(std::move(field)) {}
+};
+
+struct ValueAt : Expr {
+  ExprPtr pointer;
+  ValueAt(ExprPtr pointer, Position pos)
+      : Expr(ExprKind::VALUE_AT, pos), pointer(std::move(pointer)) {}
+};
+
+struct AddressOf : Expr {
+  ExprPtr operand;
+  AddressOf(ExprPtr operand, Position pos)
+      : Expr(ExprKind::ADDRESS_OF, pos), operand(std::move(operand)) {}
+};
+
+struct SizeOf : Expr {
+  TypeSpec typeSpec;
+  const sema::Type *operandType{nullptr};
+  SizeOf(TypeSpec typeSpec, Position pos)
+      : Expr(ExprKind::SIZEOF, pos), typeSpec(std::move(typeSpec)) {}
+};
+
+struct TypeCast : Expr {
+  TypeSpec typeSpec;
+  ExprPtr operand;
+  TypeCast(TypeSpec typeSpec, ExprPtr operand, Position pos)
+      : Expr(ExprKind::TYPECAST, pos), typeSpec(std::move(typeSpec)),
+        operand(std::move(operand)) {}
+};
+
+struct Stmt {
+  const StmtKind kind;
+  const Position pos;
+
+  Stmt(StmtKind kind, Position pos) : kind(kind), pos(pos) {}
+  virtual ~Stmt() = default;
+
+  template <class T> T &as() { return static_cast<T &>(*this); }
+  template <class T> const T &as() const {
+    return static_cast<const T &>(*this);
+  }
+};
+
+using StmtPtr = std::unique_ptr<Stmt>;
+
+struct VarDecl {
+  TypeSpec typeSpec;
+  std::string name;
+  Position pos;
+  bool isGlobal{false};
+  // Filled in by semantic analysis.
+  const sema::Type *type{nullptr};
+  // Set by semantic analysis when the variable's address is taken with `&`.
+  bool addressTaken{false};
+  // Hash of a global's tokens (see FunDecl::tokenHash).
+  uint64_t tokenHash{0};
+};
+
+using VarDeclPtr = std::unique_ptr<VarDecl>;
+
+struct Block : Stmt {
+  std::vector<VarDeclPtr> vars;
+  std::vector<StmtPtr> stmts;
+  explicit Block(Position pos) : Stmt(StmtKind::BLOCK, pos) {}
+};
+
+struct While : Stmt {
+  ExprPtr cond;
+  StmtPtr body;
+  While(ExprPtr cond, StmtPtr body, Position pos)
+      : Stmt(StmtKind::WHILE, pos), cond(std::move(cond)),
+        body(std::move(body)) {}
+};
+
+struct If : Stmt {
+  ExprPtr cond;
+  StmtPtr then;
+  StmtPtr otherwise; // may be null
+  If(ExprPtr cond, StmtPtr then, StmtPtr otherwise, Position pos)
+      : Stmt(StmtKind::IF, pos), cond(std::move(cond)), then(std::move(then)),
+        otherwise(std::move(otherwise)) {}
+};
+
+struct Return : Stmt {
+  ExprPtr value; // may be null
+  Return(ExprPtr value, Position pos)
+      : Stmt(StmtKind::RETURN, pos), value(std::move(value)) {}
+};
+
+struct Assign : Stmt {
+  ExprPtr lhs;
+  ExprPtr rhs;
+  Assign(ExprPtr lhs, ExprPtr rhs, Position pos)
+      : Stmt(StmtKind::ASSIGN, pos), lhs(std::move(lhs)), rhs(std::move(rhs)) {
+  }
+};
+
+struct ExprStmt : Stmt {
+  ExprPtr expr;
+  ExprStmt(ExprPtr expr, Position pos)
+      : Stmt(StmtKind::EXPR, pos), expr(std::move(expr)) {}
+};
+
+struct FunDecl {
+  TypeSpec returnSpec;
+  std::string name;
+  std::vector<VarDeclPtr> params;
+  // null for builtins and for functions parsed without their bodies
+  std::unique_ptr<Block> body;
+  Position pos;
+  bool isBuiltin{false};
+  // Hash of the tokens the declaration is made of, which identifies its
+  // source text across compilations whatever its position in the file.
+  uint64_t tokenHash{0};
+  // Filled in by semantic analysis.
+  const sema::Type *returnType{nullptr};
+};
+
+using FunDeclPtr = std::unique_ptr<FunDecl>;
+
+struct StructDecl {
+  std::string name;
+  std::vector<VarDeclPtr> fields;
+  Position pos;
+  // Hash of the declaration's tokens (see FunDecl::tokenHash).
+  uint64_t tokenHash{0};
+  // Filled in by semantic analysis.
+  const sema::Type *type{nullptr};
+};
+
+using StructDeclPtr = std::unique_ptr<StructDecl>;
+
+struct Program {
+  std::vector<std::string> includes;
+  std::vector<StructDeclPtr> structs;
+  std::vector<VarDeclPtr> globals;
+  std::vector<FunDeclPtr> functions;
+  // Runtime functions from minic-stdlib.h, declared by semantic analysis.
+  std::vector<FunDeclPtr> builtins;
+};
+
+} // namespace ast
+
+#endif
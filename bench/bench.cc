@@ -0,0 +1,412 @@
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <fcntl.h>
+#include <filesystem>
+#include <format>
+#include <fstream>
+#include <iostream>
+#include <linux/perf_event.h>
+#include <map>
+#include <optional>
+#include <sstream>
+#include <string>
+#include <sys/syscall.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#include <vector>
+
+// Benchmarks the code generated for the examples: every example is built by
+// this compiler and by the system C compiler, at -O0 and -O2, and each
+// executable runs a few times on the example's fixed input (<name>.input
+// next to it, or none). The best wall time, the instructions retired by the
+// best run where hardware counters can be read, and the size of the
+// executable are printed as a table. Both compilers' builds are linked
+// against the same runtime library for the builtins, so that the table
+// compares the code generated rather than the I/O. The builds of an example
+// must agree on its output, and the results of this compiler can be checked
+// against a baseline saved by an earlier run.
+
+// A way of building an executable from an example.
+struct Build {
+  std::string name;
+  bool minic;
+  int level;
+};
+
+static const std::vector<Build> BUILDS{
+    {"minic -O0", true, 0},
+    {"minic -O2", true, 2},
+    {"cc -O0", false, 0},
+    {"cc -O2", false, 2},
+};
+
+// What runs of an executable measured. Instruction counts are 0 where the
+// counters cannot be read.
+struct Result {
+  int64_t microseconds{INT64_MAX};
+  uint64_t instructions{0};
+  uintmax_t size{0};
+};
+
+// Results keyed by example and build name.
+using Results = std::map<std::pair<std::string, std::string>, Result>;
+
+// A counter of the user-space instructions `process` retires once it
+// executes a new program, or -1 if there is none (no PMU, or perf events
+// are not permitted).
+static int openCounter(pid_t process) {
+  perf_event_attr attributes{};
+  attributes.size = sizeof(attributes);
+  attributes.type = PERF_TYPE_HARDWARE;
+  attributes.config = PERF_COUNT_HW_INSTRUCTIONS;
+  attributes.disabled = 1;
+  attributes.enable_on_exec = 1;
+  attributes.inherit = 1;
+  attributes.exclude_kernel = 1;
+  attributes.exclude_hv = 1;
+  return static_cast<int>(
+      syscall(SYS_perf_event_open, &attributes, process, -1, -1, 0));
+}
+
+// Runs `executable` with stdin read from `input` and stdout written to
+// `output`. The instruction counter is attached before the program starts,
+// which the child waits for on a pipe. A child that cannot start the program
+// says so on a second pipe, which closes by itself once the program starts.
+// Returns false if it did not start or exit normally; its exit code is the
+// program's own business.
+static bool run(const std::filesystem::path &executable,
+                const std::filesystem::path &input,
+                const std::filesystem::path &output, Result &result) {
+  int ready[2];
+  int failure[2];
+  if (pipe(ready) != 0)
+    return false;
+  if (pipe2(failure, O_CLOEXEC) != 0) {
+    close(ready[0]);
+    close(ready[1]);
+    return false;
+  }
+  pid_t child{fork()};
+  if (child < 0) {
+    for (int fd : {ready[0], ready[1], failure[0], failure[1]})
+      close(fd);
+    return false;
+  }
+  if (child == 0) {
+    close(ready[1]);
+    close(failure[0]);
+    char go;
+    int in{open(input.c_str(), O_RDONLY)};
+    int out{open(output.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644)};
+    if (read(ready[0], &go, 1) == 1 && in >= 0 && out >= 0) {
+      close(ready[0]);
+      dup2(in, 0);
+      dup2(out, 1);
+      execl(executable.c_str(), executable.c_str(), nullptr);
+    }
+    [[maybe_unused]] ssize_t written{write(failure[1], "x", 1)};
+    _exit(127);
+  }
+
+  close(ready[0]);
+  close(failure[1]);
+  int counter{openCounter(child)};
+  auto start{std::chrono::steady_clock::now()};
+  bool started{write(ready[1], "x", 1) == 1};
+  close(ready[1]);
+  int status;
+  waitpid(child, &status, 0);
+  char failed;
+  bool executed{read(failure[0], &failed, 1) == 0};
+  close(failure[0]);
+  int64_t microseconds{std::chrono::duration_cast<std::chrono::microseconds>(
+                           std::chrono::steady_clock::now() - start)
+                           .count()};
+  uint64_t instructions{0};
+  if (counter >= 0) {
+    if (read(counter, &instructions, sizeof(instructions)) !=
+        sizeof(instructions))
+      instructions = 0;
+    close(counter);
+  }
+
+  if (!started || !executed || !WIFEXITED(status))
+    return false;
+  if (microseconds < result.microseconds) {
+    result.microseconds = microseconds;
+    result.instructions = instructions;
+  }
+  return true;
+}
+
+static std::string readFile(const std::filesystem::path &path) {
+  std::ifstream file(path, std::ios::binary);
+  return {std::istreambuf_iterator<char>{file}, {}};
+}
+
+// Examples that include a system header are C programs rather than MiniC
+// ones, which this compiler is not meant to build.
+static bool isMiniC(const std::filesystem::path &source) {
+  std::ifstream file(source);
+  std::string line;
+  while (std::getline(file, line))
+    if (line.starts_with("#include <"))
+      return false;
+  return true;
+}
+
+// Declarations of the builtins, which the system C compiler gets in front of
+// the example in place of the definitions in minic-stdlib.h, as not every
+// example includes it.
+static constexpr std::string_view BUILTINS{"void print_s(const char *s);\n"
+                                           "void print_i(int i);\n"
+                                           "void print_c(char c);\n"
+                                           "char read_c(void);\n"
+                                           "int read_i(void);\n"
+                                           "void *mcmalloc(int size);\n"};
+
+// The system C compiler's builds link `runtime`, the runtime library this
+// compiler links into its executables, compiled once like this compiler's.
+static bool build(const Build &build, const std::string &compiler,
+                  const std::filesystem::path &runtime,
+                  const std::filesystem::path &source,
+                  const std::filesystem::path &executable) {
+  if (build.minic)
+    return std::system(std::format("'{}' -executable '{}' '{}' -O{} > "
+                                   "/dev/null",
+                                   compiler, source.string(),
+                                   executable.string(), build.level)
+                           .c_str()) == 0;
+
+  std::filesystem::path reference{executable};
+  reference.replace_extension(".c");
+  {
+    std::ifstream in(source);
+    std::ofstream out(reference);
+    out << BUILTINS;
+    std::string line;
+    while (std::getline(in, line))
+      if (!line.starts_with("#include \"minic-stdlib.h\""))
+        out << line << '\n';
+  }
+  return std::system(std::format("cc -w -O{} -o '{}' '{}' '{}'", build.level,
+                                 executable.string(), reference.string(),
+                                 runtime.string())
+                         .c_str()) == 0;
+}
+
+// One line per result of this compiler: example, build, microseconds,
+// instructions and size, the build name's space written as '_'.
+static Results readBaseline(const std::filesystem::path &path) {
+  Results baseline;
+  std::ifstream file(path);
+  std::string line;
+  while (std::getline(file, line)) {
+    std::istringstream fields{line};
+    std::string example;
+    std::string name;
+    Result result;
+    if (fields >> example >> name >> result.microseconds >>
+        result.instructions >> result.size) {
+      std::ranges::replace(name, '_', ' ');
+      baseline[{example, name}] = result;
+    }
+  }
+  return baseline;
+}
+
+static bool writeBaseline(const std::filesystem::path &path,
+                          const Results &results) {
+  std::ofstream file(path);
+  for (const auto &[key, result] : results) {
+    if (!key.second.starts_with("minic"))
+      continue;
+    std::string name{key.second};
+    std::ranges::replace(name, ' ', '_');
+    file << std::format("{} {} {} {} {}\n", key.first, name,
+                        result.microseconds, result.instructions,
+                        result.size);
+  }
+  return static_cast<bool>(file);
+}
+
+// Reports the results of this compiler that are worse than the baseline by
+// more than `threshold` percent: instructions where both have counts and
+// wall time otherwise, and executable size, as well as those that are gone.
+// Returns how many there are.
+static int compare(const Results &results, const Results &baseline,
+                   double threshold) {
+  int regressions{0};
+  auto check{[&](const std::pair<std::string, std::string> &key,
+                 std::string_view metric, double before, double after) {
+    if (before <= 0 || after <= before * (1 + threshold / 100))
+      return;
+    std::cout << std::format("Regression: {} {} {} {} -> {} (+{:.1f}%)!",
+                             key.first, key.second, metric, before, after,
+                             (after / before - 1) * 100)
+              << std::endl;
+    regressions++;
+  }};
+  for (const auto &[key, old] : baseline)
+    if (!results.contains(key)) {
+      std::cout << std::format("Regression: {} {} no longer runs!", key.first,
+                               key.second)
+                << std::endl;
+      regressions++;
+    }
+  for (const auto &[key, result] : results) {
+    auto old{baseline.find(key)};
+    if (old == baseline.end())
+      continue;
+    if (result.instructions > 0 && old->second.instructions > 0)
+      check(key, "instructions",
+            static_cast<double>(old->second.instructions),
+            static_cast<double>(result.instructions));
+    else
+      check(key, "time (us)", static_cast<double>(old->second.microseconds),
+            static_cast<double>(result.microseconds));
+    check(key, "size (bytes)", static_cast<double>(old->second.size),
+          static_cast<double>(result.size));
+  }
+  return regressions;
+}
+
+static void usage() {
+  std::cout << std::format(
+      "Usage: bazel run //bench:bench -- <compiler> <examples directory>\n"
+      "       <runtime source> [-runs=<n>] [-threshold=<percent>]\n"
+      "       [-baseline=<file>] [-save=<file>]\n");
+}
+
+int main(int argc, char *argv[]) {
+  int runs{5};
+  double threshold{5};
+  std::filesystem::path baselinePath;
+  std::filesystem::path savePath;
+  std::vector<std::string> files;
+  for (int i = 1; i < argc; i++) {
+    std::string_view arg{argv[i]};
+    auto value{[&] { return std::string{arg.substr(arg.find('=') + 1)}; }};
+    if (arg.starts_with("-runs="))
+      runs = std::max(1, std::atoi(value().c_str()));
+    else if (arg.starts_with("-threshold="))
+      threshold = std::atof(value().c_str());
+    else if (arg.starts_with("-baseline="))
+      baselinePath = value();
+    else if (arg.starts_with("-save="))
+      savePath = value();
+    else
+      files.emplace_back(arg);
+  }
+  if (files.size() != 3) {
+    usage();
+    return -1;
+  }
+  std::string compiler{std::filesystem::absolute(files[0]).string()};
+  std::filesystem::path examples{files[1]};
+  std::filesystem::path runtimeSource{files[2]};
+
+  std::vector<std::filesystem::path> sources;
+  std::error_code error;
+  for (const auto &entry :
+       std::filesystem::directory_iterator(examples, error))
+    if (entry.path().extension() == ".c")
+      sources.push_back(entry.path());
+  if (error || sources.empty()) {
+    std::cout << std::format("No examples in {}!", examples.string())
+              << std::endl;
+    return -1;
+  }
+  std::ranges::sort(sources);
+
+  std::filesystem::path directory{std::filesystem::temp_directory_path() /
+                                  std::format("minic-bench-{}", getpid())};
+  std::filesystem::create_directories(directory);
+  // as runtime::link compiles it for this compiler's executables
+  std::filesystem::path runtime{directory / "runtime.o"};
+  if (std::system(std::format("cc -O2 -c -o '{}' -x c '{}'", runtime.string(),
+                              runtimeSource.string())
+                      .c_str()) != 0) {
+    std::cout << std::format("Cannot compile runtime {}!",
+                             runtimeSource.string())
+              << std::endl;
+    std::filesystem::remove_all(directory);
+    return -1;
+  }
+
+  bool counted{false};
+  bool failed{false};
+  Results results;
+  std::cout << std::format("{:<22}{:<12}{:>12}{:>16}{:>12}", "Example",
+                           "Build", "Time (us)", "Instructions", "Size")
+            << std::endl;
+  for (const std::filesystem::path &source : sources) {
+    std::string example{source.stem().string()};
+    if (!isMiniC(source)) {
+      std::cout << std::format("Skipping {}: not a MiniC program", example)
+                << std::endl;
+      continue;
+    }
+    std::filesystem::path input{source};
+    input.replace_extension(".input");
+    if (!std::filesystem::exists(input))
+      input = "/dev/null";
+
+    std::optional<std::string> expected;
+    for (const Build &each : BUILDS) {
+      std::filesystem::path executable{directory / "program"};
+      std::filesystem::path output{directory / "output"};
+      Result result;
+      bool ran{build(each, compiler, runtime, source, executable)};
+      for (int i = 0; ran && i < runs; i++)
+        ran = run(executable, input, i == 0 ? output : "/dev/null", result);
+      if (!ran) {
+        std::cout << std::format("Cannot build and run {} with {}!", example,
+                                 each.name)
+                  << std::endl;
+        failed = true;
+        continue;
+      }
+
+      // every build of an example must print the same
+      std::string printed{readFile(output)};
+      if (!expected)
+        expected = printed;
+      else if (printed != *expected) {
+        std::cout << std::format("Output of {} with {} differs!", example,
+                                 each.name)
+                  << std::endl;
+        failed = true;
+      }
+
+      result.size = std::filesystem::file_size(executable);
+      counted |= result.instructions > 0;
+      results[{example, each.name}] = result;
+      std::cout << std::format(
+                       "{:<22}{:<12}{:>12}{:>16}{:>12}", example, each.name,
+                       result.microseconds,
+                       result.instructions > 0
+                           ? std::to_string(result.instructions)
+                           : "-",
+                       result.size)
+                << std::endl;
+    }
+  }
+  std::filesystem::remove_all(directory);
+  if (!counted)
+    std::cout << "Instruction counters are not available; comparing wall "
+                 "time instead"
+              << std::endl;
+
+  if (!baselinePath.empty() &&
+      compare(results, readBaseline(baselinePath), threshold) > 0)
+    failed = true;
+  if (!savePath.empty() && !writeBaseline(savePath, results)) {
+    std::cout << std::format("Cannot write baseline {}!", savePath.string())
+              << std::endl;
+    failed = true;
+  }
+  return failed ? -1 : 0;
+}
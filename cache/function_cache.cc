@@ -0,0 +1,508 @@
+#include "function_cache.hpp"
+#include <algorithm>
+#include <cstring>
+#include <elf.h>
+#include <format>
+#include <fstream>
+#include <link.h>
+#include <map>
+#include <type_traits>
+#include <unistd.h>
+#include <unordered_map>
+
+namespace cache {
+
+using codegen::MachineFunction;
+using codegen::MInst;
+using codegen::Operand;
+using codegen::Symbol;
+using codegen::SymbolKind;
+
+// Changes whenever the entry format changes. Changes to code generation are
+// told apart by compilerIdentity() instead.
+constexpr std::string_view FORMAT_VERSION{"minic-function-cache 3"};
+
+// What the code of a function refers to by name.
+struct References {
+  std::vector<const ast::FunDecl *> callees;
+  std::vector<const ast::VarDecl *> globals;
+};
+
+static void collect(const ast::Expr &expr, References &references) {
+  switch (expr.kind) {
+  case ast::ExprKind::VAR: {
+    const ast::VarDecl *decl{expr.as<ast::VarExpr>().decl};
+    if (decl != nullptr && decl->isGlobal)
+      references.globals.push_back(decl);
+    return;
+  }
+  case ast::ExprKind::FUN_CALL: {
+    const ast::FunCall &call{expr.as<ast::FunCall>()};
+    if (call.decl != nullptr && !call.decl->isBuiltin)
+      references.callees.push_back(call.decl);
+    for (const ast::ExprPtr &arg : call.args)
+      collect(*arg, references);
+    return;
+  }
+  case ast::ExprKind::BIN_OP:
+    collect(*expr.as<ast::BinOp>().lhs, references);
+    collect(*expr.as<ast::BinOp>().rhs, references);
+    return;
+  case ast::ExprKind::ARRAY_ACCESS:
+    collect(*expr.as<ast::ArrayAccess>().array, references);
+    collect(*expr.as<ast::ArrayAccess>().index, references);
+    return;
+  case ast::ExprKind::FIELD_ACCESS:
+    collect(*expr.as<ast::FieldAccess>().object, references);
+    return;
+  case ast::ExprKind::VALUE_AT:
+    collect(*expr.as<ast::ValueAt>().pointer, references);
+    return;
+  case ast::ExprKind::ADDRESS_OF:
+    collect(*expr.as<ast::AddressOf>().operand, references);
+    return;
+  case ast::ExprKind::TYPECAST:
+    collect(*expr.as<ast::TypeCast>().operand, references);
+    return;
+  default:
+    return;
+  }
+}
+
+static void collect(const ast::Stmt &stmt, References &references) {
+  switch (stmt.kind) {
+  case ast::StmtKind::BLOCK:
+    for (const ast::StmtPtr &inner : stmt.as<ast::Block>().stmts)
+      collect(*inner, references);
+    return;
+  case ast::StmtKind::WHILE:
+    collect(*stmt.as<ast::While>().cond, references);
+    collect(*stmt.as<ast::While>().body, references);
+    return;
+  case ast::StmtKind::IF: {
+    const ast::If &branch{stmt.as<ast::If>()};
+    collect(*branch.cond, references);
+    collect(*branch.then, references);
+    if (branch.otherwise)
+      collect(*branch.otherwise, references);
+    return;
+  }
+  case ast::StmtKind::RETURN:
+    if (stmt.as<ast::Return>().value)
+      collect(*stmt.as<ast::Return>().value, references);
+    return;
+  case ast::StmtKind::ASSIGN:
+    collect(*stmt.as<ast::Assign>().lhs, references);
+    collect(*stmt.as<ast::Assign>().rhs, references);
+    return;
+  case ast::StmtKind::EXPR:
+    collect(*stmt.as<ast::ExprStmt>().expr, references);
+    return;
+  }
+}
+
+// 128-bit hash in hexadecimal: two FNV-1a lanes, the second of which also
+// takes in the first as it goes.
+class Hasher {
+private:
+  uint64_t high{14695981039346656037u};
+  uint64_t low{0x6c62272e07bb0142u};
+
+  void mix(uint8_t byte) {
+    high = (high ^ byte) * 1099511628211u;
+    low = (low ^ byte) * 1099511628211u + high;
+  }
+
+public:
+  // Adds `bytes` followed by a separator.
+  void add(std::string_view bytes) {
+    for (char c : bytes)
+      mix(static_cast<uint8_t>(c));
+    mix(0xff);
+  }
+  void add(uint64_t value) {
+    add(std::string_view{reinterpret_cast<const char *>(&value),
+                         sizeof(value)});
+  }
+  std::string hex() const { return std::format("{:016x}{:016x}", high, low); }
+};
+
+// dl_iterate_phdr callback copying the GNU build ID note of the executable,
+// the first object visited, into the std::string at `data`.
+static int findBuildId(dl_phdr_info *info, size_t, void *data) {
+  for (ElfW(Half) i = 0; i < info->dlpi_phnum; i++) {
+    const ElfW(Phdr) &header{info->dlpi_phdr[i]};
+    if (header.p_type != PT_NOTE)
+      continue;
+    size_t align{std::max<size_t>(header.p_align, 4)};
+    auto padded{[&](size_t size) { return (size + align - 1) & ~(align - 1); }};
+    const char *note{
+        reinterpret_cast<const char *>(info->dlpi_addr + header.p_vaddr)};
+    const char *end{note + header.p_memsz};
+    while (note + sizeof(ElfW(Nhdr)) <= end) {
+      const auto *noteHeader{reinterpret_cast<const ElfW(Nhdr) *>(note)};
+      const char *name{note + sizeof(ElfW(Nhdr))};
+      const char *descriptor{name + padded(noteHeader->n_namesz)};
+      if (noteHeader->n_type == NT_GNU_BUILD_ID &&
+          noteHeader->n_namesz == 4 && std::memcmp(name, "GNU", 4) == 0) {
+        static_cast<std::string *>(data)->assign(descriptor,
+                                                 noteHeader->n_descsz);
+        return 1;
+      }
+      note = descriptor + padded(noteHeader->n_descsz);
+    }
+  }
+  return 1;
+}
+
+// Tells apart the compilers that wrote entries, so that one built from any
+// other code never reuses them: the entry format and the linker's build ID
+// of the running compiler, or a hash of its executable if it was linked
+// without one. Worked out once.
+static const std::string &compilerIdentity() {
+  static const std::string identity{[] {
+    Hasher hasher;
+    hasher.add(FORMAT_VERSION);
+    std::string buildId;
+    dl_iterate_phdr(findBuildId, &buildId);
+    if (!buildId.empty()) {
+      hasher.add(buildId);
+      return hasher.hex();
+    }
+    std::ifstream executable("/proc/self/exe", std::ios::binary);
+    std::vector<char> chunk(1 << 16);
+    while (executable.read(chunk.data(),
+                           static_cast<std::streamsize>(chunk.size())) ||
+           executable.gcount() > 0)
+      hasher.add(std::string_view{
+          chunk.data(), static_cast<size_t>(executable.gcount())});
+    return hasher.hex();
+  }()};
+  return identity;
+}
+
+FunctionCache::FunctionCache(std::filesystem::path directory,
+                             const ast::Program &program,
+                             std::string_view options)
+    : directory(std::move(directory)), program(program) {
+  analyse(options);
+}
+
+// Finds what each function depends on and derives its key. Functions and
+// globals are the nodes of a graph in which a function leads to its callees
+// and to the globals it refers to, and a global leads to all the functions
+// referring to it; a function depends on everything it leads to.
+void FunctionCache::analyse(std::string_view options) {
+  size_t functionCount{program.functions.size()};
+  size_t globalCount{program.globals.size()};
+  std::unordered_map<const ast::FunDecl *, uint32_t> functionIndex;
+  std::unordered_map<const ast::VarDecl *, uint32_t> globalIndex;
+  for (size_t i = 0; i < functionCount; i++)
+    functionIndex.emplace(program.functions[i].get(), static_cast<uint32_t>(i));
+  for (size_t i = 0; i < globalCount; i++)
+    globalIndex.emplace(program.globals[i].get(), static_cast<uint32_t>(i));
+
+  // nodes: functions, then globals
+  std::vector<std::vector<uint32_t>> edges(functionCount + globalCount);
+  for (size_t i = 0; i < functionCount; i++) {
+    References references;
+    if (program.functions[i]->body)
+      collect(*program.functions[i]->body, references);
+    for (const ast::FunDecl *callee : references.callees) {
+      auto found{functionIndex.find(callee)};
+      if (found != functionIndex.end())
+        edges[i].push_back(found->second);
+    }
+    for (const ast::VarDecl *global : references.globals) {
+      uint32_t node{static_cast<uint32_t>(functionCount) +
+                    globalIndex.at(global)};
+      edges[i].push_back(node);
+      edges[node].push_back(static_cast<uint32_t>(i));
+    }
+  }
+
+  // what every key starts with
+  Hasher common;
+  common.add(compilerIdentity());
+  common.add(options);
+  for (const std::string &include : program.includes)
+    common.add(include);
+  for (const ast::StructDeclPtr &decl : program.structs)
+    common.add(decl->tokenHash);
+
+  keys.assign(functionCount, {});
+  dependencies.assign(functionCount, {});
+  std::vector<uint32_t> visited(edges.size(), UINT32_MAX);
+  for (uint32_t i = 0; i < functionCount; i++) {
+    std::vector<uint32_t> reached{i};
+    visited[i] = i;
+    for (size_t next = 0; next < reached.size(); next++)
+      for (uint32_t node : edges[reached[next]])
+        if (visited[node] != i) {
+          visited[node] = i;
+          reached.push_back(node);
+        }
+    // names order the dependencies independently of where they are
+    std::vector<std::pair<std::string_view, uint64_t>> named;
+    for (uint32_t node : reached) {
+      if (node < functionCount) {
+        dependencies[i].push_back(node);
+        named.emplace_back(program.functions[node]->name,
+                           program.functions[node]->tokenHash);
+      } else {
+        const ast::VarDecl &global{*program.globals[node - functionCount]};
+        named.emplace_back(global.name, global.tokenHash);
+      }
+    }
+    std::ranges::sort(named);
+
+    Hasher key{common};
+    key.add(program.functions[i]->name);
+    for (auto [name, tokenHash] : named) {
+      key.add(name);
+      key.add(tokenHash);
+    }
+    keys[i] = key.hex();
+  }
+}
+
+// Entries are binary files of little-endian integers and length-prefixed
+// strings holding the identity of the compiler, the symbols and then the
+// instructions.
+
+template <class T> static void put(std::ostream &out, T value) {
+  static_assert(std::is_trivially_copyable_v<T>);
+  out.write(reinterpret_cast<const char *>(&value), sizeof(value));
+}
+
+static void put(std::ostream &out, const std::string &string) {
+  put(out, static_cast<uint32_t>(string.size()));
+  out.write(string.data(), static_cast<std::streamsize>(string.size()));
+}
+
+static void put(std::ostream &out, const Operand &operand) {
+  put(out, operand.kind);
+  put(out, operand.reg);
+  put(out, operand.index);
+  put(out, operand.scale);
+  put(out, operand.disp);
+  put(out, operand.imm);
+}
+
+template <class T> static bool get(std::istream &in, T &value) {
+  static_assert(std::is_trivially_copyable_v<T>);
+  return static_cast<bool>(
+      in.read(reinterpret_cast<char *>(&value), sizeof(value)));
+}
+
+static bool get(std::istream &in, std::string &string) {
+  uint32_t size;
+  if (!get(in, size) || size > (1u << 24))
+    return false;
+  string.resize(size);
+  return static_cast<bool>(in.read(string.data(), size));
+}
+
+static bool get(std::istream &in, Operand &operand) {
+  return get(in, operand.kind) && get(in, operand.reg) &&
+         get(in, operand.index) && get(in, operand.scale) &&
+         get(in, operand.disp) && get(in, operand.imm);
+}
+
+// The symbol an operand refers to, if any.
+static int64_t *symbolOf(Operand &operand) {
+  if (operand.kind == Operand::Kind::SYMBOL ||
+      (operand.kind == Operand::Kind::MEM && operand.reg == codegen::Reg::RIP))
+    return &operand.imm;
+  return nullptr;
+}
+
+bool FunctionCache::load(size_t function) {
+  std::ifstream in(directory / keys[function], std::ios::binary);
+  if (!in.is_open())
+    return false;
+
+  Entry entry;
+  std::string identity;
+  uint32_t symbolCount;
+  if (!get(in, identity) || identity != compilerIdentity() ||
+      !get(in, symbolCount) || symbolCount > (1u << 20))
+    return false;
+  entry.symbols.resize(symbolCount);
+  for (Symbol &symbol : entry.symbols)
+    if (!get(in, symbol.name) || !get(in, symbol.kind) ||
+        !get(in, symbol.defined) || !get(in, symbol.size) ||
+        !get(in, symbol.align) || !get(in, symbol.bytes))
+      return false;
+
+  uint32_t codeSize;
+  if (!get(in, entry.function.symbol) || !get(in, entry.function.labelCount) ||
+      !get(in, codeSize) || codeSize > (1u << 24))
+    return false;
+  entry.function.code.resize(codeSize);
+  for (MInst &inst : entry.function.code) {
+    if (!get(in, inst.op) || !get(in, inst.size) || !get(in, inst.srcSize) ||
+        !get(in, inst.cond) || !get(in, inst.dst) || !get(in, inst.src))
+      return false;
+    for (Operand *operand : {&inst.dst, &inst.src}) {
+      int64_t *symbol{symbolOf(*operand)};
+      if (symbol != nullptr &&
+          (*symbol < 0 || static_cast<uint64_t>(*symbol) >= symbolCount))
+        return false;
+    }
+  }
+  if (entry.function.symbol >= symbolCount)
+    return false;
+  entries[function] = std::move(entry);
+  return true;
+}
+
+// Written under a temporary name first so that concurrent builds never see
+// half an entry.
+void FunctionCache::store(size_t function) const {
+  const Entry &entry{entries[function]};
+  std::filesystem::path path{directory / keys[function]};
+  std::filesystem::path temporary{path};
+  temporary += std::format(".{}", getpid());
+  {
+    std::ofstream out(temporary, std::ios::binary);
+    put(out, compilerIdentity());
+    put(out, static_cast<uint32_t>(entry.symbols.size()));
+    for (const Symbol &symbol : entry.symbols) {
+      put(out, symbol.name);
+      put(out, symbol.kind);
+      put(out, symbol.defined);
+      put(out, symbol.size);
+      put(out, symbol.align);
+      put(out, symbol.bytes);
+    }
+    put(out, entry.function.symbol);
+    put(out, entry.function.labelCount);
+    put(out, static_cast<uint32_t>(entry.function.code.size()));
+    for (const MInst &inst : entry.function.code) {
+      put(out, inst.op);
+      put(out, inst.size);
+      put(out, inst.srcSize);
+      put(out, inst.cond);
+      put(out, inst.dst);
+      put(out, inst.src);
+    }
+    if (!out)
+      return;
+  }
+  std::error_code error;
+  std::filesystem::rename(temporary, path, error);
+  if (error)
+    std::filesystem::remove(temporary, error);
+}
+
+std::vector<bool> FunctionCache::lookup() {
+  size_t count{program.functions.size()};
+  entries.assign(count, {});
+  found.assign(count, false);
+  std::vector<bool> selected(count, false);
+  reused = 0;
+  for (size_t i = 0; i < count; i++) {
+    found[i] = load(i);
+    if (found[i])
+      reused++;
+    else
+      for (uint32_t dependency : dependencies[i])
+        selected[dependency] = true;
+  }
+  return selected;
+}
+
+void FunctionCache::link(const codegen::MachineModule &compiled,
+                         codegen::MachineModule &machine) {
+  std::unordered_map<std::string_view, size_t> byName;
+  for (size_t i = 0; i < program.functions.size(); i++)
+    byName.emplace(program.functions[i]->name, i);
+
+  // new entries, numbering the symbols in order of first use
+  std::error_code error;
+  std::filesystem::create_directories(directory, error);
+  for (const MachineFunction &function : compiled.functions) {
+    size_t index{byName.at(compiled.symbols[function.symbol].name)};
+    if (found[index])
+      continue;
+    Entry &entry{entries[index]};
+    std::unordered_map<int64_t, uint32_t> local;
+    auto number{[&](int64_t symbol) {
+      auto [position, fresh]{local.try_emplace(
+          symbol, static_cast<uint32_t>(entry.symbols.size()))};
+      if (fresh)
+        entry.symbols.push_back(compiled.symbols[symbol]);
+      return position->second;
+    }};
+    entry.function = function;
+    entry.function.symbol = number(function.symbol);
+    for (MInst &inst : entry.function.code)
+      for (Operand *operand : {&inst.dst, &inst.src})
+        if (int64_t *symbol{symbolOf(*operand)})
+          *symbol = number(*symbol);
+    found[index] = true;
+    store(index);
+  }
+
+  // only what main reaches goes into the program, as the partial modules
+  // keep every function
+  std::vector<bool> reachable(program.functions.size(), false);
+  std::vector<size_t> worklist;
+  auto main{byName.find("main")};
+  if (main == byName.end())
+    reachable.assign(reachable.size(), true);
+  else {
+    reachable[main->second] = true;
+    worklist.push_back(main->second);
+  }
+  while (!worklist.empty()) {
+    const Entry &entry{entries[worklist.back()]};
+    worklist.pop_back();
+    for (const Symbol &symbol : entry.symbols) {
+      auto callee{byName.find(symbol.name)};
+      if (symbol.kind != SymbolKind::FUNCTION || callee == byName.end() ||
+          reachable[callee->second])
+        continue;
+      reachable[callee->second] = true;
+      worklist.push_back(callee->second);
+    }
+  }
+
+  // symbols are merged by name, string constants by their bytes
+  std::map<std::string, uint32_t> named;
+  std::map<std::string, uint32_t> strings;
+  auto intern{[&](const Symbol &symbol) {
+    bool rodata{symbol.kind == SymbolKind::RODATA};
+    auto [position, fresh]{
+        (rodata ? strings : named)
+            .try_emplace(rodata ? symbol.bytes : symbol.name,
+                         static_cast<uint32_t>(machine.symbols.size()))};
+    if (fresh) {
+      machine.symbols.push_back(symbol);
+      if (rodata)
+        machine.symbols.back().name =
+            std::format(".Lstr{}", strings.size() - 1);
+    }
+    machine.symbols[position->second].defined |= symbol.defined;
+    return position->second;
+  }};
+
+  for (size_t i = 0; i < program.functions.size(); i++) {
+    if (!reachable[i])
+      continue;
+    const Entry &entry{entries[i]};
+    std::vector<uint32_t> global;
+    for (const Symbol &symbol : entry.symbols)
+      global.push_back(intern(symbol));
+    MachineFunction function{entry.function};
+    function.symbol = global[function.symbol];
+    for (MInst &inst : function.code)
+      for (Operand *operand : {&inst.dst, &inst.src})
+        if (int64_t *symbol{symbolOf(*operand)})
+          *symbol = global[static_cast<size_t>(*symbol)];
+    machine.functions.push_back(std::move(function));
+  }
+}
+
+} // namespace cache
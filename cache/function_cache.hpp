@@ -0,0 +1,73 @@
+#ifndef FUNCTION_CACHE_H
+#define FUNCTION_CACHE_H
+
+#include "../ast/ast.hpp"
+#include "../codegen/x86.hpp"
+#include <cstdint>
+#include <filesystem>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace cache {
+
+constexpr std::string_view DEFAULT_DIRECTORY{".minic-cache"};
+
+// Incremental compilation a function at a time. The machine code of every
+// function is kept in a directory under a key made of the token hashes of
+// all that its code depends on: the function itself, the functions it
+// calls, the globals it refers to, the other functions referring to those
+// globals (they decide what the optimiser may assume about them), and so on
+// transitively, plus the struct declarations and the options. A build looks
+// every function up, compiles only those missing together with their
+// dependencies as a partial module (ir::Module::partial), and takes the code
+// of all the others from the cache, so that the work done scales with the
+// size of an edit rather than with the size of the file.
+class FunctionCache {
+private:
+  // A function's machine code with the symbols it refers to, numbered
+  // within the entry.
+  struct Entry {
+    std::vector<codegen::Symbol> symbols;
+    codegen::MachineFunction function;
+  };
+
+  std::filesystem::path directory;
+  const ast::Program &program;
+  // indexed like program.functions
+  std::vector<std::string> keys;
+  std::vector<std::vector<uint32_t>> dependencies;
+  std::vector<Entry> entries;
+  std::vector<bool> found;
+  size_t reused{0};
+
+  void analyse(std::string_view options);
+  bool load(size_t function);
+  void store(size_t function) const;
+
+public:
+  FunctionCache(std::filesystem::path directory, const ast::Program &program,
+                std::string_view options);
+
+  // Reads the cached functions and returns which functions of
+  // program.functions must be compiled: those not in the cache and what
+  // they depend on.
+  std::vector<bool> lookup();
+  // Stores the code of the functions that were not in the cache, taken from
+  // `compiled`, and puts the program together from the compiled and the
+  // cached functions into `machine`. Functions main cannot reach are left
+  // out.
+  void link(const codegen::MachineModule &compiled,
+            codegen::MachineModule &machine);
+
+  // Whether the code of program.functions[function] came from the cache;
+  // such functions are compiled only for what their callers learn from
+  // them and need no code generated.
+  bool isCached(size_t function) const { return found[function]; }
+  // Functions whose code came from the cache.
+  size_t getReusedCount() const { return reused; }
+};
+
+} // namespace cache
+
+#endif
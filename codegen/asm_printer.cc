@@ -0,0 +1,249 @@
+#include "asm_printer.hpp"
+#include <format>
+
+namespace codegen {
+
+static char suffix(int size) {
+  switch (size) {
+  case 1:
+    return 'b';
+  case 2:
+    return 'w';
+  case 4:
+    return 'l';
+  default:
+    return 'q';
+  }
+}
+
+static std::string_view mnemonic(MOp op) {
+  switch (op) {
+  case MOp::MOV:
+    return "mov";
+  case MOp::MOVSX:
+    return "movs";
+  case MOp::MOVZX:
+    return "movz";
+  case MOp::LEA:
+    return "lea";
+  case MOp::ADD:
+    return "add";
+  case MOp::SUB:
+    return "sub";
+  case MOp::IMUL:
+    return "imul";
+  case MOp::AND:
+    return "and";
+  case MOp::OR:
+    return "or";
+  case MOp::XOR:
+    return "xor";
+  case MOp::CMP:
+    return "cmp";
+  case MOp::TEST:
+    return "test";
+  case MOp::NEG:
+    return "neg";
+  case MOp::IDIV:
+    return "idiv";
+  case MOp::CDQ:
+    return "cltd";
+  case MOp::CQO:
+    return "cqto";
+  case MOp::SETCC:
+    return "set";
+  case MOp::JMP:
+    return "jmp";
+  case MOp::JCC:
+    return "j";
+  case MOp::CALL:
+    return "call";
+  case MOp::RET:
+    return "ret";
+  case MOp::PUSH:
+    return "push";
+  case MOp::POP:
+    return "pop";
+  case MOp::MOVDQU:
+    return "movdqu";
+  case MOp::MOVD:
+    return "movd";
+  case MOp::PSHUFD:
+    return "pshufd";
+  case MOp::PADDB:
+    return "paddb";
+  case MOp::PADDD:
+    return "paddd";
+  case MOp::PSUBB:
+    return "psubb";
+  case MOp::PSUBD:
+    return "psubd";
+  case MOp::LABEL:
+    return "";
+  }
+  return "?";
+}
+
+static std::string label(const MachineFunction &function, int64_t id) {
+  return std::format(".L{}_{}", function.symbol, id);
+}
+
+static std::string operand(const MachineModule &module,
+                           const MachineFunction &function, const Operand &op,
+                           int size) {
+  switch (op.kind) {
+  case Operand::Kind::NONE:
+    return "";
+  case Operand::Kind::REG:
+    return std::format("%{}", regName(op.reg, size));
+  case Operand::Kind::IMM:
+    return std::format("${}", op.imm);
+  case Operand::Kind::LABEL:
+    return label(function, op.imm);
+  case Operand::Kind::SYMBOL:
+    return module.symbols[op.imm].name;
+  case Operand::Kind::MEM: {
+    if (op.reg == Reg::RIP) {
+      std::string name{module.symbols[op.imm].name};
+      if (op.disp != 0)
+        name += std::format("{:+}", op.disp);
+      return name + "(%rip)";
+    }
+    std::string result{op.disp != 0 ? std::format("{}", op.disp) : ""};
+    result += std::format("(%{}", regName(op.reg, 8));
+    if (op.index != Reg::NONE)
+      result += std::format(",%{},{}", regName(op.index, 8), op.scale);
+    return result + ")";
+  }
+  }
+  return "";
+}
+
+static std::string escape(std::string_view bytes) {
+  std::string result;
+  for (char c : bytes) {
+    unsigned char byte{static_cast<unsigned char>(c)};
+    if (c == '"' || c == '\\')
+      result += std::string{'\\', c};
+    else if (byte < 0x20 || byte >= 0x7f)
+      result += {'\\', static_cast<char>('0' + (byte >> 6)),
+                 static_cast<char>('0' + (byte >> 3 & 7)),
+                 static_cast<char>('0' + (byte & 7))};
+    else
+      result += c;
+  }
+  return result;
+}
+
+void printFunction(std::ostream &out, const MachineModule &module,
+                   const MachineFunction &function) {
+  for (const MInst &inst : function.code) {
+    std::string_view name{mnemonic(inst.op)};
+
+    switch (inst.op) {
+    case MOp::LABEL:
+      out << label(function, inst.dst.imm) << ":\n";
+      continue;
+    case MOp::CDQ:
+    case MOp::CQO:
+    case MOp::RET:
+      out << "\t" << name << "\n";
+      continue;
+    case MOp::SETCC:
+      out << std::format("\tset{} {}\n", toString(inst.cond),
+                         operand(module, function, inst.dst, 1));
+      continue;
+    case MOp::JCC:
+      out << std::format("\tj{} {}\n", toString(inst.cond),
+                         operand(module, function, inst.dst, 8));
+      continue;
+    case MOp::JMP:
+    case MOp::CALL:
+      out << std::format("\t{} {}\n", name,
+                         operand(module, function, inst.dst, 8));
+      continue;
+    case MOp::MOVSX:
+    case MOp::MOVZX:
+      // AT&T spells these with both sizes, e.g. movsbl, movzbl, movslq
+      out << std::format("\t{}{}{} {}, {}\n", name, suffix(inst.srcSize),
+                         suffix(inst.size),
+                         operand(module, function, inst.src, inst.srcSize),
+                         operand(module, function, inst.dst, inst.size));
+      continue;
+    case MOp::MOVDQU:
+    case MOp::MOVD:
+    case MOp::PADDB:
+    case MOp::PADDD:
+    case MOp::PSUBB:
+    case MOp::PSUBD:
+      // the operand types give the size; movd's register is 32-bit
+      out << std::format("\t{} {}, {}\n", name,
+                         operand(module, function, inst.src, 4),
+                         operand(module, function, inst.dst, 4));
+      continue;
+    case MOp::PSHUFD:
+      out << std::format("\t{} ${}, {}, {}\n", name, inst.srcSize,
+                         operand(module, function, inst.src, 4),
+                         operand(module, function, inst.dst, 4));
+      continue;
+    default:
+      break;
+    }
+
+    if (inst.src.kind == Operand::Kind::NONE)
+      out << std::format("\t{}{} {}\n", name, suffix(inst.size),
+                         operand(module, function, inst.dst, inst.size));
+    else
+      out << std::format("\t{}{} {}, {}\n", name, suffix(inst.size),
+                         operand(module, function, inst.src, inst.size),
+                         operand(module, function, inst.dst, inst.size));
+  }
+}
+
+void printDefinition(std::ostream &out, const MachineModule &module,
+                     const MachineFunction &function) {
+  const std::string &name{module.symbols[function.symbol].name};
+  out << "\n";
+  if (name == "main")
+    out << "\t.globl main\n";
+  out << std::format("\t.type {}, @function\n{}:\n", name, name);
+  printFunction(out, module, function);
+  out << std::format("\t.size {}, .-{}\n", name, name);
+}
+
+void printData(std::ostream &out, const MachineModule &module) {
+  bool rodata{false};
+  for (const Symbol &symbol : module.symbols) {
+    if (symbol.kind != SymbolKind::RODATA)
+      continue;
+    if (!rodata)
+      out << "\n\t.section .rodata\n";
+    rodata = true;
+    out << std::format("{}:\n\t.ascii \"{}\"\n", symbol.name,
+                       escape(symbol.bytes));
+  }
+
+  bool bss{false};
+  for (const Symbol &symbol : module.symbols) {
+    if (symbol.kind != SymbolKind::DATA)
+      continue;
+    if (!bss)
+      out << "\n\t.bss\n";
+    bss = true;
+    out << std::format("\t.balign {}\n\t.type {}, @object\n\t.size {}, {}\n"
+                       "{}:\n\t.zero {}\n",
+                       symbol.align, symbol.name, symbol.name, symbol.size,
+                       symbol.name, symbol.size);
+  }
+
+  out << "\n\t.section .note.GNU-stack,\"\",@progbits\n";
+}
+
+void printAssembly(std::ostream &out, const MachineModule &module) {
+  out << "\t.text\n";
+  for (const MachineFunction &function : module.functions)
+    printDefinition(out, module, function);
+  printData(out, module);
+}
+
+} // namespace codegen
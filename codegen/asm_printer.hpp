@@ -0,0 +1,22 @@
+#ifndef ASM_PRINTER_H
+#define ASM_PRINTER_H
+
+#include "x86.hpp"
+#include <ostream>
+
+namespace codegen {
+
+// Prints GNU assembler (AT&T syntax) source for a machine module.
+void printAssembly(std::ostream &out, const MachineModule &module);
+void printFunction(std::ostream &out, const MachineModule &module,
+                   const MachineFunction &function);
+// The parts of printAssembly after the .text directive, for printing
+// functions as they are generated: each function with its symbol
+// directives, then the strings and globals.
+void printDefinition(std::ostream &out, const MachineModule &module,
+                     const MachineFunction &function);
+void printData(std::ostream &out, const MachineModule &module);
+
+} // namespace codegen
+
+#endif
@@ -0,0 +1,898 @@
+#include "codegen.hpp"
+#include "peephole.hpp"
+#include <algorithm>
+#include <format>
+#include <functional>
+
+namespace codegen {
+
+using ir::BlockId;
+using ir::Op;
+using ir::Value;
+
+constexpr Reg ARGUMENT_REGISTERS[]{Reg::RDI, Reg::RSI, Reg::RDX,
+                                   Reg::RCX, Reg::R8,  Reg::R9};
+
+// Aggregate copies up to REGISTER_COPY_LIMIT bytes are unrolled into general
+// purpose register moves, those up to VECTOR_COPY_LIMIT into 16-byte SSE
+// moves, and larger ones call memcpy.
+constexpr int64_t REGISTER_COPY_LIMIT{64};
+constexpr int64_t VECTOR_COPY_LIMIT{512};
+
+static bool isLibraryCopy(const ir::Inst &inst) {
+  return inst.op == Op::MEMCPY && inst.imm > VECTOR_COPY_LIMIT;
+}
+
+static int32_t roundUp(int32_t value, int32_t align) {
+  return (value + align - 1) / align * align;
+}
+
+CodeGenerator::CodeGenerator(const ir::Module &module, MachineModule &machine)
+    : module(module), machine(machine) {
+  for (const std::unique_ptr<ir::Function> &function : module.functions)
+    machine.symbols.push_back(
+        {function->name, SymbolKind::FUNCTION, !function->external, 0, 1, {}});
+
+  globalBase = static_cast<uint32_t>(machine.symbols.size());
+  for (const ir::Global &global : module.globals)
+    machine.symbols.push_back(
+        {global.name, SymbolKind::DATA, true, global.size, global.align, {}});
+
+  memcpySymbol = static_cast<uint32_t>(machine.symbols.size());
+  machine.symbols.push_back({"memcpy", SymbolKind::FUNCTION, false, 0, 1, {}});
+
+  stringBase = static_cast<uint32_t>(machine.symbols.size());
+  declareStrings();
+}
+
+void CodeGenerator::declareStrings() {
+  for (size_t i = machine.symbols.size() - stringBase;
+       i < module.strings.size(); i++)
+    machine.symbols.push_back({std::format(".Lstr{}", i), SymbolKind::RODATA,
+                               true,
+                               static_cast<int>(module.strings[i].size() + 1),
+                               1, module.strings[i] + '\0'});
+}
+
+void CodeGenerator::generate(support::ThreadPool *pool) {
+  std::vector<uint32_t> defined;
+  for (uint32_t i = 0; i < module.functions.size(); i++)
+    if (!module.functions[i]->external)
+      defined.push_back(i);
+  std::vector<MachineFunction> results(defined.size());
+  if (pool == nullptr) {
+    for (size_t i = 0; i < defined.size(); i++)
+      results[i] = generate(*module.functions[defined[i]], defined[i]);
+  } else {
+    // each task works on a copy of the generator's per-function state, and
+    // the functions are added in source order whichever finishes first
+    std::vector<std::function<void()>> tasks;
+    for (size_t i = 0; i < defined.size(); i++)
+      tasks.push_back([&, i] {
+        CodeGenerator worker{*this};
+        uint32_t index{defined[i]};
+        results[i] = worker.generate(*module.functions[index], index);
+      });
+    pool->run(std::move(tasks));
+  }
+  // keep the code that runs together, away from the code that does not
+  std::ranges::stable_partition(results, [&](const MachineFunction &result) {
+    const ir::Function &fn{*module.functions[result.symbol]};
+    return !fn.profiled || fn.blocks[0].count != 0;
+  });
+  for (MachineFunction &result : results)
+    machine.functions.push_back(std::move(result));
+}
+
+void CodeGenerator::emit(MOp op, int size, Operand dst, Operand src) {
+  out->code.push_back({op, static_cast<uint8_t>(size), 0, Cond::E, dst, src});
+}
+
+void CodeGenerator::emitCond(MOp op, Cond cond, Operand dst) {
+  out->code.push_back({op, 1, 0, cond, dst, {}});
+}
+
+// A stack slot or symbol address, or one plus a constant offset, which an
+// addressing mode can form without a register.
+bool CodeGenerator::isAddress(Value value) const {
+  auto isBase{[&](Op op) {
+    return op == Op::ALLOCA || op == Op::GLOBAL || op == Op::STRING;
+  }};
+  const ir::Inst &inst{function->insts[value]};
+  if (inst.op != Op::ADD || inst.type != ir::Type::PTR)
+    return isBase(inst.op);
+  const ir::Inst &offset{function->insts[inst.b]};
+  return isBase(function->insts[inst.a].op) && offset.op == Op::CONST &&
+         offset.imm == static_cast<int32_t>(offset.imm);
+}
+
+bool CodeGenerator::isRematerialised(Value value) const {
+  return function->insts[value].op == Op::CONST || isAddress(value);
+}
+
+Operand CodeGenerator::slot(int32_t index) const {
+  return Operand::mem(Reg::RBP, spillBase - 8 * (index + 1));
+}
+
+Operand CodeGenerator::location(Value value) const {
+  bool vector{function->insts[value].type == ir::Type::VEC};
+  const Location &loc{vector ? vectors.locations[value]
+                             : allocation.locations[value]};
+  if (loc.kind == Location::Kind::REG)
+    return Operand::ofReg(loc.reg);
+  if (loc.kind == Location::Kind::STACK)
+    return vector ? Operand::mem(Reg::RBP, vectorBase - 16 * (loc.slot + 1))
+                  : slot(loc.slot);
+  return {};
+}
+
+// Memory operand addressing the location `value` points to.
+Operand CodeGenerator::addressOf(Value value, Reg scratch) {
+  const ir::Inst &inst{function->insts[value]};
+  switch (inst.op) {
+  case Op::ALLOCA:
+    return Operand::mem(Reg::RBP, frameOffset[value]);
+  case Op::GLOBAL:
+    return Operand::symbolMem(globalBase + static_cast<uint32_t>(inst.imm));
+  case Op::STRING:
+    return Operand::symbolMem(stringBase + static_cast<uint32_t>(inst.imm));
+  default:
+    if (isAddress(value)) {
+      Operand base{addressOf(inst.a, scratch)};
+      base.disp += static_cast<int32_t>(function->insts[inst.b].imm);
+      return base;
+    }
+    return Operand::mem(inRegister(value, scratch, 8), 0);
+  }
+}
+
+// Operand usable directly as an instruction source: a register, a spill slot
+// or an immediate. Addresses of stack slots and symbols have no such form.
+Operand CodeGenerator::source(Value value) {
+  const ir::Inst &inst{function->insts[value]};
+  if (inst.op == Op::CONST)
+    return Operand::ofImm(inst.imm);
+  return location(value);
+}
+
+void CodeGenerator::moveTo(Reg target, Value value, int size) {
+  const ir::Inst &inst{function->insts[value]};
+  switch (inst.op) {
+  case Op::CONST:
+    emit(MOp::MOV, size, Operand::ofReg(target), Operand::ofImm(inst.imm));
+    return;
+  default:
+    if (isAddress(value)) {
+      emit(MOp::LEA, 8, Operand::ofReg(target), addressOf(value, target));
+      return;
+    }
+    break;
+  }
+
+  Operand from{location(value)};
+  if (!from.isReg(target))
+    emit(MOp::MOV, 8, Operand::ofReg(target), from);
+}
+
+Reg CodeGenerator::inRegister(Value value, Reg scratch, int size) {
+  const Location &loc{allocation.locations[value]};
+  if (loc.kind == Location::Kind::REG)
+    return loc.reg;
+  moveTo(scratch, value, size);
+  return scratch;
+}
+
+Reg CodeGenerator::resultRegister(Value value, Reg fallback) const {
+  const Location &loc{allocation.locations[value]};
+  return loc.kind == Location::Kind::REG ? loc.reg : fallback;
+}
+
+void CodeGenerator::writeResult(Value value, Reg from) {
+  Operand to{location(value)};
+  if (to.kind == Operand::Kind::NONE || to.isReg(from))
+    return;
+  emit(MOp::MOV, 8, to, Operand::ofReg(from));
+}
+
+Reg CodeGenerator::inVector(Value value, Reg scratch) {
+  Operand from{location(value)};
+  if (from.isReg())
+    return from.reg;
+  emit(MOp::MOVDQU, 16, Operand::ofReg(scratch), from);
+  return scratch;
+}
+
+void CodeGenerator::writeVector(Value value, Reg from) {
+  Operand to{location(value)};
+  if (to.kind == Operand::Kind::NONE || to.isReg(from))
+    return;
+  emit(MOp::MOVDQU, 16, to, Operand::ofReg(from));
+}
+
+void CodeGenerator::analyse() {
+  const size_t count{function->insts.size()};
+  useCount.assign(count, 0);
+  fused.assign(count, false);
+
+  for (const ir::Block &block : function->blocks)
+    for (Value value : block.insts)
+      function->forEachOperand(value,
+                               [&](Value operand) { useCount[operand]++; });
+
+  // a compare used only by the branch right after it sets the flags for the
+  // branch directly instead of materialising a 0/1 value
+  for (const ir::Block &block : function->blocks) {
+    if (block.insts.size() < 2)
+      continue;
+    const ir::Inst &last{function->insts[block.insts.back()]};
+    Value cond{block.insts[block.insts.size() - 2]};
+    Op op{function->insts[cond].op};
+    if (last.op == Op::CONDBR && last.a == cond && useCount[cond] == 1 &&
+        op >= Op::EQ && op <= Op::GE)
+      fused[cond] = true;
+  }
+}
+
+void CodeGenerator::layoutFrame() {
+  int32_t saved{static_cast<int32_t>(allocation.usedCalleeSaved.size())};
+  int32_t offset{8 * saved};
+  frameOffset.assign(function->insts.size(), 0);
+
+  for (const ir::Block &block : function->blocks)
+    for (Value value : block.insts) {
+      const ir::Inst &inst{function->insts[value]};
+      if (inst.op != Op::ALLOCA)
+        continue;
+      offset = roundUp(offset + static_cast<int32_t>(inst.imm),
+                       std::max<int32_t>(inst.aux, 1));
+      frameOffset[value] = -offset;
+    }
+
+  offset = roundUp(offset, 8);
+  spillBase = -offset;
+  offset += 8 * allocation.spillSlots;
+  // vector slots are aligned for the SSE instructions reading them
+  offset = roundUp(offset, 16);
+  vectorBase = -offset;
+  offset += 16 * vectors.spillSlots;
+  // rbp is 16-byte aligned, keep rsp aligned for calls
+  frameSize = roundUp(offset, 16) - 8 * saved;
+}
+
+void CodeGenerator::prologue() {
+  emit(MOp::PUSH, 8, Operand::ofReg(Reg::RBP));
+  emit(MOp::MOV, 8, Operand::ofReg(Reg::RBP), Operand::ofReg(Reg::RSP));
+  for (Reg reg : allocation.usedCalleeSaved)
+    emit(MOp::PUSH, 8, Operand::ofReg(reg));
+  if (frameSize > 0)
+    emit(MOp::SUB, 8, Operand::ofReg(Reg::RSP), Operand::ofImm(frameSize));
+
+  std::vector<Move> moves;
+  for (Value value : function->blocks[0].insts) {
+    const ir::Inst &inst{function->insts[value]};
+    if (inst.op != Op::PARAM)
+      continue;
+    Operand to{location(value)};
+    if (to.kind == Operand::Kind::NONE)
+      continue;
+    if (inst.imm < 6)
+      moves.push_back({to, Operand::ofReg(ARGUMENT_REGISTERS[inst.imm])});
+    else
+      moves.push_back(
+          {to, Operand::mem(Reg::RBP,
+                            static_cast<int32_t>(16 + 8 * (inst.imm - 6)))});
+  }
+  parallelMoves(std::move(moves));
+}
+
+void CodeGenerator::epilogue() {
+  int32_t saved{static_cast<int32_t>(allocation.usedCalleeSaved.size())};
+  if (saved > 0)
+    emit(MOp::LEA, 8, Operand::ofReg(Reg::RSP),
+         Operand::mem(Reg::RBP, -8 * saved));
+  else
+    emit(MOp::MOV, 8, Operand::ofReg(Reg::RSP), Operand::ofReg(Reg::RBP));
+  for (auto reg = allocation.usedCalleeSaved.rbegin();
+       reg != allocation.usedCalleeSaved.rend(); ++reg)
+    emit(MOp::POP, 8, Operand::ofReg(*reg));
+  emit(MOp::POP, 8, Operand::ofReg(Reg::RBP));
+  emit(MOp::RET, 8);
+}
+
+void CodeGenerator::emitMove(const Move &move) {
+  if (move.vector) {
+    if (move.dst.isReg() || move.src.isReg()) {
+      emit(MOp::MOVDQU, 16, move.dst, move.src);
+      return;
+    }
+    emit(MOp::MOVDQU, 16, Operand::ofReg(Reg::XMM1), move.src);
+    emit(MOp::MOVDQU, 16, move.dst, Operand::ofReg(Reg::XMM1));
+    return;
+  }
+  if (move.dst.isReg()) {
+    emit(move.lea ? MOp::LEA : MOp::MOV, 8, move.dst, move.src);
+    return;
+  }
+  if (move.src.isReg() || move.src.isImm()) {
+    emit(MOp::MOV, 8, move.dst, move.src);
+    return;
+  }
+  // memory to memory goes through r11
+  emit(move.lea ? MOp::LEA : MOp::MOV, 8, Operand::ofReg(Reg::R11), move.src);
+  emit(MOp::MOV, 8, move.dst, Operand::ofReg(Reg::R11));
+}
+
+// Sequentialises a set of moves that semantically happen at once. A move is
+// safe to emit once no other pending move still reads its destination;
+// cycles are broken by parking one destination's old value in rax, or xmm0
+// for vectors.
+void CodeGenerator::parallelMoves(std::vector<Move> moves) {
+  std::erase_if(moves,
+                [](const Move &move) { return !move.lea && move.dst == move.src; });
+
+  while (!moves.empty()) {
+    auto ready{std::ranges::find_if(moves, [&](const Move &move) {
+      return std::ranges::none_of(moves, [&](const Move &other) {
+        return &other != &move && !other.lea && other.src == move.dst;
+      });
+    })};
+
+    if (ready != moves.end()) {
+      emitMove(*ready);
+      moves.erase(ready);
+      continue;
+    }
+
+    Operand blocked{moves.front().dst};
+    Operand parked{Operand::ofReg(Reg::RAX)};
+    if (moves.front().vector) {
+      parked = Operand::ofReg(Reg::XMM0);
+      emit(MOp::MOVDQU, 16, parked, blocked);
+    } else
+      emit(MOp::MOV, 8, parked, blocked);
+    for (Move &move : moves)
+      if (!move.lea && move.src == blocked)
+        move.src = parked;
+  }
+}
+
+bool CodeGenerator::hasPhis(BlockId block) const {
+  const ir::Block &target{function->blocks[block]};
+  return !target.insts.empty() &&
+         function->insts[target.insts.front()].op == Op::PHI;
+}
+
+std::vector<CodeGenerator::Move> CodeGenerator::phiMoves(BlockId from,
+                                                         BlockId to) {
+  std::vector<Move> moves;
+  const ir::Block &target{function->blocks[to]};
+  size_t predIndex{static_cast<size_t>(
+      std::ranges::find(target.preds, from) - target.preds.begin())};
+
+  for (Value phi : target.insts) {
+    if (function->insts[phi].op != Op::PHI)
+      break;
+    Operand dst{location(phi)};
+    if (dst.kind == Operand::Kind::NONE)
+      continue;
+    Value incoming{function->extraOperands(phi)[predIndex]};
+    if (isAddress(incoming))
+      moves.push_back({dst, addressOf(incoming, Reg::R11), true});
+    else
+      moves.push_back({dst, source(incoming), false,
+                       function->insts[phi].type == ir::Type::VEC});
+  }
+  return moves;
+}
+
+// Order to emit the blocks in. Without a profile that is reverse postorder.
+// With one, chains are grown from the hottest successor of each block so
+// that the likely path falls through, and blocks that never ran go after
+// all the others, out of the way of the instruction cache.
+std::vector<BlockId> CodeGenerator::layout() const {
+  const std::vector<BlockId> &order{allocation.order};
+  auto cold{[&](BlockId block) { return function->blocks[block].count == 0; }};
+  if (!function->profiled || cold(order[0]))
+    return order;
+
+  // how often `block` went on to its successor number `i`; blocks made
+  // after the profile was read count as running as often as their pred
+  auto weight{[&](BlockId block, size_t i) {
+    const ir::Block &from{function->blocks[block]};
+    uint64_t count{function->blocks[from.succs[i]].count};
+    if (from.succs.size() == 2 && from.taken != ir::NO_COUNT &&
+        from.count != ir::NO_COUNT) {
+      uint64_t taken{std::min(from.taken, from.count)};
+      count = i == 0 ? taken : from.count - taken;
+    }
+    if (count == ir::NO_COUNT)
+      count = from.count == ir::NO_COUNT ? 1 : from.count;
+    return count;
+  }};
+
+  std::vector<BlockId> result;
+  std::vector<bool> placed(function->blocks.size(), false);
+  for (BlockId seed : order) {
+    BlockId block{seed};
+    while (block != ir::NO_BLOCK && !placed[block] && !cold(block)) {
+      result.push_back(block);
+      placed[block] = true;
+      BlockId best{ir::NO_BLOCK};
+      uint64_t bestWeight{0};
+      const std::vector<BlockId> &succs{function->blocks[block].succs};
+      for (size_t i = 0; i < succs.size(); i++) {
+        uint64_t w{weight(block, i)};
+        if (!placed[succs[i]] && !cold(succs[i]) &&
+            (best == ir::NO_BLOCK || w > bestWeight)) {
+          best = succs[i];
+          bestWeight = w;
+        }
+      }
+      block = best;
+    }
+  }
+  for (BlockId block : order)
+    if (!placed[block])
+      result.push_back(block);
+  return result;
+}
+
+MachineFunction CodeGenerator::generate(const ir::Function &fn,
+                                        uint32_t index) {
+  MachineFunction result;
+  result.symbol = index;
+  function = &fn;
+  out = &result;
+
+  analyse();
+
+  std::vector<bool> allocatable(fn.insts.size(), false);
+  std::vector<bool> vector(fn.insts.size(), false);
+  std::vector<bool> clobbers(fn.insts.size(), false);
+  for (const ir::Block &block : fn.blocks)
+    for (Value value : block.insts) {
+      const ir::Inst &inst{fn.insts[value]};
+      bool needed{inst.hasResult() && !isRematerialised(value) &&
+                  !fused[value] && useCount[value] > 0};
+      vector[value] = needed && inst.type == ir::Type::VEC;
+      allocatable[value] = needed && !vector[value];
+      clobbers[value] = inst.op == Op::CALL || isLibraryCopy(inst);
+    }
+
+  allocation = LinearScan{fn, allocatable, clobbers}.run();
+  vectors = {};
+  if (std::ranges::find(vector, true) != vector.end())
+    vectors = LinearScan{fn, vector, clobbers, VECTOR_REGISTERS, {}}.run();
+  layoutFrame();
+
+  result.labelCount = static_cast<uint32_t>(fn.blocks.size());
+  prologue();
+
+  std::vector<Stub> stubs;
+  std::vector<BlockId> order{layout()};
+  for (size_t i = 0; i < order.size(); i++) {
+    BlockId block{order[i]};
+    BlockId next{i + 1 < order.size() ? order[i + 1] : ir::NO_BLOCK};
+    emit(MOp::LABEL, 0, Operand::ofLabel(block));
+    for (Value value : fn.blocks[block].insts) {
+      if (fn.insts[value].op == Op::CONDBR)
+        selectCondBranch(value, next, stubs);
+      else
+        select(value, next);
+    }
+  }
+
+  // edges into blocks with phis that leave a conditional branch get their
+  // moves in a stub so the branch itself stays a single jcc
+  for (const Stub &stub : stubs) {
+    emit(MOp::LABEL, 0, Operand::ofLabel(stub.label));
+    parallelMoves(phiMoves(stub.from, stub.to));
+    emit(MOp::JMP, 8, Operand::ofLabel(stub.to));
+  }
+
+  peephole(result);
+  return result;
+}
+
+void CodeGenerator::select(Value value, BlockId next) {
+  const ir::Inst &inst{function->insts[value]};
+  if (inst.type == ir::Type::VEC && inst.op != Op::PHI) {
+    selectVector(value);
+    return;
+  }
+  // formed where they are used
+  if (isAddress(value))
+    return;
+
+  switch (inst.op) {
+  case Op::NOP:
+  case Op::CONST:
+  case Op::PARAM:
+  case Op::GLOBAL:
+  case Op::STRING:
+  case Op::ALLOCA:
+  case Op::PHI:
+    return;
+
+  case Op::LOAD: {
+    if (allocation.locations[value].kind == Location::Kind::NONE)
+      return;
+    Operand address{addressOf(inst.a, Reg::R11)};
+    Reg target{resultRegister(value, Reg::RAX)};
+    if (inst.type == ir::Type::I8)
+      out->code.push_back(
+          {MOp::MOVZX, 4, 1, Cond::E, Operand::ofReg(target), address});
+    else
+      emit(MOp::MOV, ir::sizeOf(inst.type), Operand::ofReg(target), address);
+    writeResult(value, target);
+    return;
+  }
+
+  case Op::STORE: {
+    int size{ir::sizeOf(inst.type)};
+    Operand address{addressOf(inst.a, Reg::R11)};
+    const ir::Inst &stored{function->insts[inst.b]};
+    if (stored.op == Op::CONST) {
+      int64_t imm{size == 1 ? static_cast<int8_t>(stored.imm) : stored.imm};
+      emit(MOp::MOV, size, address, Operand::ofImm(imm));
+      return;
+    }
+    Reg reg{inRegister(inst.b, Reg::RAX, size)};
+    emit(MOp::MOV, size, address, Operand::ofReg(reg));
+    return;
+  }
+
+  case Op::MEMCPY:
+    selectCopy(value);
+    return;
+
+  case Op::ADD:
+  case Op::SUB:
+  case Op::MUL:
+    selectBinary(value);
+    return;
+
+  case Op::DIV:
+  case Op::REM:
+    selectDivision(value);
+    return;
+
+  case Op::EQ:
+  case Op::NE:
+  case Op::LT:
+  case Op::LE:
+  case Op::GT:
+  case Op::GE: {
+    if (fused[value] || allocation.locations[value].kind ==
+                            Location::Kind::NONE)
+      return;
+    Cond cond{selectCompare(value)};
+    Reg target{resultRegister(value, Reg::RAX)};
+    emitCond(MOp::SETCC, cond, Operand::ofReg(Reg::RAX));
+    out->code.push_back({MOp::MOVZX, 4, 1, Cond::E, Operand::ofReg(target),
+                         Operand::ofReg(Reg::RAX)});
+    writeResult(value, target);
+    return;
+  }
+
+  case Op::SEXT: {
+    if (allocation.locations[value].kind == Location::Kind::NONE)
+      return;
+    const ir::Inst &operand{function->insts[inst.a]};
+    Reg target{resultRegister(value, Reg::RAX)};
+    int size{ir::sizeOf(inst.type)};
+    if (operand.op == Op::CONST) {
+      int64_t imm{operand.type == ir::Type::I8
+                      ? static_cast<int8_t>(operand.imm)
+                      : static_cast<int32_t>(operand.imm)};
+      emit(MOp::MOV, size, Operand::ofReg(target), Operand::ofImm(imm));
+    } else {
+      Operand from{source(inst.a)};
+      out->code.push_back(
+          {MOp::MOVSX, static_cast<uint8_t>(size),
+           static_cast<uint8_t>(ir::sizeOf(operand.type)), Cond::E,
+           Operand::ofReg(target), from});
+    }
+    writeResult(value, target);
+    return;
+  }
+
+  case Op::TRUNC:
+  case Op::COPY: {
+    if (allocation.locations[value].kind == Location::Kind::NONE)
+      return;
+    Reg target{resultRegister(value, Reg::RAX)};
+    moveTo(target, inst.a, inst.op == Op::TRUNC ? 4 : 8);
+    writeResult(value, target);
+    return;
+  }
+
+  case Op::SPLAT:
+  case Op::REDUCE:
+    selectVector(value);
+    return;
+
+  case Op::CALL:
+    selectCall(value);
+    return;
+
+  case Op::BR: {
+    BlockId target{function->blocks[inst.block].succs[0]};
+    if (hasPhis(target))
+      parallelMoves(phiMoves(inst.block, target));
+    if (target != next)
+      emit(MOp::JMP, 8, Operand::ofLabel(target));
+    return;
+  }
+
+  case Op::CONDBR:
+    return;
+
+  case Op::RET:
+    if (inst.a != ir::NO_VALUE)
+      moveTo(Reg::RAX, inst.a, ir::sizeOf(function->insts[inst.a].type) == 8
+                                   ? 8
+                                   : 4);
+    epilogue();
+    return;
+  }
+}
+
+void CodeGenerator::selectBinary(Value value) {
+  const ir::Inst &inst{function->insts[value]};
+  int size{ir::sizeOf(inst.type)};
+
+  Reg target{resultRegister(value, Reg::RAX)};
+  // the right operand must survive loading the left one into the target
+  if (inst.a != inst.b && location(inst.b).isReg(target))
+    target = Reg::RAX;
+  moveTo(target, inst.a, size);
+
+  Operand rhs{source(inst.b)};
+  if (rhs.kind == Operand::Kind::NONE)
+    rhs = Operand::ofReg(inRegister(inst.b, Reg::RCX, size));
+
+  MOp op{inst.op == Op::ADD   ? MOp::ADD
+         : inst.op == Op::SUB ? MOp::SUB
+                              : MOp::IMUL};
+  emit(op, size, Operand::ofReg(target), rhs);
+  writeResult(value, target);
+}
+
+void CodeGenerator::selectVector(Value value) {
+  const ir::Inst &inst{function->insts[value]};
+  if (inst.op != Op::STORE && location(value).kind == Operand::Kind::NONE)
+    return;
+  Reg target{Reg::XMM0};
+  if (Operand to{location(value)}; to.isReg() && isXmm(to.reg))
+    target = to.reg;
+
+  switch (inst.op) {
+  case Op::LOAD:
+    emit(MOp::MOVDQU, 16, Operand::ofReg(target),
+         addressOf(inst.a, Reg::R11));
+    break;
+  case Op::STORE: {
+    Operand address{addressOf(inst.a, Reg::R11)};
+    Reg reg{inVector(inst.b, Reg::XMM0)};
+    emit(MOp::MOVDQU, 16, address, Operand::ofReg(reg));
+    return;
+  }
+  case Op::ADD:
+  case Op::SUB: {
+    // the right operand must survive loading the left one into the target
+    if (inst.a != inst.b && location(inst.b).isReg(target))
+      target = Reg::XMM0;
+    Operand lhs{location(inst.a)};
+    if (!lhs.isReg(target))
+      emit(MOp::MOVDQU, 16, Operand::ofReg(target), lhs);
+    MOp op{inst.aux == 1 ? (inst.op == Op::ADD ? MOp::PADDB : MOp::PSUBB)
+                         : (inst.op == Op::ADD ? MOp::PADDD : MOp::PSUBD)};
+    emit(op, 16, Operand::ofReg(target), location(inst.b));
+    break;
+  }
+  case Op::SPLAT:
+    moveTo(Reg::RAX, inst.a, 4);
+    if (inst.aux == 1) {
+      // a byte repeated four times makes a dword lane
+      out->code.push_back({MOp::MOVZX, 4, 1, Cond::E, Operand::ofReg(Reg::RAX),
+                           Operand::ofReg(Reg::RAX)});
+      emit(MOp::IMUL, 4, Operand::ofReg(Reg::RAX), Operand::ofImm(0x01010101));
+    }
+    emit(MOp::MOVD, 4, Operand::ofReg(target), Operand::ofReg(Reg::RAX));
+    out->code.push_back({MOp::PSHUFD, 16, 0x00, Cond::E,
+                         Operand::ofReg(target), Operand::ofReg(target)});
+    break;
+  case Op::REDUCE: {
+    // add the upper half onto the lower one, then the second lane onto the
+    // first
+    Operand from{location(inst.a)};
+    out->code.push_back({MOp::PSHUFD, 16, 0x4e, Cond::E,
+                         Operand::ofReg(Reg::XMM0), from});
+    emit(MOp::PADDD, 16, Operand::ofReg(Reg::XMM0), from);
+    emit(MOp::MOVD, 4, Operand::ofReg(Reg::RAX), Operand::ofReg(Reg::XMM0));
+    out->code.push_back({MOp::PSHUFD, 16, 0x55, Cond::E,
+                         Operand::ofReg(Reg::XMM0), Operand::ofReg(Reg::XMM0)});
+    emit(MOp::MOVD, 4, Operand::ofReg(Reg::RCX), Operand::ofReg(Reg::XMM0));
+    emit(MOp::ADD, 4, Operand::ofReg(Reg::RAX), Operand::ofReg(Reg::RCX));
+    writeResult(value, Reg::RAX);
+    return;
+  }
+  default: {
+    // copies
+    Operand from{location(inst.a)};
+    if (!from.isReg(target))
+      emit(MOp::MOVDQU, 16, Operand::ofReg(target), from);
+    break;
+  }
+  }
+  writeVector(value, target);
+}
+
+void CodeGenerator::selectDivision(Value value) {
+  const ir::Inst &inst{function->insts[value]};
+
+  moveTo(Reg::RAX, inst.a, 4);
+  emit(MOp::CDQ, 4);
+  Operand divisor{source(inst.b)};
+  if (divisor.kind == Operand::Kind::NONE || divisor.isImm())
+    divisor = Operand::ofReg(inRegister(inst.b, Reg::RCX, 4));
+  emit(MOp::IDIV, 4, divisor);
+
+  writeResult(value, inst.op == Op::DIV ? Reg::RAX : Reg::RDX);
+}
+
+Cond CodeGenerator::selectCompare(Value value) {
+  const ir::Inst &inst{function->insts[value]};
+  int size{ir::sizeOf(function->insts[inst.a].type)};
+
+  Operand lhs{location(inst.a)};
+  if (lhs.kind == Operand::Kind::NONE)
+    lhs = Operand::ofReg(inRegister(inst.a, Reg::RAX, size));
+
+  Operand rhs{source(inst.b)};
+  if (rhs.isImm() && size == 1)
+    rhs.imm = static_cast<int8_t>(rhs.imm);
+  if (rhs.kind == Operand::Kind::NONE || (rhs.isMem() && lhs.isMem()))
+    rhs = Operand::ofReg(inRegister(inst.b, Reg::RCX, size));
+
+  emit(MOp::CMP, size, lhs, rhs);
+
+  switch (inst.op) {
+  case Op::EQ:
+    return Cond::E;
+  case Op::NE:
+    return Cond::NE;
+  case Op::LT:
+    return Cond::L;
+  case Op::LE:
+    return Cond::LE;
+  case Op::GT:
+    return Cond::G;
+  default:
+    return Cond::GE;
+  }
+}
+
+void CodeGenerator::selectCall(Value value) {
+  const ir::Inst &inst{function->insts[value]};
+  std::span<const Value> args{function->extraOperands(value)};
+
+  auto moveFrom{[&](Value arg, Operand dst) -> Move {
+    if (isAddress(arg))
+      return {dst, addressOf(arg, Reg::R11), true};
+    return {dst, source(arg)};
+  }};
+
+  // arguments beyond the sixth go on the stack, keeping rsp 16-byte aligned
+  int32_t stackArgs{std::max<int32_t>(0, static_cast<int32_t>(args.size()) - 6)};
+  int32_t padding{stackArgs % 2 == 1 ? 8 : 0};
+  if (padding != 0)
+    emit(MOp::SUB, 8, Operand::ofReg(Reg::RSP), Operand::ofImm(padding));
+  for (size_t i = args.size(); i-- > 6;) {
+    Move move{moveFrom(args[i], Operand::ofReg(Reg::RAX))};
+    if (move.lea) {
+      emitMove(move);
+      move.src = Operand::ofReg(Reg::RAX);
+    }
+    emit(MOp::PUSH, 8, move.src);
+  }
+
+  std::vector<Move> moves;
+  for (size_t i = 0; i < args.size() && i < 6; i++)
+    moves.push_back(moveFrom(args[i], Operand::ofReg(ARGUMENT_REGISTERS[i])));
+  parallelMoves(std::move(moves));
+
+  // char arguments are sign-extended to 32 bits as C callers do
+  for (size_t i = 0; i < args.size() && i < 6; i++)
+    if (function->insts[args[i]].type == ir::Type::I8)
+      out->code.push_back({MOp::MOVSX, 4, 1, Cond::E,
+                           Operand::ofReg(ARGUMENT_REGISTERS[i]),
+                           Operand::ofReg(ARGUMENT_REGISTERS[i])});
+
+  emit(MOp::CALL, 8, Operand::ofSymbol(static_cast<uint32_t>(inst.imm)));
+  if (stackArgs > 0 || padding > 0)
+    emit(MOp::ADD, 8, Operand::ofReg(Reg::RSP),
+         Operand::ofImm(8 * stackArgs + padding));
+
+  writeResult(value, Reg::RAX);
+}
+
+void CodeGenerator::selectCopy(Value value) {
+  const ir::Inst &inst{function->insts[value]};
+  if (isLibraryCopy(inst)) {
+    auto pointer{[&](Value address, Reg reg) -> Move {
+      if (isAddress(address))
+        return {Operand::ofReg(reg), addressOf(address, Reg::R11), true};
+      return {Operand::ofReg(reg), source(address)};
+    }};
+    parallelMoves({pointer(inst.a, Reg::RDI), pointer(inst.b, Reg::RSI)});
+    emit(MOp::MOV, 4, Operand::ofReg(Reg::RDX), Operand::ofImm(inst.imm));
+    emit(MOp::CALL, 8, Operand::ofSymbol(memcpySymbol));
+    return;
+  }
+
+  Operand destination{addressOf(inst.a, Reg::R11)};
+  Operand source{addressOf(inst.b, Reg::RCX)};
+  for (int64_t offset = 0; offset < inst.imm;) {
+    int64_t left{inst.imm - offset};
+    int chunk{left >= 8 ? 8 : left >= 4 ? 4 : 1};
+    if (left >= 16 && inst.imm > REGISTER_COPY_LIMIT)
+      chunk = 16;
+    Operand from{source};
+    Operand to{destination};
+    from.disp += static_cast<int32_t>(offset);
+    to.disp += static_cast<int32_t>(offset);
+    if (chunk == 16) {
+      emit(MOp::MOVDQU, 16, Operand::ofReg(Reg::XMM0), from);
+      emit(MOp::MOVDQU, 16, to, Operand::ofReg(Reg::XMM0));
+    } else {
+      emit(MOp::MOV, chunk, Operand::ofReg(Reg::RAX), from);
+      emit(MOp::MOV, chunk, to, Operand::ofReg(Reg::RAX));
+    }
+    offset += chunk;
+  }
+}
+
+void CodeGenerator::selectCondBranch(Value value, BlockId next,
+                                     std::vector<Stub> &stubs) {
+  const ir::Inst &inst{function->insts[value]};
+  const ir::Block &block{function->blocks[inst.block]};
+  BlockId ifTrue{block.succs[0]};
+  BlockId ifFalse{block.succs[1]};
+
+  Cond cond{Cond::NE};
+  if (fused[inst.a])
+    cond = selectCompare(inst.a);
+  else {
+    Operand tested{location(inst.a)};
+    if (tested.isReg())
+      emit(MOp::TEST, 4, tested, tested);
+    else if (tested.isMem())
+      emit(MOp::CMP, 4, tested, Operand::ofImm(0));
+    else {
+      Reg reg{inRegister(inst.a, Reg::RAX, 4)};
+      emit(MOp::TEST, 4, Operand::ofReg(reg), Operand::ofReg(reg));
+    }
+  }
+
+  // fall through to whichever successor comes next when it has no phis
+  if (ifTrue == next && !hasPhis(ifTrue) && ifTrue != ifFalse) {
+    std::swap(ifTrue, ifFalse);
+    cond = invert(cond);
+  }
+
+  uint32_t trueLabel{ifTrue};
+  if (hasPhis(ifTrue)) {
+    trueLabel = out->labelCount++;
+    stubs.push_back({trueLabel, inst.block, ifTrue});
+  }
+  emitCond(MOp::JCC, cond, Operand::ofLabel(trueLabel));
+
+  if (hasPhis(ifFalse))
+    parallelMoves(phiMoves(inst.block, ifFalse));
+  if (ifFalse != next)
+    emit(MOp::JMP, 8, Operand::ofLabel(ifFalse));
+}
+
+} // namespace codegen
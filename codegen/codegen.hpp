@@ -0,0 +1,102 @@
+#ifndef CODEGEN_H
+#define CODEGEN_H
+
+#include "../ir/ir.hpp"
+#include "../support/thread_pool.hpp"
+#include "regalloc.hpp"
+#include "x86.hpp"
+#include <vector>
+
+namespace codegen {
+
+// Selects x86-64 instructions for SSA IR functions using the locations
+// chosen by the linear scan allocator, following the System V calling
+// convention. Phis are resolved by parallel moves on their incoming edges.
+class CodeGenerator {
+private:
+  struct Move {
+    Operand dst;
+    Operand src;
+    // src is a memory operand whose address (rather than value) is moved
+    bool lea{false};
+    // 128-bit move of a vector value
+    bool vector{false};
+  };
+
+  // Out-of-line edge from a conditional branch into a block with phis.
+  struct Stub {
+    uint32_t label;
+    ir::BlockId from;
+    ir::BlockId to;
+  };
+
+  const ir::Module &module;
+  MachineModule &machine;
+  uint32_t globalBase{0};
+  uint32_t stringBase{0};
+  uint32_t memcpySymbol{0};
+
+  // per function state
+  const ir::Function *function{nullptr};
+  MachineFunction *out{nullptr};
+  Allocation allocation;
+  Allocation vectors;
+  std::vector<int32_t> frameOffset;
+  std::vector<uint32_t> useCount;
+  std::vector<bool> fused;
+  std::vector<uint32_t> blockLabel;
+  int32_t spillBase{0};
+  int32_t vectorBase{0};
+  int32_t frameSize{0};
+
+  void emit(MOp op, int size, Operand dst = {}, Operand src = {});
+  void emitCond(MOp op, Cond cond, Operand dst);
+
+  bool isAddress(ir::Value value) const;
+  bool isRematerialised(ir::Value value) const;
+  Operand slot(int32_t index) const;
+  Operand location(ir::Value value) const;
+  Operand addressOf(ir::Value value, Reg scratch);
+  Operand source(ir::Value value);
+  void moveTo(Reg target, ir::Value value, int size);
+  Reg inRegister(ir::Value value, Reg scratch, int size);
+  Reg resultRegister(ir::Value value, Reg fallback) const;
+  void writeResult(ir::Value value, Reg from);
+  Reg inVector(ir::Value value, Reg scratch);
+  void writeVector(ir::Value value, Reg from);
+
+  void analyse();
+  void layoutFrame();
+  void prologue();
+  void epilogue();
+  void parallelMoves(std::vector<Move> moves);
+  void emitMove(const Move &move);
+  std::vector<Move> phiMoves(ir::BlockId from, ir::BlockId to);
+  bool hasPhis(ir::BlockId block) const;
+  std::vector<ir::BlockId> layout() const;
+
+  void select(ir::Value value, ir::BlockId next);
+  void selectBinary(ir::Value value);
+  void selectVector(ir::Value value);
+  void selectDivision(ir::Value value);
+  Cond selectCompare(ir::Value value);
+  void selectCall(ir::Value value);
+  void selectCopy(ir::Value value);
+  void selectCondBranch(ir::Value value, ir::BlockId next,
+                        std::vector<Stub> &stubs);
+
+public:
+  CodeGenerator(const ir::Module &module, MachineModule &machine);
+
+  // Adds symbols for the strings the module gained since, for generating
+  // functions one at a time as they are lowered.
+  void declareStrings();
+  MachineFunction generate(const ir::Function &function, uint32_t index);
+  // Generates every defined function, on the pool's threads if given one.
+  // Functions that never ran in a profiled run go last.
+  void generate(support::ThreadPool *pool = nullptr);
+};
+
+} // namespace codegen
+
+#endif
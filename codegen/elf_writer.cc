@@ -0,0 +1,219 @@
+#include "elf_writer.hpp"
+#include <algorithm>
+#include <cstring>
+#include <elf.h>
+#include <string>
+#include <vector>
+
+namespace codegen {
+
+namespace {
+
+enum SectionIndex : uint16_t {
+  TEXT = 1,
+  RELA_TEXT,
+  RODATA,
+  BSS,
+  SYMTAB,
+  STRTAB,
+  SHSTRTAB,
+  NOTE_GNU_STACK,
+  SECTION_COUNT,
+};
+
+// String table under construction; offset 0 is the empty string.
+class StringTable {
+private:
+  std::string data{'\0'};
+
+public:
+  uint32_t add(std::string_view str) {
+    uint32_t offset{static_cast<uint32_t>(data.size())};
+    data += str;
+    data += '\0';
+    return offset;
+  }
+  const std::string &bytes() const { return data; }
+};
+
+template <class T> void append(std::string &buffer, const T &value) {
+  buffer.append(reinterpret_cast<const char *>(&value), sizeof(T));
+}
+
+void alignTo(std::string &buffer, size_t align) {
+  buffer.resize((buffer.size() + align - 1) / align * align, '\0');
+}
+
+} // namespace
+
+void writeElfObject(std::ostream &out, const MachineModule &module,
+                    const ObjectCode &code) {
+  // place strings in .rodata and globals in .bss
+  std::string rodata;
+  uint64_t bssSize{0};
+  uint64_t bssAlign{1};
+  std::vector<uint64_t> dataOffsets(module.symbols.size(), 0);
+  for (size_t i = 0; i < module.symbols.size(); i++) {
+    const Symbol &symbol{module.symbols[i]};
+    if (symbol.kind == SymbolKind::RODATA) {
+      dataOffsets[i] = rodata.size();
+      rodata += symbol.bytes;
+    } else if (symbol.kind == SymbolKind::DATA) {
+      uint64_t align{static_cast<uint64_t>(symbol.align)};
+      bssSize = (bssSize + align - 1) / align * align;
+      dataOffsets[i] = bssSize;
+      bssSize += symbol.size;
+      bssAlign = std::max(bssAlign, align);
+    }
+  }
+
+  std::vector<bool> referenced(module.symbols.size(), false);
+  for (const Relocation &relocation : code.relocations)
+    referenced[relocation.symbol] = true;
+
+  // local symbols must precede global ones; strings are referenced through
+  // the .rodata section symbol like the assembler does for .L labels
+  StringTable strtab;
+  std::vector<Elf64_Sym> symbols(1, Elf64_Sym{});
+  std::vector<uint32_t> elfSymbol(module.symbols.size(), 0);
+  auto sectionSymbol{[&](uint16_t section) {
+    Elf64_Sym sym{};
+    sym.st_info = ELF64_ST_INFO(STB_LOCAL, STT_SECTION);
+    sym.st_shndx = section;
+    symbols.push_back(sym);
+    return static_cast<uint32_t>(symbols.size() - 1);
+  }};
+  sectionSymbol(TEXT);
+  uint32_t rodataSymbol{sectionSymbol(RODATA)};
+
+  auto addSymbols{[&](bool global) {
+    for (size_t i = 0; i < module.symbols.size(); i++) {
+      const Symbol &symbol{module.symbols[i]};
+      bool isGlobal{symbol.name == "main" || !symbol.defined};
+      if (symbol.kind == SymbolKind::RODATA) {
+        elfSymbol[i] = rodataSymbol;
+        continue;
+      }
+      if (isGlobal != global || (!symbol.defined && !referenced[i]))
+        continue;
+
+      Elf64_Sym sym{};
+      sym.st_name = strtab.add(symbol.name);
+      if (!symbol.defined) {
+        sym.st_info = ELF64_ST_INFO(STB_GLOBAL, STT_NOTYPE);
+        sym.st_shndx = SHN_UNDEF;
+      } else if (symbol.kind == SymbolKind::FUNCTION) {
+        sym.st_info = ELF64_ST_INFO(global ? STB_GLOBAL : STB_LOCAL, STT_FUNC);
+        sym.st_shndx = TEXT;
+        sym.st_value = code.symbolOffsets[i];
+        sym.st_size = code.symbolSizes[i];
+      } else {
+        sym.st_info =
+            ELF64_ST_INFO(global ? STB_GLOBAL : STB_LOCAL, STT_OBJECT);
+        sym.st_shndx = BSS;
+        sym.st_value = dataOffsets[i];
+        sym.st_size = static_cast<uint64_t>(symbol.size);
+      }
+      elfSymbol[i] = static_cast<uint32_t>(symbols.size());
+      symbols.push_back(sym);
+    }
+  }};
+  addSymbols(false);
+  uint32_t firstGlobal{static_cast<uint32_t>(symbols.size())};
+  addSymbols(true);
+
+  std::vector<Elf64_Rela> relocations;
+  for (const Relocation &relocation : code.relocations) {
+    Elf64_Rela rela{};
+    rela.r_offset = relocation.offset;
+    uint32_t type{relocation.kind == RelocationKind::PLT32
+                      ? uint32_t{R_X86_64_PLT32}
+                      : uint32_t{R_X86_64_PC32}};
+    rela.r_info = ELF64_R_INFO(elfSymbol[relocation.symbol], type);
+    rela.r_addend = relocation.addend;
+    if (module.symbols[relocation.symbol].kind == SymbolKind::RODATA)
+      rela.r_addend += static_cast<int64_t>(dataOffsets[relocation.symbol]);
+    relocations.push_back(rela);
+  }
+
+  StringTable shstrtab;
+  std::vector<Elf64_Shdr> sections(SECTION_COUNT, Elf64_Shdr{});
+  auto section{[&](SectionIndex index, std::string_view name, uint32_t type,
+                   uint64_t flags, uint64_t align) -> Elf64_Shdr & {
+    Elf64_Shdr &header{sections[index]};
+    header.sh_name = shstrtab.add(name);
+    header.sh_type = type;
+    header.sh_flags = flags;
+    header.sh_addralign = align;
+    return header;
+  }};
+
+  // the file image: header, section contents, then the section headers
+  std::string image(sizeof(Elf64_Ehdr), '\0');
+  auto place{[&](Elf64_Shdr &header, const void *data, size_t size) {
+    alignTo(image, header.sh_addralign);
+    header.sh_offset = image.size();
+    header.sh_size = size;
+    image.append(static_cast<const char *>(data), size);
+  }};
+
+  place(section(TEXT, ".text", SHT_PROGBITS, SHF_ALLOC | SHF_EXECINSTR, 16),
+        code.text.data(), code.text.size());
+
+  Elf64_Shdr &rela{section(RELA_TEXT, ".rela.text", SHT_RELA, SHF_INFO_LINK,
+                           8)};
+  rela.sh_link = SYMTAB;
+  rela.sh_info = TEXT;
+  rela.sh_entsize = sizeof(Elf64_Rela);
+  place(rela, relocations.data(), relocations.size() * sizeof(Elf64_Rela));
+
+  place(section(RODATA, ".rodata", SHT_PROGBITS, SHF_ALLOC, 1), rodata.data(),
+        rodata.size());
+
+  Elf64_Shdr &bss{section(BSS, ".bss", SHT_NOBITS, SHF_ALLOC | SHF_WRITE,
+                          bssAlign)};
+  bss.sh_offset = image.size();
+  bss.sh_size = bssSize;
+
+  Elf64_Shdr &symtab{section(SYMTAB, ".symtab", SHT_SYMTAB, 0, 8)};
+  symtab.sh_link = STRTAB;
+  symtab.sh_info = firstGlobal;
+  symtab.sh_entsize = sizeof(Elf64_Sym);
+  place(symtab, symbols.data(), symbols.size() * sizeof(Elf64_Sym));
+
+  place(section(STRTAB, ".strtab", SHT_STRTAB, 0, 1), strtab.bytes().data(),
+        strtab.bytes().size());
+
+  Elf64_Shdr &note{section(NOTE_GNU_STACK, ".note.GNU-stack", SHT_PROGBITS,
+                           0, 1)};
+  note.sh_offset = image.size();
+
+  // named last so that its own name is part of it
+  Elf64_Shdr &names{section(SHSTRTAB, ".shstrtab", SHT_STRTAB, 0, 1)};
+  place(names, shstrtab.bytes().data(), shstrtab.bytes().size());
+
+  alignTo(image, 8);
+  uint64_t sectionHeaders{image.size()};
+  for (const Elf64_Shdr &header : sections)
+    append(image, header);
+
+  Elf64_Ehdr header{};
+  std::memcpy(header.e_ident, ELFMAG, SELFMAG);
+  header.e_ident[EI_CLASS] = ELFCLASS64;
+  header.e_ident[EI_DATA] = ELFDATA2LSB;
+  header.e_ident[EI_VERSION] = EV_CURRENT;
+  header.e_ident[EI_OSABI] = ELFOSABI_SYSV;
+  header.e_type = ET_REL;
+  header.e_machine = EM_X86_64;
+  header.e_version = EV_CURRENT;
+  header.e_shoff = sectionHeaders;
+  header.e_ehsize = sizeof(Elf64_Ehdr);
+  header.e_shentsize = sizeof(Elf64_Shdr);
+  header.e_shnum = SECTION_COUNT;
+  header.e_shstrndx = SHSTRTAB;
+  std::memcpy(image.data(), &header, sizeof(header));
+
+  out.write(image.data(), static_cast<std::streamsize>(image.size()));
+}
+
+} // namespace codegen
@@ -0,0 +1,17 @@
+#ifndef ELF_WRITER_H
+#define ELF_WRITER_H
+
+#include "encoder.hpp"
+#include "x86.hpp"
+#include <ostream>
+
+namespace codegen {
+
+// Writes a relocatable ELF64 object with .text, .rodata and .bss sections.
+// Only main is exported; builtins stay undefined for the linker to resolve.
+void writeElfObject(std::ostream &out, const MachineModule &module,
+                    const ObjectCode &code);
+
+} // namespace codegen
+
+#endif
@@ -0,0 +1,370 @@
+#include "encoder.hpp"
+#include <cassert>
+#include <utility>
+
+namespace codegen {
+
+static bool fitsInt8(int64_t value) { return value >= -128 && value <= 127; }
+
+static bool fitsInt32(int64_t value) {
+  return value >= INT32_MIN && value <= INT32_MAX;
+}
+
+static uint8_t number(Reg reg) { return static_cast<uint8_t>(reg); }
+
+Encoder::Encoder(const MachineModule &module) : module(module) {
+  code.symbolOffsets.resize(module.symbols.size());
+  code.symbolSizes.resize(module.symbols.size());
+}
+
+void Encoder::byte(uint8_t value) { code.text.push_back(value); }
+
+void Encoder::bytes(int64_t value, int count) {
+  for (int i = 0; i < count; i++)
+    byte(static_cast<uint8_t>(value >> (8 * i)));
+}
+
+// Emits [66] [REX] opcode ModRM [SIB] [disp] [imm]. `reg` is the ModRM reg
+// field: a register number or an opcode extension. For 8-bit registers
+// spl/bpl/sil/dil need a REX prefix to be told apart from ah/ch/dh/bh.
+void Encoder::emitModRM(std::initializer_list<uint8_t> opcode, int size,
+                        uint8_t reg, const Operand &rm, ByteRegs byteRegs,
+                        int immSize, int64_t imm) {
+  if (size == 2)
+    byte(0x66);
+
+  uint8_t rex{0x40};
+  if (size == 8)
+    rex |= 0x08;
+  if (reg & 8)
+    rex |= 0x04;
+  bool forceRex{byteRegs == ByteRegs::BOTH && reg >= 4 && reg < 8};
+  if (rm.isReg()) {
+    if (number(rm.reg) & 8)
+      rex |= 0x01;
+    forceRex |= byteRegs != ByteRegs::NONE && number(rm.reg) >= 4 &&
+                number(rm.reg) < 8;
+  } else if (rm.reg != Reg::RIP) {
+    if (number(rm.reg) & 8)
+      rex |= 0x01;
+    if (rm.index != Reg::NONE && (number(rm.index) & 8))
+      rex |= 0x02;
+  }
+  if (rex != 0x40 || forceRex)
+    byte(rex);
+
+  for (uint8_t op : opcode)
+    byte(op);
+
+  uint8_t regBits{static_cast<uint8_t>((reg & 7) << 3)};
+  if (rm.isReg()) {
+    byte(0xc0 | regBits | (number(rm.reg) & 7));
+  } else if (rm.reg == Reg::RIP) {
+    byte(regBits | 0x05);
+    // the displacement is relative to the end of the instruction
+    code.relocations.push_back({code.text.size(),
+                                static_cast<uint32_t>(rm.imm),
+                                RelocationKind::PC32, rm.disp - 4 - immSize});
+    bytes(0, 4);
+  } else {
+    uint8_t base{static_cast<uint8_t>(number(rm.reg) & 7)};
+    bool sib{rm.index != Reg::NONE || base == 4};
+    uint8_t mod{rm.disp == 0 && base != 5 ? uint8_t{0x00}
+                : fitsInt8(rm.disp)       ? uint8_t{0x40}
+                                          : uint8_t{0x80}};
+    byte(mod | regBits | (sib ? 4 : base));
+    if (sib) {
+      uint8_t scale{static_cast<uint8_t>(rm.scale == 8   ? 3
+                                         : rm.scale == 4 ? 2
+                                         : rm.scale == 2 ? 1
+                                                         : 0)};
+      uint8_t index{rm.index == Reg::NONE
+                        ? uint8_t{4}
+                        : static_cast<uint8_t>(number(rm.index) & 7)};
+      byte(static_cast<uint8_t>(scale << 6 | index << 3 | base));
+    }
+    if (mod == 0x40)
+      bytes(rm.disp, 1);
+    else if (mod == 0x80)
+      bytes(rm.disp, 4);
+  }
+
+  bytes(imm, immSize);
+}
+
+// Emits prefix [REX] 0F opcode ModRM ..., the legacy SSE form where the
+// mandatory prefix has to come before REX.
+void Encoder::emitSse(uint8_t prefix, uint8_t opcode, Reg reg,
+                      const Operand &rm, int immSize, int64_t imm) {
+  byte(prefix);
+  emitModRM({0x0f, opcode}, 4, number(reg), rm, ByteRegs::NONE, immSize, imm);
+}
+
+void Encoder::emitRegOpcode(uint8_t opcode, int size, Reg reg) {
+  uint8_t rex{0x40};
+  if (size == 8)
+    rex |= 0x08;
+  if (number(reg) & 8)
+    rex |= 0x01;
+  if (rex != 0x40)
+    byte(rex);
+  byte(opcode + (number(reg) & 7));
+}
+
+void Encoder::emitBranch(std::initializer_list<uint8_t> opcode,
+                         const Operand &target) {
+  for (uint8_t op : opcode)
+    byte(op);
+  fixups.push_back({code.text.size(), static_cast<uint32_t>(target.imm)});
+  bytes(0, 4);
+}
+
+void Encoder::encodeMov(const MInst &inst) {
+  const Operand &dst{inst.dst};
+  const Operand &src{inst.src};
+  bool byteReg{inst.size == 1};
+  ByteRegs byteRegs{byteReg ? ByteRegs::BOTH : ByteRegs::NONE};
+
+  if (src.isImm()) {
+    if (dst.isReg() && inst.size != 1) {
+      if (inst.size == 4 || (src.imm >= 0 && src.imm <= UINT32_MAX)) {
+        // 32-bit moves zero the upper half of the register
+        emitRegOpcode(0xb8, 4, dst.reg);
+        bytes(src.imm, 4);
+      } else if (fitsInt32(src.imm)) {
+        emitModRM({0xc7}, 8, 0, dst, ByteRegs::NONE, 4, src.imm);
+      } else {
+        emitRegOpcode(0xb8, 8, dst.reg);
+        bytes(src.imm, 8);
+      }
+      return;
+    }
+    assert(fitsInt32(src.imm));
+    if (inst.size == 1)
+      emitModRM({0xc6}, 1, 0, dst, ByteRegs::RM, 1, src.imm);
+    else
+      emitModRM({0xc7}, inst.size, 0, dst, ByteRegs::NONE, 4, src.imm);
+    return;
+  }
+
+  if (src.isReg())
+    emitModRM({static_cast<uint8_t>(byteReg ? 0x88 : 0x89)}, inst.size,
+              number(src.reg), dst, byteRegs);
+  else
+    emitModRM({static_cast<uint8_t>(byteReg ? 0x8a : 0x8b)}, inst.size,
+              number(dst.reg), src, byteRegs);
+}
+
+// ADD, OR, AND, SUB, XOR and CMP share their encodings, differing only in
+// the group number used as opcode extension and opcode row.
+void Encoder::encodeAlu(const MInst &inst, uint8_t group) {
+  const Operand &dst{inst.dst};
+  const Operand &src{inst.src};
+  bool byteReg{inst.size == 1};
+  ByteRegs byteRegs{byteReg ? ByteRegs::BOTH : ByteRegs::NONE};
+
+  if (src.isImm()) {
+    assert(fitsInt32(src.imm));
+    if (byteReg)
+      emitModRM({0x80}, 1, group, dst, ByteRegs::RM, 1, src.imm);
+    else if (fitsInt8(src.imm))
+      emitModRM({0x83}, inst.size, group, dst, ByteRegs::NONE, 1,
+                src.imm);
+    else
+      emitModRM({0x81}, inst.size, group, dst, ByteRegs::NONE, 4,
+                src.imm);
+    return;
+  }
+
+  uint8_t row{static_cast<uint8_t>(group * 8)};
+  if (src.isReg())
+    emitModRM({static_cast<uint8_t>(row + (byteReg ? 0 : 1))}, inst.size,
+              number(src.reg), dst, byteRegs);
+  else
+    emitModRM({static_cast<uint8_t>(row + (byteReg ? 2 : 3))}, inst.size,
+              number(dst.reg), src, byteRegs);
+}
+
+void Encoder::encode(const MInst &inst) {
+  uint8_t cond{static_cast<uint8_t>(inst.cond)};
+  bool byteReg{inst.size == 1};
+  ByteRegs rmByte{byteReg ? ByteRegs::RM : ByteRegs::NONE};
+
+  switch (inst.op) {
+  case MOp::MOV:
+    encodeMov(inst);
+    return;
+  case MOp::MOVSX:
+    if (inst.srcSize == 4)
+      emitModRM({0x63}, inst.size, number(inst.dst.reg), inst.src);
+    else
+      emitModRM({0x0f, 0xbe}, inst.size, number(inst.dst.reg), inst.src,
+                ByteRegs::RM);
+    return;
+  case MOp::MOVZX:
+    emitModRM({0x0f, 0xb6}, inst.size, number(inst.dst.reg), inst.src,
+              ByteRegs::RM);
+    return;
+  case MOp::LEA:
+    emitModRM({0x8d}, inst.size, number(inst.dst.reg), inst.src);
+    return;
+  case MOp::ADD:
+    encodeAlu(inst, 0);
+    return;
+  case MOp::OR:
+    encodeAlu(inst, 1);
+    return;
+  case MOp::AND:
+    encodeAlu(inst, 4);
+    return;
+  case MOp::SUB:
+    encodeAlu(inst, 5);
+    return;
+  case MOp::XOR:
+    encodeAlu(inst, 6);
+    return;
+  case MOp::CMP:
+    encodeAlu(inst, 7);
+    return;
+  case MOp::IMUL:
+    if (inst.src.isImm() && fitsInt8(inst.src.imm))
+      emitModRM({0x6b}, inst.size, number(inst.dst.reg), inst.dst,
+                ByteRegs::NONE, 1, inst.src.imm);
+    else if (inst.src.isImm())
+      emitModRM({0x69}, inst.size, number(inst.dst.reg), inst.dst,
+                ByteRegs::NONE, 4, inst.src.imm);
+    else
+      emitModRM({0x0f, 0xaf}, inst.size, number(inst.dst.reg), inst.src);
+    return;
+  case MOp::TEST:
+    if (inst.src.isImm())
+      emitModRM({static_cast<uint8_t>(byteReg ? 0xf6 : 0xf7)}, inst.size, 0,
+                inst.dst, rmByte, byteReg ? 1 : 4, inst.src.imm);
+    else
+      emitModRM({static_cast<uint8_t>(byteReg ? 0x84 : 0x85)}, inst.size,
+                number(inst.src.reg), inst.dst,
+                byteReg ? ByteRegs::BOTH : ByteRegs::NONE);
+    return;
+  case MOp::NEG:
+    emitModRM({static_cast<uint8_t>(byteReg ? 0xf6 : 0xf7)}, inst.size, 3,
+              inst.dst, rmByte);
+    return;
+  case MOp::IDIV:
+    emitModRM({static_cast<uint8_t>(byteReg ? 0xf6 : 0xf7)}, inst.size, 7,
+              inst.dst, rmByte);
+    return;
+  case MOp::CDQ:
+    byte(0x99);
+    return;
+  case MOp::CQO:
+    byte(0x48);
+    byte(0x99);
+    return;
+  case MOp::SETCC:
+    emitModRM({0x0f, static_cast<uint8_t>(0x90 + cond)}, 1, 0, inst.dst,
+              ByteRegs::RM);
+    return;
+  case MOp::JMP:
+    emitBranch({0xe9}, inst.dst);
+    return;
+  case MOp::JCC:
+    emitBranch({0x0f, static_cast<uint8_t>(0x80 + cond)}, inst.dst);
+    return;
+  case MOp::CALL:
+    byte(0xe8);
+    code.relocations.push_back({code.text.size(),
+                                static_cast<uint32_t>(inst.dst.imm),
+                                RelocationKind::PLT32, -4});
+    bytes(0, 4);
+    return;
+  case MOp::RET:
+    byte(0xc3);
+    return;
+  case MOp::PUSH:
+    if (inst.dst.isReg()) {
+      emitRegOpcode(0x50, 4, inst.dst.reg);
+    } else if (inst.dst.isImm()) {
+      byte(0x68);
+      bytes(inst.dst.imm, 4);
+    } else {
+      emitModRM({0xff}, 4, 6, inst.dst);
+    }
+    return;
+  case MOp::POP:
+    emitRegOpcode(0x58, 4, inst.dst.reg);
+    return;
+  case MOp::MOVDQU:
+    if (inst.dst.isReg())
+      emitSse(0xf3, 0x6f, inst.dst.reg, inst.src);
+    else
+      emitSse(0xf3, 0x7f, inst.src.reg, inst.dst);
+    return;
+  case MOp::MOVD:
+    if (isXmm(inst.dst.reg))
+      emitSse(0x66, 0x6e, inst.dst.reg, inst.src);
+    else
+      emitSse(0x66, 0x7e, inst.src.reg, inst.dst);
+    return;
+  case MOp::PSHUFD:
+    emitSse(0x66, 0x70, inst.dst.reg, inst.src, 1, inst.srcSize);
+    return;
+  case MOp::PADDB:
+    emitSse(0x66, 0xfc, inst.dst.reg, inst.src);
+    return;
+  case MOp::PADDD:
+    emitSse(0x66, 0xfe, inst.dst.reg, inst.src);
+    return;
+  case MOp::PSUBB:
+    emitSse(0x66, 0xf8, inst.dst.reg, inst.src);
+    return;
+  case MOp::PSUBD:
+    emitSse(0x66, 0xfa, inst.dst.reg, inst.src);
+    return;
+  case MOp::LABEL:
+    labelOffsets[inst.dst.imm] = code.text.size();
+    return;
+  }
+}
+
+void Encoder::encode(const MachineFunction &function) {
+  uint64_t start{code.text.size()};
+  code.symbolOffsets[function.symbol] = start;
+
+  labelOffsets.assign(function.labelCount, 0);
+  fixups.clear();
+  for (const MInst &inst : function.code)
+    encode(inst);
+
+  for (const Fixup &fixup : fixups) {
+    int64_t rel{static_cast<int64_t>(labelOffsets[fixup.label]) -
+                static_cast<int64_t>(fixup.offset + 4)};
+    for (int i = 0; i < 4; i++)
+      code.text[fixup.offset + i] = static_cast<uint8_t>(rel >> (8 * i));
+  }
+
+  code.symbolSizes[function.symbol] = code.text.size() - start;
+}
+
+ObjectCode Encoder::encode() {
+  for (const MachineFunction &function : module.functions)
+    encode(function);
+
+  // calls between functions of this module never need the linker
+  std::vector<Relocation> external;
+  for (const Relocation &relocation : code.relocations) {
+    const Symbol &symbol{module.symbols[relocation.symbol]};
+    if (symbol.kind != SymbolKind::FUNCTION || !symbol.defined) {
+      external.push_back(relocation);
+      continue;
+    }
+    int64_t rel{static_cast<int64_t>(code.symbolOffsets[relocation.symbol]) +
+                relocation.addend - static_cast<int64_t>(relocation.offset)};
+    for (int i = 0; i < 4; i++)
+      code.text[relocation.offset + i] = static_cast<uint8_t>(rel >> (8 * i));
+  }
+  code.relocations = std::move(external);
+
+  return std::move(code);
+}
+
+} // namespace codegen
@@ -0,0 +1,75 @@
+#ifndef ENCODER_H
+#define ENCODER_H
+
+#include "x86.hpp"
+#include <cstdint>
+#include <initializer_list>
+#include <vector>
+
+namespace codegen {
+
+enum class RelocationKind : uint8_t {
+  PC32,  // S + A - P, data references through rip
+  PLT32, // L + A - P, calls
+};
+
+// A reference from the text to a symbol that has to be patched by the linker
+// (or the JIT) once the symbol's address is known.
+struct Relocation {
+  uint64_t offset;
+  uint32_t symbol;
+  RelocationKind kind;
+  int64_t addend;
+};
+
+struct ObjectCode {
+  std::vector<uint8_t> text;
+  // Only references to symbols outside the text remain: calls between
+  // functions of the module are resolved during encoding.
+  std::vector<Relocation> relocations;
+  // Offset and size in the text of each FUNCTION symbol (indexed by symbol).
+  std::vector<uint64_t> symbolOffsets;
+  std::vector<uint64_t> symbolSizes;
+};
+
+// Encodes machine instructions into x86-64 machine code. Branches always use
+// the rel32 forms so that labels can be patched in a single pass.
+class Encoder {
+private:
+  // Which ModRM operands are 8-bit registers.
+  enum class ByteRegs : uint8_t { NONE, RM, BOTH };
+
+  struct Fixup {
+    uint64_t offset;
+    uint32_t label;
+  };
+
+  const MachineModule &module;
+  ObjectCode code;
+  std::vector<uint64_t> labelOffsets;
+  std::vector<Fixup> fixups;
+
+  void byte(uint8_t value);
+  void bytes(int64_t value, int count);
+  void emitModRM(std::initializer_list<uint8_t> opcode, int size, uint8_t reg,
+                 const Operand &rm, ByteRegs byteRegs = ByteRegs::NONE,
+                 int immSize = 0, int64_t imm = 0);
+  void emitSse(uint8_t prefix, uint8_t opcode, Reg reg, const Operand &rm,
+               int immSize = 0, int64_t imm = 0);
+  void emitRegOpcode(uint8_t opcode, int size, Reg reg);
+  void emitBranch(std::initializer_list<uint8_t> opcode, const Operand &target);
+
+  void encode(const MachineFunction &function);
+  void encode(const MInst &inst);
+  void encodeMov(const MInst &inst);
+  void encodeAlu(const MInst &inst, uint8_t group);
+
+public:
+  explicit Encoder(const MachineModule &module);
+
+  ObjectCode encode();
+};
+
+} // namespace codegen
+
+#endif
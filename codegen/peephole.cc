@@ -0,0 +1,357 @@
+#include "peephole.hpp"
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <format>
+#include <initializer_list>
+#include <span>
+#include <string_view>
+#include <vector>
+
+namespace codegen {
+
+namespace {
+
+constexpr size_t MAX_WINDOW = 4;
+// Variable 0 names no operand.
+constexpr size_t VARIABLES = 4;
+constexpr size_t MOP_COUNT = static_cast<size_t>(MOp::LABEL) + 1;
+
+// Sizes an instruction of a pattern may have: any, that of the first
+// instruction of the window, or a set of sizes in bytes ORed together.
+constexpr uint8_t ANY_SIZE = 0xff;
+constexpr uint8_t FIRST_SIZE = 0;
+
+// What an operand of a pattern must be. Operands naming the same variable
+// must be equal.
+enum class Shape : uint8_t { ANY, REG, MEM, ZERO, LABEL };
+
+struct OperandPattern {
+  Shape shape{Shape::ANY};
+  uint8_t variable{0};
+};
+
+enum class CondPattern : uint8_t { ANY, E, NE };
+
+struct Step {
+  MOp op;
+  uint8_t size{ANY_SIZE};
+  OperandPattern dst;
+  OperandPattern src;
+  CondPattern cond{CondPattern::ANY};
+};
+
+// Where a replacement takes its condition code from: the instruction of the
+// window at `condStep`, as it is or inverted.
+enum class CondFrom : uint8_t { NONE, SAME, INVERTED };
+
+// One instruction of a replacement: the instruction of the window at
+// `step` as it is, or a new one with the given operands. A new instruction
+// has the size of the one at `step` unless given one.
+struct Output {
+  bool copy;
+  uint8_t step;
+  MOp op{MOp::MOV};
+  uint8_t size{ANY_SIZE};
+  uint8_t dst{0};
+  uint8_t src{0};
+  CondFrom cond{CondFrom::NONE};
+  uint8_t condStep{0};
+};
+
+struct Pattern {
+  std::string_view name;
+  std::array<Step, MAX_WINDOW> steps{};
+  size_t length{0};
+  std::array<Output, MAX_WINDOW> outputs{};
+  size_t outputCount{0};
+  // the flags must not be read after the window before they are set again
+  bool flagsDead{false};
+};
+
+constexpr OperandPattern any(uint8_t variable = 0) {
+  return {Shape::ANY, variable};
+}
+constexpr OperandPattern reg(uint8_t variable) {
+  return {Shape::REG, variable};
+}
+constexpr OperandPattern mem(uint8_t variable) {
+  return {Shape::MEM, variable};
+}
+constexpr OperandPattern label(uint8_t variable) {
+  return {Shape::LABEL, variable};
+}
+constexpr OperandPattern ZERO{Shape::ZERO, 0};
+
+constexpr Output keep(uint8_t step) { return {true, step}; }
+constexpr Output make(uint8_t step, MOp op, uint8_t dst, uint8_t src = 0,
+                      uint8_t size = ANY_SIZE) {
+  return {false, step, op, size, dst, src};
+}
+constexpr Output branch(uint8_t step, uint8_t target, CondFrom cond,
+                        uint8_t condStep) {
+  return {false, step, MOp::JCC, ANY_SIZE, target, 0, cond, condStep};
+}
+
+constexpr Pattern pattern(std::string_view name,
+                          std::initializer_list<Step> steps,
+                          std::initializer_list<Output> outputs,
+                          bool flagsDead = false) {
+  Pattern result{name};
+  for (const Step &step : steps)
+    result.steps[result.length++] = step;
+  for (const Output &output : outputs)
+    result.outputs[result.outputCount++] = output;
+  result.flagsDead = flagsDead;
+  return result;
+}
+
+// Tried in order at every instruction; the first that matches is applied.
+// 32-bit moves and arithmetic clear the upper half of their destination, so
+// the patterns dropping moves only drop 64-bit ones.
+constexpr Pattern PATTERNS[]{
+    // mov %a, %a
+    pattern("self-move", {{MOp::MOV, 8, reg(1), reg(1)}}, {}),
+    // mov %b, a; mov a, %b -> mov %b, a
+    pattern("move-back",
+            {{MOp::MOV, 8, any(1), reg(2)}, {MOp::MOV, 8, reg(2), any(1)}},
+            {keep(0)}),
+    // mov %b, m; mov m, %c -> mov %b, m; mov %b, %c
+    pattern("store-reload",
+            {{MOp::MOV, ANY_SIZE, mem(1), reg(2)},
+             {MOp::MOV, FIRST_SIZE, reg(3), mem(1)}},
+            {keep(0), make(1, MOp::MOV, 3, 2)}),
+    // jmp .L; .L: -> .L:
+    pattern("jump-to-next",
+            {{MOp::JMP, ANY_SIZE, label(1), any()},
+             {MOp::LABEL, ANY_SIZE, label(1), any()}},
+            {keep(1)}),
+    // cmp $0, %a -> test %a, %a
+    pattern("compare-zero", {{MOp::CMP, ANY_SIZE, reg(1), ZERO}},
+            {make(0, MOp::TEST, 1, 1)}),
+    // mov $0, %a -> xor %a, %a; not for byte moves, as xor clears the
+    // whole register
+    pattern("zero-register", {{MOp::MOV, 4 | 8, reg(1), ZERO}},
+            {make(0, MOp::XOR, 1, 1, 4)}, true),
+    // setcc %a; movzx %a, %b; test %b, %b; jne .L -> setcc %a; movzx %a, %b;
+    // jcc .L, as neither setcc nor movzx touch the flags of the compare
+    pattern("setcc-branch",
+            {{MOp::SETCC, ANY_SIZE, reg(1), any()},
+             {MOp::MOVZX, 4, reg(2), reg(1)},
+             {MOp::TEST, 4, reg(2), reg(2)},
+             {MOp::JCC, ANY_SIZE, label(3), any(), CondPattern::NE}},
+            {keep(0), keep(1), branch(3, 3, CondFrom::SAME, 0)}),
+    pattern("setcc-branch-not",
+            {{MOp::SETCC, ANY_SIZE, reg(1), any()},
+             {MOp::MOVZX, 4, reg(2), reg(1)},
+             {MOp::TEST, 4, reg(2), reg(2)},
+             {MOp::JCC, ANY_SIZE, label(3), any(), CondPattern::E}},
+            {keep(0), keep(1), branch(3, 3, CondFrom::INVERTED, 0)}),
+};
+
+constexpr size_t PATTERN_COUNT = std::size(PATTERNS);
+
+// A replacement may only use variables its window binds, and never grows
+// the code.
+constexpr bool isValid(const Pattern &pattern) {
+  if (pattern.length == 0 || pattern.outputCount > pattern.length)
+    return false;
+  std::array<bool, VARIABLES> bound{};
+  for (size_t i = 0; i < pattern.length; i++)
+    for (OperandPattern operand :
+         {pattern.steps[i].dst, pattern.steps[i].src})
+      if (operand.variable >= VARIABLES)
+        return false;
+      else
+        bound[operand.variable] = true;
+  for (size_t i = 0; i < pattern.outputCount; i++) {
+    const Output &output{pattern.outputs[i]};
+    if (output.step >= pattern.length || output.condStep >= pattern.length)
+      return false;
+    if (!output.copy && ((output.dst != 0 && !bound[output.dst]) ||
+                         (output.src != 0 && !bound[output.src])))
+      return false;
+  }
+  return true;
+}
+
+static_assert(PATTERN_COUNT <= 32);
+static_assert(std::ranges::all_of(PATTERNS, [](const Pattern &pattern) {
+  return isValid(pattern);
+}));
+
+// The patterns that can start at an instruction, as a bit set by opcode,
+// so that most instructions are passed over without trying any.
+constexpr std::array<uint32_t, MOP_COUNT> FIRST{[] {
+  std::array<uint32_t, MOP_COUNT> first{};
+  for (size_t i = 0; i < PATTERN_COUNT; i++)
+    first[static_cast<size_t>(PATTERNS[i].steps[0].op)] |= 1u << i;
+  return first;
+}()};
+
+std::array<std::atomic<uint64_t>, PATTERN_COUNT> hits{};
+
+} // namespace
+
+static bool matchOperand(OperandPattern pattern, const Operand &operand,
+                         std::array<Operand, VARIABLES> &bound,
+                         std::array<bool, VARIABLES> &isBound) {
+  switch (pattern.shape) {
+  case Shape::ANY:
+    break;
+  case Shape::REG:
+    if (!operand.isReg())
+      return false;
+    break;
+  case Shape::MEM:
+    if (!operand.isMem())
+      return false;
+    break;
+  case Shape::ZERO:
+    return operand.isImm() && operand.imm == 0;
+  case Shape::LABEL:
+    if (operand.kind != Operand::Kind::LABEL)
+      return false;
+    break;
+  }
+  if (pattern.variable == 0)
+    return true;
+  if (!isBound[pattern.variable]) {
+    bound[pattern.variable] = operand;
+    isBound[pattern.variable] = true;
+    return true;
+  }
+  return bound[pattern.variable] == operand;
+}
+
+static bool match(const Pattern &pattern, std::span<const MInst> window,
+                  std::array<Operand, VARIABLES> &bound) {
+  if (window.size() < pattern.length)
+    return false;
+  std::array<bool, VARIABLES> isBound{};
+  for (size_t i = 0; i < pattern.length; i++) {
+    const Step &step{pattern.steps[i]};
+    const MInst &inst{window[i]};
+    if (inst.op != step.op)
+      return false;
+    if (step.size == FIRST_SIZE ? inst.size != window[0].size
+                                : step.size != ANY_SIZE &&
+                                      (inst.size & step.size) == 0)
+      return false;
+    if ((step.cond == CondPattern::E && inst.cond != Cond::E) ||
+        (step.cond == CondPattern::NE && inst.cond != Cond::NE))
+      return false;
+    if (!matchOperand(step.dst, inst.dst, bound, isBound) ||
+        !matchOperand(step.src, inst.src, bound, isBound))
+      return false;
+  }
+  return true;
+}
+
+static void replace(const Pattern &pattern, std::span<const MInst> window,
+                    const std::array<Operand, VARIABLES> &bound,
+                    std::vector<MInst> &out) {
+  for (size_t i = 0; i < pattern.outputCount; i++) {
+    const Output &output{pattern.outputs[i]};
+    const MInst &from{window[output.step]};
+    if (output.copy) {
+      out.push_back(from);
+      continue;
+    }
+    MInst inst{output.op,
+               output.size != ANY_SIZE ? output.size : from.size,
+               0,
+               Cond::E,
+               bound[output.dst],
+               bound[output.src]};
+    if (output.cond != CondFrom::NONE) {
+      inst.cond = window[output.condStep].cond;
+      if (output.cond == CondFrom::INVERTED)
+        inst.cond = invert(inst.cond);
+    }
+    out.push_back(inst);
+  }
+}
+
+// Whether the flags may be read after each instruction before they are set
+// again. Instruction selection only reads them in the jcc or setcc right
+// behind the compare setting them, never across a label, jump or call.
+static void flagsLive(const std::vector<MInst> &code, std::vector<bool> &live) {
+  live.assign(code.size(), false);
+  bool read{false};
+  for (size_t i = code.size(); i-- > 0;) {
+    live[i] = read;
+    switch (code[i].op) {
+    case MOp::JCC:
+    case MOp::SETCC:
+      read = true;
+      break;
+    case MOp::ADD:
+    case MOp::SUB:
+    case MOp::IMUL:
+    case MOp::AND:
+    case MOp::OR:
+    case MOp::XOR:
+    case MOp::CMP:
+    case MOp::TEST:
+    case MOp::NEG:
+    case MOp::IDIV:
+    case MOp::JMP:
+    case MOp::CALL:
+    case MOp::RET:
+    case MOp::LABEL:
+      read = false;
+      break;
+    default:
+      break;
+    }
+  }
+}
+
+void peephole(MachineFunction &function) {
+  std::vector<MInst> &code{function.code};
+  std::vector<MInst> rewritten;
+  std::vector<bool> live;
+  std::array<Operand, VARIABLES> bound;
+  // a rewrite can make the window before it match, so passes are repeated
+  // until one changes nothing
+  for (bool changed{true}; changed;) {
+    changed = false;
+    flagsLive(code, live);
+    rewritten.clear();
+    rewritten.reserve(code.size());
+    for (size_t i = 0; i < code.size();) {
+      std::span<const MInst> window{code.data() + i,
+                                    std::min(MAX_WINDOW, code.size() - i)};
+      uint32_t candidates{FIRST[static_cast<size_t>(code[i].op)]};
+      size_t applied{PATTERN_COUNT};
+      for (size_t p = 0; p < PATTERN_COUNT && applied == PATTERN_COUNT; p++)
+        if ((candidates >> p & 1) != 0 && match(PATTERNS[p], window, bound) &&
+            (!PATTERNS[p].flagsDead || !live[i + PATTERNS[p].length - 1]))
+          applied = p;
+      if (applied == PATTERN_COUNT) {
+        rewritten.push_back(code[i++]);
+        continue;
+      }
+      replace(PATTERNS[applied], window, bound, rewritten);
+      hits[applied].fetch_add(1, std::memory_order_relaxed);
+      i += PATTERNS[applied].length;
+      changed = true;
+    }
+    code.swap(rewritten);
+  }
+}
+
+void printPeepholeStatistics(std::ostream &out) {
+  out << std::format("{:<20} {:>10}\n", "Peephole pattern", "Hits");
+  uint64_t total{0};
+  for (size_t i = 0; i < PATTERN_COUNT; i++) {
+    uint64_t count{hits[i].load(std::memory_order_relaxed)};
+    total += count;
+    out << std::format("{:<20} {:>10}\n", PATTERNS[i].name, count);
+  }
+  out << std::format("Total: {} rewrites\n", total);
+}
+
+} // namespace codegen
@@ -0,0 +1,20 @@
+#ifndef PEEPHOLE_H
+#define PEEPHOLE_H
+
+#include "x86.hpp"
+#include <ostream>
+
+namespace codegen {
+
+// Rewrites short windows of selected instructions that match the pattern
+// table in peephole.cc (redundant moves, reloads of what was just stored,
+// jumps to the next instruction, compares against zero and the test of a
+// setcc result before a branch) until no window matches.
+void peephole(MachineFunction &function);
+
+// How often each pattern was applied, over every function so far.
+void printPeepholeStatistics(std::ostream &out);
+
+} // namespace codegen
+
+#endif
@@ -0,0 +1,269 @@
+#include "regalloc.hpp"
+#include <algorithm>
+#include <bit>
+#include <span>
+
+namespace codegen {
+
+using ir::BlockId;
+using ir::Value;
+
+std::vector<uint32_t> LinearScan::computeOrder() {
+  // iterative postorder DFS from the entry block
+  std::vector<uint32_t> postorder;
+  std::vector<uint8_t> state(function.blocks.size(), 0);
+  std::vector<std::pair<BlockId, size_t>> stack{{0, 0}};
+  state[0] = 1;
+
+  while (!stack.empty()) {
+    auto &[block, next] = stack.back();
+    const std::vector<BlockId> &succs{function.blocks[block].succs};
+    if (next < succs.size()) {
+      BlockId succ{succs[next++]};
+      if (state[succ] == 0) {
+        state[succ] = 1;
+        stack.emplace_back(succ, 0);
+      }
+      continue;
+    }
+    postorder.push_back(block);
+    stack.pop_back();
+  }
+
+  std::reverse(postorder.begin(), postorder.end());
+  return postorder;
+}
+
+std::vector<LiveInterval>
+LinearScan::buildIntervals(const std::vector<uint32_t> &order) {
+  const size_t valueCount{function.insts.size()};
+  const size_t words{(valueCount + 63) / 64};
+  const size_t blockCount{function.blocks.size()};
+
+  // positions: each instruction gets an even number, block ends the odd
+  // number after their terminator
+  std::vector<uint32_t> position(valueCount, 0);
+  std::vector<uint32_t> blockStart(blockCount, 0);
+  std::vector<uint32_t> blockEnd(blockCount, 0);
+  uint32_t pos{2};
+  for (BlockId block : order) {
+    blockStart[block] = pos;
+    for (Value value : function.blocks[block].insts) {
+      position[value] = pos;
+      pos += 2;
+    }
+    blockEnd[block] = pos - 1;
+  }
+
+  auto isAllocatable{[&](Value value) {
+    return value != ir::NO_VALUE && allocatable[value];
+  }};
+
+  // upward exposed uses and definitions per block
+  std::vector<std::vector<uint64_t>> gen(blockCount,
+                                         std::vector<uint64_t>(words, 0));
+  std::vector<std::vector<uint64_t>> kill(blockCount,
+                                          std::vector<uint64_t>(words, 0));
+  for (BlockId block : order) {
+    std::vector<uint64_t> &blockGen{gen[block]};
+    std::vector<uint64_t> &blockKill{kill[block]};
+    for (Value value : function.blocks[block].insts) {
+      const ir::Inst &inst{function.insts[value]};
+      if (inst.op != ir::Op::PHI) {
+        auto use{[&](Value operand) {
+          if (isAllocatable(operand) &&
+              !(blockKill[operand / 64] >> (operand % 64) & 1))
+            blockGen[operand / 64] |= 1ull << (operand % 64);
+        }};
+        if (inst.a != ir::NO_VALUE)
+          use(inst.a);
+        if (inst.b != ir::NO_VALUE)
+          use(inst.b);
+        for (Value operand : function.extraOperands(value))
+          use(operand);
+      }
+      if (isAllocatable(value))
+        blockKill[value / 64] |= 1ull << (value % 64);
+    }
+  }
+
+  // liveness fixpoint, visiting blocks in postorder
+  std::vector<std::vector<uint64_t>> liveIn(blockCount,
+                                            std::vector<uint64_t>(words, 0));
+  std::vector<std::vector<uint64_t>> liveOut(blockCount,
+                                             std::vector<uint64_t>(words, 0));
+  bool changed{true};
+  while (changed) {
+    changed = false;
+    for (auto it = order.rbegin(); it != order.rend(); ++it) {
+      BlockId block{*it};
+      std::vector<uint64_t> out(words, 0);
+      for (BlockId succ : function.blocks[block].succs) {
+        for (size_t w = 0; w < words; w++)
+          out[w] |= liveIn[succ][w];
+        // phi operands flowing along this edge
+        const ir::Block &succBlock{function.blocks[succ]};
+        size_t predIndex{static_cast<size_t>(
+            std::find(succBlock.preds.begin(), succBlock.preds.end(), block) -
+            succBlock.preds.begin())};
+        for (Value phi : succBlock.insts) {
+          if (function.insts[phi].op != ir::Op::PHI)
+            break;
+          Value operand{function.extraOperands(phi)[predIndex]};
+          if (isAllocatable(operand))
+            out[operand / 64] |= 1ull << (operand % 64);
+        }
+      }
+      std::vector<uint64_t> in(words, 0);
+      for (size_t w = 0; w < words; w++)
+        in[w] = gen[block][w] | (out[w] & ~kill[block][w]);
+
+      if (in != liveIn[block] || out != liveOut[block]) {
+        liveIn[block] = std::move(in);
+        liveOut[block] = std::move(out);
+        changed = true;
+      }
+    }
+  }
+
+  // SSA definitions dominate their uses and blocks are in reverse postorder,
+  // so an interval runs from the definition to the furthest use or block end
+  // it is live out of
+  std::vector<LiveInterval> intervals;
+  std::vector<int32_t> intervalOf(valueCount, -1);
+  for (BlockId block : order)
+    for (Value value : function.blocks[block].insts) {
+      if (!isAllocatable(value))
+        continue;
+      const ir::Inst &inst{function.insts[value]};
+      uint32_t start{position[value]};
+      if (inst.op == ir::Op::PHI)
+        start = blockStart[block];
+      else if (inst.op == ir::Op::PARAM)
+        start = 0; // moved out of the argument registers on entry
+      intervalOf[value] = static_cast<int32_t>(intervals.size());
+      intervals.push_back({value, start, start, false});
+    }
+
+  auto extend{[&](Value value, uint32_t to) {
+    if (!isAllocatable(value) || intervalOf[value] < 0)
+      return;
+    LiveInterval &interval{intervals[intervalOf[value]]};
+    interval.end = std::max(interval.end, to);
+  }};
+
+  std::vector<uint32_t> calls;
+  for (BlockId block : order) {
+    for (size_t w = 0; w < words; w++)
+      for (uint64_t bits = liveOut[block][w]; bits != 0; bits &= bits - 1)
+        extend(static_cast<Value>(w * 64 + std::countr_zero(bits)),
+               blockEnd[block]);
+
+    for (Value value : function.blocks[block].insts) {
+      const ir::Inst &inst{function.insts[value]};
+      if (clobbers[value])
+        calls.push_back(position[value]);
+      if (inst.op == ir::Op::PHI) {
+        // operands are read at the end of the corresponding predecessor
+        std::span<const Value> incoming{function.extraOperands(value)};
+        for (size_t i = 0; i < incoming.size(); i++)
+          extend(incoming[i], blockEnd[function.blocks[block].preds[i]]);
+        continue;
+      }
+      if (inst.a != ir::NO_VALUE)
+        extend(inst.a, position[value]);
+      if (inst.b != ir::NO_VALUE)
+        extend(inst.b, position[value]);
+      for (Value operand : function.extraOperands(value))
+        extend(operand, position[value]);
+    }
+  }
+
+  std::ranges::sort(calls);
+  for (LiveInterval &interval : intervals) {
+    auto call{std::ranges::upper_bound(calls, interval.start)};
+    interval.crossesCall = call != calls.end() && *call < interval.end;
+  }
+
+  return intervals;
+}
+
+// Index of a register in the set being allocated.
+static int number(Reg reg) { return static_cast<int>(reg) & 15; }
+
+Allocation LinearScan::run() {
+  Allocation allocation;
+  std::vector<uint32_t> order{computeOrder()};
+  allocation.order.assign(order.begin(), order.end());
+  allocation.locations.resize(function.insts.size());
+
+  std::vector<LiveInterval> intervals{buildIntervals(order)};
+  std::ranges::sort(intervals, {}, &LiveInterval::start);
+
+  std::vector<LiveInterval> active;
+  bool inUse[16]{};
+  bool calleeUsed[16]{};
+
+  auto spill{[&](Value value) {
+    allocation.locations[value] = {Location::Kind::STACK, Reg::NONE,
+                                   allocation.spillSlots++};
+  }};
+
+  for (const LiveInterval &current : intervals) {
+    // expire intervals that ended before this one starts
+    std::erase_if(active, [&](const LiveInterval &interval) {
+      if (interval.end >= current.start)
+        return false;
+      inUse[number(allocation.locations[interval.value].reg)] =
+          false;
+      return true;
+    });
+
+    Reg chosen{Reg::NONE};
+    if (!current.crossesCall)
+      for (Reg reg : callerSaved)
+        if (!inUse[number(reg)]) {
+          chosen = reg;
+          break;
+        }
+    if (chosen == Reg::NONE)
+      for (Reg reg : calleeSaved)
+        if (!inUse[number(reg)]) {
+          chosen = reg;
+          break;
+        }
+
+    if (chosen == Reg::NONE) {
+      // steal the register of the compatible interval that ends last
+      auto victim{active.end()};
+      for (auto it = active.begin(); it != active.end(); ++it) {
+        Reg reg{allocation.locations[it->value].reg};
+        bool compatible{!current.crossesCall ||
+                        std::ranges::find(calleeSaved, reg) !=
+                            calleeSaved.end()};
+        if (compatible && (victim == active.end() || it->end > victim->end))
+          victim = it;
+      }
+      if (victim == active.end() || victim->end <= current.end) {
+        spill(current.value);
+        continue;
+      }
+      chosen = allocation.locations[victim->value].reg;
+      spill(victim->value);
+      active.erase(victim);
+    }
+
+    inUse[number(chosen)] = true;
+    if (std::ranges::find(calleeSaved, chosen) != calleeSaved.end())
+      calleeUsed[number(chosen)] = true;
+    allocation.locations[current.value] = {Location::Kind::REG, chosen, 0};
+    active.push_back(current);
+  }
+
+  for (Reg reg : calleeSaved)
+    if (calleeUsed[number(reg)])
+      allocation.usedCalleeSaved.push_back(reg);
+  return allocation;
+}
+
+} // namespace codegen
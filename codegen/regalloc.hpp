@@ -0,0 +1,82 @@
+#ifndef REGALLOC_H
+#define REGALLOC_H
+
+#include "../ir/ir.hpp"
+#include "x86.hpp"
+#include <span>
+#include <vector>
+
+namespace codegen {
+
+struct Location {
+  enum class Kind : uint8_t { NONE, REG, STACK };
+
+  Kind kind{Kind::NONE};
+  Reg reg{Reg::NONE};
+  // Spill slot index for STACK.
+  int32_t slot{0};
+};
+
+struct LiveInterval {
+  ir::Value value;
+  uint32_t start;
+  uint32_t end;
+  bool crossesCall;
+};
+
+struct Allocation {
+  // Blocks in the linear (reverse postorder) order positions are numbered
+  // in, which is also the order code is emitted in unless there is a
+  // profile.
+  std::vector<ir::BlockId> order;
+  std::vector<Location> locations;
+  std::vector<Reg> usedCalleeSaved;
+  int spillSlots{0};
+};
+
+constexpr Reg CALLER_SAVED[]{Reg::RSI, Reg::RDI, Reg::R8, Reg::R9, Reg::R10};
+constexpr Reg CALLEE_SAVED[]{Reg::RBX, Reg::R12, Reg::R13, Reg::R14,
+                             Reg::R15};
+
+// xmm0 and xmm1 are scratch registers; System V preserves no xmm register
+// across calls.
+constexpr Reg VECTOR_REGISTERS[]{
+    Reg::XMM2,  Reg::XMM3,  Reg::XMM4,  Reg::XMM5,  Reg::XMM6,
+    Reg::XMM7,  Reg::XMM8,  Reg::XMM9,  Reg::XMM10, Reg::XMM11,
+    Reg::XMM12, Reg::XMM13, Reg::XMM14, Reg::XMM15};
+
+// Poletto & Sarkar style linear scan over live intervals computed from block
+// liveness in reverse postorder. Values live across a call are restricted to
+// callee-saved registers; when registers run out the interval ending last is
+// spilled. rax, rcx, rdx and r11 are never allocated and serve as scratch
+// registers for instruction selection. Vector values are allocated by a
+// separate run over the xmm registers.
+class LinearScan {
+private:
+  const ir::Function &function;
+  // Values that need a register or stack slot of their own (constants and
+  // addresses of stack slots and symbols are rematerialised at each use).
+  const std::vector<bool> &allocatable;
+  // Instructions that clobber the caller-saved registers.
+  const std::vector<bool> &clobbers;
+  std::span<const Reg> callerSaved;
+  std::span<const Reg> calleeSaved;
+
+  std::vector<uint32_t> computeOrder();
+  std::vector<LiveInterval> buildIntervals(const std::vector<uint32_t> &order);
+
+public:
+  LinearScan(const ir::Function &function,
+             const std::vector<bool> &allocatable,
+             const std::vector<bool> &clobbers,
+             std::span<const Reg> callerSaved = CALLER_SAVED,
+             std::span<const Reg> calleeSaved = CALLEE_SAVED)
+      : function(function), allocatable(allocatable), clobbers(clobbers),
+        callerSaved(callerSaved), calleeSaved(calleeSaved) {}
+
+  Allocation run();
+};
+
+} // namespace codegen
+
+#endif
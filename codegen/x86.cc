@@ -0,0 +1,44 @@
+#include "x86.hpp"
+
+namespace codegen {
+
+std::string_view regName(Reg reg, int size) {
+  static constexpr std::string_view names64[]{
+      "rax", "rcx", "rdx", "rbx", "rsp", "rbp", "rsi", "rdi", "r8",
+      "r9",  "r10", "r11", "r12", "r13", "r14", "r15", "rip"};
+  static constexpr std::string_view names32[]{
+      "eax", "ecx", "edx",  "ebx",  "esp",  "ebp",  "esi",  "edi", "r8d",
+      "r9d", "r10d", "r11d", "r12d", "r13d", "r14d", "r15d", "eip"};
+  static constexpr std::string_view names8[]{
+      "al",  "cl",   "dl",   "bl",   "spl",  "bpl",  "sil",  "dil", "r8b",
+      "r9b", "r10b", "r11b", "r12b", "r13b", "r14b", "r15b", "rip"};
+
+  static constexpr std::string_view xmmNames[]{
+      "xmm0", "xmm1", "xmm2",  "xmm3",  "xmm4",  "xmm5",  "xmm6",  "xmm7",
+      "xmm8", "xmm9", "xmm10", "xmm11", "xmm12", "xmm13", "xmm14", "xmm15"};
+
+  size_t index{static_cast<size_t>(reg)};
+  if (isXmm(reg))
+    return xmmNames[index & 15];
+  if (index > static_cast<size_t>(Reg::RIP))
+    return "?";
+  if (size == 1)
+    return names8[index];
+  if (size == 4)
+    return names32[index];
+  return names64[index];
+}
+
+std::string_view toString(Cond cond) {
+  static constexpr std::string_view names[]{"o", "no", "b",  "ae", "e",  "ne",
+                                            "be", "a", "s",  "ns", "p",  "np",
+                                            "l",  "ge", "le", "g"};
+  return names[static_cast<size_t>(cond)];
+}
+
+// Flipping the low bit of a condition code negates it.
+Cond invert(Cond cond) {
+  return static_cast<Cond>(static_cast<uint8_t>(cond) ^ 1);
+}
+
+} // namespace codegen
@@ -0,0 +1,207 @@
+#ifndef X86_H
+#define X86_H
+
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace codegen {
+
+// Registers in hardware encoding order. The SSE registers share the encodings
+// of the general purpose ones in their low four bits.
+enum class Reg : uint8_t {
+  RAX,
+  RCX,
+  RDX,
+  RBX,
+  RSP,
+  RBP,
+  RSI,
+  RDI,
+  R8,
+  R9,
+  R10,
+  R11,
+  R12,
+  R13,
+  R14,
+  R15,
+  RIP,
+  XMM0 = 0x20,
+  XMM1,
+  XMM2,
+  XMM3,
+  XMM4,
+  XMM5,
+  XMM6,
+  XMM7,
+  XMM8,
+  XMM9,
+  XMM10,
+  XMM11,
+  XMM12,
+  XMM13,
+  XMM14,
+  XMM15,
+  NONE = 0xff,
+};
+
+constexpr bool isXmm(Reg reg) { return reg >= Reg::XMM0 && reg <= Reg::XMM15; }
+
+// Condition codes in hardware encoding order (the low nibble of Jcc/SETcc).
+enum class Cond : uint8_t {
+  O,
+  NO,
+  B,
+  AE,
+  E,
+  NE,
+  BE,
+  A,
+  S,
+  NS,
+  P,
+  NP,
+  L,
+  GE,
+  LE,
+  G,
+};
+
+enum class MOp : uint8_t {
+  MOV,
+  MOVSX, // size: destination size, srcSize: source size
+  MOVZX,
+  LEA,
+  ADD,
+  SUB,
+  IMUL,
+  AND,
+  OR,
+  XOR,
+  CMP,
+  TEST,
+  NEG,
+  IDIV,
+  CDQ,
+  CQO,
+  SETCC,
+  JMP,
+  JCC,
+  CALL,
+  RET,
+  PUSH,
+  POP,
+  // SSE2 on 128-bit vectors; memory operands other than MOVDQU's must be
+  // 16-byte aligned
+  MOVDQU,
+  MOVD,   // 32-bit move between a general purpose and an xmm register
+  PSHUFD, // srcSize: the shuffle control byte
+  PADDB,
+  PADDD,
+  PSUBB,
+  PSUBD,
+  LABEL, // pseudo instruction marking a jump target
+};
+
+struct Operand {
+  enum class Kind : uint8_t { NONE, REG, IMM, MEM, LABEL, SYMBOL };
+
+  Kind kind{Kind::NONE};
+  // Register for REG, base register for MEM (RIP for symbol-relative).
+  Reg reg{Reg::NONE};
+  Reg index{Reg::NONE};
+  uint8_t scale{1};
+  int32_t disp{0};
+  // Immediate for IMM, label id for LABEL, symbol id for SYMBOL and for MEM
+  // operands based on RIP.
+  int64_t imm{0};
+
+  static Operand none() { return {}; }
+  static Operand ofReg(Reg reg) {
+    Operand op;
+    op.kind = Kind::REG;
+    op.reg = reg;
+    return op;
+  }
+  static Operand ofImm(int64_t value) {
+    Operand op;
+    op.kind = Kind::IMM;
+    op.imm = value;
+    return op;
+  }
+  static Operand mem(Reg base, int32_t disp) {
+    Operand op;
+    op.kind = Kind::MEM;
+    op.reg = base;
+    op.disp = disp;
+    return op;
+  }
+  static Operand symbolMem(uint32_t symbol, int32_t disp = 0) {
+    Operand op;
+    op.kind = Kind::MEM;
+    op.reg = Reg::RIP;
+    op.imm = symbol;
+    op.disp = disp;
+    return op;
+  }
+  static Operand ofLabel(uint32_t label) {
+    Operand op;
+    op.kind = Kind::LABEL;
+    op.imm = label;
+    return op;
+  }
+  static Operand ofSymbol(uint32_t symbol) {
+    Operand op;
+    op.kind = Kind::SYMBOL;
+    op.imm = symbol;
+    return op;
+  }
+
+  bool isReg() const { return kind == Kind::REG; }
+  bool isReg(Reg r) const { return kind == Kind::REG && reg == r; }
+  bool isImm() const { return kind == Kind::IMM; }
+  bool isMem() const { return kind == Kind::MEM; }
+  bool operator==(const Operand &) const = default;
+};
+
+struct MInst {
+  MOp op;
+  uint8_t size{8};
+  uint8_t srcSize{0};
+  Cond cond{Cond::E};
+  Operand dst;
+  Operand src;
+};
+
+enum class SymbolKind : uint8_t { FUNCTION, DATA, RODATA };
+
+struct Symbol {
+  std::string name;
+  SymbolKind kind;
+  bool defined;
+  // DATA: zero-initialised size and alignment; RODATA: the bytes.
+  int size{0};
+  int align{1};
+  std::string bytes;
+};
+
+struct MachineFunction {
+  uint32_t symbol;
+  std::vector<MInst> code;
+  uint32_t labelCount{0};
+};
+
+struct MachineModule {
+  std::vector<Symbol> symbols;
+  std::vector<MachineFunction> functions;
+};
+
+std::string_view regName(Reg reg, int size);
+std::string_view toString(Cond cond);
+Cond invert(Cond cond);
+
+} // namespace codegen
+
+#endif
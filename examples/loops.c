@@ -0,0 +1,35 @@
+#include "minic-stdlib.h"
+int grid[64][64];
+int fill(int *a, int n, int k) { int i; i = 0; while (i < n) { a[i] = i * k + 3; i = i + 1; } return n; }
+int sumPairs(int *a, int n) { int i; int s; i = 0; s = 0; while (i < n - 1) { s = s + a[i] * a[i + 1]; i = i + 1; } return s; }
+int down(int *a, int n) { int s; s = 0; while (n > 0) { n = n - 1; s = s + a[n]; } return s; }
+int main() {
+  int a[100]; char c[50]; int i; int j; int s; int t; int r; int n; int k;
+  n = read_i();
+  fill((int*)a, 100, n);
+  s = 0; r = 0;
+  while (r < 200) {
+    i = 0;
+    while (i < 64) {
+      j = 0;
+      while (j < 64) { grid[i][j] = i * j + r; j = j + 1; }
+      i = i + 1;
+    }
+    i = 0;
+    while (i < 64) {
+      j = 0; t = n * 3 + r;
+      while (j < 64) { s = s + grid[i][j] + t; j = j + 1; }
+      i = i + 1;
+    }
+    r = r + 1;
+  }
+  i = 0; k = 5;
+  while (i < 50) { c[i] = (char)(97 + i % 26); i = i + 1; }
+  i = 2;
+  while (i < 40) { print_c(c[i + 3]); i = i + 3; }
+  print_c('\n');
+  print_i(s); print_c(' ');
+  print_i(sumPairs((int*)a, 100)); print_c(' ');
+  print_i(down((int*)a, 100)); print_c('\n');
+  return 0;
+}
@@ -0,0 +1,117 @@
+#ifndef BYTECODE_H
+#define BYTECODE_H
+
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace interp {
+
+constexpr uint32_t NO_REGISTER = std::numeric_limits<uint32_t>::max();
+
+// Register machine: every instruction names its registers explicitly, so an
+// SSA value maps to one register of the frame instead of a stack push/pop.
+// Registers hold 64-bit values; I8 and I32 values are kept sign-extended.
+// A 128-bit vector takes two consecutive registers.
+enum class Opcode : uint8_t {
+  MOV, // dst = a
+  // 32-bit arithmetic wraps like the native code does
+  ADD,
+  SUB,
+  MUL,
+  DIV,
+  REM,
+  // 64-bit pointer arithmetic
+  ADDP,
+  SUBP,
+  MULP,
+  EQ,
+  NE,
+  LT,
+  LE,
+  GT,
+  GE,
+  TRUNC8,
+  TRUNC32,
+  ALLOCA, // dst = frame memory + imm
+  LOAD8,  // dst = *a
+  LOAD32,
+  LOAD64,
+  STORE8, // *a = b
+  STORE32,
+  STORE64,
+  MEMCPY, // memcpy(a, b, imm)
+  // lane-wise on vectors of 16 bytes or 4 ints
+  VMOV,
+  VLOAD,  // dst = *a
+  VSTORE, // *a = b
+  VADD8,
+  VADD32,
+  VSUB8,
+  VSUB32,
+  VSPLAT8, // every lane of dst = a
+  VSPLAT32,
+  VREDUCE32, // dst = sum of the lanes of a
+  JMP,    // pc = imm
+  BRNZ,   // pc = a != 0 ? b : imm
+  // compare and branch: pc = a <cc> b ? dst : imm
+  BEQ,
+  BNE,
+  BLT,
+  BLE,
+  BGT,
+  BGE,
+  CALL,        // dst = functions[imm](args[a .. a + b))
+  CALL_NATIVE, // dst = natives[imm](args[a .. a + b))
+  RET,         // return a
+  RET_VOID,
+};
+
+constexpr size_t OPCODE_COUNT = static_cast<size_t>(Opcode::RET_VOID) + 1;
+
+struct Instruction {
+  // Filled in with the address of the opcode's handler before the first run
+  // when the interpreter uses direct threading.
+  const void *handler{nullptr};
+  Opcode op;
+  uint32_t dst{NO_REGISTER};
+  uint32_t a{NO_REGISTER};
+  uint32_t b{NO_REGISTER};
+  int64_t imm{0};
+};
+
+struct Function {
+  std::string name;
+  std::vector<Instruction> code;
+  // Registers [0, constants.size()) are initialised from `constants` on each
+  // call and parameters follow them.
+  std::vector<int64_t> constants;
+  uint32_t paramCount{0};
+  uint32_t registerCount{0};
+  // Argument registers of all calls, referenced by CALL's a/b.
+  std::vector<uint32_t> arguments;
+  // Bytes of stack memory for the function's allocas.
+  uint32_t frameSize{0};
+};
+
+using Native = int64_t (*)(const int64_t *args);
+
+struct Program {
+  std::vector<Function> functions;
+  std::vector<Native> natives;
+  std::vector<std::string> nativeNames;
+  // Zero-initialised storage for the globals and the string literals that
+  // pointer constants refer to.
+  std::unique_ptr<uint8_t[]> globals;
+  std::vector<std::string> strings;
+  uint32_t mainFunction{NO_REGISTER};
+  // Handler table the instructions are currently threaded with.
+  const void *const *handlers{nullptr};
+};
+
+} // namespace interp
+
+#endif
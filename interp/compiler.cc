@@ -0,0 +1,398 @@
+#include "compiler.hpp"
+#include "natives.hpp"
+#include <algorithm>
+#include <format>
+#include <iostream>
+
+namespace interp {
+
+using ir::BlockId;
+using ir::Op;
+using ir::Value;
+
+static int64_t roundUp(int64_t value, int64_t align) {
+  return (value + align - 1) / align * align;
+}
+
+static bool isCompare(Op op) {
+  return op == Op::EQ || op == Op::NE || op == Op::LT || op == Op::LE ||
+         op == Op::GT || op == Op::GE;
+}
+
+Compiler::Compiler(const ir::Module &module, Program &program)
+    : module(module), program(program) {}
+
+int Compiler::getErrorCount() const { return errorCount; }
+
+void Compiler::compile() {
+  uint64_t size{0};
+  for (const ir::Global &global : module.globals) {
+    size = roundUp(size, global.align);
+    globalOffsets.push_back(size);
+    size += global.size;
+  }
+  program.globals = std::make_unique<uint8_t[]>(std::max<uint64_t>(size, 1));
+  program.strings = module.strings;
+
+  // functions keep their IR indices so calls need no remapping; externals
+  // stay empty and are called through the native table instead
+  program.functions.resize(module.functions.size());
+  program.natives.assign(module.functions.size(), nullptr);
+  for (size_t i = 0; i < module.functions.size(); i++) {
+    const ir::Function &fn{*module.functions[i]};
+    program.functions[i].name = fn.name;
+    if (fn.external) {
+      program.natives[i] = findNative(fn.name);
+      if (program.natives[i] == nullptr) {
+        std::cout << std::format("Runtime error: no native implementation of "
+                                 "{}!",
+                                 fn.name)
+                  << std::endl;
+        errorCount++;
+      }
+      continue;
+    }
+    if (fn.name == "main")
+      program.mainFunction = static_cast<uint32_t>(i);
+    compile(fn, program.functions[i]);
+  }
+
+  if (program.mainFunction == NO_REGISTER) {
+    std::cout << "Runtime error: no main function!" << std::endl;
+    errorCount++;
+  }
+}
+
+size_t Compiler::emit(Instruction inst) {
+  out->code.push_back(inst);
+  return out->code.size() - 1;
+}
+
+uint32_t Compiler::reg(Value value) const { return registers[value]; }
+
+// Constants, global and string addresses come first so that a call only has
+// to copy that prefix into the new frame, followed by the parameters.
+void Compiler::assignRegisters() {
+  registers.assign(function->insts.size(), NO_REGISTER);
+  useCount.assign(function->insts.size(), 0);
+  allocaOffsets.assign(function->insts.size(), 0);
+
+  for (const ir::Block &block : function->blocks)
+    for (Value value : block.insts) {
+      function->forEachOperand(value,
+                               [&](Value operand) { useCount[operand]++; });
+
+      const ir::Inst &inst{function->insts[value]};
+      int64_t constant{0};
+      switch (inst.op) {
+      case Op::CONST:
+        constant = inst.imm;
+        break;
+      case Op::GLOBAL:
+        constant = reinterpret_cast<int64_t>(program.globals.get() +
+                                             globalOffsets[inst.imm]);
+        break;
+      case Op::STRING:
+        constant = reinterpret_cast<int64_t>(program.strings[inst.imm].data());
+        break;
+      default:
+        continue;
+      }
+      registers[value] = static_cast<uint32_t>(out->constants.size());
+      out->constants.push_back(constant);
+    }
+
+  uint32_t next{static_cast<uint32_t>(out->constants.size())};
+  out->paramCount = static_cast<uint32_t>(function->params.size());
+  for (const ir::Block &block : function->blocks)
+    for (Value value : block.insts)
+      if (function->insts[value].op == Op::PARAM)
+        registers[value] =
+            next + static_cast<uint32_t>(function->insts[value].imm);
+  next += out->paramCount;
+
+  int64_t frame{0};
+  for (const ir::Block &block : function->blocks)
+    for (Value value : block.insts) {
+      const ir::Inst &inst{function->insts[value]};
+      if (registers[value] != NO_REGISTER || !inst.hasResult())
+        continue;
+      registers[value] = next;
+      next += inst.type == ir::Type::VEC ? 2 : 1;
+      if (inst.op == Op::ALLOCA) {
+        frame = roundUp(frame, std::max<int64_t>(inst.aux, 1));
+        allocaOffsets[value] = frame;
+        frame += inst.imm;
+      }
+    }
+  temporary = next++;
+  out->registerCount = next;
+  out->frameSize = static_cast<uint32_t>(roundUp(frame, 16));
+}
+
+bool Compiler::isFused(Value compare, BlockId block) const {
+  const std::vector<Value> &insts{function->blocks[block].insts};
+  if (insts.size() < 2 || insts[insts.size() - 2] != compare ||
+      useCount[compare] != 1)
+    return false;
+  const ir::Inst &terminator{function->insts[insts.back()]};
+  return terminator.op == Op::CONDBR && terminator.a == compare;
+}
+
+void Compiler::patch(size_t inst, Field field, size_t target) {
+  Instruction &instruction{out->code[inst]};
+  switch (field) {
+  case Field::DST:
+    instruction.dst = static_cast<uint32_t>(target);
+    break;
+  case Field::B:
+    instruction.b = static_cast<uint32_t>(target);
+    break;
+  case Field::IMM:
+    instruction.imm = static_cast<int64_t>(target);
+    break;
+  }
+}
+
+void Compiler::target(size_t inst, Field field, BlockId from, BlockId to) {
+  bool phis{false};
+  for (Value value : function->blocks[to].insts)
+    phis |= function->insts[value].op == Op::PHI;
+  if (phis)
+    edges.push_back({inst, field, from, to});
+  else
+    fixups.push_back({inst, field, to});
+}
+
+void Compiler::phiCopies(BlockId from, BlockId to) {
+  const ir::Block &block{function->blocks[to]};
+  size_t pred{static_cast<size_t>(
+      std::ranges::find(block.preds, from) - block.preds.begin())};
+
+  std::vector<std::pair<uint32_t, uint32_t>> copies;
+  for (Value value : block.insts) {
+    if (function->insts[value].op != Op::PHI)
+      break;
+    uint32_t source{reg(function->extraOperands(value)[pred])};
+    copies.emplace_back(reg(value), source);
+    // vectors are copied a register at a time
+    if (function->insts[value].type == ir::Type::VEC)
+      copies.emplace_back(reg(value) + 1, source + 1);
+  }
+  parallelCopies(std::move(copies));
+}
+
+// Sequentialises simultaneous copies (dst, src). A copy is safe once no
+// other pending copy still reads its destination; cycles are broken by
+// saving one destination in the temporary register.
+void Compiler::parallelCopies(
+    std::vector<std::pair<uint32_t, uint32_t>> copies) {
+  std::erase_if(copies,
+                [](const auto &copy) { return copy.first == copy.second; });
+
+  while (!copies.empty()) {
+    auto ready{std::ranges::find_if(copies, [&](const auto &copy) {
+      return std::ranges::none_of(copies, [&](const auto &other) {
+        return other.second == copy.first;
+      });
+    })};
+
+    if (ready == copies.end()) {
+      uint32_t blocked{copies.front().first};
+      emit({.op = Opcode::MOV, .dst = temporary, .a = blocked});
+      for (auto &copy : copies)
+        if (copy.second == blocked)
+          copy.second = temporary;
+      continue;
+    }
+
+    emit({.op = Opcode::MOV, .dst = ready->first, .a = ready->second});
+    copies.erase(ready);
+  }
+}
+
+void Compiler::select(Value value, BlockId next) {
+  const ir::Inst &inst{function->insts[value]};
+  BlockId block{inst.block};
+  bool pointer{inst.type == ir::Type::PTR};
+  bool bytes{inst.aux == 1};
+
+  auto binary{[&](Opcode op) {
+    emit({.op = op, .dst = reg(value), .a = reg(inst.a), .b = reg(inst.b)});
+  }};
+
+  if (inst.type == ir::Type::VEC)
+    switch (inst.op) {
+    case Op::LOAD:
+      emit({.op = Opcode::VLOAD, .dst = reg(value), .a = reg(inst.a)});
+      return;
+    case Op::STORE:
+      emit({.op = Opcode::VSTORE, .a = reg(inst.a), .b = reg(inst.b)});
+      return;
+    case Op::ADD:
+      binary(bytes ? Opcode::VADD8 : Opcode::VADD32);
+      return;
+    case Op::SUB:
+      binary(bytes ? Opcode::VSUB8 : Opcode::VSUB32);
+      return;
+    case Op::SPLAT:
+      emit({.op = bytes ? Opcode::VSPLAT8 : Opcode::VSPLAT32,
+            .dst = reg(value),
+            .a = reg(inst.a)});
+      return;
+    case Op::COPY:
+      emit({.op = Opcode::VMOV, .dst = reg(value), .a = reg(inst.a)});
+      return;
+    default:
+      break;
+    }
+
+  switch (inst.op) {
+  case Op::NOP:
+  case Op::CONST:
+  case Op::PARAM:
+  case Op::GLOBAL:
+  case Op::STRING:
+  case Op::PHI:
+    return;
+  case Op::REDUCE:
+    emit({.op = Opcode::VREDUCE32, .dst = reg(value), .a = reg(inst.a)});
+    return;
+  case Op::SPLAT:
+    return;
+  case Op::ALLOCA:
+    emit({.op = Opcode::ALLOCA,
+          .dst = reg(value),
+          .imm = allocaOffsets[value]});
+    return;
+  case Op::LOAD: {
+    Opcode op{inst.type == ir::Type::I8    ? Opcode::LOAD8
+              : inst.type == ir::Type::I32 ? Opcode::LOAD32
+                                           : Opcode::LOAD64};
+    emit({.op = op, .dst = reg(value), .a = reg(inst.a)});
+    return;
+  }
+  case Op::STORE: {
+    Opcode op{inst.type == ir::Type::I8    ? Opcode::STORE8
+              : inst.type == ir::Type::I32 ? Opcode::STORE32
+                                           : Opcode::STORE64};
+    emit({.op = op, .a = reg(inst.a), .b = reg(inst.b)});
+    return;
+  }
+  case Op::MEMCPY:
+    emit({.op = Opcode::MEMCPY, .a = reg(inst.a), .b = reg(inst.b),
+          .imm = inst.imm});
+    return;
+  case Op::ADD:
+    binary(pointer ? Opcode::ADDP : Opcode::ADD);
+    return;
+  case Op::SUB:
+    binary(pointer ? Opcode::SUBP : Opcode::SUB);
+    return;
+  case Op::MUL:
+    binary(pointer ? Opcode::MULP : Opcode::MUL);
+    return;
+  case Op::DIV:
+    binary(Opcode::DIV);
+    return;
+  case Op::REM:
+    binary(Opcode::REM);
+    return;
+  case Op::EQ:
+  case Op::NE:
+  case Op::LT:
+  case Op::LE:
+  case Op::GT:
+  case Op::GE:
+    if (!isFused(value, block))
+      binary(static_cast<Opcode>(static_cast<int>(Opcode::EQ) +
+                                 static_cast<int>(inst.op) -
+                                 static_cast<int>(Op::EQ)));
+    return;
+  case Op::SEXT:
+  case Op::COPY:
+    // narrower values are already kept sign-extended
+    emit({.op = Opcode::MOV, .dst = reg(value), .a = reg(inst.a)});
+    return;
+  case Op::TRUNC:
+    emit({.op = inst.type == ir::Type::I8 ? Opcode::TRUNC8 : Opcode::TRUNC32,
+          .dst = reg(value),
+          .a = reg(inst.a)});
+    return;
+  case Op::CALL: {
+    std::span<const Value> args{function->extraOperands(value)};
+    uint32_t first{static_cast<uint32_t>(out->arguments.size())};
+    for (Value arg : args)
+      out->arguments.push_back(reg(arg));
+    bool native{module.functions[inst.imm]->external};
+    emit({.op = native ? Opcode::CALL_NATIVE : Opcode::CALL,
+          .dst = inst.hasResult() ? reg(value) : NO_REGISTER,
+          .a = first,
+          .b = static_cast<uint32_t>(args.size()),
+          .imm = inst.imm});
+    return;
+  }
+  case Op::BR: {
+    BlockId to{function->blocks[block].succs[0]};
+    phiCopies(block, to);
+    if (to != next)
+      fixups.push_back({emit({.op = Opcode::JMP}), Field::IMM, to});
+    return;
+  }
+  case Op::CONDBR: {
+    BlockId ifTrue{function->blocks[block].succs[0]};
+    BlockId ifFalse{function->blocks[block].succs[1]};
+    const ir::Inst &condition{function->insts[inst.a]};
+
+    size_t branch;
+    Field trueField;
+    if (isCompare(condition.op) && isFused(inst.a, block)) {
+      Opcode op{static_cast<Opcode>(static_cast<int>(Opcode::BEQ) +
+                                    static_cast<int>(condition.op) -
+                                    static_cast<int>(Op::EQ))};
+      branch = emit({.op = op, .a = reg(condition.a), .b = reg(condition.b)});
+      trueField = Field::DST;
+    } else {
+      branch = emit({.op = Opcode::BRNZ, .a = reg(inst.a)});
+      trueField = Field::B;
+    }
+    target(branch, trueField, block, ifTrue);
+    target(branch, Field::IMM, block, ifFalse);
+    return;
+  }
+  case Op::RET:
+    if (inst.a == ir::NO_VALUE)
+      emit({.op = Opcode::RET_VOID});
+    else
+      emit({.op = Opcode::RET, .a = reg(inst.a)});
+    return;
+  }
+}
+
+void Compiler::compile(const ir::Function &fn, Function &result) {
+  function = &fn;
+  out = &result;
+  fixups.clear();
+  edges.clear();
+  assignRegisters();
+
+  std::vector<size_t> blockStart(fn.blocks.size(), 0);
+  for (BlockId block = 0; block < fn.blocks.size(); block++) {
+    blockStart[block] = out->code.size();
+    BlockId next{block + 1 < fn.blocks.size() ? block + 1 : ir::NO_BLOCK};
+    for (Value value : fn.blocks[block].insts)
+      select(value, next);
+  }
+
+  // conditional edges into phi blocks get their copies out of line
+  for (const Edge &edge : edges) {
+    patch(edge.inst, edge.field, out->code.size());
+    phiCopies(edge.from, edge.to);
+    fixups.push_back({emit({.op = Opcode::JMP}), Field::IMM, edge.to});
+  }
+
+  for (const Fixup &fixup : fixups)
+    patch(fixup.inst, fixup.field, blockStart[fixup.block]);
+}
+
+} // namespace interp
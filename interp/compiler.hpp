@@ -0,0 +1,68 @@
+#ifndef INTERP_COMPILER_H
+#define INTERP_COMPILER_H
+
+#include "../ir/ir.hpp"
+#include "bytecode.hpp"
+#include <utility>
+#include <vector>
+
+namespace interp {
+
+// Translates SSA IR into register bytecode. Every IR value gets its own
+// register; constants and addresses of globals and strings are preloaded
+// registers; phis become copies on their incoming edges.
+class Compiler {
+private:
+  enum class Field : uint8_t { DST, B, IMM };
+
+  struct Fixup {
+    size_t inst;
+    Field field;
+    ir::BlockId block;
+  };
+
+  // Edge into a block with phis, compiled after the function body.
+  struct Edge {
+    size_t inst;
+    Field field;
+    ir::BlockId from;
+    ir::BlockId to;
+  };
+
+  const ir::Module &module;
+  Program &program;
+  std::vector<uint64_t> globalOffsets;
+  int errorCount{0};
+
+  // per function state
+  const ir::Function *function{nullptr};
+  Function *out{nullptr};
+  std::vector<uint32_t> registers;
+  std::vector<uint32_t> useCount;
+  std::vector<int64_t> allocaOffsets;
+  std::vector<Fixup> fixups;
+  std::vector<Edge> edges;
+  uint32_t temporary{0};
+
+  size_t emit(Instruction inst);
+  uint32_t reg(ir::Value value) const;
+  void target(size_t inst, Field field, ir::BlockId from, ir::BlockId to);
+  void patch(size_t inst, Field field, size_t target);
+  void phiCopies(ir::BlockId from, ir::BlockId to);
+  void parallelCopies(std::vector<std::pair<uint32_t, uint32_t>> copies);
+  bool isFused(ir::Value compare, ir::BlockId block) const;
+
+  void assignRegisters();
+  void select(ir::Value value, ir::BlockId next);
+  void compile(const ir::Function &function, Function &out);
+
+public:
+  Compiler(const ir::Module &module, Program &program);
+
+  void compile();
+  int getErrorCount() const;
+};
+
+} // namespace interp
+
+#endif
@@ -0,0 +1,349 @@
+#include "interpreter.hpp"
+#include <algorithm>
+#include <cstring>
+#include <format>
+#include <iostream>
+
+#if defined(__GNUC__)
+#define INTERP_THREADED 1
+#else
+#define INTERP_THREADED 0
+#endif
+
+namespace interp {
+
+// Arithmetic is done on unsigned bits so that overflow wraps like the native
+// code does instead of being undefined.
+static uint64_t bits(int64_t value) { return static_cast<uint64_t>(value); }
+
+static int64_t wrap32(uint64_t value) {
+  return static_cast<int32_t>(static_cast<uint32_t>(value));
+}
+
+static int64_t wrap64(uint64_t value) { return static_cast<int64_t>(value); }
+
+static int32_t low32(int64_t value) { return static_cast<int32_t>(value); }
+
+template <class T> static int64_t load(int64_t address) {
+  T value;
+  std::memcpy(&value, reinterpret_cast<const void *>(address), sizeof(T));
+  return value;
+}
+
+template <class T> static void store(int64_t address, int64_t value) {
+  T narrowed{static_cast<T>(value)};
+  std::memcpy(reinterpret_cast<void *>(address), &narrowed, sizeof(T));
+}
+
+// Vectors are operated on as arrays of unsigned lanes so that they wrap.
+template <class T, class F>
+static void lanes(int64_t *dst, const int64_t *a, const int64_t *b, F f) {
+  T x[16 / sizeof(T)];
+  T y[16 / sizeof(T)];
+  std::memcpy(x, a, 16);
+  std::memcpy(y, b, 16);
+  for (size_t i = 0; i < std::size(x); i++)
+    x[i] = static_cast<T>(f(x[i], y[i]));
+  std::memcpy(dst, x, 16);
+}
+
+template <class T> static void splat(int64_t *dst, int64_t value) {
+  T x[16 / sizeof(T)];
+  std::ranges::fill(x, static_cast<T>(value));
+  std::memcpy(dst, x, 16);
+}
+
+Interpreter::Interpreter(Program &program)
+    : program(program),
+      registerStack(new int64_t[REGISTER_STACK_SIZE]),
+      memoryStack(new uint8_t[MEMORY_STACK_SIZE]) {
+  frames.reserve(1024);
+}
+
+uint64_t Interpreter::getExecutedCount() const { return executed; }
+
+int Interpreter::getErrorCount() const { return errorCount; }
+
+int64_t Interpreter::run(bool count) {
+  executed = 0;
+  return count ? execute<true>(program.mainFunction)
+               : execute<false>(program.mainFunction);
+}
+
+// Each handler ends by dispatching the next instruction itself, so with
+// computed goto every handler has its own indirect branch for the predictor
+// to learn from rather than sharing the one at the top of a switch.
+#if INTERP_THREADED
+#define OP(name)                                                               \
+  op_##name:                                                                   \
+  case Opcode::name
+#define DISPATCH()                                                             \
+  do {                                                                         \
+    if constexpr (COUNT)                                                       \
+      executed++;                                                              \
+    goto *pc->handler;                                                         \
+  } while (0)
+#else
+#define OP(name) case Opcode::name
+#define DISPATCH()                                                             \
+  do {                                                                         \
+    if constexpr (COUNT)                                                       \
+      executed++;                                                              \
+    goto dispatch;                                                             \
+  } while (0)
+#endif
+#define NEXT()                                                                 \
+  do {                                                                         \
+    ++pc;                                                                      \
+    DISPATCH();                                                                \
+  } while (0)
+#define JUMP(target)                                                           \
+  do {                                                                         \
+    pc = code + (target);                                                      \
+    DISPATCH();                                                                \
+  } while (0)
+
+template <bool COUNT> int64_t Interpreter::execute(uint32_t entry) {
+#if INTERP_THREADED
+  // in Opcode order
+  static const void *const HANDLERS[] = {
+      &&op_MOV,     &&op_ADD,    &&op_SUB,         &&op_MUL,
+      &&op_DIV,     &&op_REM,    &&op_ADDP,        &&op_SUBP,
+      &&op_MULP,    &&op_EQ,     &&op_NE,          &&op_LT,
+      &&op_LE,      &&op_GT,     &&op_GE,          &&op_TRUNC8,
+      &&op_TRUNC32, &&op_ALLOCA, &&op_LOAD8,       &&op_LOAD32,
+      &&op_LOAD64,  &&op_STORE8, &&op_STORE32,     &&op_STORE64,
+      &&op_MEMCPY,    &&op_VMOV,      &&op_VLOAD,       &&op_VSTORE,
+      &&op_VADD8,     &&op_VADD32,    &&op_VSUB8,       &&op_VSUB32,
+      &&op_VSPLAT8,   &&op_VSPLAT32,  &&op_VREDUCE32,   &&op_JMP,
+      &&op_BRNZ,      &&op_BEQ,       &&op_BNE,         &&op_BLT,
+      &&op_BLE,       &&op_BGT,       &&op_BGE,         &&op_CALL,
+      &&op_CALL_NATIVE, &&op_RET,     &&op_RET_VOID,
+  };
+  static_assert(std::size(HANDLERS) == OPCODE_COUNT);
+
+  // thread the code for this instantiation of the loop
+  if (program.handlers != HANDLERS) {
+    for (Function &function : program.functions)
+      for (Instruction &inst : function.code)
+        inst.handler = HANDLERS[static_cast<size_t>(inst.op)];
+    program.handlers = HANDLERS;
+  }
+#endif
+
+  frames.clear();
+  const int64_t *registersEnd{registerStack.get() + REGISTER_STACK_SIZE};
+  const uint8_t *memoryEnd{memoryStack.get() + MEMORY_STACK_SIZE};
+
+  const Function *function{&program.functions[entry]};
+  const Instruction *code{function->code.data()};
+  const Instruction *pc{code};
+  int64_t *regs{registerStack.get()};
+  uint8_t *memory{memoryStack.get()};
+  std::ranges::copy(function->constants, regs);
+
+  DISPATCH();
+
+#if !INTERP_THREADED
+dispatch:
+#endif
+  switch (pc->op) {
+  OP(MOV):
+    regs[pc->dst] = regs[pc->a];
+    NEXT();
+  OP(ADD):
+    regs[pc->dst] = wrap32(bits(regs[pc->a]) + bits(regs[pc->b]));
+    NEXT();
+  OP(SUB):
+    regs[pc->dst] = wrap32(bits(regs[pc->a]) - bits(regs[pc->b]));
+    NEXT();
+  OP(MUL):
+    regs[pc->dst] = wrap32(bits(regs[pc->a]) * bits(regs[pc->b]));
+    NEXT();
+  OP(DIV):
+    regs[pc->dst] = low32(regs[pc->a]) / low32(regs[pc->b]);
+    NEXT();
+  OP(REM):
+    regs[pc->dst] = low32(regs[pc->a]) % low32(regs[pc->b]);
+    NEXT();
+  OP(ADDP):
+    regs[pc->dst] = wrap64(bits(regs[pc->a]) + bits(regs[pc->b]));
+    NEXT();
+  OP(SUBP):
+    regs[pc->dst] = wrap64(bits(regs[pc->a]) - bits(regs[pc->b]));
+    NEXT();
+  OP(MULP):
+    regs[pc->dst] = wrap64(bits(regs[pc->a]) * bits(regs[pc->b]));
+    NEXT();
+  OP(EQ):
+    regs[pc->dst] = regs[pc->a] == regs[pc->b];
+    NEXT();
+  OP(NE):
+    regs[pc->dst] = regs[pc->a] != regs[pc->b];
+    NEXT();
+  OP(LT):
+    regs[pc->dst] = regs[pc->a] < regs[pc->b];
+    NEXT();
+  OP(LE):
+    regs[pc->dst] = regs[pc->a] <= regs[pc->b];
+    NEXT();
+  OP(GT):
+    regs[pc->dst] = regs[pc->a] > regs[pc->b];
+    NEXT();
+  OP(GE):
+    regs[pc->dst] = regs[pc->a] >= regs[pc->b];
+    NEXT();
+  OP(TRUNC8):
+    regs[pc->dst] = static_cast<int8_t>(regs[pc->a]);
+    NEXT();
+  OP(TRUNC32):
+    regs[pc->dst] = static_cast<int32_t>(regs[pc->a]);
+    NEXT();
+  OP(ALLOCA):
+    regs[pc->dst] = reinterpret_cast<int64_t>(memory + pc->imm);
+    NEXT();
+  OP(LOAD8):
+    regs[pc->dst] = load<int8_t>(regs[pc->a]);
+    NEXT();
+  OP(LOAD32):
+    regs[pc->dst] = load<int32_t>(regs[pc->a]);
+    NEXT();
+  OP(LOAD64):
+    regs[pc->dst] = load<int64_t>(regs[pc->a]);
+    NEXT();
+  OP(STORE8):
+    store<int8_t>(regs[pc->a], regs[pc->b]);
+    NEXT();
+  OP(STORE32):
+    store<int32_t>(regs[pc->a], regs[pc->b]);
+    NEXT();
+  OP(STORE64):
+    store<int64_t>(regs[pc->a], regs[pc->b]);
+    NEXT();
+  OP(MEMCPY):
+    std::memmove(reinterpret_cast<void *>(regs[pc->a]),
+                 reinterpret_cast<const void *>(regs[pc->b]),
+                 static_cast<size_t>(pc->imm));
+    NEXT();
+  OP(VMOV):
+    regs[pc->dst] = regs[pc->a];
+    regs[pc->dst + 1] = regs[pc->a + 1];
+    NEXT();
+  OP(VLOAD):
+    std::memcpy(regs + pc->dst, reinterpret_cast<const void *>(regs[pc->a]),
+                16);
+    NEXT();
+  OP(VSTORE):
+    std::memcpy(reinterpret_cast<void *>(regs[pc->a]), regs + pc->b, 16);
+    NEXT();
+  OP(VADD8):
+    lanes<uint8_t>(regs + pc->dst, regs + pc->a, regs + pc->b,
+                   [](auto x, auto y) { return x + y; });
+    NEXT();
+  OP(VADD32):
+    lanes<uint32_t>(regs + pc->dst, regs + pc->a, regs + pc->b,
+                    [](auto x, auto y) { return x + y; });
+    NEXT();
+  OP(VSUB8):
+    lanes<uint8_t>(regs + pc->dst, regs + pc->a, regs + pc->b,
+                   [](auto x, auto y) { return x - y; });
+    NEXT();
+  OP(VSUB32):
+    lanes<uint32_t>(regs + pc->dst, regs + pc->a, regs + pc->b,
+                    [](auto x, auto y) { return x - y; });
+    NEXT();
+  OP(VSPLAT8):
+    splat<uint8_t>(regs + pc->dst, regs[pc->a]);
+    NEXT();
+  OP(VSPLAT32):
+    splat<uint32_t>(regs + pc->dst, regs[pc->a]);
+    NEXT();
+  OP(VREDUCE32): {
+    uint32_t x[4];
+    std::memcpy(x, regs + pc->a, 16);
+    regs[pc->dst] = wrap32(uint64_t{x[0]} + x[1] + x[2] + x[3]);
+    NEXT();
+  }
+  OP(JMP):
+    JUMP(pc->imm);
+  OP(BRNZ):
+    JUMP(regs[pc->a] != 0 ? pc->b : pc->imm);
+  OP(BEQ):
+    JUMP(regs[pc->a] == regs[pc->b] ? pc->dst : pc->imm);
+  OP(BNE):
+    JUMP(regs[pc->a] != regs[pc->b] ? pc->dst : pc->imm);
+  OP(BLT):
+    JUMP(regs[pc->a] < regs[pc->b] ? pc->dst : pc->imm);
+  OP(BLE):
+    JUMP(regs[pc->a] <= regs[pc->b] ? pc->dst : pc->imm);
+  OP(BGT):
+    JUMP(regs[pc->a] > regs[pc->b] ? pc->dst : pc->imm);
+  OP(BGE):
+    JUMP(regs[pc->a] >= regs[pc->b] ? pc->dst : pc->imm);
+
+  OP(CALL): {
+    const Function *callee{&program.functions[pc->imm]};
+    int64_t *calleeRegs{regs + function->registerCount};
+    uint8_t *calleeMemory{memory + function->frameSize};
+    if (calleeRegs + callee->registerCount > registersEnd ||
+        calleeMemory + callee->frameSize > memoryEnd) {
+      std::cout << std::format("Runtime error: stack overflow in {}!",
+                               callee->name)
+                << std::endl;
+      errorCount++;
+      return -1;
+    }
+
+    std::ranges::copy(callee->constants, calleeRegs);
+    const uint32_t *args{function->arguments.data() + pc->a};
+    int64_t *params{calleeRegs + callee->constants.size()};
+    for (uint32_t i = 0; i < pc->b; i++)
+      params[i] = regs[args[i]];
+
+    frames.push_back({function, pc + 1, regs, memory, pc->dst});
+    function = callee;
+    code = function->code.data();
+    pc = code;
+    regs = calleeRegs;
+    memory = calleeMemory;
+    DISPATCH();
+  }
+
+  OP(CALL_NATIVE): {
+    int64_t args[8];
+    const uint32_t *argRegs{function->arguments.data() + pc->a};
+    for (uint32_t i = 0; i < pc->b; i++)
+      args[i] = regs[argRegs[i]];
+    int64_t result{program.natives[pc->imm](args)};
+    if (pc->dst != NO_REGISTER)
+      regs[pc->dst] = result;
+    NEXT();
+  }
+
+  OP(RET):
+  OP(RET_VOID): {
+    int64_t result{pc->op == Opcode::RET ? regs[pc->a] : 0};
+    if (frames.empty())
+      return result;
+
+    const Frame &frame{frames.back()};
+    function = frame.function;
+    code = function->code.data();
+    pc = frame.returnPc;
+    regs = frame.registers;
+    memory = frame.memory;
+    if (frame.dst != NO_REGISTER)
+      regs[frame.dst] = result;
+    frames.pop_back();
+    DISPATCH();
+  }
+  }
+  return 0;
+}
+
+#undef OP
+#undef DISPATCH
+#undef NEXT
+#undef JUMP
+
+} // namespace interp
@@ -0,0 +1,49 @@
+#ifndef INTERPRETER_H
+#define INTERPRETER_H
+
+#include "bytecode.hpp"
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+namespace interp {
+
+// Executes bytecode with a direct-threaded dispatch loop (computed goto)
+// where the compiler supports it and a switch loop otherwise. Calls do not
+// recurse on the host stack: frames live on the interpreter's own register
+// and memory stacks.
+class Interpreter {
+private:
+  struct Frame {
+    const Function *function;
+    const Instruction *returnPc;
+    int64_t *registers;
+    uint8_t *memory;
+    uint32_t dst;
+  };
+
+  static constexpr size_t REGISTER_STACK_SIZE = 1 << 22;
+  static constexpr size_t MEMORY_STACK_SIZE = 8 << 20;
+
+  Program &program;
+  std::unique_ptr<int64_t[]> registerStack;
+  std::unique_ptr<uint8_t[]> memoryStack;
+  std::vector<Frame> frames;
+  uint64_t executed{0};
+  int errorCount{0};
+
+  template <bool COUNT> int64_t execute(uint32_t entry);
+
+public:
+  explicit Interpreter(Program &program);
+
+  // Runs main and returns its result. With `count` the number of executed
+  // instructions is recorded, which costs an increment per dispatch.
+  int64_t run(bool count = false);
+  uint64_t getExecutedCount() const;
+  int getErrorCount() const;
+};
+
+} // namespace interp
+
+#endif
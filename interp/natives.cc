@@ -0,0 +1,69 @@
+#include "natives.hpp"
+#include "../profile/profile.hpp"
+#include <cstdio>
+#include <cstdlib>
+
+namespace interp {
+
+// These mirror examples/minic-stdlib.h so that interpreted programs behave
+// like natively compiled ones.
+
+static int64_t printS(const int64_t *args) {
+  std::fputs(reinterpret_cast<const char *>(args[0]), stdout);
+  return 0;
+}
+
+static int64_t printI(const int64_t *args) {
+  std::printf("%d", static_cast<int>(args[0]));
+  return 0;
+}
+
+static int64_t printC(const int64_t *args) {
+  std::putchar(static_cast<char>(args[0]));
+  return 0;
+}
+
+static int64_t readC(const int64_t *) {
+  char c{0};
+  if (std::scanf(" %c", &c) != 1)
+    return 0;
+  return c;
+}
+
+static int64_t readI(const int64_t *) {
+  int i{0};
+  if (std::scanf("%d", &i) != 1)
+    return 0;
+  return i;
+}
+
+static int64_t mcmalloc(const int64_t *args) {
+  return reinterpret_cast<int64_t>(std::malloc(static_cast<int>(args[0])));
+}
+
+static int64_t profileStart(const int64_t *args) {
+  profile::start(reinterpret_cast<const uint64_t *>(args[0]),
+                 static_cast<int>(args[1]), static_cast<int>(args[2]),
+                 reinterpret_cast<const char *>(args[3]));
+  return 0;
+}
+
+Native findNative(std::string_view name) {
+  if (name == "print_s")
+    return printS;
+  if (name == "print_i")
+    return printI;
+  if (name == "print_c")
+    return printC;
+  if (name == "read_c")
+    return readC;
+  if (name == "read_i")
+    return readI;
+  if (name == "mcmalloc")
+    return mcmalloc;
+  if (name == profile::START_FUNCTION)
+    return profileStart;
+  return nullptr;
+}
+
+} // namespace interp
@@ -0,0 +1,15 @@
+#ifndef NATIVES_H
+#define NATIVES_H
+
+#include "bytecode.hpp"
+#include <string_view>
+
+namespace interp {
+
+// Host implementations of the minic-stdlib.h functions, or nullptr if `name`
+// is not one of them.
+Native findNative(std::string_view name);
+
+} // namespace interp
+
+#endif
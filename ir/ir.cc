@@ -0,0 +1,393 @@
+#include "ir.hpp"
+#include <algorithm>
+#include <format>
+
+namespace ir {
+
+BlockId Function::newBlock() {
+  blocks.emplace_back();
+  return static_cast<BlockId>(blocks.size() - 1);
+}
+
+Value Function::create(Inst inst) {
+  insts.push_back(inst);
+  return static_cast<Value>(insts.size() - 1);
+}
+
+Value Function::append(BlockId block, Inst inst) {
+  inst.block = block;
+  Value value{create(inst)};
+  blocks[block].insts.push_back(value);
+  return value;
+}
+
+void Function::addEdge(BlockId from, BlockId to) {
+  blocks[from].succs.push_back(to);
+  blocks[to].preds.push_back(from);
+}
+
+void Function::removeIncoming(BlockId id, size_t pred) {
+  Block &block{blocks[id]};
+  for (Value value : block.insts) {
+    if (insts[value].op != Op::PHI)
+      continue;
+    std::vector<Value> incoming(extraOperands(value).begin(),
+                                extraOperands(value).end());
+    incoming.erase(incoming.begin() + pred);
+    setExtraOperands(value, incoming);
+  }
+  block.preds.erase(block.preds.begin() + pred);
+}
+
+void Function::removeEdge(BlockId from, BlockId to) {
+  std::vector<BlockId> &succs{blocks[from].succs};
+  succs.erase(std::find(succs.begin(), succs.end(), to));
+  const std::vector<BlockId> &preds{blocks[to].preds};
+  removeIncoming(to, static_cast<size_t>(
+                         std::find(preds.begin(), preds.end(), from) -
+                         preds.begin()));
+}
+
+void Function::sortPhis(BlockId block) {
+  std::stable_partition(
+      blocks[block].insts.begin(), blocks[block].insts.end(),
+      [&](Value value) { return insts[value].op == Op::PHI; });
+}
+
+void Function::setExtraOperands(Value value, std::span<const Value> values) {
+  // reuse the old range in place when it is large enough
+  Inst &inst{insts[value]};
+  if (values.size() <= inst.count) {
+    std::copy(values.begin(), values.end(), operands.begin() + inst.extra);
+    inst.count = static_cast<uint32_t>(values.size());
+    return;
+  }
+  uint32_t start{static_cast<uint32_t>(operands.size())};
+  operands.insert(operands.end(), values.begin(), values.end());
+  insts[value].extra = start;
+  insts[value].count = static_cast<uint32_t>(values.size());
+}
+
+void Function::remove(Value value) {
+  Inst &inst{insts[value]};
+  if (inst.block != NO_BLOCK) {
+    std::vector<Value> &list{blocks[inst.block].insts};
+    list.erase(std::find(list.begin(), list.end(), value));
+  }
+  inst = Inst{};
+}
+
+void Function::releaseBody() {
+  insts.clear();
+  insts.shrink_to_fit();
+  operands.clear();
+  operands.shrink_to_fit();
+  blocks.clear();
+  blocks.shrink_to_fit();
+  external = true;
+}
+
+void Function::removeUnreachableBlocks() {
+  std::vector<bool> reachable(blocks.size(), false);
+  std::vector<BlockId> worklist{0};
+  reachable[0] = true;
+  while (!worklist.empty()) {
+    BlockId block{worklist.back()};
+    worklist.pop_back();
+    for (BlockId succ : blocks[block].succs)
+      if (!reachable[succ]) {
+        reachable[succ] = true;
+        worklist.push_back(succ);
+      }
+  }
+
+  // drop edges from dead blocks into live ones along with phi operands
+  for (BlockId id = 0; id < blocks.size(); id++) {
+    if (!reachable[id])
+      continue;
+    Block &block{blocks[id]};
+    for (size_t i = block.preds.size(); i-- > 0;)
+      if (!reachable[block.preds[i]])
+        removeIncoming(id, i);
+  }
+
+  std::vector<BlockId> renumber(blocks.size(), NO_BLOCK);
+  BlockId next{0};
+  for (BlockId id = 0; id < blocks.size(); id++) {
+    if (reachable[id]) {
+      renumber[id] = next;
+      if (next != id)
+        blocks[next] = std::move(blocks[id]);
+      next++;
+    } else
+      for (Value value : blocks[id].insts)
+        insts[value] = Inst{};
+  }
+  blocks.resize(next);
+
+  for (BlockId id = 0; id < blocks.size(); id++) {
+    Block &block{blocks[id]};
+    for (BlockId &pred : block.preds)
+      pred = renumber[pred];
+    for (BlockId &succ : block.succs)
+      succ = renumber[succ];
+    for (Value value : block.insts)
+      insts[value].block = id;
+  }
+}
+
+size_t Function::instructionCount() const {
+  size_t count{0};
+  for (const Block &block : blocks)
+    count += block.insts.size();
+  return count;
+}
+
+uint32_t Module::declareFunction(std::string_view name) {
+  auto found{functionIndex.find(std::string{name})};
+  if (found != functionIndex.end())
+    return found->second;
+
+  auto function{std::make_unique<Function>()};
+  function->name = name;
+  function->external = true;
+  functions.push_back(std::move(function));
+  uint32_t index{static_cast<uint32_t>(functions.size() - 1)};
+  functionIndex.emplace(name, index);
+  return index;
+}
+
+std::string_view toString(Op op) {
+  switch (op) {
+  case Op::NOP:
+    return "nop";
+  case Op::CONST:
+    return "const";
+  case Op::PARAM:
+    return "param";
+  case Op::GLOBAL:
+    return "global";
+  case Op::STRING:
+    return "string";
+  case Op::ALLOCA:
+    return "alloca";
+  case Op::LOAD:
+    return "load";
+  case Op::STORE:
+    return "store";
+  case Op::MEMCPY:
+    return "memcpy";
+  case Op::ADD:
+    return "add";
+  case Op::SUB:
+    return "sub";
+  case Op::MUL:
+    return "mul";
+  case Op::DIV:
+    return "div";
+  case Op::REM:
+    return "rem";
+  case Op::EQ:
+    return "eq";
+  case Op::NE:
+    return "ne";
+  case Op::LT:
+    return "lt";
+  case Op::LE:
+    return "le";
+  case Op::GT:
+    return "gt";
+  case Op::GE:
+    return "ge";
+  case Op::SEXT:
+    return "sext";
+  case Op::TRUNC:
+    return "trunc";
+  case Op::COPY:
+    return "copy";
+  case Op::SPLAT:
+    return "splat";
+  case Op::REDUCE:
+    return "reduce";
+  case Op::PHI:
+    return "phi";
+  case Op::CALL:
+    return "call";
+  case Op::BR:
+    return "br";
+  case Op::CONDBR:
+    return "condbr";
+  case Op::RET:
+    return "ret";
+  }
+  return "?";
+}
+
+std::string_view toString(Type type) {
+  switch (type) {
+  case Type::VOID:
+    return "void";
+  case Type::I8:
+    return "i8";
+  case Type::I32:
+    return "i32";
+  case Type::PTR:
+    return "ptr";
+  case Type::VEC:
+    return "v128";
+  }
+  return "?";
+}
+
+int sizeOf(Type type) {
+  switch (type) {
+  case Type::VOID:
+    return 0;
+  case Type::I8:
+    return 1;
+  case Type::I32:
+    return 4;
+  case Type::PTR:
+    return 8;
+  case Type::VEC:
+    return 16;
+  }
+  return 0;
+}
+
+static std::string escape(std::string_view str) {
+  std::string result;
+  for (char c : str) {
+    switch (c) {
+    case '\n':
+      result += "\\n";
+      break;
+    case '\t':
+      result += "\\t";
+      break;
+    case '"':
+      result += "\\\"";
+      break;
+    case '\\':
+      result += "\\\\";
+      break;
+    default:
+      if (static_cast<unsigned char>(c) < 0x20)
+        result += std::format("\\{:03o}", static_cast<unsigned char>(c));
+      else
+        result += c;
+    }
+  }
+  return result;
+}
+
+static void printInst(std::ostream &out, const Function &function,
+                      const Module &module, Value value) {
+  const Inst &inst{function.insts[value]};
+  out << "  ";
+  if (inst.hasResult())
+    out << std::format("%{} = ", value);
+  out << toString(inst.op);
+  if (inst.type == Type::VEC)
+    out << std::format(" <{} x {}>", 16 / inst.aux,
+                       inst.aux == 1 ? "i8" : "i32");
+  else if (inst.type != Type::VOID)
+    out << " " << toString(inst.type);
+
+  std::string operands;
+  auto operand{[&](std::string str) {
+    operands += operands.empty() ? " " : ", ";
+    operands += str;
+  }};
+
+  switch (inst.op) {
+  case Op::CONST:
+  case Op::PARAM:
+    operand(std::format("{}", inst.imm));
+    break;
+  case Op::GLOBAL:
+    operand("@" + module.globals[inst.imm].name);
+    break;
+  case Op::STRING:
+    operand(std::format(".str{}", inst.imm));
+    break;
+  case Op::ALLOCA:
+    operand(std::format("{}, align {}", inst.imm, inst.aux));
+    break;
+  case Op::CALL:
+    operand("@" + module.functions[inst.imm]->name);
+    break;
+  default:
+    break;
+  }
+
+  if (inst.a != NO_VALUE)
+    operand(std::format("%{}", inst.a));
+  if (inst.b != NO_VALUE)
+    operand(std::format("%{}", inst.b));
+
+  const Block &block{function.blocks[inst.block]};
+  std::span<const Value> extra{function.extraOperands(value)};
+  for (size_t i = 0; i < extra.size(); i++) {
+    if (inst.op == Op::PHI && i < block.preds.size())
+      operand(std::format("[%{}, bb{}]", extra[i], block.preds[i]));
+    else
+      operand(std::format("%{}", extra[i]));
+  }
+
+  if (inst.op == Op::MEMCPY)
+    operand(std::format("{}", inst.imm));
+  for (BlockId succ : inst.isTerminator() ? block.succs
+                                          : std::vector<BlockId>{})
+    operand(std::format("bb{}", succ));
+
+  out << operands << "\n";
+}
+
+void print(std::ostream &out, const Function &function, const Module &module) {
+  out << std::format("{} {} @{}(", function.external ? "declare" : "function",
+                     toString(function.returnType), function.name);
+  for (size_t i = 0; i < function.params.size(); i++)
+    out << (i == 0 ? "" : ", ") << toString(function.params[i]);
+  out << ")";
+
+  if (function.external) {
+    out << "\n";
+    return;
+  }
+
+  out << " {\n";
+  for (BlockId id = 0; id < function.blocks.size(); id++) {
+    const Block &block{function.blocks[id]};
+    if (block.insts.empty() && id != 0)
+      continue;
+    out << std::format("bb{}:", id);
+    if (!block.preds.empty()) {
+      out << "  ; preds:";
+      for (BlockId pred : block.preds)
+        out << std::format(" bb{}", pred);
+    }
+    out << "\n";
+    for (Value value : block.insts)
+      printInst(out, function, module, value);
+  }
+  out << "}\n";
+}
+
+void print(std::ostream &out, const Module &module) {
+  for (const Global &global : module.globals)
+    out << std::format("global @{} : {} bytes, align {}\n", global.name,
+                       global.size, global.align);
+  for (size_t i = 0; i < module.strings.size(); i++)
+    out << std::format("string .str{} = \"{}\"\n", i,
+                       escape(module.strings[i]));
+  if (!module.globals.empty() || !module.strings.empty())
+    out << "\n";
+
+  for (const std::unique_ptr<Function> &function : module.functions) {
+    print(out, *function, module);
+    out << "\n";
+  }
+}
+
+} // namespace ir
@@ -0,0 +1,204 @@
+#ifndef IR_H
+#define IR_H
+
+#include <cstdint>
+#include <limits>
+#include <memory>
+#include <ostream>
+#include <span>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+namespace ir {
+
+// Values and blocks are 32-bit indices into their function's arenas rather
+// than pointers, so a function's IR is a handful of flat arrays that passes
+// can walk linearly and that are freed together with the function.
+using Value = uint32_t;
+using BlockId = uint32_t;
+
+constexpr Value NO_VALUE = std::numeric_limits<Value>::max();
+constexpr BlockId NO_BLOCK = std::numeric_limits<BlockId>::max();
+// Execution count of a block that no profile covers, such as one made by a
+// pass after the profile was read.
+constexpr uint64_t NO_COUNT = std::numeric_limits<uint64_t>::max();
+
+// Pointers are 64-bit; MiniC has no 64-bit integers. VEC is a 128-bit
+// vector made by the vectorizer whose lane width in bytes is the `aux` of the
+// instruction producing or storing it; it only lives inside vectorized loops.
+enum class Type : uint8_t { VOID, I8, I32, PTR, VEC };
+
+enum class Op : uint8_t {
+  NOP, // deleted instruction
+  CONST,
+  PARAM,  // imm: parameter index
+  GLOBAL, // imm: global index, yields its address
+  STRING, // imm: string literal index, yields its address
+  ALLOCA, // imm: size, aux: alignment, yields a stack slot address
+  LOAD,   // a: address
+  STORE,  // a: address, b: value; type is the stored value's type
+  MEMCPY, // a: destination, b: source, imm: size, aux: alignment
+  ADD,
+  SUB,
+  MUL,
+  DIV,
+  REM,
+  EQ, // comparisons yield an I32 0/1; operand width is that of `a`
+  NE,
+  LT,
+  LE,
+  GT,
+  GE,
+  SEXT,  // a: narrower value sign-extended to `type`
+  TRUNC, // a: wider value truncated to `type`
+  COPY,  // a
+  SPLAT,  // a: scalar copied to every lane of a VEC, aux: lane width
+  REDUCE, // a: VEC of I32 lanes summed into an I32
+  PHI,   // operands: one incoming value per predecessor, in pred order
+  CALL,  // imm: callee function index, operands: arguments
+  BR,    // jumps to succs[0]
+  CONDBR, // a: condition, jumps to succs[0] if non-zero else succs[1]
+  RET,    // a: returned value or NO_VALUE
+};
+
+struct Inst {
+  Op op{Op::NOP};
+  Type type{Type::VOID};
+  uint16_t aux{0};
+  BlockId block{NO_BLOCK};
+  Value a{NO_VALUE};
+  Value b{NO_VALUE};
+  // Range of extra operands in Function::operands (PHI and CALL).
+  uint32_t extra{0};
+  uint32_t count{0};
+  int64_t imm{0};
+
+  bool isTerminator() const {
+    return op == Op::BR || op == Op::CONDBR || op == Op::RET;
+  }
+  bool hasResult() const {
+    return type != Type::VOID && op != Op::STORE && op != Op::NOP;
+  }
+};
+
+struct Block {
+  // Instruction ids in execution order; the terminator is last.
+  std::vector<Value> insts;
+  std::vector<BlockId> preds;
+  std::vector<BlockId> succs;
+  // Times the block ran and, if it ends in a CONDBR, went to succs[0] in the
+  // profiled run (see Function::profiled).
+  uint64_t count{NO_COUNT};
+  uint64_t taken{NO_COUNT};
+};
+
+struct Global {
+  std::string name;
+  int size;
+  int align;
+};
+
+struct Function {
+  std::string name;
+  Type returnType{Type::VOID};
+  std::vector<Type> params;
+  // Declared but defined elsewhere (the minic-stdlib.h builtins).
+  bool external{false};
+  // Block counts were read from a profile (-profile-use).
+  bool profiled{false};
+
+  std::vector<Inst> insts;
+  std::vector<Value> operands;
+  std::vector<Block> blocks; // blocks[0] is the entry block
+
+  BlockId newBlock();
+  // Appends an instruction to the end of `block` and returns its value.
+  Value append(BlockId block, Inst inst);
+  // Creates an instruction without placing it in any block.
+  Value create(Inst inst);
+  void addEdge(BlockId from, BlockId to);
+  // Removes one from -> to edge together with the phi operands in `to` that
+  // flow along it.
+  void removeEdge(BlockId from, BlockId to);
+
+  std::span<Value> extraOperands(Value value) {
+    const Inst &inst{insts[value]};
+    return {operands.data() + inst.extra, inst.count};
+  }
+  std::span<const Value> extraOperands(Value value) const {
+    const Inst &inst{insts[value]};
+    return {operands.data() + inst.extra, inst.count};
+  }
+  // Replaces the extra operands of `value` with a fresh range.
+  void setExtraOperands(Value value, std::span<const Value> values);
+
+  // Calls `visit` with a reference to every value operand of `value`.
+  template <class F> void forEachOperand(Value value, F &&visit) {
+    Inst &inst{insts[value]};
+    if (inst.a != NO_VALUE)
+      visit(inst.a);
+    if (inst.b != NO_VALUE)
+      visit(inst.b);
+    for (Value &operand : extraOperands(value))
+      visit(operand);
+  }
+
+  template <class F> void forEachOperand(Value value, F &&visit) const {
+    const Inst &inst{insts[value]};
+    if (inst.a != NO_VALUE)
+      visit(inst.a);
+    if (inst.b != NO_VALUE)
+      visit(inst.b);
+    for (Value operand : extraOperands(value))
+      visit(operand);
+  }
+
+  Value terminator(BlockId block) const {
+    return blocks[block].insts.empty() ? NO_VALUE : blocks[block].insts.back();
+  }
+
+  // Unlinks an instruction from its block and turns it into a NOP.
+  void remove(Value value);
+  // Frees the body once compiled, leaving a declaration.
+  void releaseBody();
+  // Deletes blocks not reachable from the entry, dropping their phi operands
+  // in reachable successors, and renumbers the remaining blocks densely.
+  void removeUnreachableBlocks();
+
+  // Moves phis converted to other instructions behind the remaining phis so
+  // that every block again starts with all of its phis.
+  void sortPhis(BlockId block);
+
+  // Number of live (placed) instructions.
+  size_t instructionCount() const;
+
+private:
+  void removeIncoming(BlockId block, size_t pred);
+};
+
+struct Module {
+  std::vector<Global> globals;
+  std::vector<std::string> strings;
+  std::vector<std::unique_ptr<Function>> functions;
+  std::unordered_map<std::string, uint32_t> functionIndex;
+  // Code compiled separately may call any of the functions, as when only
+  // some functions of a program are compiled (see cache::FunctionCache).
+  bool partial{false};
+
+  // Returns the index of the named function, adding a declaration if it has
+  // not been seen yet.
+  uint32_t declareFunction(std::string_view name);
+};
+
+std::string_view toString(Op op);
+std::string_view toString(Type type);
+int sizeOf(Type type);
+
+void print(std::ostream &out, const Function &function, const Module &module);
+void print(std::ostream &out, const Module &module);
+
+} // namespace ir
+
+#endif
@@ -0,0 +1,656 @@
+#include "lowering.hpp"
+#include <algorithm>
+
+namespace ir {
+
+Type Lowering::typeOf(const sema::Type *type) {
+  switch (type->kind) {
+  case sema::TypeKind::INT:
+    return Type::I32;
+  case sema::TypeKind::CHAR:
+    return Type::I8;
+  case sema::TypeKind::VOID:
+  case sema::TypeKind::ERROR:
+    return Type::VOID;
+  case sema::TypeKind::POINTER:
+  case sema::TypeKind::ARRAY:
+  case sema::TypeKind::STRUCT:
+    // aggregates are always handled through their address
+    return Type::PTR;
+  }
+  return Type::VOID;
+}
+
+void Lowering::declare(const ast::Program &program) {
+  for (const ast::VarDeclPtr &var : program.globals) {
+    globals.emplace(var.get(), static_cast<uint32_t>(module.globals.size()));
+    module.globals.push_back(
+        {var->name, layouts.sizeOf(var->type), layouts.alignOf(var->type)});
+  }
+
+  auto declareFunction{[&](const ast::FunDecl &fun) {
+    Function &function{*module.functions[module.declareFunction(fun.name)]};
+    function.external = fun.isBuiltin;
+    function.params.clear();
+    if (fun.returnType->isStruct()) {
+      // struct results are written through a hidden pointer argument
+      function.returnType = Type::VOID;
+      function.params.push_back(Type::PTR);
+    } else if (fun.name == "main" && fun.returnType->kind ==
+                                         sema::TypeKind::VOID)
+      function.returnType = Type::I32;
+    else
+      function.returnType = typeOf(fun.returnType);
+    for (const ast::VarDeclPtr &param : fun.params)
+      function.params.push_back(typeOf(param->type));
+  }};
+
+  for (const ast::FunDeclPtr &fun : program.builtins)
+    declareFunction(*fun);
+  for (const ast::FunDeclPtr &fun : program.functions)
+    declareFunction(*fun);
+}
+
+void Lowering::lower(const ast::Program &program,
+                     const std::vector<bool> &selected) {
+  declare(program);
+  for (size_t i = 0; i < program.functions.size(); i++) {
+    if (selected.empty() || selected[i])
+      lowerFunction(*program.functions[i]);
+    else
+      module.functions[module.functionIndex.at(program.functions[i]->name)]
+          ->external = true;
+  }
+}
+
+Value Lowering::emit(Op op, Type type, Value a, Value b, int64_t imm) {
+  Inst inst;
+  inst.op = op;
+  inst.type = type;
+  inst.a = a;
+  inst.b = b;
+  inst.imm = imm;
+  return function->append(current, inst);
+}
+
+Value Lowering::constant(Type type, int64_t value) {
+  return emit(Op::CONST, type, NO_VALUE, NO_VALUE, value);
+}
+
+// Places an instruction at the top of the entry block, ahead of any code.
+Value Lowering::entryValue(Inst inst) {
+  inst.block = 0;
+  Value value{function->create(inst)};
+  std::vector<Value> &entry{function->blocks[0].insts};
+  entry.insert(entry.begin() + entryPrefix++, value);
+  return value;
+}
+
+Value Lowering::stackSlot(const sema::Type *type) {
+  Inst inst;
+  inst.op = Op::ALLOCA;
+  inst.type = Type::PTR;
+  inst.imm = layouts.sizeOf(type);
+  inst.aux = static_cast<uint16_t>(layouts.alignOf(type));
+  return entryValue(inst);
+}
+
+BlockId Lowering::newBlock() {
+  sealed.push_back(false);
+  return function->newBlock();
+}
+
+void Lowering::jump(BlockId target) {
+  Value last{function->terminator(current)};
+  if (last != NO_VALUE && function->insts[last].isTerminator())
+    return;
+  emit(Op::BR, Type::VOID);
+  function->addEdge(current, target);
+}
+
+void Lowering::startBlock(BlockId block) { current = block; }
+
+void Lowering::writeVariable(uint32_t var, BlockId block, Value value) {
+  currentDef[(static_cast<uint64_t>(var) << 32) | block] = value;
+}
+
+Value Lowering::readVariable(uint32_t var, BlockId block) {
+  auto found{currentDef.find((static_cast<uint64_t>(var) << 32) | block)};
+  if (found != currentDef.end())
+    return resolve(found->second);
+  return readVariableRecursive(var, block);
+}
+
+Value Lowering::readVariableRecursive(uint32_t var, BlockId block) {
+  Value value;
+  const std::vector<BlockId> &preds{function->blocks[block].preds};
+
+  if (!sealed[block]) {
+    Inst phi;
+    phi.op = Op::PHI;
+    phi.type = variableTypes[var];
+    phi.block = block;
+    value = function->create(phi);
+    std::vector<Value> &list{function->blocks[block].insts};
+    list.insert(list.begin(), value);
+    incompletePhis[block].emplace_back(var, value);
+  } else if (preds.empty()) {
+    // read of a variable that was never assigned
+    Inst undef;
+    undef.op = Op::CONST;
+    undef.type = variableTypes[var];
+    value = entryValue(undef);
+  } else if (preds.size() == 1) {
+    value = readVariable(var, preds[0]);
+  } else {
+    Inst phi;
+    phi.op = Op::PHI;
+    phi.type = variableTypes[var];
+    phi.block = block;
+    value = function->create(phi);
+    std::vector<Value> &list{function->blocks[block].insts};
+    list.insert(list.begin(), value);
+    // break cycles before visiting the predecessors
+    writeVariable(var, block, value);
+    value = addPhiOperands(var, value);
+  }
+
+  writeVariable(var, block, value);
+  return value;
+}
+
+Value Lowering::addPhiOperands(uint32_t var, Value phi) {
+  BlockId block{function->insts[phi].block};
+  std::vector<Value> incoming;
+  incoming.reserve(function->blocks[block].preds.size());
+  for (size_t i = 0; i < function->blocks[block].preds.size(); i++)
+    incoming.push_back(readVariable(var, function->blocks[block].preds[i]));
+  function->setExtraOperands(phi, incoming);
+  return tryRemoveTrivialPhi(phi);
+}
+
+Value Lowering::tryRemoveTrivialPhi(Value phi) {
+  Value same{NO_VALUE};
+  for (Value operand : function->extraOperands(phi)) {
+    operand = resolve(operand);
+    if (operand == same || operand == phi)
+      continue;
+    if (same != NO_VALUE)
+      return phi;
+    same = operand;
+  }
+
+  if (same == NO_VALUE) {
+    Inst undef;
+    undef.op = Op::CONST;
+    undef.type = function->insts[phi].type;
+    same = entryValue(undef);
+  }
+
+  if (forward.size() < function->insts.size())
+    forward.resize(function->insts.size(), NO_VALUE);
+  forward[phi] = same;
+  function->remove(phi);
+  return same;
+}
+
+Value Lowering::resolve(Value value) {
+  while (value < forward.size() && forward[value] != NO_VALUE)
+    value = forward[value];
+  return value;
+}
+
+void Lowering::sealBlock(BlockId block) {
+  auto pending{incompletePhis.find(block)};
+  if (pending != incompletePhis.end()) {
+    std::vector<std::pair<uint32_t, Value>> phis{std::move(pending->second)};
+    incompletePhis.erase(pending);
+    for (auto [var, phi] : phis)
+      addPhiOperands(var, phi);
+  }
+  sealed[block] = true;
+}
+
+// Drops unreachable code, then removes the phis that only became trivial
+// afterwards and rewrites every operand through the forwarding table.
+void Lowering::finishFunction() {
+  function->removeUnreachableBlocks();
+
+  bool changed{true};
+  while (changed) {
+    changed = false;
+    for (Block &block : function->blocks)
+      for (size_t i = 0; i < block.insts.size(); i++) {
+        Value value{block.insts[i]};
+        if (function->insts[value].op != Op::PHI)
+          continue;
+        if (tryRemoveTrivialPhi(value) != value) {
+          changed = true;
+          i--;
+        }
+      }
+  }
+
+  for (Block &block : function->blocks)
+    for (Value value : block.insts)
+      function->forEachOperand(value,
+                               [&](Value &operand) { operand = resolve(operand); });
+}
+
+Function *Lowering::lowerFunction(const ast::FunDecl &fun) {
+  function = module.functions[module.functionIndex.at(fun.name)].get();
+  function->external = false;
+  funDecl = &fun;
+  slots.clear();
+  variables.clear();
+  variableTypes.clear();
+  currentDef.clear();
+  sealed.clear();
+  incompletePhis.clear();
+  forward.clear();
+  entryPrefix = 0;
+  sret = NO_VALUE;
+
+  current = newBlock();
+  sealed[current] = true;
+
+  int64_t paramIndex{0};
+  if (fun.returnType->isStruct())
+    sret = emit(Op::PARAM, Type::PTR, NO_VALUE, NO_VALUE, paramIndex++);
+
+  for (const ast::VarDeclPtr &param : fun.params) {
+    Value value{emit(Op::PARAM, typeOf(param->type), NO_VALUE, NO_VALUE,
+                     paramIndex++)};
+    if (param->type->isStruct())
+      // the caller passes the address of a private copy
+      slots.emplace(param.get(), value);
+    else if (param->addressTaken) {
+      Value slot{stackSlot(param->type)};
+      emit(Op::STORE, typeOf(param->type), slot, value);
+      slots.emplace(param.get(), slot);
+    } else {
+      declareLocal(*param);
+      writeVariable(variables.at(param.get()), current, value);
+    }
+  }
+
+  lowerBlock(*fun.body);
+
+  // falling off the end of the function
+  Value last{function->terminator(current)};
+  if (last == NO_VALUE || !function->insts[last].isTerminator()) {
+    if (function->returnType == Type::VOID)
+      emit(Op::RET, Type::VOID);
+    else
+      emit(Op::RET, Type::VOID, constant(function->returnType, 0));
+  }
+
+  finishFunction();
+  return function;
+}
+
+void Lowering::declareLocal(const ast::VarDecl &var) {
+  if (var.type->isStruct() || var.type->isArray() || var.addressTaken) {
+    slots.emplace(&var, stackSlot(var.type));
+    return;
+  }
+  variables.emplace(&var, static_cast<uint32_t>(variableTypes.size()));
+  variableTypes.push_back(typeOf(var.type));
+}
+
+void Lowering::lowerBlock(const ast::Block &block) {
+  for (const ast::VarDeclPtr &var : block.vars)
+    declareLocal(*var);
+  for (const ast::StmtPtr &stmt : block.stmts)
+    lowerStmt(*stmt);
+}
+
+void Lowering::lowerStmt(const ast::Stmt &stmt) {
+  switch (stmt.kind) {
+  case ast::StmtKind::BLOCK:
+    lowerBlock(stmt.as<ast::Block>());
+    return;
+
+  case ast::StmtKind::WHILE: {
+    const ast::While &loop{stmt.as<ast::While>()};
+    BlockId header{newBlock()};
+    BlockId body{newBlock()};
+    BlockId exit{newBlock()};
+
+    jump(header);
+    startBlock(header);
+    branch(*loop.cond, body, exit);
+    sealBlock(body);
+    sealBlock(exit);
+
+    startBlock(body);
+    lowerStmt(*loop.body);
+    jump(header);
+    // all back edges are known now
+    sealBlock(header);
+
+    startBlock(exit);
+    return;
+  }
+
+  case ast::StmtKind::IF: {
+    const ast::If &branchStmt{stmt.as<ast::If>()};
+    BlockId then{newBlock()};
+    BlockId otherwise{branchStmt.otherwise ? newBlock() : NO_BLOCK};
+    BlockId join{newBlock()};
+
+    branch(*branchStmt.cond, then, otherwise != NO_BLOCK ? otherwise : join);
+    sealBlock(then);
+    if (otherwise != NO_BLOCK)
+      sealBlock(otherwise);
+
+    startBlock(then);
+    lowerStmt(*branchStmt.then);
+    jump(join);
+
+    if (otherwise != NO_BLOCK) {
+      startBlock(otherwise);
+      lowerStmt(*branchStmt.otherwise);
+      jump(join);
+    }
+
+    sealBlock(join);
+    startBlock(join);
+    return;
+  }
+
+  case ast::StmtKind::RETURN:
+    lowerReturn(stmt.as<ast::Return>());
+    return;
+
+  case ast::StmtKind::ASSIGN:
+    lowerAssign(stmt.as<ast::Assign>());
+    return;
+
+  case ast::StmtKind::EXPR:
+    rvalue(*stmt.as<ast::ExprStmt>().expr);
+    return;
+  }
+}
+
+void Lowering::lowerAssign(const ast::Assign &assign) {
+  const sema::Type *type{assign.lhs->type};
+
+  if (type->isStruct()) {
+    Value destination{address(*assign.lhs)};
+    Value source{rvalue(*assign.rhs)};
+    Value copy{emit(Op::MEMCPY, Type::VOID, destination, source,
+                    layouts.sizeOf(type))};
+    function->insts[copy].aux = static_cast<uint16_t>(layouts.alignOf(type));
+    return;
+  }
+
+  if (assign.lhs->kind == ast::ExprKind::VAR) {
+    const ast::VarDecl *var{assign.lhs->as<ast::VarExpr>().decl};
+    auto found{variables.find(var)};
+    if (found != variables.end()) {
+      writeVariable(found->second, current, rvalue(*assign.rhs));
+      return;
+    }
+  }
+
+  Value destination{address(*assign.lhs)};
+  Value value{rvalue(*assign.rhs)};
+  emit(Op::STORE, typeOf(type), destination, value);
+}
+
+void Lowering::lowerReturn(const ast::Return &ret) {
+  if (!ret.value) {
+    if (function->returnType == Type::VOID)
+      emit(Op::RET, Type::VOID);
+    else // void main returns 0 to the host
+      emit(Op::RET, Type::VOID, constant(function->returnType, 0));
+  } else if (sret != NO_VALUE) {
+    Value source{rvalue(*ret.value)};
+    Value copy{emit(Op::MEMCPY, Type::VOID, sret, source,
+                    layouts.sizeOf(ret.value->type))};
+    function->insts[copy].aux =
+        static_cast<uint16_t>(layouts.alignOf(ret.value->type));
+    emit(Op::RET, Type::VOID);
+  } else
+    emit(Op::RET, Type::VOID, rvalue(*ret.value));
+
+  // anything after a return is unreachable
+  current = newBlock();
+  sealed[current] = true;
+}
+
+void Lowering::branch(const ast::Expr &cond, BlockId ifTrue,
+                      BlockId ifFalse) {
+  if (cond.kind == ast::ExprKind::BIN_OP) {
+    const ast::BinOp &binOp{cond.as<ast::BinOp>()};
+    if (binOp.op == ast::BinOpKind::AND || binOp.op == ast::BinOpKind::OR) {
+      BlockId rhs{newBlock()};
+      if (binOp.op == ast::BinOpKind::AND)
+        branch(*binOp.lhs, rhs, ifFalse);
+      else
+        branch(*binOp.lhs, ifTrue, rhs);
+      sealBlock(rhs);
+      startBlock(rhs);
+      branch(*binOp.rhs, ifTrue, ifFalse);
+      return;
+    }
+  }
+
+  Value value{rvalue(cond)};
+  emit(Op::CONDBR, Type::VOID, value);
+  function->addEdge(current, ifTrue);
+  function->addEdge(current, ifFalse);
+}
+
+Value Lowering::loadIfScalar(const sema::Type *type, Value address) {
+  if (type->isStruct() || type->isArray())
+    return address;
+  return emit(Op::LOAD, typeOf(type), address);
+}
+
+Value Lowering::rvalue(const ast::Expr &expr) {
+  switch (expr.kind) {
+  case ast::ExprKind::INT_LITERAL:
+    return constant(Type::I32, expr.as<ast::IntLiteral>().value);
+
+  case ast::ExprKind::CHAR_LITERAL:
+    return constant(Type::I8, expr.as<ast::CharLiteral>().value);
+
+  case ast::ExprKind::STRING_LITERAL: {
+    const std::string &value{expr.as<ast::StringLiteral>().value};
+    auto [found, inserted] = strings.try_emplace(
+        value, static_cast<uint32_t>(module.strings.size()));
+    if (inserted)
+      module.strings.push_back(value);
+    return emit(Op::STRING, Type::PTR, NO_VALUE, NO_VALUE, found->second);
+  }
+
+  case ast::ExprKind::VAR: {
+    const ast::VarDecl *var{expr.as<ast::VarExpr>().decl};
+    auto found{variables.find(var)};
+    if (found != variables.end())
+      return readVariable(found->second, current);
+    return loadIfScalar(expr.type, address(expr));
+  }
+
+  case ast::ExprKind::FUN_CALL:
+    return lowerCall(expr.as<ast::FunCall>());
+
+  case ast::ExprKind::BIN_OP:
+    return lowerBinOp(expr.as<ast::BinOp>());
+
+  case ast::ExprKind::ARRAY_ACCESS:
+  case ast::ExprKind::FIELD_ACCESS:
+  case ast::ExprKind::VALUE_AT:
+    return loadIfScalar(expr.type, address(expr));
+
+  case ast::ExprKind::ADDRESS_OF:
+    return address(*expr.as<ast::AddressOf>().operand);
+
+  case ast::ExprKind::SIZEOF:
+    return constant(Type::I32,
+                    layouts.sizeOf(expr.as<ast::SizeOf>().operandType));
+
+  case ast::ExprKind::TYPECAST:
+    return lowerCast(expr.as<ast::TypeCast>());
+  }
+  return NO_VALUE;
+}
+
+Value Lowering::address(const ast::Expr &expr) {
+  switch (expr.kind) {
+  case ast::ExprKind::VAR: {
+    const ast::VarDecl *var{expr.as<ast::VarExpr>().decl};
+    auto slot{slots.find(var)};
+    if (slot != slots.end())
+      return slot->second;
+    return emit(Op::GLOBAL, Type::PTR, NO_VALUE, NO_VALUE, globals.at(var));
+  }
+
+  case ast::ExprKind::ARRAY_ACCESS: {
+    const ast::ArrayAccess &access{expr.as<ast::ArrayAccess>()};
+    // arrays evaluate to their address, pointers to their value
+    Value base{rvalue(*access.array)};
+    Value index{emit(Op::SEXT, Type::PTR, rvalue(*access.index))};
+    int size{layouts.sizeOf(expr.type)};
+    if (size != 1)
+      index = emit(Op::MUL, Type::PTR, index, constant(Type::PTR, size));
+    return emit(Op::ADD, Type::PTR, base, index);
+  }
+
+  case ast::ExprKind::FIELD_ACCESS: {
+    const ast::FieldAccess &access{expr.as<ast::FieldAccess>()};
+    Value base{rvalue(*access.object)};
+    int offset{layouts.fieldOffset(access.object->type, access.fieldIndex)};
+    if (offset == 0)
+      return base;
+    return emit(Op::ADD, Type::PTR, base, constant(Type::PTR, offset));
+  }
+
+  case ast::ExprKind::VALUE_AT:
+    return rvalue(*expr.as<ast::ValueAt>().pointer);
+
+  default:
+    // struct-valued calls already yield the address of their result
+    return rvalue(expr);
+  }
+}
+
+Value Lowering::lowerCall(const ast::FunCall &call) {
+  uint32_t callee{module.functionIndex.at(call.name)};
+  std::vector<Value> args;
+  args.reserve(call.args.size() + 1);
+
+  Value result{NO_VALUE};
+  if (call.type->isStruct()) {
+    result = stackSlot(call.type);
+    args.push_back(result);
+  }
+
+  for (const ast::ExprPtr &arg : call.args) {
+    Value value{rvalue(*arg)};
+    if (arg->type->isStruct()) {
+      // structs are passed by reference to a copy owned by the caller
+      Value copy{stackSlot(arg->type)};
+      Value memcpy{emit(Op::MEMCPY, Type::VOID, copy, value,
+                        layouts.sizeOf(arg->type))};
+      function->insts[memcpy].aux =
+          static_cast<uint16_t>(layouts.alignOf(arg->type));
+      value = copy;
+    }
+    args.push_back(value);
+  }
+
+  Value value{emit(Op::CALL, module.functions[callee]->returnType, NO_VALUE,
+                   NO_VALUE, callee)};
+  function->setExtraOperands(value, args);
+  return result != NO_VALUE ? result : value;
+}
+
+Value Lowering::lowerBinOp(const ast::BinOp &binOp) {
+  Op op{Op::NOP};
+  switch (binOp.op) {
+  case ast::BinOpKind::ADD:
+    op = Op::ADD;
+    break;
+  case ast::BinOpKind::SUB:
+    op = Op::SUB;
+    break;
+  case ast::BinOpKind::MUL:
+    op = Op::MUL;
+    break;
+  case ast::BinOpKind::DIV:
+    op = Op::DIV;
+    break;
+  case ast::BinOpKind::MOD:
+    op = Op::REM;
+    break;
+  case ast::BinOpKind::GT:
+    op = Op::GT;
+    break;
+  case ast::BinOpKind::LT:
+    op = Op::LT;
+    break;
+  case ast::BinOpKind::GE:
+    op = Op::GE;
+    break;
+  case ast::BinOpKind::LE:
+    op = Op::LE;
+    break;
+  case ast::BinOpKind::NE:
+    op = Op::NE;
+    break;
+  case ast::BinOpKind::EQ:
+    op = Op::EQ;
+    break;
+  case ast::BinOpKind::OR:
+  case ast::BinOpKind::AND: {
+    // materialise the short-circuit result as a phi of 1 and 0
+    BlockId ifTrue{newBlock()};
+    BlockId ifFalse{newBlock()};
+    BlockId join{newBlock()};
+    branch(binOp, ifTrue, ifFalse);
+    sealBlock(ifTrue);
+    sealBlock(ifFalse);
+
+    startBlock(ifTrue);
+    Value one{constant(Type::I32, 1)};
+    jump(join);
+    startBlock(ifFalse);
+    Value zero{constant(Type::I32, 0)};
+    jump(join);
+    sealBlock(join);
+    startBlock(join);
+
+    Inst phi;
+    phi.op = Op::PHI;
+    phi.type = Type::I32;
+    phi.block = join;
+    Value value{function->create(phi)};
+    function->blocks[join].insts.push_back(value);
+    const Value incoming[]{one, zero};
+    function->setExtraOperands(value, incoming);
+    return value;
+  }
+  }
+
+  Value lhs{rvalue(*binOp.lhs)};
+  Value rhs{rvalue(*binOp.rhs)};
+  return emit(op, Type::I32, lhs, rhs);
+}
+
+Value Lowering::lowerCast(const ast::TypeCast &cast) {
+  const sema::Type *from{cast.operand->type};
+  const sema::Type *to{cast.type};
+  Value value{rvalue(*cast.operand)};
+
+  if (from->kind == sema::TypeKind::CHAR && to->kind == sema::TypeKind::INT)
+    return emit(Op::SEXT, Type::I32, value);
+  if (from->kind == sema::TypeKind::INT && to->kind == sema::TypeKind::CHAR)
+    return emit(Op::TRUNC, Type::I8, value);
+  // array decay and pointer casts keep the address as is
+  return value;
+}
+
+} // namespace ir
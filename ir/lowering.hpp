@@ -0,0 +1,92 @@
+#ifndef LOWERING_H
+#define LOWERING_H
+
+#include "../ast/ast.hpp"
+#include "../sema/layout.hpp"
+#include "../sema/types.hpp"
+#include "ir.hpp"
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+namespace ir {
+
+// Lowers a checked AST into SSA form. Scalar locals and parameters whose
+// address is never taken become SSA values directly, using the on-the-fly
+// construction of Braun et al. (sealed blocks, trivial phi removal); arrays,
+// structs and address-taken variables live in stack slots.
+class Lowering {
+private:
+  Module &module;
+  sema::LayoutEngine &layouts;
+  std::unordered_map<const ast::VarDecl *, uint32_t> globals;
+  std::unordered_map<std::string, uint32_t> strings;
+
+  // per function state
+  Function *function{nullptr};
+  const ast::FunDecl *funDecl{nullptr};
+  BlockId current{0};
+  Value sret{NO_VALUE};
+  size_t entryPrefix{0};
+  std::unordered_map<const ast::VarDecl *, Value> slots;
+  std::unordered_map<const ast::VarDecl *, uint32_t> variables;
+  std::vector<Type> variableTypes;
+  std::unordered_map<uint64_t, Value> currentDef;
+  std::vector<bool> sealed;
+  std::unordered_map<BlockId, std::vector<std::pair<uint32_t, Value>>>
+      incompletePhis;
+  std::vector<Value> forward;
+
+  Type typeOf(const sema::Type *type);
+  Value emit(Op op, Type type, Value a = NO_VALUE, Value b = NO_VALUE,
+             int64_t imm = 0);
+  Value constant(Type type, int64_t value);
+  Value entryValue(Inst inst);
+  Value stackSlot(const sema::Type *type);
+  BlockId newBlock();
+  void jump(BlockId target);
+  void startBlock(BlockId block);
+
+  // SSA construction
+  void writeVariable(uint32_t var, BlockId block, Value value);
+  Value readVariable(uint32_t var, BlockId block);
+  Value readVariableRecursive(uint32_t var, BlockId block);
+  Value addPhiOperands(uint32_t var, Value phi);
+  Value tryRemoveTrivialPhi(Value phi);
+  Value resolve(Value value);
+  void sealBlock(BlockId block);
+  void finishFunction();
+
+  void declareLocal(const ast::VarDecl &var);
+  void lowerStmt(const ast::Stmt &stmt);
+  void lowerBlock(const ast::Block &block);
+  void lowerAssign(const ast::Assign &assign);
+  void lowerReturn(const ast::Return &ret);
+  void branch(const ast::Expr &cond, BlockId ifTrue, BlockId ifFalse);
+
+  Value rvalue(const ast::Expr &expr);
+  Value address(const ast::Expr &expr);
+  Value lowerCall(const ast::FunCall &call);
+  Value lowerBinOp(const ast::BinOp &binOp);
+  Value lowerCast(const ast::TypeCast &cast);
+  Value loadIfScalar(const sema::Type *type, Value address);
+
+public:
+  Lowering(Module &module, sema::LayoutEngine &layouts)
+      : module(module), layouts(layouts) {}
+
+  // Declares globals, builtins and every function so calls can be lowered in
+  // any order.
+  void declare(const ast::Program &program);
+  Function *lowerFunction(const ast::FunDecl &fun);
+  // Lowers the functions of program.functions picked by index in
+  // `selected`, or all of them if it is empty. The others are left as
+  // declarations of functions defined elsewhere.
+  void lower(const ast::Program &program,
+             const std::vector<bool> &selected = {});
+};
+
+} // namespace ir
+
+#endif
@@ -0,0 +1,60 @@
+#include "host.hpp"
+#include "../profile/profile.hpp"
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+namespace jit {
+
+// Same behaviour as examples/minic-stdlib.h, with the same signatures so that
+// JIT-compiled calls pass arguments exactly as they would to the linked
+// library.
+
+static void printS(const char *s) { std::fputs(s, stdout); }
+
+static void printI(int i) { std::printf("%d", i); }
+
+static void printC(char c) { std::putchar(c); }
+
+static char readC() {
+  char c{0};
+  if (std::scanf(" %c", &c) != 1)
+    return 0;
+  return c;
+}
+
+static int readI() {
+  int i{0};
+  if (std::scanf("%d", &i) != 1)
+    return 0;
+  return i;
+}
+
+static void *mcmalloc(int size) { return std::malloc(size); }
+
+// Called by generated code for large aggregate copies.
+static void *copy(void *destination, const void *source, size_t size) {
+  return std::memcpy(destination, source, size);
+}
+
+void *hostFunction(std::string_view name) {
+  if (name == "print_s")
+    return reinterpret_cast<void *>(printS);
+  if (name == "print_i")
+    return reinterpret_cast<void *>(printI);
+  if (name == "print_c")
+    return reinterpret_cast<void *>(printC);
+  if (name == "read_c")
+    return reinterpret_cast<void *>(readC);
+  if (name == "read_i")
+    return reinterpret_cast<void *>(readI);
+  if (name == "mcmalloc")
+    return reinterpret_cast<void *>(mcmalloc);
+  if (name == "memcpy")
+    return reinterpret_cast<void *>(copy);
+  if (name == profile::START_FUNCTION)
+    return reinterpret_cast<void *>(profile::start);
+  return nullptr;
+}
+
+} // namespace jit
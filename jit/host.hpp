@@ -0,0 +1,14 @@
+#ifndef HOST_H
+#define HOST_H
+
+#include <string_view>
+
+namespace jit {
+
+// Address of the host implementation of a minic-stdlib.h function, callable
+// with the System V convention that generated code uses, or nullptr.
+void *hostFunction(std::string_view name);
+
+} // namespace jit
+
+#endif
@@ -0,0 +1,141 @@
+#include "jit.hpp"
+#include "../codegen/encoder.hpp"
+#include "host.hpp"
+#include <algorithm>
+#include <cstring>
+#include <format>
+#include <iostream>
+#include <sys/mman.h>
+#include <unistd.h>
+#include <vector>
+
+namespace jit {
+
+// jmp *8(%rip) followed by padding and the 64-bit target address
+constexpr uint8_t STUB_CODE[] = {0xff, 0x25, 0x02, 0x00,
+                                 0x00, 0x00, 0xcc, 0xcc};
+constexpr size_t STUB_SIZE = 16;
+
+static size_t roundUp(size_t value, size_t align) {
+  return (value + align - 1) / align * align;
+}
+
+Jit::Jit(const codegen::MachineModule &module) : module(module) {}
+
+Jit::~Jit() {
+  if (base != nullptr)
+    munmap(base, mappingSize);
+}
+
+size_t Jit::getCodeSize() const { return textSize; }
+
+int Jit::getErrorCount() const { return errorCount; }
+
+void Jit::error(std::string_view message) {
+  std::cout << std::format("JIT error: {}!", message) << std::endl;
+  errorCount++;
+}
+
+bool Jit::load() {
+  codegen::Encoder encoder{module};
+  codegen::ObjectCode code{encoder.encode()};
+  size_t page{static_cast<size_t>(sysconf(_SC_PAGESIZE))};
+
+  // one stub per builtin, and data placed like the linker would
+  std::vector<size_t> offsets(module.symbols.size(), 0);
+  std::vector<void *> stubTargets;
+  size_t stubsStart{roundUp(code.text.size(), 16)};
+  size_t rodataSize{0};
+  size_t bssSize{0};
+  for (size_t i = 0; i < module.symbols.size(); i++) {
+    const codegen::Symbol &symbol{module.symbols[i]};
+    switch (symbol.kind) {
+    case codegen::SymbolKind::FUNCTION:
+      if (symbol.defined) {
+        offsets[i] = code.symbolOffsets[i];
+        break;
+      }
+      if (void *host{hostFunction(symbol.name)}; host != nullptr) {
+        offsets[i] = stubsStart + STUB_SIZE * stubTargets.size();
+        stubTargets.push_back(host);
+      } else {
+        error(std::format("no host function for {}", symbol.name));
+      }
+      break;
+    case codegen::SymbolKind::RODATA:
+      offsets[i] = rodataSize;
+      rodataSize += symbol.bytes.size();
+      break;
+    case codegen::SymbolKind::DATA:
+      bssSize = roundUp(bssSize, static_cast<size_t>(symbol.align));
+      offsets[i] = bssSize;
+      bssSize += static_cast<size_t>(symbol.size);
+      break;
+    }
+  }
+  if (errorCount > 0)
+    return false;
+
+  size_t execSize{roundUp(stubsStart + STUB_SIZE * stubTargets.size(), page)};
+  size_t rodataStart{execSize};
+  size_t bssStart{rodataStart + roundUp(rodataSize, page)};
+  mappingSize = bssStart + roundUp(std::max<size_t>(bssSize, 1), page);
+
+  void *mapping{mmap(nullptr, mappingSize, PROT_READ | PROT_WRITE,
+                     MAP_PRIVATE | MAP_ANONYMOUS, -1, 0)};
+  if (mapping == MAP_FAILED) {
+    mappingSize = 0;
+    error("cannot map memory");
+    return false;
+  }
+  base = static_cast<uint8_t *>(mapping);
+
+  std::memcpy(base, code.text.data(), code.text.size());
+  for (size_t i = 0; i < stubTargets.size(); i++) {
+    uint8_t *stub{base + stubsStart + STUB_SIZE * i};
+    std::memcpy(stub, STUB_CODE, sizeof(STUB_CODE));
+    std::memcpy(stub + sizeof(STUB_CODE), &stubTargets[i], sizeof(void *));
+  }
+  for (size_t i = 0; i < module.symbols.size(); i++) {
+    const codegen::Symbol &symbol{module.symbols[i]};
+    if (symbol.kind == codegen::SymbolKind::RODATA) {
+      offsets[i] += rodataStart;
+      std::memcpy(base + offsets[i], symbol.bytes.data(), symbol.bytes.size());
+    } else if (symbol.kind == codegen::SymbolKind::DATA) {
+      offsets[i] += bssStart;
+    }
+  }
+
+  // both relocation kinds are pc-relative once the stubs stand in for PLT
+  // entries
+  for (const codegen::Relocation &relocation : code.relocations) {
+    int64_t value{static_cast<int64_t>(offsets[relocation.symbol]) +
+                  relocation.addend - static_cast<int64_t>(relocation.offset)};
+    int32_t rel{static_cast<int32_t>(value)};
+    std::memcpy(base + relocation.offset, &rel, sizeof(rel));
+  }
+
+  if (mprotect(base, execSize, PROT_READ | PROT_EXEC) != 0 ||
+      (rodataSize > 0 &&
+       mprotect(base + rodataStart, bssStart - rodataStart, PROT_READ) != 0)) {
+    error("cannot protect memory");
+    return false;
+  }
+
+  textSize = code.text.size();
+  for (size_t i = 0; i < module.symbols.size(); i++)
+    if (module.symbols[i].name == "main" && module.symbols[i].defined)
+      mainAddress = base + offsets[i];
+  if (mainAddress == nullptr) {
+    error("no main function");
+    return false;
+  }
+  return true;
+}
+
+int Jit::run() {
+  using Main = int (*)();
+  return reinterpret_cast<Main>(mainAddress)();
+}
+
+} // namespace jit
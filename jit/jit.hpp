@@ -0,0 +1,44 @@
+#ifndef JIT_H
+#define JIT_H
+
+#include "../codegen/x86.hpp"
+#include <cstddef>
+#include <cstdint>
+#include <string_view>
+
+namespace jit {
+
+// Loads a machine module into one anonymous mapping laid out as
+//   [text | call stubs] [rodata] [bss]
+// so that every rip-relative reference stays within 2 GiB. Calls to
+// builtins go through stubs that jump indirectly to the host functions,
+// which may live anywhere in the address space. After relocation the text
+// is remapped read/execute and never writable at the same time.
+class Jit {
+private:
+  const codegen::MachineModule &module;
+  uint8_t *base{nullptr};
+  size_t mappingSize{0};
+  size_t textSize{0};
+  uint8_t *mainAddress{nullptr};
+  int errorCount{0};
+
+  void error(std::string_view message);
+
+public:
+  explicit Jit(const codegen::MachineModule &module);
+  ~Jit();
+  Jit(const Jit &) = delete;
+  Jit &operator=(const Jit &) = delete;
+
+  bool load();
+  // Calls main in-process and returns its result.
+  int run();
+
+  size_t getCodeSize() const;
+  int getErrorCount() const;
+};
+
+} // namespace jit
+
+#endif
@@ -0,0 +1,178 @@
+#include "include_scanner.hpp"
+#include <algorithm>
+#include <bit>
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+namespace lexer {
+
+static bool isSpecial(char c) {
+  return c == '#' || c == '/' || c == '"' || c == '\'';
+}
+
+// The first byte at or after `position` that can start a directive, a
+// comment or a literal, or the end of the source.
+static size_t findSpecial(std::string_view source, size_t position) {
+#ifdef __SSE2__
+  const __m128i hash{_mm_set1_epi8('#')};
+  const __m128i slash{_mm_set1_epi8('/')};
+  const __m128i quote{_mm_set1_epi8('"')};
+  const __m128i apostrophe{_mm_set1_epi8('\'')};
+  for (; position + 16 <= source.size(); position += 16) {
+    __m128i chunk{_mm_loadu_si128(
+        reinterpret_cast<const __m128i *>(source.data() + position))};
+    __m128i hits{
+        _mm_or_si128(_mm_or_si128(_mm_cmpeq_epi8(chunk, hash),
+                                  _mm_cmpeq_epi8(chunk, slash)),
+                     _mm_or_si128(_mm_cmpeq_epi8(chunk, quote),
+                                  _mm_cmpeq_epi8(chunk, apostrophe)))};
+    unsigned mask{static_cast<unsigned>(_mm_movemask_epi8(hits))};
+    if (mask != 0)
+      return position + static_cast<size_t>(std::countr_zero(mask));
+  }
+#endif
+  while (position < source.size() && !isSpecial(source[position]))
+    position++;
+  return position;
+}
+
+// Past the literal opening at `position`: behind its closing quote, or at
+// the end of its line if it has none.
+static size_t skipLiteral(std::string_view source, size_t position) {
+  char quote{source[position++]};
+  while (position < source.size() && source[position] != '\n') {
+    if (source[position] == quote)
+      return position + 1;
+    position += source[position] == '\\' ? 2 : 1;
+  }
+  return std::min(position, source.size());
+}
+
+// Past any line splices (a backslash ending a line) at `position`; C joins
+// such lines before it looks for comments and directives.
+static size_t skipSplices(std::string_view source, size_t position) {
+  while (source.substr(position, 2) == "\\\n")
+    position += 2;
+  return position;
+}
+
+// The end of the // comment at `position`: the first newline that does not
+// end a splice, or the end of the source.
+static size_t skipLineComment(std::string_view source, size_t position) {
+  size_t end{source.find('\n', position)};
+  while (end != std::string_view::npos && source[end - 1] == '\\')
+    end = source.find('\n', end + 1);
+  return std::min(end, source.size());
+}
+
+// Past the /* comment at `position`.
+static size_t skipBlockComment(std::string_view source, size_t position) {
+  size_t end{source.find("*/", position + 2)};
+  return end == std::string_view::npos ? source.size() : end + 2;
+}
+
+// Whether only blanks, splices and comments precede `position` on its line.
+// Comments are known from `blankUntil`, the end of the last one that did.
+static bool startsLine(std::string_view source, size_t position,
+                       size_t blankUntil) {
+  while (position > 0) {
+    if (source[position - 1] == ' ' || source[position - 1] == '\t')
+      position--;
+    else if (position >= 2 && source.substr(position - 2, 2) == "\\\n")
+      position -= 2;
+    else
+      break;
+  }
+  return position == 0 || source[position - 1] == '\n' ||
+         position == blankUntil;
+}
+
+// Past the blanks, splices and /* comments at `position`, which all stand
+// for blanks within a directive.
+static size_t skipBlanks(std::string_view source, size_t position) {
+  while (position < source.size()) {
+    size_t next{skipSplices(source, position)};
+    if (next < source.size() && (source[next] == ' ' || source[next] == '\t'))
+      next++;
+    else if (source.substr(next, 2) == "/*")
+      next = skipBlockComment(source, next);
+    if (next == position)
+      break;
+    position = next;
+  }
+  return position;
+}
+
+// Past `word` spelt at `position`, splices allowed anywhere within it, or
+// npos if it is not there.
+static size_t skipWord(std::string_view source, size_t position,
+                       std::string_view word) {
+  for (char c : word) {
+    position = skipSplices(source, position);
+    if (position == source.size() || source[position] != c)
+      return std::string_view::npos;
+    position++;
+  }
+  return position;
+}
+
+std::vector<Include> scanIncludes(std::string_view source) {
+  std::vector<Include> includes;
+  // lines are counted only up to the directives found
+  size_t counted{0};
+  int line{1};
+  size_t blankUntil{std::string_view::npos};
+  size_t position{0};
+  while ((position = findSpecial(source, position)) < source.size()) {
+    char c{source[position]};
+    if (c == '"' || c == '\'') {
+      position = skipLiteral(source, position);
+      continue;
+    }
+    if (c == '/') {
+      size_t start{position};
+      if (source.substr(position, 2) == "//")
+        position = skipLineComment(source, position);
+      else if (source.substr(position, 2) == "/*") {
+        position = skipBlockComment(source, position);
+        if (startsLine(source, start, blankUntil))
+          blankUntil = position;
+      } else
+        position++;
+      continue;
+    }
+
+    // #include "path" or #include <path>
+    bool directive{startsLine(source, position, blankUntil)};
+    position = skipBlanks(source, position + 1);
+    if (!directive)
+      continue;
+    size_t word{skipWord(source, position, "include")};
+    if (word == std::string_view::npos)
+      continue;
+    position = skipSplices(source, skipBlanks(source, word));
+    if (position == source.size() ||
+        (source[position] != '"' && source[position] != '<'))
+      continue;
+    bool system{source[position] == '<'};
+    char close{system ? '>' : '"'};
+    std::string path;
+    size_t end{skipSplices(source, position + 1)};
+    while (end < source.size() && source[end] != close &&
+           source[end] != '\n') {
+      path += source[end];
+      end = skipSplices(source, end + 1);
+    }
+    if (end == source.size() || source[end] == '\n')
+      continue;
+    line += static_cast<int>(std::count(source.begin() + counted,
+                                        source.begin() + position, '\n'));
+    counted = position;
+    includes.push_back({std::move(path), system, line});
+    position = end + 1;
+  }
+  return includes;
+}
+
+} // namespace lexer
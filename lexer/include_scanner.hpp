@@ -0,0 +1,29 @@
+#ifndef INCLUDE_SCANNER_H
+#define INCLUDE_SCANNER_H
+
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace lexer {
+
+// An #include directive.
+struct Include {
+  std::string path;
+  // <path> rather than "path"
+  bool system;
+  int line;
+};
+
+// Finds the #include directives of a source file without tokenising it. Only
+// the bytes that can start a directive, a comment or a literal are looked
+// at, 16 at a time where SSE2 is available; comments and string and
+// character literals are skipped as a whole, and a '#' starts a directive
+// only when nothing but blanks and comments precede it on its line. Lines
+// ending in a backslash are joined to the next, in comments and directives
+// alike, as C does before it looks for either.
+std::vector<Include> scanIncludes(std::string_view source);
+
+} // namespace lexer
+
+#endif
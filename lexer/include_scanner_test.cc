@@ -0,0 +1,68 @@
+#include "include_scanner.hpp"
+#include <algorithm>
+#include <format>
+#include <iostream>
+#include <string>
+#include <vector>
+
+// Checks scanIncludes against what a C preprocessor makes of each source:
+// the paths of the directives found, in order, with <> around system ones.
+
+struct Case {
+  std::string_view name;
+  std::string_view source;
+  std::vector<std::string_view> expected;
+};
+
+static const std::vector<Case> CASES{
+    {"plain", "#include \"a.h\"\n#include <b.h>\n", {"a.h", "<b.h>"}},
+    {"indented", "  \t#  include \"a.h\"\n", {"a.h"}},
+    {"after code", "int x; #include \"a.h\"\n", {}},
+    {"in a string", "char *s = \"\n#include \\\"a.h\\\"\";\n", {}},
+    {"in a block comment", "/*\n#include \"a.h\"\n*/\n", {}},
+    {"in a line comment", "// #include \"a.h\"\n", {}},
+    {"after a block comment", "/* x */ #include \"a.h\"\n", {"a.h"}},
+    {"after block comments", "/* x */ /* y */#include \"a.h\"\n", {"a.h"}},
+    {"after a multi-line block comment",
+     "/* x\n y */ #include \"a.h\"\n",
+     {"a.h"}},
+    {"after code and a block comment",
+     "int x; /* y */ #include \"a.h\"\n",
+     {}},
+    {"spliced line comment",
+     "// old \\\n#include \"gone.h\"\n#include \"a.h\"\n",
+     {"a.h"}},
+    {"spliced line comment twice",
+     "// old \\\n\\\n#include \"gone.h\"\n",
+     {}},
+    {"spliced before the path", "#include \\\n\"b.h\"\n", {"b.h"}},
+    {"spliced within the directive",
+     "#inc\\\nlude <b\\\n.h>\n#\\\ninclude \"c.h\"\n",
+     {"<b.h>", "c.h"}},
+    {"spliced before the hash", " \\\n #include \"a.h\"\n", {"a.h"}},
+    {"spliced onto code", "int x; \\\n#include \"a.h\"\n", {}},
+    {"block comment within the directive",
+     "# /* x */ include /* y\n */ \"a.h\"\n",
+     {"a.h"}},
+    {"unterminated path", "#include \"a.h\n\"b.h\"\n", {}},
+};
+
+int main() {
+  int failures{0};
+  for (const Case &test : CASES) {
+    std::vector<std::string> found;
+    for (const lexer::Include &include : lexer::scanIncludes(test.source))
+      found.push_back(include.system ? std::format("<{}>", include.path)
+                                     : include.path);
+    if (std::ranges::equal(found, test.expected))
+      continue;
+    std::string paths;
+    for (const std::string &path : found)
+      paths += std::format(" {}", path);
+    std::cout << std::format("Include scanner: {}: found{}!", test.name,
+                             paths.empty() ? " nothing" : paths)
+              << std::endl;
+    failures++;
+  }
+  return failures == 0 ? 0 : -1;
+}
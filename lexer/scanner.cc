@@ -2,34 +2,44 @@
 
 namespace lexer {
 
+// Reads the next chunk once the buffer is used up. Returns false at the end
+// of the stream.
+bool Scanner::fill() {
+  buffer.resize(CHUNK_SIZE);
+  stream->read(buffer.data(), static_cast<std::streamsize>(buffer.size()));
+  buffer.resize(static_cast<size_t>(stream->gcount()));
+  pos = 0;
+  return !buffer.empty();
+}
+
 int Scanner::getColumn() { return column; }
 
 int Scanner::getLine() { return line; }
 
-char Scanner::peek() {
-  if (peeked != -1)
+int Scanner::peek() {
+  if (peeked != END_OF_INPUT)
     return peeked;
 
-  if (pos >= (buffer.size()))
-    return -1;
+  if (pos >= buffer.size() && !fill())
+    return END_OF_INPUT;
 
-  peeked = buffer[pos++];
+  peeked = static_cast<unsigned char>(buffer[pos++]);
 
   return peeked;
 }
 
-char Scanner::next() {
-  char nextChar;
+int Scanner::next() {
+  int nextChar;
 
-  if (peeked != -1) {
+  if (peeked != END_OF_INPUT) {
     nextChar = peeked;
-    peeked = -1;
+    peeked = END_OF_INPUT;
   } else {
 
-    if (pos >= (buffer.size()))
-      return -1;
+    if (pos >= buffer.size() && !fill())
+      return END_OF_INPUT;
 
-    nextChar = buffer[pos++];
+    nextChar = static_cast<unsigned char>(buffer[pos++]);
   }
 
   if (nextChar == '\n') {
@@ -41,13 +51,13 @@ char Scanner::next() {
 }
 
 bool Scanner::hasNext() {
-  if (peeked != -1)
+  if (peeked != END_OF_INPUT)
     return true;
 
-  if (pos == (buffer.size()))
+  if (pos >= buffer.size() && !fill())
     return false;
 
-  peeked = buffer[pos++];
+  peeked = static_cast<unsigned char>(buffer[pos++]);
 
   return true;
 }
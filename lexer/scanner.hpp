@@ -1,28 +1,38 @@
 #ifndef SCANNER_H
 #define SCANNER_H
 
-#include <fstream>
+#include <istream>
 #include <vector>
 
 namespace lexer {
+
+// What the scanner returns once the input is used up. Bytes are returned as
+// unsigned values, so the marker is out of their range and a 0xff byte in
+// the source is not taken for the end.
+constexpr int END_OF_INPUT = -1;
+
+// Reads the source a chunk at a time, so that only the text being tokenised
+// is held in memory however large the file.
 class Scanner {
 private:
+  static constexpr size_t CHUNK_SIZE{1 << 16};
+
+  std::istream *stream;
   std::vector<char> buffer;
-  char peeked{-1};
+  int peeked{END_OF_INPUT};
   int line{1};
   int column{1};
   long unsigned int pos{0};
 
+  bool fill();
+
 public:
-  Scanner(std::ifstream &file) {
-    std::istreambuf_iterator<char> begin(file), end;
-    buffer = std::vector<char>(begin, end);
-  }
+  Scanner(std::istream &stream) : stream(&stream) {}
 
   int getColumn();
   int getLine();
-  char peek();
-  char next();
+  int peek();
+  int next();
   bool hasNext();
 };
 } // namespace lexer
@@ -1,4 +1,90 @@
 #include "token.hpp"
 namespace lexer {
 std::string Token::toString() { return "(" + str + ")"; }
+
+std::string_view toString(TokenClass type) {
+  switch (type) {
+  case TokenClass::IDENTIFIER:
+    return "IDENTIFIER";
+  case TokenClass::ASSIGN:
+    return "=";
+  case TokenClass::LBRA:
+    return "{";
+  case TokenClass::RBRA:
+    return "}";
+  case TokenClass::LPAR:
+    return "(";
+  case TokenClass::RPAR:
+    return ")";
+  case TokenClass::LSBR:
+    return "[";
+  case TokenClass::RSBR:
+    return "]";
+  case TokenClass::SC:
+    return ";";
+  case TokenClass::COMMA:
+    return ",";
+  case TokenClass::INT:
+    return "int";
+  case TokenClass::VOID:
+    return "void";
+  case TokenClass::CHAR:
+    return "char";
+  case TokenClass::IF:
+    return "if";
+  case TokenClass::ELSE:
+    return "else";
+  case TokenClass::WHILE:
+    return "while";
+  case TokenClass::RETURN:
+    return "return";
+  case TokenClass::STRUCT:
+    return "struct";
+  case TokenClass::SIZEOF:
+    return "sizeof";
+  case TokenClass::INCLUDE:
+    return "#include";
+  case TokenClass::STRING_LITERAL:
+    return "STRING_LITERAL";
+  case TokenClass::INT_LITERAL:
+    return "INT_LITERAL";
+  case TokenClass::CHAR_LITERAL:
+    return "CHAR_LITERAL";
+  case TokenClass::LOGAND:
+    return "&&";
+  case TokenClass::LOGOR:
+    return "||";
+  case TokenClass::EQ:
+    return "==";
+  case TokenClass::NE:
+    return "!=";
+  case TokenClass::LT:
+    return "<";
+  case TokenClass::GT:
+    return ">";
+  case TokenClass::LE:
+    return "<=";
+  case TokenClass::GE:
+    return ">=";
+  case TokenClass::PLUS:
+    return "+";
+  case TokenClass::MINUS:
+    return "-";
+  case TokenClass::ASTERIX:
+    return "*";
+  case TokenClass::DIV:
+    return "/";
+  case TokenClass::REM:
+    return "%";
+  case TokenClass::AND:
+    return "&";
+  case TokenClass::DOT:
+    return ".";
+  case TokenClass::END:
+    return "EOF";
+  case TokenClass::INVALID:
+    return "INVALID";
+  }
+  return "INVALID";
+}
 } // namespace lexer
@@ -1,3 +1,6 @@
+#ifndef TOKEN_H
+#define TOKEN_H
+
 #include <string>
 namespace lexer {
 
@@ -61,4 +64,8 @@ public:
   std::string toString();
 };
 
+std::string_view toString(TokenClass type);
+
 } // namespace lexer
+
+#endif
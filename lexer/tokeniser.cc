@@ -1,5 +1,4 @@
 #include "tokeniser.hpp"
-#include <cctype>
 #include <format>
 #include <string>
 
@@ -41,13 +40,24 @@ static Token lexInclude(Scanner &scanner, int line, int column,
 // helper functions
 static Token possibleKeywordToToken(const std::string_view str, const int line,
                                     const int column);
-static bool isEscapeCharacter(const char curChar);
-static char toEscapeCharacter(const char curChar);
+static bool isEscapeCharacter(const int curChar);
+static int toEscapeCharacter(const int curChar);
+
+// Bytes are classified as ASCII whatever the locale: those of multi-byte
+// UTF-8 sequences are never letters, digits or spaces.
+static bool isLetter(int c) {
+  return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z');
+}
+static bool isDigit(int c) { return c >= '0' && c <= '9'; }
+static bool isLetterOrDigit(int c) { return isLetter(c) || isDigit(c); }
+static bool isSpace(int c) { return c == ' ' || (c >= '\t' && c <= '\r'); }
+
+static std::string asString(int c) { return std::string{static_cast<char>(c)}; }
 
 int Tokeniser::getErrorCount() { return errors; }
 
 Token Tokeniser::nextToken() {
-  char nextChar;
+  int nextChar;
 
   int line{scanner.getLine()};
   int column{scanner.getColumn()};
@@ -56,14 +66,14 @@ Token Tokeniser::nextToken() {
 
   nextChar = scanner.next();
 
-  if (nextChar == -1)
+  if (nextChar == END_OF_INPUT)
     return Token{TokenClass::END, "EOF", line, column};
 
-  if (std::isspace(nextChar))
+  if (isSpace(nextChar))
     return nextToken();
 
-  if (std::isalpha(nextChar) || nextChar == '_')
-    return lexKeywordOrIdent(scanner, std::string{nextChar}, line, column,
+  if (isLetter(nextChar) || nextChar == '_')
+    return lexKeywordOrIdent(scanner, asString(nextChar), line, column,
                              error_func);
 
   if (nextChar == '\'')
@@ -72,100 +82,99 @@ Token Tokeniser::nextToken() {
   if (nextChar == '"')
     return lexStringLiteral(scanner, line, column, error_func);
 
-  if (std::isdigit(nextChar))
-    return lexIntLiteral(scanner, std::string{nextChar}, line, column,
-                         error_func);
+  if (isDigit(nextChar))
+    return lexIntLiteral(scanner, asString(nextChar), line, column, error_func);
 
   if (nextChar == '#')
     return lexInclude(scanner, line, column, error_func);
 
   if (nextChar == '+')
-    return Token{TokenClass::PLUS, std::string{nextChar}, line, column};
+    return Token{TokenClass::PLUS, asString(nextChar), line, column};
 
   if (nextChar == '-')
-    return Token{TokenClass::MINUS, std::string{nextChar}, line, column};
+    return Token{TokenClass::MINUS, asString(nextChar), line, column};
 
   if (nextChar == '*')
-    return Token{TokenClass::ASTERIX, std::string{nextChar}, line, column};
+    return Token{TokenClass::ASTERIX, asString(nextChar), line, column};
 
   if (nextChar == '%')
-    return Token{TokenClass::REM, std::string{nextChar}, line, column};
+    return Token{TokenClass::REM, asString(nextChar), line, column};
 
   if (nextChar == '{')
-    return Token{TokenClass::LBRA, std::string{nextChar}, line, column};
+    return Token{TokenClass::LBRA, asString(nextChar), line, column};
 
   if (nextChar == '}')
-    return Token{TokenClass::RBRA, std::string{nextChar}, line, column};
+    return Token{TokenClass::RBRA, asString(nextChar), line, column};
 
   if (nextChar == '(')
-    return Token{TokenClass::LPAR, std::string{nextChar}, line, column};
+    return Token{TokenClass::LPAR, asString(nextChar), line, column};
 
   if (nextChar == ')')
-    return Token{TokenClass::RPAR, std::string{nextChar}, line, column};
+    return Token{TokenClass::RPAR, asString(nextChar), line, column};
 
   if (nextChar == '[')
-    return Token{TokenClass::LSBR, std::string{nextChar}, line, column};
+    return Token{TokenClass::LSBR, asString(nextChar), line, column};
 
   if (nextChar == ']')
-    return Token{TokenClass::RSBR, std::string{nextChar}, line, column};
+    return Token{TokenClass::RSBR, asString(nextChar), line, column};
 
   if (nextChar == ';')
-    return Token{TokenClass::SC, std::string{nextChar}, line, column};
+    return Token{TokenClass::SC, asString(nextChar), line, column};
 
   if (nextChar == ',')
-    return Token{TokenClass::COMMA, std::string{nextChar}, line, column};
+    return Token{TokenClass::COMMA, asString(nextChar), line, column};
 
   if (nextChar == '.')
-    return Token{TokenClass::DOT, std::string{nextChar}, line, column};
+    return Token{TokenClass::DOT, asString(nextChar), line, column};
 
   if (nextChar == '&') {
     if (scanner.peek() != '&')
-      return Token{TokenClass::AND, std::string{nextChar}, line, column};
+      return Token{TokenClass::AND, asString(nextChar), line, column};
     scanner.next();
-    return Token{TokenClass::LOGAND, std::string{nextChar, '&'}, line, column};
+    return Token{TokenClass::LOGAND, asString(nextChar) + '&', line, column};
   }
 
   if (nextChar == '=') {
     if (scanner.peek() != '=')
-      return Token{TokenClass::ASSIGN, std::string{nextChar}, line, column};
+      return Token{TokenClass::ASSIGN, asString(nextChar), line, column};
     scanner.next();
-    return Token{TokenClass::EQ, std::string{nextChar, '='}, line, column};
+    return Token{TokenClass::EQ, asString(nextChar) + '=', line, column};
   }
 
   if (nextChar == '|' && scanner.peek() == '|') {
     scanner.next();
-    return Token{TokenClass::LOGOR, std::string{nextChar, '|'}, line, column};
+    return Token{TokenClass::LOGOR, asString(nextChar) + '|', line, column};
   }
 
   if (nextChar == '!' && scanner.peek() == '=') {
     scanner.next();
-    return Token{TokenClass::NE, std::string{nextChar, '='}, line, column};
+    return Token{TokenClass::NE, asString(nextChar) + '=', line, column};
   }
 
   if (nextChar == '<') {
     if (scanner.peek() != '=')
-      return Token{TokenClass::LT, std::string{nextChar}, line, column};
+      return Token{TokenClass::LT, asString(nextChar), line, column};
     scanner.next();
-    return Token{TokenClass::LE, std::string{nextChar, '='}, line, column};
+    return Token{TokenClass::LE, asString(nextChar) + '=', line, column};
   }
 
   if (nextChar == '>') {
     if (scanner.peek() != '=')
-      return Token{TokenClass::GT, std::string{nextChar}, line, column};
+      return Token{TokenClass::GT, asString(nextChar), line, column};
     scanner.next();
-    return Token{TokenClass::GE, std::string{nextChar, '='}, line, column};
+    return Token{TokenClass::GE, asString(nextChar) + '=', line, column};
   }
 
   if (nextChar == '/') {
     nextChar = scanner.peek();
     if (nextChar != '/' && nextChar != '*')
-      return Token{TokenClass::GT, std::string{'/'}, line, column};
+      return Token{TokenClass::DIV, std::string{'/'}, line, column};
 
-    char lastChar{nextChar};
+    int lastChar{nextChar};
     scanner.next();
     nextChar = scanner.peek();
     if (lastChar == '/') { // single line comment
-      while (nextChar != '\n')
+      while (nextChar != '\n' && nextChar != END_OF_INPUT)
         nextChar = scanner.next();
       return nextToken();
     }
@@ -174,7 +183,7 @@ Token Tokeniser::nextToken() {
 
     while (keepSkipping) { // multi line comment
       nextChar = scanner.next();
-      if (nextChar == -1)
+      if (nextChar == END_OF_INPUT)
         keepSkipping = false;
       if (nextChar == '*' && scanner.peek() == '/') {
         scanner.next();
@@ -185,39 +194,41 @@ Token Tokeniser::nextToken() {
   }
 
   error(std::format("Lexing error: unrecognised character ({}) at {}:{}!",
-                    nextChar, line, column));
-  return Token{TokenClass::INVALID, std::string{nextChar}, line, column};
+                    nextChar < 0x80 ? asString(nextChar)
+                                    : std::format("0x{:02x}", nextChar),
+                    line, column));
+  return Token{TokenClass::INVALID, asString(nextChar), line, column};
 }
 
 static Token lexKeywordOrIdent(Scanner &scanner, std::string str, int line,
                                int column, ErrorFunction error) {
-  char nextChar{scanner.peek()};
+  int nextChar{scanner.peek()};
 
-  if (nextChar == -1)
+  if (nextChar == END_OF_INPUT)
     return Token{TokenClass::END, "EOF", line, column};
 
-  while (std::isalpha(nextChar)) {
-    str += nextChar;
+  while (isLetter(nextChar)) {
+    str += static_cast<char>(nextChar);
     scanner.next();
     nextChar = scanner.peek();
 
-    if (nextChar == -1) {
+    if (nextChar == END_OF_INPUT) {
       error(std::format(
           "Lexing error: file ending cutoff keyword or identifier at {}:{}!",
           line, column));
       return Token{TokenClass::INVALID, std::string{str}, line, column};
     }
-    if (!std::isalnum(nextChar) && nextChar != '_') {
+    if (!isLetterOrDigit(nextChar) && nextChar != '_') {
       return possibleKeywordToToken(str, line, column);
     }
   }
 
-  while (std::isalnum(nextChar) || nextChar == '_') { // ident
-    str += nextChar;
+  while (isLetterOrDigit(nextChar) || nextChar == '_') { // ident
+    str += static_cast<char>(nextChar);
     scanner.next();
     nextChar = scanner.peek();
 
-    if (nextChar == -1) {
+    if (nextChar == END_OF_INPUT) {
       error(std::format("Lexing error: file ending cutoff identifier at {}:{}!",
                         line, column));
       return Token{TokenClass::INVALID, std::string{str}, line, column};
@@ -236,9 +247,9 @@ static Token lexKeywordOrIdent(Scanner &scanner, std::string str, int line,
 static Token lexCharLiteral(Scanner &scanner, int line, int column,
                             ErrorFunction error) {
 
-  char nextChar{scanner.peek()};
+  int nextChar{scanner.peek()};
 
-  if (nextChar == -1)
+  if (nextChar == END_OF_INPUT)
     return Token{TokenClass::END, "EOF", line, column};
 
   std::string str;
@@ -247,7 +258,7 @@ static Token lexCharLiteral(Scanner &scanner, int line, int column,
     scanner.next();
     nextChar = scanner.peek();
 
-    if (nextChar == -1) {
+    if (nextChar == END_OF_INPUT) {
       error(std::format("Lexing error: char at {}:{} must be enclosed "
                         "between apostrophes!",
                         line, column));
@@ -255,7 +266,7 @@ static Token lexCharLiteral(Scanner &scanner, int line, int column,
     }
 
     if (isEscapeCharacter(nextChar)) {
-      str = std::string{toEscapeCharacter(nextChar)};
+      str = asString(toEscapeCharacter(nextChar));
       scanner.next();
       nextChar = scanner.peek();
 
@@ -270,7 +281,7 @@ static Token lexCharLiteral(Scanner &scanner, int line, int column,
     }
   }
 
-  str = std::string{nextChar};
+  str = asString(nextChar);
   scanner.next();
   nextChar = scanner.peek();
 
@@ -287,9 +298,9 @@ static Token lexCharLiteral(Scanner &scanner, int line, int column,
 static Token lexStringLiteral(Scanner &scanner, int line, int column,
                               ErrorFunction error) {
   std::string str{""};
-  char nextChar{scanner.peek()};
+  int nextChar{scanner.peek()};
 
-  if (nextChar == -1)
+  if (nextChar == END_OF_INPUT)
     return Token{TokenClass::END, "EOF", line, column};
 
   while (nextChar != '"') {
@@ -298,13 +309,13 @@ static Token lexStringLiteral(Scanner &scanner, int line, int column,
       nextChar = toEscapeCharacter(scanner.peek());
     }
 
-    if (nextChar == -1) {
+    if (nextChar == END_OF_INPUT) {
       error(std::format(
           "Lexing error: string at {}:{} must be enclosed between quotes!",
           line, column));
       return Token{TokenClass::INVALID, str, line, column};
     }
-    str += nextChar;
+    str += static_cast<char>(nextChar);
     scanner.next();
     nextChar = scanner.peek();
   }
@@ -315,9 +326,9 @@ static Token lexStringLiteral(Scanner &scanner, int line, int column,
 
 static Token lexIntLiteral(Scanner &scanner, std::string str, int line,
                            int column, ErrorFunction error) {
-  char nextChar{scanner.peek()};
-  while (std::isdigit(nextChar)) {
-    str += nextChar;
+  int nextChar{scanner.peek()};
+  while (isDigit(nextChar)) {
+    str += static_cast<char>(nextChar);
     scanner.next();
     nextChar = scanner.peek();
   }
@@ -326,11 +337,11 @@ static Token lexIntLiteral(Scanner &scanner, std::string str, int line,
 
 static Token lexInclude(Scanner &scanner, int line, int column,
                         ErrorFunction error) {
-  char nextChar{scanner.peek()};
+  int nextChar{scanner.peek()};
   std::string str{""};
 
-  while (std::isalpha(nextChar)) {
-    str += nextChar;
+  while (isLetter(nextChar)) {
+    str += static_cast<char>(nextChar);
     scanner.next();
     nextChar = scanner.peek();
   }
@@ -365,14 +376,14 @@ static Token possibleKeywordToToken(const std::string_view str, const int line,
   return Token(TokenClass::IDENTIFIER, std::string(str), line, column);
 }
 
-static bool isEscapeCharacter(const char curChar) {
+static bool isEscapeCharacter(const int curChar) {
   return curChar == BACKSPACE || curChar == FORMFEED || curChar == NEWLINE ||
          curChar == CARRIAGE_RETURN || curChar == HORIZONTAL_TAB ||
          curChar == BACKSLASH || curChar == SINGLE_QUOTE ||
          curChar == NULL_TERMINATOR;
 }
 
-static char toEscapeCharacter(const char curChar) {
+static int toEscapeCharacter(const int curChar) {
   if (curChar == BACKSPACE)
     return '\b';
   if (curChar == FORMFEED)
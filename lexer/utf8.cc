@@ -0,0 +1,110 @@
+#include "utf8.hpp"
+#include <bit>
+#include <string>
+#include <vector>
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+namespace lexer {
+
+constexpr size_t CHUNK_SIZE{1 << 16};
+
+// Length of the sequence starting `text` by the table of well-formed byte
+// sequences in the Unicode standard (3.9, table 3-7): 0 if it is
+// ill-formed, or -1 if it is well-formed as far as `text` goes but cut off.
+// Overlong forms, surrogates and code points beyond U+10FFFF are ill-formed
+// through the range allowed for the second byte.
+static int sequenceLength(std::string_view text) {
+  auto byte{[&](size_t i) { return static_cast<unsigned char>(text[i]); }};
+  unsigned char lead{byte(0)};
+  unsigned char low{0x80};
+  unsigned char high{0xbf};
+  size_t length;
+  if (lead < 0x80)
+    return 1;
+  if (lead >= 0xc2 && lead <= 0xdf)
+    length = 2;
+  else if (lead >= 0xe0 && lead <= 0xef) {
+    length = 3;
+    low = lead == 0xe0 ? 0xa0 : low;
+    high = lead == 0xed ? 0x9f : high;
+  } else if (lead >= 0xf0 && lead <= 0xf4) {
+    length = 4;
+    low = lead == 0xf0 ? 0x90 : low;
+    high = lead == 0xf4 ? 0x8f : high;
+  } else
+    return 0;
+
+  for (size_t i = 1; i < length; i++) {
+    if (i == text.size())
+      return -1;
+    if (byte(i) < low || byte(i) > high)
+      return 0;
+    low = 0x80;
+    high = 0xbf;
+  }
+  return static_cast<int>(length);
+}
+
+// Length of the longest well-formed prefix of `text`, and whether what
+// follows it is a sequence cut off by the end of `text`.
+static size_t validPrefix(std::string_view text, bool &cutOff) {
+  cutOff = false;
+  size_t position{0};
+  while (position < text.size()) {
+#ifdef __SSE2__
+    // a byte with its top bit set ends the run of ASCII
+    for (; position + 16 <= text.size(); position += 16) {
+      unsigned mask{static_cast<unsigned>(_mm_movemask_epi8(_mm_loadu_si128(
+          reinterpret_cast<const __m128i *>(text.data() + position))))};
+      if (mask != 0) {
+        position += static_cast<size_t>(std::countr_zero(mask));
+        break;
+      }
+    }
+#endif
+    while (position < text.size() &&
+           static_cast<unsigned char>(text[position]) < 0x80)
+      position++;
+    if (position == text.size())
+      break;
+
+    int length{sequenceLength(text.substr(position))};
+    if (length <= 0) {
+      cutOff = length < 0;
+      return position;
+    }
+    position += static_cast<size_t>(length);
+  }
+  return position;
+}
+
+size_t findInvalidUtf8(std::string_view text) {
+  bool cutOff;
+  return validPrefix(text, cutOff);
+}
+
+std::optional<uint64_t> findInvalidUtf8(std::istream &stream) {
+  // the bytes not yet checked, starting at `offset` in the stream: a
+  // sequence cut off by the end of the last chunk and the next chunk
+  std::string pending;
+  uint64_t offset{0};
+  std::vector<char> chunk(CHUNK_SIZE);
+  for (;;) {
+    stream.read(chunk.data(), static_cast<std::streamsize>(chunk.size()));
+    size_t count{static_cast<size_t>(stream.gcount())};
+    pending.append(chunk.data(), count);
+
+    bool cutOff;
+    size_t valid{validPrefix(pending, cutOff)};
+    if (valid < pending.size() && (!cutOff || count == 0))
+      return offset + valid;
+    if (count == 0)
+      return std::nullopt;
+    offset += valid;
+    pending.erase(0, valid);
+  }
+}
+
+} // namespace lexer
@@ -0,0 +1,23 @@
+#ifndef UTF8_H
+#define UTF8_H
+
+#include <cstdint>
+#include <istream>
+#include <optional>
+#include <string_view>
+
+namespace lexer {
+
+// Offset of the first byte of `text` that is not part of a well-formed UTF-8
+// sequence, or text.size() if every byte is; a sequence cut off by the end
+// of the text is ill-formed. Runs of ASCII are skipped 16 bytes at a time
+// where SSE2 is available, so plain ASCII source is checked at memory speed.
+size_t findInvalidUtf8(std::string_view text);
+
+// The same over a whole stream, read a chunk at a time so that sequences
+// may straddle chunks. Returns nothing if the stream is well-formed.
+std::optional<uint64_t> findInvalidUtf8(std::istream &stream);
+
+} // namespace lexer
+
+#endif
@@ -1,48 +1,735 @@
+#include "../cache/function_cache.hpp"
+#include "../codegen/asm_printer.hpp"
+#include "../codegen/codegen.hpp"
+#include "../codegen/elf_writer.hpp"
+#include "../codegen/encoder.hpp"
+#include "../codegen/peephole.hpp"
+#include "../interp/compiler.hpp"
+#include "../interp/interpreter.hpp"
+#include "../jit/jit.hpp"
+#include "../ir/ir.hpp"
+#include "../ir/lowering.hpp"
+#include "../lexer/include_scanner.hpp"
 #include "../lexer/scanner.hpp"
 #include "../lexer/tokeniser.hpp"
+#include "../lexer/utf8.hpp"
+#include "../opt/pass_manager.hpp"
+#include "../parser/parser.hpp"
+#include "../profile/profile.hpp"
+#include "../runtime/runtime.hpp"
+#include "../sema/analyser.hpp"
+#include "../sema/layout.hpp"
+#include "../sema/types.hpp"
+#include "../support/thread_pool.hpp"
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <fcntl.h>
 #include <filesystem>
 #include <format>
 #include <fstream>
+#include <functional>
 #include <iostream>
+#include <optional>
 #include <ostream>
+#include <set>
+#include <sys/resource.h>
+#include <unistd.h>
+#include <vector>
 
 enum class Mode {
   LEXER,
   PARSER,
+  SEMA,
+  LAYOUT_REPORT,
+  IR,
+  CODEGEN,
+  OBJECT,
+  EXECUTABLE,
+  RUN,
+  RUN_BENCH,
+  JIT,
+  JIT_BENCH,
+  LOOP_BENCH,
+  IO_BENCH,
+  PGO_BENCH,
+  DEPENDENCIES,
+  DEPENDENCIES_JSON,
 };
 
+static int64_t microsecondsSince(std::chrono::steady_clock::time_point start) {
+  return std::chrono::duration_cast<std::chrono::microseconds>(
+             std::chrono::steady_clock::now() - start)
+      .count();
+}
+
+static bool writeObject(const codegen::MachineModule &machine,
+                        const std::filesystem::path &path) {
+  codegen::Encoder encoder{machine};
+  codegen::ObjectCode code{encoder.encode()};
+  std::ofstream objectFile(path, std::ios::binary);
+  if (!objectFile.is_open())
+    return false;
+  codegen::writeElfObject(objectFile, machine, code);
+  return static_cast<bool>(objectFile);
+}
+
+// Runs an executable with stdin read from `programInput` and stdout sent to
+// `programOutput`. Returns the run time.
+static int64_t runExecutable(const std::filesystem::path &executable,
+                             const std::string &programInput,
+                             const std::string &programOutput) {
+  auto start{std::chrono::steady_clock::now()};
+  std::system(std::format("'{}' < '{}' > '{}'", executable.string(),
+                          programInput, programOutput)
+                  .c_str());
+  return microsecondsSince(start);
+}
+
+// Runs loaded JIT code with stdin read from `programInput` and stdout
+// discarded. Returns the run time, or -1 if the redirection failed.
+static int64_t runRedirected(jit::Jit &jit, const std::string &programInput) {
+  std::fflush(stdout);
+  int savedStdin{dup(0)};
+  int savedStdout{dup(1)};
+  int input{open(programInput.c_str(), O_RDONLY)};
+  int output{open("/dev/null", O_WRONLY)};
+  if (input < 0 || output < 0) {
+    std::cout << "Cannot open program input!" << std::endl;
+    return -1;
+  }
+  dup2(input, 0);
+  dup2(output, 1);
+
+  auto start{std::chrono::steady_clock::now()};
+  jit.run();
+  std::fflush(stdout);
+  int64_t runUs{microsecondsSince(start)};
+
+  dup2(savedStdin, 0);
+  dup2(savedStdout, 1);
+  for (int fd : {savedStdin, savedStdout, input, output})
+    close(fd);
+  return runUs;
+}
+
+// The best time out of `runs` runs of the JIT-compiled program on
+// `programInput`, or -1 if it cannot be loaded or run. Every run needs
+// fresh globals, so the code is loaded each time; `codeSize` is set to the
+// size of the code loaded.
+static int64_t timeJit(const codegen::MachineModule &machine,
+                       const std::string &programInput, int runs,
+                       size_t &codeSize) {
+  int64_t best{INT64_MAX};
+  for (int run = 0; run < runs; run++) {
+    jit::Jit jit{machine};
+    if (!jit.load())
+      return -1;
+    int64_t runUs{runRedirected(jit, programInput)};
+    if (runUs < 0)
+      return -1;
+    best = std::min(best, runUs);
+    codeSize = jit.getCodeSize();
+  }
+  return best;
+}
+
+// How many times faster a run of `after` microseconds is than one of
+// `before`, on stderr.
+static void printSpeedup(int64_t before, int64_t after) {
+  std::cerr << std::format("Speedup: {:.2f}x",
+                           after > 0 ? static_cast<double>(before) /
+                                           static_cast<double>(after)
+                                     : 0.0)
+            << std::endl;
+}
+
+// Runs the program in-process through the JIT and then as an executable
+// linked by the system toolchain against the runtime library. Both read
+// `programInput` and have their output discarded; the time spent in each
+// step is reported on stderr.
+static int benchmarkJit(const codegen::MachineModule &machine,
+                        const std::string &programInput, int64_t compileUs) {
+  auto start{std::chrono::steady_clock::now()};
+  jit::Jit jit{machine};
+  if (!jit.load())
+    return -1;
+  int64_t loadUs{microsecondsSince(start)};
+  int64_t runUs{runRedirected(jit, programInput)};
+  if (runUs < 0)
+    return -1;
+
+  std::cerr << std::format("JIT: compile {} us, load {} us, run {} us, "
+                           "total {} us ({} bytes of code)",
+                           compileUs, loadUs, runUs,
+                           compileUs + loadUs + runUs, jit.getCodeSize())
+            << std::endl;
+
+  std::filesystem::path directory{std::filesystem::temp_directory_path() /
+                                  std::format("c-compiler-{}", getpid())};
+  std::filesystem::create_directories(directory);
+  std::filesystem::path object{directory / "program.o"};
+  std::filesystem::path executable{directory / "program"};
+
+  start = std::chrono::steady_clock::now();
+  writeObject(machine, object);
+  int64_t objectUs{microsecondsSince(start)};
+
+  start = std::chrono::steady_clock::now();
+  bool linked{runtime::link(executable, object)};
+  int64_t linkUs{microsecondsSince(start)};
+
+  int64_t aotRunUs{
+      linked ? runExecutable(executable, programInput, "/dev/null") : 0};
+  std::filesystem::remove_all(directory);
+
+  if (!linked) {
+    std::cerr << "AOT: link failed" << std::endl;
+    return -1;
+  }
+  std::cerr << std::format("AOT: compile {} us, object {} us, link {} us, "
+                           "run {} us, total {} us",
+                           compileUs, objectUs, linkUs, aotRunUs,
+                           compileUs + objectUs + linkUs + aotRunUs)
+            << std::endl;
+  return 0;
+}
+
+// Links the program against the runtime library and against the
+// minic-stdlib.h next to the source, and runs both on `programInput`: the
+// best run time out of a few and the output throughput of each, on stderr.
+static int benchmarkIo(const codegen::MachineModule &machine,
+                       const std::filesystem::path &source,
+                       const std::string &programInput) {
+  constexpr int RUNS = 5;
+  std::filesystem::path header{source.parent_path() / "minic-stdlib.h"};
+  if (!std::filesystem::exists(header)) {
+    std::cerr << "No minic-stdlib.h next to the source to compare with"
+              << std::endl;
+    return -1;
+  }
+
+  std::filesystem::path directory{std::filesystem::temp_directory_path() /
+                                  std::format("c-compiler-{}", getpid())};
+  std::filesystem::create_directories(directory);
+  std::filesystem::path object{directory / "program.o"};
+  writeObject(machine, object);
+
+  int64_t times[2];
+  std::string outputs[2];
+  for (int i = 0; i < 2; i++) {
+    std::filesystem::path executable{directory / std::format("program{}", i)};
+    if (!runtime::link(executable, object,
+                       i == 0 ? std::filesystem::path{} : header)) {
+      std::cerr << "Link failed" << std::endl;
+      std::filesystem::remove_all(directory);
+      return -1;
+    }
+    std::filesystem::path output{directory / std::format("output{}", i)};
+    runExecutable(executable, programInput, output.string());
+    std::ifstream outputFile(output, std::ios::binary);
+    outputs[i].assign(std::istreambuf_iterator<char>{outputFile}, {});
+
+    int64_t best{INT64_MAX};
+    for (int run = 0; run < RUNS; run++)
+      best = std::min(best,
+                      runExecutable(executable, programInput, "/dev/null"));
+    times[i] = best;
+    // bytes per microsecond are megabytes per second
+    std::cerr << std::format("{}: run {} us, {} bytes of output ({:.1f} MB/s)",
+                             i == 0 ? "Runtime" : "Header ", best,
+                             outputs[i].size(),
+                             best > 0 ? static_cast<double>(outputs[i].size()) /
+                                            static_cast<double>(best)
+                                      : 0.0)
+              << std::endl;
+  }
+  std::filesystem::remove_all(directory);
+
+  if (outputs[0] != outputs[1]) {
+    std::cerr << "Outputs differ" << std::endl;
+    return -1;
+  }
+  printSpeedup(times[1], times[0]);
+  return 0;
+}
+
+// Compiles the program at `level` with and without the loop passes and
+// compares the JIT-compiled code of both: the best run time out of a few and
+// the code size, on stderr.
+static int benchmarkLoops(const ast::Program &program,
+                          sema::LayoutEngine &layouts, int level,
+                          const std::string &programInput) {
+  constexpr int RUNS = 5;
+  int64_t times[2];
+  for (bool loopPasses : {false, true}) {
+    ir::Module module;
+    ir::Lowering lowering{module, layouts};
+    lowering.lower(program);
+    opt::PassManager passes;
+    opt::addPipeline(passes, level, loopPasses);
+    passes.run(module);
+
+    codegen::MachineModule machine;
+    codegen::CodeGenerator generator{module, machine};
+    generator.generate();
+
+    size_t codeSize{0};
+    int64_t best{timeJit(machine, programInput, RUNS, codeSize)};
+    if (best < 0)
+      return -1;
+    times[loopPasses] = best;
+    std::cerr << std::format("Loop passes {}: {} instructions, run {} us ({} "
+                             "bytes of code)",
+                             loopPasses ? "on " : "off",
+                             opt::instructionCount(module), best, codeSize)
+              << std::endl;
+  }
+
+  printSpeedup(times[0], times[1]);
+  return 0;
+}
+
+// Trains the program on `programInput` with an instrumented build run by the
+// JIT, then compiles it at `level` without and with the profile and compares
+// the JIT-compiled code of both: the best run time out of a few and the code
+// size, on stderr.
+static int benchmarkProfile(const ast::Program &program,
+                            sema::LayoutEngine &layouts, int level,
+                            const std::string &programInput) {
+  constexpr int RUNS = 5;
+  std::filesystem::path file{std::filesystem::temp_directory_path() /
+                             std::format("c-compiler-{}.profile", getpid())};
+  auto compile{[&](codegen::MachineModule &machine, bool instrumented,
+                   bool profiled) {
+    ir::Module module;
+    ir::Lowering lowering{module, layouts};
+    lowering.lower(program);
+    if (profiled && !profile::annotate(module, file))
+      return false;
+    if (instrumented)
+      profile::instrument(module, file);
+    opt::PassManager passes;
+    opt::addPipeline(passes, level);
+    passes.run(module);
+
+    codegen::CodeGenerator generator{module, machine};
+    generator.generate();
+    return true;
+  }};
+
+  {
+    codegen::MachineModule machine;
+    compile(machine, true, false);
+    jit::Jit jit{machine};
+    if (!jit.load() || runRedirected(jit, programInput) < 0)
+      return -1;
+    if (!profile::flush()) {
+      std::cerr << "Cannot write the profile" << std::endl;
+      return -1;
+    }
+  }
+
+  int64_t times[2];
+  for (bool profiled : {false, true}) {
+    codegen::MachineModule machine;
+    if (!compile(machine, false, profiled)) {
+      std::filesystem::remove(file);
+      return -1;
+    }
+
+    size_t codeSize{0};
+    int64_t best{timeJit(machine, programInput, RUNS, codeSize)};
+    if (best < 0) {
+      std::filesystem::remove(file);
+      return -1;
+    }
+    times[profiled] = best;
+    std::cerr << std::format("Profile {}: run {} us ({} bytes of code)",
+                             profiled ? "on " : "off", best, codeSize)
+              << std::endl;
+  }
+  std::filesystem::remove(file);
+
+  printSpeedup(times[0], times[1]);
+  return 0;
+}
+
+// The high-water mark of the compiler's resident memory, in megabytes.
+static uint64_t peakMemory() {
+  rusage usage{};
+  getrusage(RUSAGE_SELF, &usage);
+  return static_cast<uint64_t>(usage.ru_maxrss) / 1024;
+}
+
+// -max-memory: whether the peak resident memory so far is within `limit`
+// megabytes, if there is a limit.
+static bool withinMemoryLimit(uint64_t limit) {
+  if (limit == 0 || peakMemory() <= limit)
+    return true;
+  std::cout << std::format("Memory limit of {} MB exceeded (peak {} MB)!",
+                           limit, peakMemory())
+            << std::endl;
+  return false;
+}
+
+// Compiles the file to assembly a function at a time (-stream), so that
+// memory use is bounded by the largest function rather than by the file. A
+// first pass reads only the declarations, skipping the function bodies, so
+// that calls to functions further down the file resolve. The second parses
+// every function again and checks, lowers, optimises and prints it before
+// reading on, releasing its AST, IR and machine code. Only the passes that
+// look at nothing but the function itself run. The declarations and the
+// string literals are all that is kept for the whole file.
+static int compileStreaming(const std::filesystem::path &source,
+                            std::ostream &output, int level, bool optReport,
+                            uint64_t maxMemory) {
+  std::ifstream declarationFile(source);
+  lexer::Scanner declarationScanner{declarationFile};
+  lexer::Tokeniser declarationTokeniser{declarationScanner};
+  parser::Parser declarationParser{declarationTokeniser};
+  declarationParser.skipBodies();
+  std::unique_ptr<ast::Program> program{declarationParser.parse()};
+  int parseErrors{declarationTokeniser.getErrorCount() +
+                  declarationParser.getErrorCount()};
+  if (parseErrors != 0) {
+    std::cout << std::format("Parsing: failed ({} errors)", parseErrors)
+              << std::endl;
+    return -1;
+  }
+
+  sema::TypeTable types;
+  sema::Analyser analyser{types};
+  analyser.declare(*program);
+  auto checked{[&] {
+    if (analyser.getErrorCount() == 0)
+      return true;
+    std::cout << std::format("Semantic analysis: failed ({} errors)",
+                             analyser.getErrorCount())
+              << std::endl;
+    return false;
+  }};
+  if (!checked())
+    return -1;
+
+  sema::LayoutEngine layouts;
+  ir::Module module;
+  ir::Lowering lowering{module, layouts};
+  lowering.declare(*program);
+  opt::PassManager passes;
+  opt::addFunctionPipeline(passes, level);
+  codegen::MachineModule machine;
+  codegen::CodeGenerator generator{module, machine};
+  output << "\t.text\n";
+
+  std::ifstream file(source);
+  lexer::Scanner scanner{file};
+  lexer::Tokeniser tokeniser{scanner};
+  parser::Parser parser{tokeniser};
+  ast::Program includes;
+  parser.parseIncludes(includes);
+  while (true) {
+    // structs and globals were all taken from the first pass
+    ast::Program declaration;
+    bool more{parser.parseDeclaration(declaration)};
+    parseErrors = tokeniser.getErrorCount() + parser.getErrorCount();
+    if (parseErrors != 0) {
+      std::cout << std::format("Parsing: failed ({} errors)", parseErrors)
+                << std::endl;
+      return -1;
+    }
+    if (!more)
+      break;
+    if (declaration.functions.empty())
+      continue;
+
+    ast::FunDecl &fun{*declaration.functions.front()};
+    analyser.checkDefinition(fun);
+    if (!checked())
+      return -1;
+    ir::Function &function{*lowering.lowerFunction(fun)};
+    passes.run(function);
+
+    uint32_t index{module.functionIndex.at(fun.name)};
+    generator.declareStrings();
+    machine.symbols[index].defined = true;
+    codegen::printDefinition(output, machine,
+                             generator.generate(function, index));
+    function.releaseBody();
+    if (!withinMemoryLimit(maxMemory))
+      return -1;
+  }
+  codegen::printData(output, machine);
+
+  if (optReport)
+    passes.report(std::cerr);
+  return 0;
+}
+
+static std::string makeEscape(std::string_view path) {
+  std::string escaped;
+  for (char c : path) {
+    if (c == ' ' || c == '#')
+      escaped += '\\';
+    escaped += c;
+    if (c == '$')
+      escaped += '$';
+  }
+  return escaped;
+}
+
+// Control characters may not appear raw in a JSON string.
+static std::string jsonEscape(std::string_view text) {
+  std::string escaped;
+  for (char c : text) {
+    if (static_cast<unsigned char>(c) < 0x20) {
+      escaped += std::format("\\u{:04x}", static_cast<unsigned char>(c));
+      continue;
+    }
+    if (c == '"' || c == '\\')
+      escaped += '\\';
+    escaped += c;
+  }
+  return escaped;
+}
+
+// Writes the files each source depends on through #include directives,
+// followed transitively, as Makefile rules or as JSON. System headers are
+// left out, as with cc -MM. The sources are scanned in parallel and only
+// for their directives, never tokenised.
+static int scanDependencies(const std::vector<std::string> &sources,
+                            bool json, unsigned threads) {
+  std::vector<std::vector<std::string>> dependencies(sources.size());
+  std::vector<std::string> errors(sources.size());
+  std::vector<std::function<void()>> tasks;
+  for (size_t i = 0; i < sources.size(); i++)
+    tasks.push_back([&, i] {
+      std::vector<std::filesystem::path> worklist{sources[i]};
+      std::set<std::filesystem::path> seen{worklist.front()};
+      while (!worklist.empty()) {
+        std::filesystem::path file{std::move(worklist.back())};
+        worklist.pop_back();
+        std::ifstream in(file, std::ios::binary);
+        if (!in.is_open()) {
+          errors[i] = std::format("File {} not found!", file.string());
+          return;
+        }
+        std::string text{std::istreambuf_iterator<char>{in}, {}};
+        for (const lexer::Include &include : lexer::scanIncludes(text)) {
+          if (include.system)
+            continue;
+          std::filesystem::path dependency{
+              (file.parent_path() / include.path).lexically_normal()};
+          if (seen.insert(dependency).second) {
+            dependencies[i].push_back(dependency.string());
+            worklist.push_back(std::move(dependency));
+          }
+        }
+      }
+    });
+  support::ThreadPool pool{threads};
+  pool.run(std::move(tasks));
+
+  bool failed{false};
+  for (const std::string &error : errors)
+    if (!error.empty()) {
+      std::cout << error << std::endl;
+      failed = true;
+    }
+  if (failed)
+    return -1;
+
+  if (json)
+    std::cout << "[";
+  for (size_t i = 0; i < sources.size(); i++) {
+    if (json) {
+      std::cout << std::format("{}\n  {{\"source\": \"{}\", "
+                               "\"dependencies\": [",
+                               i == 0 ? "" : ",", jsonEscape(sources[i]));
+      for (size_t j = 0; j < dependencies[i].size(); j++)
+        std::cout << std::format("{}\"{}\"", j == 0 ? "" : ", ",
+                                 jsonEscape(dependencies[i][j]));
+      std::cout << "]}";
+      continue;
+    }
+    std::filesystem::path object{sources[i]};
+    object = object.filename().replace_extension(".o");
+    std::cout << std::format("{}: {}", makeEscape(object.string()),
+                             makeEscape(sources[i]));
+    for (const std::string &dependency : dependencies[i])
+      std::cout << std::format(" \\\n  {}", makeEscape(dependency));
+    std::cout << '\n';
+  }
+  if (json)
+    std::cout << "\n]\n";
+  std::cout << std::flush;
+  return 0;
+}
+
 void usage() {
   std::cout << std::format(
-      "Usage: bazel run //main:c-compiler -- <mode> <inputfile>");
+      "Usage: bazel run //main:c-compiler -- <mode> <inputfile> [outputfile]\n"
+      "       [-O0|-O1|-O2] [-opt-report] [-j<threads>]\n"
+      "       [-profile-generate[=<file>]] [-profile-use[=<file>]]\n"
+      "       [-cache[=<directory>]] [-stream] [-max-memory=<megabytes>]\n"
+      "       [-peephole-stats]\n"
+      "Modes: -lexer, -parser, -sema, -layout-report, -ir, -codegen,\n"
+      "       -object, -executable, -run, -run-bench, -jit, -jit-bench,\n"
+      "       -loop-bench, -io-bench, -pgo-bench,\n"
+      "       -M, -M-json <inputfile>...\n");
 }
 
 int main(int argc, char *argv[]) {
 
-  if (argc != 3) {
+  // options may follow the mode anywhere among the file arguments
+  int optLevel{0};
+  bool optReport{false};
+  bool peepholeStats{false};
+  unsigned threads{support::ThreadPool::defaultThreads()};
+  // profile files, empty unless asked for
+  std::string profileGenerate;
+  std::string profileUse;
+  std::string cacheDirectory;
+  bool stream{false};
+  // no limit unless given
+  uint64_t maxMemory{0};
+  std::vector<std::string> files;
+  for (int i = 2; i < argc; i++) {
+    std::string_view arg{argv[i]};
+    if (arg.size() == 3 && arg.starts_with("-O") && arg[2] >= '0' &&
+        arg[2] <= '9')
+      optLevel = arg[2] - '0';
+    else if (arg == "-opt-report")
+      optReport = true;
+    else if (arg == "-peephole-stats")
+      peepholeStats = true;
+    else if (arg.size() > 2 && arg.starts_with("-j") &&
+             std::ranges::all_of(arg.substr(2), [](char c) {
+               return c >= '0' && c <= '9';
+             }))
+      threads = static_cast<unsigned>(std::stoul(std::string{arg.substr(2)}));
+    else if (arg == "-profile-generate")
+      profileGenerate = profile::DEFAULT_FILE;
+    else if (arg.starts_with("-profile-generate="))
+      profileGenerate = arg.substr(arg.find('=') + 1);
+    else if (arg == "-profile-use")
+      profileUse = profile::DEFAULT_FILE;
+    else if (arg.starts_with("-profile-use="))
+      profileUse = arg.substr(arg.find('=') + 1);
+    else if (arg == "-cache")
+      cacheDirectory = cache::DEFAULT_DIRECTORY;
+    else if (arg.starts_with("-cache="))
+      cacheDirectory = arg.substr(arg.find('=') + 1);
+    else if (arg == "-stream")
+      stream = true;
+    else if (arg.starts_with("-max-memory=") &&
+             arg.size() > std::string_view{"-max-memory="}.size() &&
+             std::ranges::all_of(arg.substr(arg.find('=') + 1), [](char c) {
+               return c >= '0' && c <= '9';
+             }))
+      maxMemory = std::stoull(std::string{arg.substr(arg.find('=') + 1)});
+    else
+      files.emplace_back(arg);
+  }
+
+  std::string_view pass{argc < 2 ? "" : argv[1]};
+  bool dependencies{pass == "-M" || pass == "-M-json"};
+  if (argc < 2 || files.empty() ||
+      (!dependencies && files.size() != 1 && files.size() != 2)) {
     usage();
     return -1;
   }
 
   Mode mode;
-  std::string_view pass{argv[1]};
-
-  if (pass == "-lexer")
+  if (pass == "-M")
+    mode = Mode::DEPENDENCIES;
+  else if (pass == "-M-json")
+    mode = Mode::DEPENDENCIES_JSON;
+  else if (pass == "-lexer")
     mode = Mode::LEXER;
   else if (pass == "-parser")
     mode = Mode::PARSER;
+  else if (pass == "-sema")
+    mode = Mode::SEMA;
+  else if (pass == "-layout-report")
+    mode = Mode::LAYOUT_REPORT;
+  else if (pass == "-ir")
+    mode = Mode::IR;
+  else if (pass == "-codegen")
+    mode = Mode::CODEGEN;
+  else if (pass == "-object" && files.size() == 2)
+    mode = Mode::OBJECT;
+  else if (pass == "-executable" && files.size() == 2)
+    mode = Mode::EXECUTABLE;
+  else if (pass == "-run")
+    mode = Mode::RUN;
+  else if (pass == "-run-bench")
+    mode = Mode::RUN_BENCH;
+  else if (pass == "-jit")
+    mode = Mode::JIT;
+  else if (pass == "-jit-bench")
+    mode = Mode::JIT_BENCH;
+  else if (pass == "-loop-bench")
+    mode = Mode::LOOP_BENCH;
+  else if (pass == "-io-bench")
+    mode = Mode::IO_BENCH;
+  else if (pass == "-pgo-bench")
+    mode = Mode::PGO_BENCH;
   else {
     usage();
     return -1;
   }
 
-  std::filesystem::path inputPath = std::filesystem::path(argv[2]);
+  if (mode == Mode::DEPENDENCIES || mode == Mode::DEPENDENCIES_JSON)
+    return scanDependencies(files, mode == Mode::DEPENDENCIES_JSON, threads);
+
+  std::filesystem::path inputPath = std::filesystem::path(files[0]);
   std::ifstream inputFile(inputPath);
+  auto compileStart{std::chrono::steady_clock::now()};
 
   if (!inputFile.is_open()) {
     std::cout << "File not found!" << std::endl;
     return -1;
   }
 
+  // the lexer takes the source for UTF-8 once it has been checked in full
+  if (std::optional<uint64_t> invalid{lexer::findInvalidUtf8(inputFile)}) {
+    std::cout << std::format("Encoding error: invalid UTF-8 at byte {}!",
+                             *invalid)
+              << std::endl;
+    return -1;
+  }
+  inputFile.clear();
+  inputFile.seekg(0);
+
+  // assembly goes to the output file if one is given, stdout otherwise
+  std::ofstream outputFile;
+  if (mode == Mode::CODEGEN && files.size() == 2) {
+    outputFile.open(files[1]);
+    if (!outputFile.is_open()) {
+      std::cout << "Cannot open output file!" << std::endl;
+      return -1;
+    }
+  }
+  std::ostream &output{files.size() == 2 ? outputFile : std::cout};
+
+  if (stream) {
+    if (mode != Mode::CODEGEN) {
+      std::cout << "-stream only works with -codegen!" << std::endl;
+      return -1;
+    }
+    int result{compileStreaming(inputPath, output, optLevel, optReport,
+                                maxMemory)};
+    if (peepholeStats)
+      codegen::printPeepholeStatistics(std::cerr);
+    if (maxMemory != 0)
+      std::cerr << std::format("Peak memory: {} MB", peakMemory())
+                << std::endl;
+    return result;
+  }
+
   lexer::Scanner scanner{inputFile};
 
   lexer::Tokeniser tokeniser{scanner};
@@ -63,5 +750,215 @@ int main(int argc, char *argv[]) {
     return tokeniser.getErrorCount() == 0 ? 0 : -1;
   }
 
+  parser::Parser parser{tokeniser};
+  std::unique_ptr<ast::Program> program{parser.parse()};
+  int parseErrors{tokeniser.getErrorCount() + parser.getErrorCount()};
+
+  if (mode == Mode::PARSER) {
+    if (parseErrors == 0)
+      std::cout << "Parsing: pass" << std::endl;
+    else
+      std::cout << std::format("Parsing: failed ({} errors)", parseErrors)
+                << std::endl;
+    return parseErrors == 0 ? 0 : -1;
+  }
+
+  if (parseErrors != 0) {
+    std::cout << std::format("Parsing: failed ({} errors)", parseErrors)
+              << std::endl;
+    return -1;
+  }
+
+  sema::TypeTable types;
+  sema::Analyser analyser{types};
+
+  auto start{std::chrono::steady_clock::now()};
+  analyser.analyse(*program);
+  auto elapsed{std::chrono::duration_cast<std::chrono::microseconds>(
+      std::chrono::steady_clock::now() - start)};
+
+  if (analyser.getErrorCount() != 0) {
+    std::cout << std::format("Semantic analysis: failed ({} errors)",
+                             analyser.getErrorCount())
+              << std::endl;
+    return -1;
+  }
+
+  if (mode == Mode::SEMA) {
+    std::cout << std::format("Semantic analysis: pass ({} us, {} types)",
+                             elapsed.count(), types.size())
+              << std::endl;
+    return 0;
+  }
+
+  sema::LayoutEngine layouts;
+
+  if (mode == Mode::LAYOUT_REPORT) {
+    for (const ast::StructDeclPtr &decl : program->structs) {
+      layouts.report(std::cout, decl->type);
+      std::cout << std::endl;
+    }
+    return 0;
+  }
+
+  if (mode == Mode::LOOP_BENCH)
+    return benchmarkLoops(*program, layouts, std::max(optLevel, 2),
+                          files.size() == 2 ? files[1] : "/dev/null");
+
+  if (mode == Mode::PGO_BENCH)
+    return benchmarkProfile(*program, layouts, std::max(optLevel, 2),
+                            files.size() == 2 ? files[1] : "/dev/null");
+
+  // With a cache, only the functions missing from it are compiled, with
+  // what they depend on. Profiles number and weigh the whole program, so
+  // they bypass it, as do the modes that work on the IR.
+  std::optional<cache::FunctionCache> functionCache;
+  std::vector<bool> selected;
+  if (!cacheDirectory.empty() && profileGenerate.empty() &&
+      profileUse.empty() && mode != Mode::IR && mode != Mode::RUN &&
+      mode != Mode::RUN_BENCH) {
+    functionCache.emplace(cacheDirectory, *program,
+                          std::format("-O{}", optLevel));
+    selected = functionCache->lookup();
+  }
+
+  ir::Module module;
+  module.partial = functionCache.has_value();
+  ir::Lowering lowering{module, layouts};
+  lowering.lower(*program, selected);
+
+  // profiles are made and read against the module as lowered
+  if (!profileUse.empty())
+    profile::annotate(module, profileUse);
+  if (!profileGenerate.empty())
+    profile::instrument(module, profileGenerate);
+
+  // functions are optimised and compiled in parallel once lowered
+  support::ThreadPool pool{threads};
+  opt::PassManager passes;
+  opt::addPipeline(passes, optLevel);
+  passes.run(module, &pool);
+  // the report goes to stderr so that it can accompany any output mode
+  if (optReport) {
+    passes.report(std::cerr);
+    if (functionCache)
+      std::cerr << std::format("Cache: {} of {} functions reused",
+                               functionCache->getReusedCount(),
+                               program->functions.size())
+                << std::endl;
+  }
+
+  if (mode == Mode::IR) {
+    ir::print(std::cout, module);
+    return 0;
+  }
+
+  if (mode == Mode::RUN || mode == Mode::RUN_BENCH) {
+    interp::Program bytecode;
+    interp::Compiler compiler{module, bytecode};
+    compiler.compile();
+    if (compiler.getErrorCount() > 0)
+      return -1;
+
+    interp::Interpreter interpreter{bytecode};
+    auto start{std::chrono::steady_clock::now()};
+    int64_t result{interpreter.run(mode == Mode::RUN_BENCH)};
+    auto elapsed{std::chrono::duration_cast<std::chrono::microseconds>(
+        std::chrono::steady_clock::now() - start)};
+    std::cout << std::flush;
+    if (!profile::flush())
+      std::cout << "Cannot write profile!" << std::endl;
+    if (interpreter.getErrorCount() > 0)
+      return -1;
+
+    // statistics go to stderr to keep the program's own output intact
+    if (mode == Mode::RUN_BENCH) {
+      double seconds{static_cast<double>(elapsed.count()) / 1e6};
+      uint64_t count{interpreter.getExecutedCount()};
+      std::cerr << std::format(
+                       "Interpreter: {} instructions in {} us ({:.1f} M/s)",
+                       count, elapsed.count(),
+                       seconds > 0 ? static_cast<double>(count) / seconds / 1e6
+                                   : 0.0)
+                << std::endl;
+    }
+    return static_cast<int>(result);
+  }
+
+  codegen::MachineModule machine;
+  if (functionCache)
+    for (size_t i = 0; i < program->functions.size(); i++)
+      if (functionCache->isCached(i))
+        module.functions[module.functionIndex.at(program->functions[i]->name)]
+            ->external = true;
+  codegen::CodeGenerator generator{module, machine};
+  generator.generate(&pool);
+  if (peepholeStats)
+    codegen::printPeepholeStatistics(std::cerr);
+  if (maxMemory != 0)
+    std::cerr << std::format("Peak memory: {} MB", peakMemory()) << std::endl;
+  if (!withinMemoryLimit(maxMemory))
+    return -1;
+  if (functionCache) {
+    codegen::MachineModule compiled{std::move(machine)};
+    machine = {};
+    functionCache->link(compiled, machine);
+  }
+
+  if (mode == Mode::JIT_BENCH)
+    return benchmarkJit(machine, files.size() == 2 ? files[1] : "/dev/null",
+                        microsecondsSince(compileStart));
+
+  if (mode == Mode::IO_BENCH)
+    return benchmarkIo(machine, inputPath,
+                       files.size() == 2 ? files[1] : "/dev/null");
+
+  // executables get the runtime library linked in
+  if (mode == Mode::EXECUTABLE) {
+    std::filesystem::path object{files[1] + ".o"};
+    bool linked{writeObject(machine, object) &&
+                runtime::link(files[1], object)};
+    std::filesystem::remove(object);
+    if (!linked) {
+      std::cout << "Linking failed!" << std::endl;
+      return -1;
+    }
+    return 0;
+  }
+
+  if (mode == Mode::JIT) {
+    jit::Jit jit{machine};
+    if (!jit.load())
+      return -1;
+    int result{jit.run()};
+    std::fflush(stdout);
+    if (!profile::flush())
+      std::cout << "Cannot write profile!" << std::endl;
+    return result;
+  }
+
+  if (mode == Mode::OBJECT) {
+    auto start{std::chrono::steady_clock::now()};
+    codegen::Encoder encoder{machine};
+    codegen::ObjectCode code{encoder.encode()};
+
+    std::ofstream objectFile(files[1], std::ios::binary);
+    if (!objectFile.is_open()) {
+      std::cout << "Cannot open output file!" << std::endl;
+      return -1;
+    }
+    codegen::writeElfObject(objectFile, machine, code);
+    objectFile.close();
+
+    auto elapsed{std::chrono::duration_cast<std::chrono::microseconds>(
+        std::chrono::steady_clock::now() - start)};
+    std::cout << std::format("Object: {} bytes of code, {} relocations ({} us)",
+                             code.text.size(), code.relocations.size(),
+                             elapsed.count())
+              << std::endl;
+    return 0;
+  }
+
+  codegen::printAssembly(output, machine);
   return 0;
 }
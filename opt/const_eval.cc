@@ -0,0 +1,250 @@
+#include "const_eval.hpp"
+#include "fold.hpp"
+#include <algorithm>
+#include <format>
+#include <ostream>
+#include <span>
+
+namespace opt {
+
+using ir::BlockId;
+using ir::Op;
+using ir::Type;
+using ir::Value;
+
+static bool isInteger(Type type) {
+  return type == Type::I8 || type == Type::I32;
+}
+
+// Instructions a pure function may run besides calls.
+static bool isComputation(const ir::Inst &inst) {
+  if (inst.type == Type::VEC || inst.type == Type::PTR)
+    return false;
+  switch (inst.op) {
+  case Op::NOP:
+  case Op::CONST:
+  case Op::PARAM:
+  case Op::ADD:
+  case Op::SUB:
+  case Op::MUL:
+  case Op::DIV:
+  case Op::REM:
+  case Op::EQ:
+  case Op::NE:
+  case Op::LT:
+  case Op::LE:
+  case Op::GT:
+  case Op::GE:
+  case Op::SEXT:
+  case Op::TRUNC:
+  case Op::COPY:
+  case Op::PHI:
+  case Op::BR:
+  case Op::CONDBR:
+  case Op::RET:
+    return true;
+  default:
+    return false;
+  }
+}
+
+// Starts from every defined function with integer parameters and result and
+// drops those running anything else until no more go, so that functions
+// calling each other recursively stay pure.
+void ConstantEvaluation::findPure() {
+  size_t count{module->functions.size()};
+  pure.assign(count, false);
+  for (size_t f = 0; f < count; f++) {
+    const ir::Function &function{*module->functions[f]};
+    pure[f] = !function.external && isInteger(function.returnType) &&
+              std::ranges::all_of(function.params, isInteger);
+  }
+
+  bool changed{true};
+  while (changed) {
+    changed = false;
+    for (size_t f = 0; f < count; f++) {
+      if (!pure[f])
+        continue;
+      const ir::Function &function{*module->functions[f]};
+      for (const ir::Block &block : function.blocks)
+        for (Value value : block.insts) {
+          const ir::Inst &inst{function.insts[value]};
+          if (inst.op == Op::CALL ? pure[inst.imm] : isComputation(inst))
+            continue;
+          pure[f] = false;
+          changed = true;
+        }
+    }
+  }
+}
+
+std::optional<int64_t>
+ConstantEvaluation::evaluate(uint32_t callee, const std::vector<int64_t> &args,
+                             int depth) {
+  auto found{memo[callee].find(args)};
+  if (found != memo[callee].end())
+    return found->second;
+  if (depth == MAX_DEPTH)
+    return std::nullopt;
+
+  const ir::Function &function{*module->functions[callee]};
+  std::vector<int64_t> values(function.insts.size());
+  std::vector<int64_t> incoming;
+  std::vector<int64_t> callArgs;
+  BlockId from{ir::NO_BLOCK};
+  BlockId block{0};
+  for (;;) {
+    const ir::Block &current{function.blocks[block]};
+    // the phis of a block take their values from the edge together
+    size_t edge{0};
+    if (from != ir::NO_BLOCK)
+      edge = static_cast<size_t>(std::ranges::find(current.preds, from) -
+                                 current.preds.begin());
+    size_t phis{0};
+    incoming.clear();
+    while (phis < current.insts.size() &&
+           function.insts[current.insts[phis]].op == Op::PHI)
+      incoming.push_back(
+          values[function.extraOperands(current.insts[phis++])[edge]]);
+    for (size_t i = 0; i < phis; i++)
+      values[current.insts[i]] = incoming[i];
+
+    for (size_t i = phis; i < current.insts.size(); i++) {
+      if (++steps > MAX_STEPS)
+        return std::nullopt;
+      Value value{current.insts[i]};
+      const ir::Inst &inst{function.insts[value]};
+      int64_t a{inst.a != ir::NO_VALUE ? values[inst.a] : 0};
+      int64_t b{inst.b != ir::NO_VALUE ? values[inst.b] : 0};
+      int64_t &result{values[value]};
+      switch (inst.op) {
+      case Op::CONST:
+        result = inst.imm;
+        break;
+      case Op::PARAM:
+        result = args[inst.imm];
+        break;
+      case Op::ADD:
+      case Op::SUB:
+      case Op::MUL:
+      case Op::DIV:
+      case Op::REM:
+      case Op::EQ:
+      case Op::NE:
+      case Op::LT:
+      case Op::LE:
+      case Op::GT:
+      case Op::GE: {
+        // a division that traps is left to run time
+        std::optional<int64_t> folded{foldBinary(inst.op, inst.type, a, b)};
+        if (!folded)
+          return std::nullopt;
+        result = *folded;
+        break;
+      }
+      case Op::SEXT:
+      case Op::COPY:
+        // narrow values are already held sign-extended
+        result = a;
+        break;
+      case Op::TRUNC:
+        result = wrap(inst.type, static_cast<uint64_t>(a));
+        break;
+      case Op::CALL: {
+        callArgs.clear();
+        for (Value operand : function.extraOperands(value))
+          callArgs.push_back(values[operand]);
+        std::optional<int64_t> returned{
+            evaluate(static_cast<uint32_t>(inst.imm), callArgs, depth + 1)};
+        if (!returned)
+          return std::nullopt;
+        result = *returned;
+        break;
+      }
+      case Op::BR:
+        from = block;
+        block = current.succs[0];
+        break;
+      case Op::CONDBR:
+        from = block;
+        block = current.succs[a != 0 ? 0 : 1];
+        break;
+      case Op::RET:
+        // falling off the end of the function returns nothing to fold
+        if (inst.a == ir::NO_VALUE)
+          return std::nullopt;
+        memo[callee][args] = a;
+        return a;
+      default:
+        break;
+      }
+    }
+  }
+}
+
+bool ConstantEvaluation::runOnModule(ir::Module &mod) {
+  module = &mod;
+  counts.clear();
+  totalSteps = 0;
+  findPure();
+  memo.assign(mod.functions.size(), {});
+  return Pass::runOnModule(mod);
+}
+
+bool ConstantEvaluation::run(ir::Function &function) {
+  int folded{0};
+  int calls{0};
+  std::vector<int64_t> args;
+  for (const ir::Block &block : function.blocks)
+    for (Value value : block.insts) {
+      ir::Inst &inst{function.insts[value]};
+      if (inst.op != Op::CALL || !pure[inst.imm])
+        continue;
+      std::span<const Value> operands{function.extraOperands(value)};
+      if (!std::ranges::all_of(operands, [&](Value operand) {
+            return function.insts[operand].op == Op::CONST;
+          }))
+        continue;
+      calls++;
+      if (totalSteps >= MAX_TOTAL_STEPS)
+        continue;
+
+      args.clear();
+      for (Value operand : operands)
+        args.push_back(function.insts[operand].imm);
+      uint32_t callee{static_cast<uint32_t>(inst.imm)};
+      steps = 0;
+      std::optional<int64_t> result{evaluate(callee, args, 0)};
+      totalSteps += steps;
+      if (!result) {
+        // not worth trying again with the same budget
+        memo[callee][args] = std::nullopt;
+        continue;
+      }
+      inst.op = Op::CONST;
+      inst.extra = 0;
+      inst.count = 0;
+      inst.imm = *result;
+      folded++;
+    }
+  if (calls > 0)
+    counts.push_back({function.name, {folded, calls}});
+  return folded > 0;
+}
+
+void ConstantEvaluation::report(std::ostream &out) const {
+  int folded{0};
+  int total{0};
+  for (const auto &[function, count] : counts) {
+    out << std::format("const-eval: {}: {} of {} calls with constant "
+                       "arguments folded\n",
+                       function, count.first, count.second);
+    folded += count.first;
+    total += count.second;
+  }
+  out << std::format("const-eval: {} of {} calls folded in {} steps\n",
+                     folded, total, totalSteps);
+}
+
+} // namespace opt
@@ -0,0 +1,53 @@
+#ifndef CONST_EVAL_H
+#define CONST_EVAL_H
+
+#include "pass.hpp"
+#include <cstdint>
+#include <map>
+#include <optional>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace opt {
+
+// Evaluates calls to pure functions with constant arguments at compile time
+// and replaces them with their result. A function is pure when it only
+// computes on integer parameters and returns an integer: no memory, no
+// globals and no calls but to other pure functions, so a run cannot do or
+// see anything outside its own values. Calls are run by a small interpreter
+// over the IR that gives up after MAX_STEPS instructions or MAX_DEPTH
+// nested calls, or on a division that would trap, leaving the call to run
+// time. Results are memoized by function and arguments, which makes naive
+// recursion such as fibonacci linear.
+class ConstantEvaluation : public Pass {
+private:
+  static constexpr uint64_t MAX_STEPS = 1 << 20;
+  static constexpr uint64_t MAX_TOTAL_STEPS = 1 << 24;
+  static constexpr int MAX_DEPTH = 512;
+
+  ir::Module *module{nullptr};
+  std::vector<bool> pure;
+  // per function, results by arguments; failed evaluations hold nothing
+  std::vector<std::map<std::vector<int64_t>, std::optional<int64_t>>> memo;
+  uint64_t steps{0};
+  uint64_t totalSteps{0};
+  // calls folded and calls to pure functions with constant arguments, by
+  // function name
+  std::vector<std::pair<std::string, std::pair<int, int>>> counts;
+
+  void findPure();
+  std::optional<int64_t> evaluate(uint32_t callee,
+                                  const std::vector<int64_t> &args,
+                                  int depth);
+
+public:
+  std::string_view name() const override { return "const-eval"; }
+  bool run(ir::Function &function) override;
+  bool runOnModule(ir::Module &module) override;
+  void report(std::ostream &out) const override;
+};
+
+} // namespace opt
+
+#endif
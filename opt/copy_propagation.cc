@@ -0,0 +1,72 @@
+#include "copy_propagation.hpp"
+#include <algorithm>
+
+namespace opt {
+
+using ir::Op;
+using ir::Value;
+
+Value CopyPropagation::find(Value value) {
+  while (forward[value] != value) {
+    forward[value] = forward[forward[value]];
+    value = forward[value];
+  }
+  return value;
+}
+
+bool CopyPropagation::run(ir::Function &function) {
+  forward.resize(function.insts.size());
+  for (Value value = 0; value < forward.size(); value++)
+    forward[value] = value;
+
+  // forwarding one phi can make another trivial, so iterate to a fixpoint
+  bool changed{true};
+  bool any{false};
+  while (changed) {
+    changed = false;
+    for (const ir::Block &block : function.blocks)
+      for (Value value : block.insts) {
+        if (find(value) != value)
+          continue;
+        const ir::Inst &inst{function.insts[value]};
+
+        Value source{ir::NO_VALUE};
+        if (inst.op == Op::COPY) {
+          source = find(inst.a);
+        } else if (inst.op == Op::PHI) {
+          for (Value operand : function.extraOperands(value)) {
+            Value incoming{find(operand)};
+            if (incoming == value || incoming == source)
+              continue;
+            if (source != ir::NO_VALUE) {
+              source = ir::NO_VALUE;
+              break;
+            }
+            source = incoming;
+          }
+        }
+
+        if (source != ir::NO_VALUE && source != value) {
+          forward[value] = source;
+          changed = any = true;
+        }
+      }
+  }
+  if (!any)
+    return false;
+
+  for (ir::Block &block : function.blocks) {
+    std::erase_if(block.insts, [&](Value value) {
+      if (forward[value] == value)
+        return false;
+      function.insts[value] = ir::Inst{};
+      return true;
+    });
+    for (Value value : block.insts)
+      function.forEachOperand(value,
+                              [&](Value &operand) { operand = find(operand); });
+  }
+  return true;
+}
+
+} // namespace opt
@@ -0,0 +1,27 @@
+#ifndef COPY_PROPAGATION_H
+#define COPY_PROPAGATION_H
+
+#include "pass.hpp"
+#include <vector>
+
+namespace opt {
+
+// Replaces uses of copies and of phis whose incoming values are all the
+// same (ignoring the phi itself) with the copied value, then deletes them.
+class CopyPropagation : public Pass {
+private:
+  std::vector<ir::Value> forward;
+
+  ir::Value find(ir::Value value);
+
+public:
+  std::string_view name() const override { return "copy-propagation"; }
+  bool run(ir::Function &function) override;
+  std::unique_ptr<Pass> clone() const override {
+    return std::make_unique<CopyPropagation>();
+  }
+};
+
+} // namespace opt
+
+#endif
@@ -0,0 +1,46 @@
+#include "dce.hpp"
+
+namespace opt {
+
+using ir::Op;
+using ir::Value;
+
+static bool hasSideEffects(Op op) {
+  return op == Op::STORE || op == Op::MEMCPY || op == Op::CALL ||
+         op == Op::BR || op == Op::CONDBR || op == Op::RET;
+}
+
+bool DeadCodeElimination::run(ir::Function &function) {
+  live.assign(function.insts.size(), false);
+  worklist.clear();
+
+  for (const ir::Block &block : function.blocks)
+    for (Value value : block.insts)
+      if (hasSideEffects(function.insts[value].op)) {
+        live[value] = true;
+        worklist.push_back(value);
+      }
+
+  while (!worklist.empty()) {
+    Value value{worklist.back()};
+    worklist.pop_back();
+    function.forEachOperand(value, [&](Value operand) {
+      if (!live[operand]) {
+        live[operand] = true;
+        worklist.push_back(operand);
+      }
+    });
+  }
+
+  bool changed{false};
+  for (ir::Block &block : function.blocks)
+    changed |= std::erase_if(block.insts, [&](Value value) {
+                 if (live[value])
+                   return false;
+                 function.insts[value] = ir::Inst{};
+                 return true;
+               }) > 0;
+  return changed;
+}
+
+} // namespace opt
@@ -0,0 +1,27 @@
+#ifndef DCE_H
+#define DCE_H
+
+#include "pass.hpp"
+#include <vector>
+
+namespace opt {
+
+// Mark-and-sweep dead code elimination: instructions with side effects and
+// terminators are live, as is everything they transitively use; the rest is
+// deleted, including cycles of phis that only feed each other.
+class DeadCodeElimination : public Pass {
+private:
+  std::vector<bool> live;
+  std::vector<ir::Value> worklist;
+
+public:
+  std::string_view name() const override { return "dce"; }
+  bool run(ir::Function &function) override;
+  std::unique_ptr<Pass> clone() const override {
+    return std::make_unique<DeadCodeElimination>();
+  }
+};
+
+} // namespace opt
+
+#endif
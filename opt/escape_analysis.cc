@@ -0,0 +1,120 @@
+#include "escape_analysis.hpp"
+#include <algorithm>
+#include <format>
+#include <ostream>
+
+namespace opt {
+
+using ir::Op;
+using ir::Type;
+using ir::Value;
+
+bool EscapeAnalysis::runOnModule(ir::Module &module) {
+  counts.clear();
+  auto found{module.functionIndex.find("mcmalloc")};
+  if (found == module.functionIndex.end() ||
+      !module.functions[found->second]->external)
+    return false;
+  allocator = found->second;
+  return Pass::runOnModule(module);
+}
+
+bool EscapeAnalysis::escapes(const ir::Function &function,
+                             Value pointer) const {
+  std::vector<Value> worklist{pointer};
+  std::vector<Value> seen{pointer};
+  while (!worklist.empty()) {
+    Value derived{worklist.back()};
+    worklist.pop_back();
+    for (Value user : users[derived]) {
+      const ir::Inst &inst{function.insts[user]};
+      switch (inst.op) {
+      case Op::LOAD:
+      case Op::MEMCPY:
+      case Op::EQ:
+      case Op::NE:
+      case Op::LT:
+      case Op::LE:
+      case Op::GT:
+      case Op::GE:
+        continue;
+      case Op::STORE:
+        if (inst.b == derived)
+          return true;
+        continue;
+      case Op::ADD:
+      case Op::COPY:
+        if (inst.type != Type::PTR)
+          return true;
+        if (std::ranges::find(seen, user) == seen.end()) {
+          seen.push_back(user);
+          worklist.push_back(user);
+        }
+        continue;
+      default:
+        return true;
+      }
+    }
+  }
+  return false;
+}
+
+bool EscapeAnalysis::run(ir::Function &function) {
+  users.assign(function.insts.size(), {});
+  std::vector<Value> calls;
+  for (const ir::Block &block : function.blocks)
+    for (Value value : block.insts) {
+      function.forEachOperand(
+          value, [&](Value operand) { users[operand].push_back(value); });
+      const ir::Inst &inst{function.insts[value]};
+      if (inst.op == Op::CALL && inst.imm == allocator)
+        calls.push_back(value);
+    }
+  if (calls.empty())
+    return false;
+
+  int moved{0};
+  for (Value call : calls) {
+    const ir::Inst &size{function.insts[function.extraOperands(call)[0]]};
+    if (size.op != Op::CONST || size.imm <= 0 || size.imm > MAX_SIZE ||
+        escapes(function, call))
+      continue;
+
+    // one slot in the entry block serves every execution of the call: a
+    // pointer from an earlier one cannot be reached once it is dropped
+    ir::Block &block{function.blocks[function.insts[call].block]};
+    std::vector<Value> &insts{block.insts};
+    insts.erase(std::ranges::find(insts, call));
+    std::vector<Value> &entry{function.blocks[0].insts};
+    function.insts[call] = {.op = Op::ALLOCA,
+                            .type = Type::PTR,
+                            .aux = 16,
+                            .block = 0,
+                            .imm = size.imm};
+    entry.insert(std::ranges::find_if(entry,
+                                      [&](Value other) {
+                                        return function.insts[other].op !=
+                                               Op::PARAM;
+                                      }),
+                 call);
+    moved++;
+  }
+  counts.push_back({function.name, {moved, static_cast<int>(calls.size())}});
+  return moved > 0;
+}
+
+void EscapeAnalysis::report(std::ostream &out) const {
+  int moved{0};
+  int total{0};
+  for (const auto &[function, count] : counts) {
+    out << std::format("escape-analysis: {}: {} of {} mcmalloc calls moved "
+                       "to the stack\n",
+                       function, count.first, count.second);
+    moved += count.first;
+    total += count.second;
+  }
+  out << std::format("escape-analysis: {} of {} heap allocations removed\n",
+                     moved, total);
+}
+
+} // namespace opt
@@ -0,0 +1,39 @@
+#ifndef ESCAPE_ANALYSIS_H
+#define ESCAPE_ANALYSIS_H
+
+#include "pass.hpp"
+#include <cstdint>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace opt {
+
+// Moves heap allocations that cannot outlive their function to the stack. A
+// call to mcmalloc with a constant size becomes a stack slot when its result
+// and the pointers derived from it are only loaded from, stored to, copied
+// between, offset and compared: never stored as a value, passed to a call,
+// returned or merged by a phi. MiniC has no free, so nothing else can tell
+// the difference. Inlining first lets this see through small helpers.
+class EscapeAnalysis : public Pass {
+private:
+  // larger slots could overflow the stack of a recursive function
+  static constexpr int64_t MAX_SIZE = 4096;
+
+  uint32_t allocator{UINT32_MAX};
+  std::vector<std::vector<ir::Value>> users;
+  // calls moved to the stack and all calls, by function name
+  std::vector<std::pair<std::string, std::pair<int, int>>> counts;
+
+  bool escapes(const ir::Function &function, ir::Value pointer) const;
+
+public:
+  std::string_view name() const override { return "escape-analysis"; }
+  bool run(ir::Function &function) override;
+  bool runOnModule(ir::Module &module) override;
+  void report(std::ostream &out) const override;
+};
+
+} // namespace opt
+
+#endif
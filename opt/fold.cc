@@ -0,0 +1,51 @@
+#include "fold.hpp"
+
+namespace opt {
+
+using ir::Op;
+
+int64_t wrap(ir::Type type, uint64_t value) {
+  switch (type) {
+  case ir::Type::I8:
+    return static_cast<int8_t>(value);
+  case ir::Type::I32:
+    return static_cast<int32_t>(value);
+  default:
+    return static_cast<int64_t>(value);
+  }
+}
+
+std::optional<int64_t> foldBinary(Op op, ir::Type type, int64_t a,
+                                  int64_t b) {
+  uint64_t ua{static_cast<uint64_t>(a)};
+  uint64_t ub{static_cast<uint64_t>(b)};
+  switch (op) {
+  case Op::ADD:
+    return wrap(type, ua + ub);
+  case Op::SUB:
+    return wrap(type, ua - ub);
+  case Op::MUL:
+    return wrap(type, ua * ub);
+  case Op::DIV:
+  case Op::REM:
+    if (b == 0 || (b == -1 && a == INT32_MIN))
+      return std::nullopt;
+    return op == Op::DIV ? a / b : a % b;
+  case Op::EQ:
+    return a == b;
+  case Op::NE:
+    return a != b;
+  case Op::LT:
+    return a < b;
+  case Op::LE:
+    return a <= b;
+  case Op::GT:
+    return a > b;
+  case Op::GE:
+    return a >= b;
+  default:
+    return std::nullopt;
+  }
+}
+
+} // namespace opt
@@ -0,0 +1,25 @@
+#ifndef FOLD_H
+#define FOLD_H
+
+#include "../ir/ir.hpp"
+#include <cstdint>
+#include <optional>
+
+namespace opt {
+
+// Constant folding shared by the passes that evaluate the IR at compile
+// time, so that they agree with each other and with the hardware. Narrow
+// values are held sign-extended in an int64_t.
+
+// Narrows a result to its type, wrapping on overflow like the hardware.
+int64_t wrap(ir::Type type, uint64_t value);
+
+// The result of the arithmetic or comparison `op` on `a` and `b`, or
+// nothing if `op` is not one or would trap (division by zero or overflow),
+// which is left to run time.
+std::optional<int64_t> foldBinary(ir::Op op, ir::Type type, int64_t a,
+                                  int64_t b);
+
+} // namespace opt
+
+#endif
@@ -0,0 +1,131 @@
+#include "global_dce.hpp"
+
+namespace opt {
+
+using ir::Op;
+using ir::Value;
+
+bool GlobalDeadCodeElimination::runOnModule(ir::Module &module) {
+  bool changed{removeFunctions(module)};
+  changed |= removeGlobals(module);
+  return changed;
+}
+
+// Without a main the module may be linked into something else that calls
+// any of its functions, so all of them stay; likewise in a partial module.
+bool GlobalDeadCodeElimination::removeFunctions(ir::Module &module) {
+  auto main{module.functionIndex.find("main")};
+  if (module.partial || main == module.functionIndex.end() ||
+      module.functions[main->second]->external)
+    return false;
+
+  size_t count{module.functions.size()};
+  std::vector<bool> reachable(count, false);
+  std::vector<uint32_t> worklist{main->second};
+  reachable[main->second] = true;
+  while (!worklist.empty()) {
+    const ir::Function &function{*module.functions[worklist.back()]};
+    worklist.pop_back();
+    for (const ir::Block &block : function.blocks)
+      for (Value value : block.insts) {
+        const ir::Inst &inst{function.insts[value]};
+        if (inst.op != Op::CALL || reachable[inst.imm])
+          continue;
+        reachable[inst.imm] = true;
+        worklist.push_back(static_cast<uint32_t>(inst.imm));
+      }
+  }
+
+  // declarations cost nothing and stay
+  std::vector<uint32_t> renumbered(count);
+  std::vector<std::unique_ptr<ir::Function>> kept;
+  for (size_t i = 0; i < count; i++) {
+    if (!reachable[i] && !module.functions[i]->external)
+      continue;
+    renumbered[i] = static_cast<uint32_t>(kept.size());
+    kept.push_back(std::move(module.functions[i]));
+  }
+  if (kept.size() == count) {
+    module.functions = std::move(kept);
+    return false;
+  }
+
+  module.functions = std::move(kept);
+  module.functionIndex.clear();
+  for (size_t i = 0; i < module.functions.size(); i++) {
+    ir::Function &function{*module.functions[i]};
+    module.functionIndex.emplace(function.name, static_cast<uint32_t>(i));
+    for (const ir::Block &block : function.blocks)
+      for (Value value : block.insts)
+        if (function.insts[value].op == Op::CALL)
+          function.insts[value].imm = renumbered[function.insts[value].imm];
+  }
+  return true;
+}
+
+bool GlobalDeadCodeElimination::removeGlobals(ir::Module &module) {
+  modRef.analyse(module);
+  size_t count{module.globals.size()};
+  std::vector<bool> read(count, false);
+  for (uint32_t i = 0; i < module.functions.size(); i++)
+    for (uint32_t global = 0; global < count; global++)
+      if (modRef.mayRead(i, global))
+        read[global] = true;
+
+  bool changed{false};
+  std::vector<bool> used(count, false);
+  for (std::unique_ptr<ir::Function> &function : module.functions) {
+    std::vector<Value> dead;
+    for (const ir::Block &block : function->blocks)
+      for (Value value : block.insts) {
+        const ir::Inst &inst{function->insts[value]};
+        if (inst.op == Op::STORE) {
+          uint32_t global{trackedGlobal(*function, modRef, inst.a)};
+          if (global != NO_GLOBAL && !read[global]) {
+            dead.push_back(value);
+            continue;
+          }
+        }
+        function->forEachOperand(value, [&](Value operand) {
+          const ir::Inst &source{function->insts[operand]};
+          if (source.op == Op::GLOBAL)
+            used[source.imm] = true;
+        });
+      }
+    for (Value value : dead)
+      function->remove(value);
+    changed |= !dead.empty();
+  }
+
+  // globals without users go, along with the instructions naming them
+  std::vector<uint32_t> renumbered(count);
+  std::vector<ir::Global> kept;
+  for (size_t global = 0; global < count; global++) {
+    if (!used[global])
+      continue;
+    renumbered[global] = static_cast<uint32_t>(kept.size());
+    kept.push_back(std::move(module.globals[global]));
+  }
+  if (kept.size() != count)
+    changed = true;
+  module.globals = std::move(kept);
+
+  for (std::unique_ptr<ir::Function> &function : module.functions) {
+    std::vector<Value> unused;
+    for (const ir::Block &block : function->blocks)
+      for (Value value : block.insts) {
+        ir::Inst &inst{function->insts[value]};
+        if (inst.op != Op::GLOBAL)
+          continue;
+        if (used[inst.imm])
+          inst.imm = renumbered[inst.imm];
+        else
+          unused.push_back(value);
+      }
+    for (Value value : unused)
+      function->remove(value);
+  }
+  return changed;
+}
+
+} // namespace opt
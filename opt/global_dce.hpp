@@ -0,0 +1,28 @@
+#ifndef GLOBAL_DCE_H
+#define GLOBAL_DCE_H
+
+#include "mod_ref.hpp"
+#include "pass.hpp"
+
+namespace opt {
+
+// Removes what the program can never observe: functions main cannot reach
+// through calls (after inlining many have no callers left), stores to
+// tracked globals that no function reads, and globals nothing refers to any
+// more. Functions and globals are renumbered densely afterwards.
+class GlobalDeadCodeElimination : public Pass {
+private:
+  ModRef modRef;
+
+  bool removeFunctions(ir::Module &module);
+  bool removeGlobals(ir::Module &module);
+
+public:
+  std::string_view name() const override { return "global-dce"; }
+  bool run(ir::Function &) override { return false; }
+  bool runOnModule(ir::Module &module) override;
+};
+
+} // namespace opt
+
+#endif
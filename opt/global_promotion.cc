@@ -0,0 +1,134 @@
+#include "global_promotion.hpp"
+
+namespace opt {
+
+using ir::BlockId;
+using ir::Op;
+using ir::Value;
+
+bool GlobalPromotion::runOnModule(ir::Module &mod) {
+  module = &mod;
+  modRef.analyse(mod);
+  bool changed{false};
+  for (std::unique_ptr<ir::Function> &function : mod.functions)
+    if (!function->external)
+      changed |= run(*function);
+  return changed;
+}
+
+void GlobalPromotion::transfer(const ir::Function &function, Value value,
+                               State &state) const {
+  const ir::Inst &inst{function.insts[value]};
+  switch (inst.op) {
+  case Op::LOAD:
+    if (uint32_t global{trackedGlobal(function, modRef, inst.a)};
+        global != NO_GLOBAL && state[global] == ir::NO_VALUE)
+      state[global] = value;
+    return;
+  case Op::STORE:
+    if (uint32_t global{trackedGlobal(function, modRef, inst.a)};
+        global != NO_GLOBAL)
+      state[global] = inst.b;
+    return;
+  case Op::CALL:
+    for (uint32_t global = 0; global < state.size(); global++)
+      if (modRef.mayWrite(static_cast<uint32_t>(inst.imm), global))
+        state[global] = ir::NO_VALUE;
+    return;
+  default:
+    return;
+  }
+}
+
+bool GlobalPromotion::run(ir::Function &function) {
+  size_t globals{module->globals.size()};
+  if (globals == 0)
+    return false;
+  info.analyse(function);
+  const std::vector<BlockId> &order{info.getOrder()};
+  entry.assign(function.blocks.size(), State(globals, ir::NO_VALUE));
+  visited.assign(function.blocks.size(), false);
+
+  // A value is known at a block's entry when every visited predecessor
+  // leaves the global holding it. Facts only ever get dropped, so this
+  // settles; the value's definition is on every path to the block and
+  // therefore dominates it.
+  std::vector<State> exit(function.blocks.size());
+  bool changed{true};
+  while (changed) {
+    changed = false;
+    for (BlockId block : order) {
+      State state(globals, ir::NO_VALUE);
+      bool first{true};
+      for (BlockId pred : function.blocks[block].preds) {
+        if (!visited[pred])
+          continue;
+        if (first)
+          state = exit[pred];
+        else
+          for (size_t global = 0; global < globals; global++)
+            if (state[global] != exit[pred][global])
+              state[global] = ir::NO_VALUE;
+        first = false;
+      }
+      if (visited[block] && state == entry[block])
+        continue;
+      entry[block] = state;
+      visited[block] = true;
+      for (Value value : function.blocks[block].insts)
+        transfer(function, value, state);
+      exit[block] = std::move(state);
+      changed = true;
+    }
+  }
+
+  bool rewritten{false};
+  for (BlockId block : order)
+    rewritten |= rewrite(function, block);
+  return rewritten;
+}
+
+bool GlobalPromotion::rewrite(ir::Function &function, BlockId block) {
+  State state{entry[block]};
+  // the last store to each global that nothing may have read yet
+  std::vector<Value> pending(state.size(), ir::NO_VALUE);
+  std::vector<Value> dead;
+  bool changed{false};
+
+  for (Value value : function.blocks[block].insts) {
+    ir::Inst &inst{function.insts[value]};
+    uint32_t global{inst.op == Op::LOAD || inst.op == Op::STORE
+                        ? trackedGlobal(function, modRef, inst.a)
+                        : NO_GLOBAL};
+    if (inst.op == Op::LOAD && global != NO_GLOBAL) {
+      if (state[global] != ir::NO_VALUE) {
+        inst = {.op = Op::COPY,
+                .type = inst.type,
+                .block = block,
+                .a = state[global]};
+        changed = true;
+        continue;
+      }
+      pending[global] = ir::NO_VALUE;
+    } else if (inst.op == Op::STORE && global != NO_GLOBAL) {
+      if (state[global] == inst.b) {
+        dead.push_back(value);
+        continue;
+      }
+      if (pending[global] != ir::NO_VALUE)
+        dead.push_back(pending[global]);
+      pending[global] = value;
+    } else if (inst.op == Op::CALL) {
+      for (uint32_t other = 0; other < state.size(); other++)
+        if (modRef.mayRead(static_cast<uint32_t>(inst.imm), other))
+          pending[other] = ir::NO_VALUE;
+    }
+    transfer(function, value, state);
+  }
+
+  for (Value value : dead)
+    function.remove(value);
+  return changed || !dead.empty();
+}
+
+} // namespace opt
@@ -0,0 +1,40 @@
+#ifndef GLOBAL_PROMOTION_H
+#define GLOBAL_PROMOTION_H
+
+#include "loops.hpp"
+#include "mod_ref.hpp"
+#include "pass.hpp"
+#include <vector>
+
+namespace opt {
+
+// Keeps tracked globals (see ModRef) in SSA values instead of memory where
+// that is safe. The value a global is known to hold, from the last load of
+// or store to it, flows forward over the CFG and survives calls to functions
+// that never write it, so later loads become copies of it. Stores of the
+// value a global already holds are dropped, as are stores overwritten in
+// the same block before anything could read them.
+class GlobalPromotion : public Pass {
+private:
+  // the value each global holds, or NO_VALUE when unknown
+  using State = std::vector<ir::Value>;
+
+  ir::Module *module{nullptr};
+  ModRef modRef;
+  LoopInfo info;
+  std::vector<State> entry;
+  std::vector<bool> visited;
+
+  void transfer(const ir::Function &function, ir::Value value,
+                State &state) const;
+  bool rewrite(ir::Function &function, ir::BlockId block);
+
+public:
+  std::string_view name() const override { return "global-promotion"; }
+  bool run(ir::Function &function) override;
+  bool runOnModule(ir::Module &module) override;
+};
+
+} // namespace opt
+
+#endif
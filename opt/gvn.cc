@@ -0,0 +1,131 @@
+#include "gvn.hpp"
+#include <utility>
+
+namespace opt {
+
+using ir::BlockId;
+using ir::Op;
+using ir::Type;
+using ir::Value;
+
+static bool isPure(const ir::Inst &inst) {
+  if (inst.type == Type::VEC)
+    return false;
+  switch (inst.op) {
+  case Op::CONST:
+  case Op::GLOBAL:
+  case Op::STRING:
+  case Op::ADD:
+  case Op::SUB:
+  case Op::MUL:
+  case Op::DIV:
+  case Op::REM:
+  case Op::EQ:
+  case Op::NE:
+  case Op::LT:
+  case Op::LE:
+  case Op::GT:
+  case Op::GE:
+  case Op::SEXT:
+  case Op::TRUNC:
+    return true;
+  default:
+    return false;
+  }
+}
+
+static bool isCommutative(Op op) {
+  return op == Op::ADD || op == Op::MUL || op == Op::EQ || op == Op::NE;
+}
+
+// Rewrites `(base + c1) + c2` as `base + (c1 + c2)` and drops a zero offset.
+// `index` is the position of `value` in its block and moves past the
+// constant inserted before it.
+bool GlobalValueNumbering::foldOffsets(ir::Function &function, Value value,
+                                       size_t &index) {
+  const ir::Inst &inst{function.insts[value]};
+  if (inst.op != Op::ADD || inst.type != Type::PTR)
+    return false;
+  const ir::Inst &offset{function.insts[inst.b]};
+  if (offset.op != Op::CONST)
+    return false;
+  if (offset.imm == 0) {
+    function.insts[value] = {
+        .op = Op::COPY, .type = Type::PTR, .block = inst.block, .a = inst.a};
+    return true;
+  }
+
+  const ir::Inst &inner{function.insts[inst.a]};
+  if (inner.op != Op::ADD || inner.type != Type::PTR ||
+      function.insts[inner.b].op != Op::CONST)
+    return false;
+  Value base{inner.a};
+  int64_t sum{function.insts[inner.b].imm + offset.imm};
+  BlockId block{inst.block};
+  Value constant{function.create(
+      {.op = Op::CONST, .type = Type::PTR, .block = block, .imm = sum})};
+  std::vector<Value> &insts{function.blocks[block].insts};
+  insts.insert(insts.begin() + index, constant);
+  index++;
+
+  ir::Inst &folded{function.insts[value]};
+  folded.a = base;
+  folded.b = constant;
+  if (sum == 0)
+    folded = {.op = Op::COPY, .type = Type::PTR, .block = block, .a = base};
+  return true;
+}
+
+bool GlobalValueNumbering::run(ir::Function &function) {
+  info.analyse(function);
+  table.clear();
+
+  // operands are looked through the copies made on the way
+  auto resolve{[&](Value value) {
+    while (function.insts[value].op == Op::COPY)
+      value = function.insts[value].a;
+    return value;
+  }};
+
+  bool changed{false};
+  for (BlockId block : info.getOrder()) {
+    for (size_t i = 0; i < function.blocks[block].insts.size(); i++) {
+      Value value{function.blocks[block].insts[i]};
+      if (!isPure(function.insts[value]))
+        continue;
+      function.forEachOperand(value, [&](Value &operand) {
+        Value source{resolve(operand)};
+        changed |= source != operand;
+        operand = source;
+      });
+      changed |= foldOffsets(function, value, i);
+
+      const ir::Inst &inst{function.insts[value]};
+      if (inst.op == Op::COPY)
+        continue;
+      Value a{inst.a};
+      Value b{inst.b};
+      if (isCommutative(inst.op) && a > b)
+        std::swap(a, b);
+      std::vector<Value> &candidates{
+          table[{inst.op, inst.type, inst.aux, a, b, inst.imm}]};
+
+      Value leader{ir::NO_VALUE};
+      for (Value candidate : candidates)
+        if (info.dominates(function.insts[candidate].block, block)) {
+          leader = candidate;
+          break;
+        }
+      if (leader == ir::NO_VALUE) {
+        candidates.push_back(value);
+        continue;
+      }
+      function.insts[value] = {
+          .op = Op::COPY, .type = inst.type, .block = block, .a = leader};
+      changed = true;
+    }
+  }
+  return changed;
+}
+
+} // namespace opt
@@ -0,0 +1,40 @@
+#ifndef GVN_H
+#define GVN_H
+
+#include "loops.hpp"
+#include "pass.hpp"
+#include <cstdint>
+#include <map>
+#include <tuple>
+#include <vector>
+
+namespace opt {
+
+// Global value numbering over pure expressions. Blocks are visited in
+// reverse postorder, and an instruction computing what one in a dominating
+// block already computed becomes a copy of it. Constant offsets added to an
+// address are folded together first, so a chain of struct member and array
+// element accesses is a base plus one offset and every access to the same
+// member shares its address.
+class GlobalValueNumbering : public Pass {
+private:
+  // operation, type, aux, operands and immediate
+  using Key = std::tuple<ir::Op, ir::Type, uint32_t, ir::Value, ir::Value,
+                         int64_t>;
+
+  LoopInfo info;
+  std::map<Key, std::vector<ir::Value>> table;
+
+  bool foldOffsets(ir::Function &function, ir::Value value, size_t &index);
+
+public:
+  std::string_view name() const override { return "gvn"; }
+  bool run(ir::Function &function) override;
+  std::unique_ptr<Pass> clone() const override {
+    return std::make_unique<GlobalValueNumbering>();
+  }
+};
+
+} // namespace opt
+
+#endif
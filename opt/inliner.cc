@@ -0,0 +1,279 @@
+#include "inliner.hpp"
+#include <algorithm>
+#include <limits>
+
+namespace opt {
+
+using ir::BlockId;
+using ir::Op;
+using ir::Value;
+
+static constexpr uint32_t UNVISITED = std::numeric_limits<uint32_t>::max();
+static constexpr int NEVER = std::numeric_limits<int>::max();
+
+// Counts the instructions that end up as machine code. Functions that never
+// return or whose entry is a loop header are not worth the trouble.
+static int weigh(const ir::Function &function) {
+  if (function.external || !function.blocks[0].preds.empty())
+    return NEVER;
+  int weight{0};
+  bool returns{false};
+  for (const ir::Block &block : function.blocks)
+    for (Value value : block.insts)
+      switch (function.insts[value].op) {
+      case Op::CONST:
+      case Op::PARAM:
+      case Op::GLOBAL:
+      case Op::STRING:
+      case Op::ALLOCA:
+      case Op::COPY:
+      case Op::PHI:
+        break;
+      case Op::RET:
+        returns = true;
+        break;
+      default:
+        weight++;
+      }
+  return returns ? weight : NEVER;
+}
+
+bool Inliner::runOnModule(ir::Module &mod) {
+  module = &mod;
+  std::vector<uint32_t> order;
+  findComponents(order);
+
+  hottest = 0;
+  for (const std::unique_ptr<ir::Function> &function : mod.functions)
+    if (function->profiled)
+      for (const ir::Block &block : function->blocks)
+        if (block.count != ir::NO_COUNT)
+          hottest = std::max(hottest, block.count);
+
+  bool changed{false};
+  weights.assign(mod.functions.size(), NEVER);
+  for (uint32_t index : order) {
+    ir::Function &function{*mod.functions[index]};
+    if (function.external)
+      continue;
+    changed |= run(function);
+    if (!recursive[index])
+      weights[index] = weigh(function);
+  }
+  return changed;
+}
+
+// Tarjan's algorithm. Components are completed callees first, which is the
+// bottom-up order that `order` receives the functions in.
+void Inliner::findComponents(std::vector<uint32_t> &order) {
+  size_t count{module->functions.size()};
+  std::vector<std::vector<uint32_t>> callees(count);
+  for (size_t i = 0; i < count; i++) {
+    const ir::Function &function{*module->functions[i]};
+    for (const ir::Block &block : function.blocks)
+      for (Value value : block.insts)
+        if (function.insts[value].op == Op::CALL)
+          callees[i].push_back(
+              static_cast<uint32_t>(function.insts[value].imm));
+  }
+
+  std::vector<uint32_t> index(count, UNVISITED);
+  std::vector<uint32_t> low(count, 0);
+  std::vector<bool> onStack(count, false);
+  std::vector<uint32_t> stack;
+  uint32_t next{0};
+  recursive.assign(count, false);
+
+  auto visit{[&](auto &self, uint32_t function) -> void {
+    index[function] = low[function] = next++;
+    stack.push_back(function);
+    onStack[function] = true;
+    for (uint32_t callee : callees[function]) {
+      if (index[callee] == UNVISITED) {
+        self(self, callee);
+        low[function] = std::min(low[function], low[callee]);
+      } else if (onStack[callee])
+        low[function] = std::min(low[function], index[callee]);
+    }
+    if (low[function] != index[function])
+      return;
+
+    size_t first{order.size()};
+    uint32_t member;
+    do {
+      member = stack.back();
+      stack.pop_back();
+      onStack[member] = false;
+      order.push_back(member);
+    } while (member != function);
+
+    bool cycle{order.size() - first > 1 ||
+               std::ranges::find(callees[function], function) !=
+                   callees[function].end()};
+    for (size_t i = first; i < order.size(); i++)
+      recursive[order[i]] = cycle;
+  }};
+
+  for (uint32_t function = 0; function < count; function++)
+    if (index[function] == UNVISITED)
+      visit(visit, function);
+}
+
+bool Inliner::shouldInline(const ir::Function &caller, Value call) const {
+  uint32_t callee{static_cast<uint32_t>(caller.insts[call].imm)};
+  if (weights[callee] == NEVER)
+    return false;
+
+  int threshold{THRESHOLD};
+  if (caller.profiled) {
+    uint64_t count{caller.blocks[caller.insts[call].block].count};
+    if (count == 0)
+      return false;
+    if (count != ir::NO_COUNT && count * HOT_FRACTION >= hottest)
+      threshold = HOT_THRESHOLD;
+  }
+
+  int cost{weights[callee] - 1};
+  for (Value arg : caller.extraOperands(call))
+    cost -= caller.insts[arg].op == Op::CONST ? 2 : 1;
+  return cost <= threshold &&
+         caller.instructionCount() + static_cast<size_t>(weights[callee]) <=
+             MAX_CALLER_SIZE;
+}
+
+void Inliner::inlineCall(ir::Function &caller, Value call) {
+  const ir::Inst site{caller.insts[call]};
+  const ir::Function &callee{*module->functions[site.imm]};
+  std::span<const Value> callArgs{caller.extraOperands(call)};
+  std::vector<Value> args(callArgs.begin(), callArgs.end());
+
+  // the instructions after the call continue in a block of their own
+  BlockId block{site.block};
+  BlockId rest{caller.newBlock()};
+  {
+    std::vector<Value> &insts{caller.blocks[block].insts};
+    auto position{std::ranges::find(insts, call)};
+    caller.blocks[rest].insts.assign(position + 1, insts.end());
+    insts.erase(position, insts.end());
+  }
+  for (Value value : caller.blocks[rest].insts)
+    caller.insts[value].block = rest;
+  caller.blocks[rest].succs = std::move(caller.blocks[block].succs);
+  caller.blocks[block].succs.clear();
+  for (BlockId succ : caller.blocks[rest].succs)
+    std::ranges::replace(caller.blocks[succ].preds, block, rest);
+  caller.blocks[rest].count = caller.blocks[block].count;
+  caller.blocks[rest].taken = caller.blocks[block].taken;
+  caller.blocks[block].taken = ir::NO_COUNT;
+
+  // the callee's counts are scaled down to this call's share of its calls
+  uint64_t calls{callee.blocks[0].count};
+  uint64_t share{caller.blocks[block].count};
+  auto scale{[&](uint64_t count) {
+    if (count == ir::NO_COUNT || share == ir::NO_COUNT ||
+        calls == ir::NO_COUNT || calls == 0)
+      return ir::NO_COUNT;
+    return static_cast<uint64_t>(static_cast<double>(count) *
+                                 static_cast<double>(share) /
+                                 static_cast<double>(calls));
+  }};
+  std::vector<BlockId> blockMap(callee.blocks.size());
+  for (BlockId from = 0; from < callee.blocks.size(); from++) {
+    blockMap[from] = caller.newBlock();
+    caller.blocks[blockMap[from]].count = scale(callee.blocks[from].count);
+    caller.blocks[blockMap[from]].taken = scale(callee.blocks[from].taken);
+  }
+
+  // clone first and remap operands afterwards, since phis refer to values
+  // defined further down
+  std::vector<Value> valueMap(callee.insts.size(), ir::NO_VALUE);
+  std::vector<Value> clones;
+  std::vector<std::pair<BlockId, Value>> returns;
+  for (BlockId from = 0; from < callee.blocks.size(); from++)
+    for (Value value : callee.blocks[from].insts) {
+      ir::Inst inst{callee.insts[value]};
+      if (inst.op == Op::PARAM) {
+        valueMap[value] = args[inst.imm];
+        continue;
+      }
+      if (inst.op == Op::RET) {
+        returns.emplace_back(blockMap[from], inst.a);
+        caller.append(blockMap[from], {.op = Op::BR});
+        continue;
+      }
+
+      inst.extra = 0;
+      inst.count = 0;
+      Value clone;
+      if (inst.op == Op::ALLOCA) {
+        // stack slots stay in the entry block so they are allocated once
+        inst.block = 0;
+        clone = caller.create(inst);
+        std::vector<Value> &entry{caller.blocks[0].insts};
+        entry.insert(std::ranges::find_if(entry,
+                                          [&](Value other) {
+                                            return caller.insts[other].op !=
+                                                   Op::PARAM;
+                                          }),
+                     clone);
+      } else
+        clone = caller.append(blockMap[from], inst);
+      if (callee.insts[value].count > 0)
+        caller.setExtraOperands(clone, callee.extraOperands(value));
+      valueMap[value] = clone;
+      clones.push_back(clone);
+    }
+  for (Value clone : clones)
+    caller.forEachOperand(clone,
+                          [&](Value &operand) { operand = valueMap[operand]; });
+
+  for (BlockId from = 0; from < callee.blocks.size(); from++) {
+    ir::Block &mapped{caller.blocks[blockMap[from]]};
+    for (BlockId pred : callee.blocks[from].preds)
+      mapped.preds.push_back(blockMap[pred]);
+    for (BlockId succ : callee.blocks[from].succs)
+      mapped.succs.push_back(blockMap[succ]);
+  }
+  caller.append(block, {.op = Op::BR});
+  caller.addEdge(block, blockMap[0]);
+  for (auto [from, value] : returns)
+    caller.addEdge(from, rest);
+
+  // the call turns into a copy of the returned value so that its users
+  // need not be rewritten; copy propagation removes it later
+  if (!site.hasResult()) {
+    caller.insts[call] = ir::Inst{};
+    return;
+  }
+  std::vector<Value> &restInsts{caller.blocks[rest].insts};
+  Value returned{valueMap[returns.front().second]};
+  if (returns.size() > 1) {
+    Value phi{caller.create({.op = Op::PHI, .type = site.type, .block = rest})};
+    std::vector<Value> incoming;
+    for (auto [from, value] : returns)
+      incoming.push_back(valueMap[value]);
+    caller.setExtraOperands(phi, incoming);
+    restInsts.insert(restInsts.begin(), phi);
+    returned = phi;
+  }
+  caller.insts[call] = {
+      .op = Op::COPY, .type = site.type, .block = rest, .a = returned};
+  restInsts.insert(restInsts.begin() + (returns.size() > 1 ? 1 : 0), call);
+}
+
+bool Inliner::run(ir::Function &function) {
+  bool changed{false};
+  // inlining moves the rest of the block into a new block at the end, which
+  // is scanned later on
+  for (BlockId block = 0; block < function.blocks.size(); block++)
+    for (Value value : function.blocks[block].insts)
+      if (function.insts[value].op == Op::CALL &&
+          shouldInline(function, value)) {
+        inlineCall(function, value);
+        changed = true;
+        break;
+      }
+  return changed;
+}
+
+} // namespace opt
@@ -0,0 +1,48 @@
+#ifndef INLINER_H
+#define INLINER_H
+
+#include "pass.hpp"
+#include <cstdint>
+#include <vector>
+
+namespace opt {
+
+// Inlines calls to small functions. Functions are visited bottom-up over the
+// call graph's strongly connected components so that a callee has already
+// had its own calls inlined when its cost is estimated. Recursive functions,
+// those in a component with a cycle, are never inlined.
+//
+// The cost of a callee is the number of instructions that generate code,
+// less what the call itself costs at the call site (the call, its argument
+// moves and a bonus for constant arguments that later folding may exploit).
+// Calls at or under the threshold are inlined as long as the caller stays
+// under a size limit.
+//
+// With a profile, calls that never ran are left alone and those in blocks
+// that ran at least 1/HOT_FRACTION as often as the hottest block of the
+// module get the larger HOT_THRESHOLD.
+class Inliner : public Pass {
+private:
+  static constexpr int THRESHOLD = 12;
+  static constexpr int HOT_THRESHOLD = 48;
+  static constexpr uint64_t HOT_FRACTION = 20;
+  static constexpr size_t MAX_CALLER_SIZE = 2000;
+
+  ir::Module *module{nullptr};
+  uint64_t hottest{0};
+  std::vector<bool> recursive;
+  std::vector<int> weights;
+
+  void findComponents(std::vector<uint32_t> &order);
+  bool shouldInline(const ir::Function &caller, ir::Value call) const;
+  void inlineCall(ir::Function &caller, ir::Value call);
+
+public:
+  std::string_view name() const override { return "inline"; }
+  bool run(ir::Function &function) override;
+  bool runOnModule(ir::Module &module) override;
+};
+
+} // namespace opt
+
+#endif
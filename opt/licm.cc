@@ -0,0 +1,69 @@
+#include "licm.hpp"
+#include <algorithm>
+
+namespace opt {
+
+using ir::BlockId;
+using ir::Op;
+using ir::Value;
+
+static bool isHoistable(const ir::Function &function, const ir::Inst &inst) {
+  switch (inst.op) {
+  case Op::CONST:
+  case Op::GLOBAL:
+  case Op::STRING:
+  case Op::ADD:
+  case Op::SUB:
+  case Op::MUL:
+  case Op::EQ:
+  case Op::NE:
+  case Op::LT:
+  case Op::LE:
+  case Op::GT:
+  case Op::GE:
+  case Op::SEXT:
+  case Op::TRUNC:
+  case Op::COPY:
+    return true;
+  case Op::DIV:
+  case Op::REM: {
+    // only divisions that cannot trap whatever the dividend
+    const ir::Inst &divisor{function.insts[inst.b]};
+    return divisor.op == Op::CONST && divisor.imm != 0 && divisor.imm != -1;
+  }
+  default:
+    return false;
+  }
+}
+
+bool LoopInvariantCodeMotion::run(ir::Function &function) {
+  bool changed{insertPreheaders(function)};
+  info.analyse(function);
+
+  for (const Loop &loop : info.getLoops()) {
+    BlockId preheader{loop.preheader};
+    std::vector<Value> &target{function.blocks[preheader].insts};
+    for (BlockId block : loop.blocks) {
+      std::vector<Value> &insts{function.blocks[block].insts};
+      std::erase_if(insts, [&](Value value) {
+        ir::Inst &inst{function.insts[value]};
+        if (!isHoistable(function, inst))
+          return false;
+        bool invariant{true};
+        function.forEachOperand(value, [&](Value operand) {
+          invariant &= !loop.contains(function.insts[operand].block);
+        });
+        if (!invariant)
+          return false;
+
+        target.insert(target.end() - 1, value);
+        inst.block = preheader;
+        changed = true;
+        return true;
+      });
+    }
+  }
+  return changed;
+}
+
+} // namespace opt
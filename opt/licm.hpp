@@ -0,0 +1,28 @@
+#ifndef LICM_H
+#define LICM_H
+
+#include "loops.hpp"
+#include "pass.hpp"
+
+namespace opt {
+
+// Loop-invariant code motion: instructions inside a loop whose operands are
+// all defined outside of it are moved to the loop's preheader. Loops are
+// visited innermost first, so an expression can climb out of a whole nest.
+// Only instructions that cannot trap or observe memory move, since the
+// preheader runs even when the loop body does not.
+class LoopInvariantCodeMotion : public Pass {
+private:
+  LoopInfo info;
+
+public:
+  std::string_view name() const override { return "licm"; }
+  bool run(ir::Function &function) override;
+  std::unique_ptr<Pass> clone() const override {
+    return std::make_unique<LoopInvariantCodeMotion>();
+  }
+};
+
+} // namespace opt
+
+#endif
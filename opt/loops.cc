@@ -0,0 +1,192 @@
+#include "loops.hpp"
+#include <algorithm>
+
+namespace opt {
+
+using ir::BlockId;
+using ir::Op;
+using ir::Value;
+
+static constexpr uint32_t UNREACHABLE = UINT32_MAX;
+
+void LoopInfo::computeDominators(const ir::Function &function) {
+  size_t count{function.blocks.size()};
+  order.clear();
+  orderIndex.assign(count, UNREACHABLE);
+
+  // iterative depth-first search for the postorder
+  std::vector<bool> visited(count, false);
+  std::vector<std::pair<BlockId, size_t>> stack{{0, 0}};
+  visited[0] = true;
+  while (!stack.empty()) {
+    auto &[block, next]{stack.back()};
+    const std::vector<BlockId> &succs{function.blocks[block].succs};
+    if (next < succs.size()) {
+      BlockId succ{succs[next++]};
+      if (!visited[succ]) {
+        visited[succ] = true;
+        stack.emplace_back(succ, 0);
+      }
+      continue;
+    }
+    order.push_back(block);
+    stack.pop_back();
+  }
+  std::ranges::reverse(order);
+  for (uint32_t i = 0; i < order.size(); i++)
+    orderIndex[order[i]] = i;
+
+  idom.assign(count, ir::NO_BLOCK);
+  idom[0] = 0;
+  bool changed{true};
+  while (changed) {
+    changed = false;
+    for (BlockId block : order) {
+      if (block == 0)
+        continue;
+      BlockId dominator{ir::NO_BLOCK};
+      for (BlockId pred : function.blocks[block].preds) {
+        if (idom[pred] == ir::NO_BLOCK)
+          continue;
+        dominator =
+            dominator == ir::NO_BLOCK ? pred : intersect(pred, dominator);
+      }
+      if (idom[block] != dominator) {
+        idom[block] = dominator;
+        changed = true;
+      }
+    }
+  }
+}
+
+BlockId LoopInfo::intersect(BlockId a, BlockId b) const {
+  while (a != b) {
+    while (orderIndex[a] > orderIndex[b])
+      a = idom[a];
+    while (orderIndex[b] > orderIndex[a])
+      b = idom[b];
+  }
+  return a;
+}
+
+bool LoopInfo::dominates(BlockId a, BlockId b) const {
+  if (idom[b] == ir::NO_BLOCK)
+    return false;
+  while (b != a && b != 0)
+    b = idom[b];
+  return b == a;
+}
+
+void LoopInfo::analyse(const ir::Function &function) {
+  computeDominators(function);
+  loops.clear();
+
+  std::vector<size_t> loopOf(function.blocks.size(), SIZE_MAX);
+  for (BlockId latch : order)
+    for (BlockId header : function.blocks[latch].succs) {
+      if (!dominates(header, latch))
+        continue;
+      if (loopOf[header] == SIZE_MAX) {
+        loopOf[header] = loops.size();
+        Loop &loop{loops.emplace_back()};
+        loop.header = header;
+        loop.body.assign(function.blocks.size(), false);
+        loop.body[header] = true;
+      }
+      Loop &loop{loops[loopOf[header]]};
+      if (std::ranges::find(loop.latches, latch) == loop.latches.end())
+        loop.latches.push_back(latch);
+
+      std::vector<BlockId> worklist{latch};
+      while (!worklist.empty()) {
+        BlockId block{worklist.back()};
+        worklist.pop_back();
+        if (loop.body[block])
+          continue;
+        loop.body[block] = true;
+        for (BlockId pred : function.blocks[block].preds)
+          if (orderIndex[pred] != UNREACHABLE)
+            worklist.push_back(pred);
+      }
+    }
+
+  for (Loop &loop : loops) {
+    for (BlockId block : order)
+      if (loop.body[block])
+        loop.blocks.push_back(block);
+
+    const ir::Block &header{function.blocks[loop.header]};
+    size_t outside{0};
+    for (BlockId pred : header.preds)
+      if (!loop.body[pred]) {
+        outside++;
+        loop.preheader = pred;
+      }
+    if (outside != 1 || function.blocks[loop.preheader].succs.size() != 1)
+      loop.preheader = ir::NO_BLOCK;
+  }
+
+  // a loop nested in another has fewer blocks
+  std::ranges::stable_sort(loops, {}, [](const Loop &loop) {
+    return loop.blocks.size();
+  });
+}
+
+bool insertPreheaders(ir::Function &function) {
+  LoopInfo info;
+  info.analyse(function);
+
+  bool changed{false};
+  for (const Loop &loop : info.getLoops()) {
+    if (loop.preheader != ir::NO_BLOCK)
+      continue;
+
+    BlockId header{loop.header};
+    BlockId preheader{function.newBlock()};
+    std::vector<size_t> outside;
+    std::vector<BlockId> preds{preheader};
+    for (size_t i = 0; i < function.blocks[header].preds.size(); i++) {
+      BlockId pred{function.blocks[header].preds[i]};
+      if (loop.contains(pred)) {
+        preds.push_back(pred);
+        continue;
+      }
+      outside.push_back(i);
+      function.blocks[preheader].preds.push_back(pred);
+      // one edge at a time, as a conditional branch may have two to here
+      std::vector<BlockId> &succs{function.blocks[pred].succs};
+      *std::ranges::find(succs, header) = preheader;
+    }
+
+    for (Value value : function.blocks[header].insts) {
+      if (function.insts[value].op != Op::PHI)
+        break;
+      std::span<const Value> incoming{function.extraOperands(value)};
+      std::vector<Value> merged;
+      std::vector<Value> kept{ir::NO_VALUE};
+      for (size_t i = 0; i < incoming.size(); i++)
+        if (std::ranges::find(outside, i) != outside.end())
+          merged.push_back(incoming[i]);
+        else
+          kept.push_back(incoming[i]);
+
+      if (std::ranges::all_of(merged,
+                              [&](Value other) { return other == merged[0]; }))
+        kept[0] = merged[0];
+      else {
+        kept[0] = function.append(preheader, {.op = Op::PHI,
+                                              .type = function.insts[value].type});
+        function.setExtraOperands(kept[0], merged);
+      }
+      function.setExtraOperands(value, kept);
+    }
+
+    function.blocks[header].preds = preds;
+    function.append(preheader, {.op = Op::BR});
+    function.blocks[preheader].succs.push_back(header);
+    changed = true;
+  }
+  return changed;
+}
+
+} // namespace opt
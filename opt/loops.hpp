@@ -0,0 +1,56 @@
+#ifndef LOOPS_H
+#define LOOPS_H
+
+#include "../ir/ir.hpp"
+#include <cstdint>
+#include <vector>
+
+namespace opt {
+
+// A natural loop: the blocks that can reach one of the back edges into
+// `header` without passing through the header. Loops sharing a header are
+// merged.
+struct Loop {
+  ir::BlockId header;
+  // Single predecessor from outside the loop whose only successor is the
+  // header, or NO_BLOCK if the loop has none.
+  ir::BlockId preheader{ir::NO_BLOCK};
+  // In reverse postorder, so definitions come before their uses apart from
+  // phis; the header is first.
+  std::vector<ir::BlockId> blocks;
+  std::vector<ir::BlockId> latches;
+  std::vector<bool> body;
+
+  bool contains(ir::BlockId block) const { return body[block]; }
+};
+
+// Dominator tree (Cooper, Harvey and Kennedy's iterative algorithm over the
+// reverse postorder) and the natural loops found from its back edges.
+class LoopInfo {
+private:
+  std::vector<ir::BlockId> order;
+  std::vector<uint32_t> orderIndex;
+  std::vector<ir::BlockId> idom;
+  std::vector<Loop> loops;
+
+  void computeDominators(const ir::Function &function);
+  ir::BlockId intersect(ir::BlockId a, ir::BlockId b) const;
+
+public:
+  void analyse(const ir::Function &function);
+
+  bool dominates(ir::BlockId a, ir::BlockId b) const;
+  // The reachable blocks in reverse postorder.
+  const std::vector<ir::BlockId> &getOrder() const { return order; }
+  // Innermost loops come before the loops containing them.
+  const std::vector<Loop> &getLoops() const { return loops; }
+};
+
+// Gives every loop a preheader, merging the values that flow into the
+// header's phis from outside the loop in new phis there. Returns whether a
+// block was added.
+bool insertPreheaders(ir::Function &function);
+
+} // namespace opt
+
+#endif
@@ -0,0 +1,83 @@
+#include "mod_ref.hpp"
+
+namespace opt {
+
+using ir::Op;
+using ir::Value;
+
+uint32_t trackedGlobal(const ir::Function &function, const ModRef &modRef,
+                       Value value) {
+  const ir::Inst &inst{function.insts[value]};
+  if (inst.op != Op::GLOBAL)
+    return NO_GLOBAL;
+  uint32_t global{static_cast<uint32_t>(inst.imm)};
+  return modRef.isTracked(global) ? global : NO_GLOBAL;
+}
+
+void ModRef::analyse(const ir::Module &module) {
+  size_t globalCount{module.globals.size()};
+  size_t functionCount{module.functions.size()};
+  tracked.assign(globalCount, true);
+  reads.assign(functionCount, std::vector<bool>(globalCount, false));
+  writes.assign(functionCount, std::vector<bool>(globalCount, false));
+
+  auto globalOf{[&](const ir::Function &function, Value value) {
+    const ir::Inst &inst{function.insts[value]};
+    return inst.op == Op::GLOBAL ? static_cast<uint32_t>(inst.imm)
+                                 : NO_GLOBAL;
+  }};
+
+  for (const std::unique_ptr<ir::Function> &function : module.functions)
+    for (const ir::Block &block : function->blocks)
+      for (Value value : block.insts) {
+        const ir::Inst &inst{function->insts[value]};
+        bool access{inst.op == Op::LOAD || inst.op == Op::STORE};
+        function->forEachOperand(value, [&](Value operand) {
+          uint32_t global{globalOf(*function, operand)};
+          if (global == NO_GLOBAL)
+            return;
+          // anything but the address of a whole-sized access lets it escape
+          if (!access || operand != inst.a || operand == inst.b ||
+              ir::sizeOf(inst.type) != module.globals[global].size)
+            tracked[global] = false;
+        });
+      }
+
+  for (size_t i = 0; i < functionCount; i++) {
+    const ir::Function &function{*module.functions[i]};
+    for (const ir::Block &block : function.blocks)
+      for (Value value : block.insts) {
+        const ir::Inst &inst{function.insts[value]};
+        if (inst.op != Op::LOAD && inst.op != Op::STORE)
+          continue;
+        uint32_t global{globalOf(function, inst.a)};
+        if (global == NO_GLOBAL || !tracked[global])
+          continue;
+        (inst.op == Op::LOAD ? reads : writes)[i][global] = true;
+      }
+  }
+
+  // callers take on the effects of their callees, around cycles too
+  bool changed{true};
+  while (changed) {
+    changed = false;
+    for (size_t i = 0; i < functionCount; i++) {
+      const ir::Function &function{*module.functions[i]};
+      for (const ir::Block &block : function.blocks)
+        for (Value value : block.insts) {
+          const ir::Inst &inst{function.insts[value]};
+          if (inst.op != Op::CALL)
+            continue;
+          size_t callee{static_cast<size_t>(inst.imm)};
+          for (size_t global = 0; global < globalCount; global++) {
+            if (reads[callee][global] && !reads[i][global])
+              reads[i][global] = changed = true;
+            if (writes[callee][global] && !writes[i][global])
+              writes[i][global] = changed = true;
+          }
+        }
+    }
+  }
+}
+
+} // namespace opt
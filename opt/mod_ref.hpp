@@ -0,0 +1,41 @@
+#ifndef MOD_REF_H
+#define MOD_REF_H
+
+#include "../ir/ir.hpp"
+#include <cstdint>
+#include <vector>
+
+namespace opt {
+
+// Whole-program mod/ref summaries for scalar globals. A global is tracked
+// when its address is only ever the address operand of loads and stores of
+// its own size, so that no pointer can reach it. For tracked globals every
+// function gets the sets it may read and write, directly or through the
+// functions it calls; the builtins touch no globals.
+class ModRef {
+private:
+  std::vector<bool> tracked;
+  // indexed by function, then by global
+  std::vector<std::vector<bool>> reads;
+  std::vector<std::vector<bool>> writes;
+
+public:
+  void analyse(const ir::Module &module);
+
+  bool isTracked(uint32_t global) const { return tracked[global]; }
+  bool mayRead(uint32_t function, uint32_t global) const {
+    return reads[function][global];
+  }
+  bool mayWrite(uint32_t function, uint32_t global) const {
+    return writes[function][global];
+  }
+};
+
+// The tracked global `value` is the address of, or NO_GLOBAL.
+constexpr uint32_t NO_GLOBAL = UINT32_MAX;
+uint32_t trackedGlobal(const ir::Function &function, const ModRef &modRef,
+                       ir::Value value);
+
+} // namespace opt
+
+#endif
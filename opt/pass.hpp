@@ -0,0 +1,40 @@
+#ifndef PASS_H
+#define PASS_H
+
+#include "../ir/ir.hpp"
+#include <memory>
+#include <ostream>
+#include <string_view>
+
+namespace opt {
+
+// A transformation of a single function's IR.
+class Pass {
+public:
+  virtual ~Pass() = default;
+
+  virtual std::string_view name() const = 0;
+  // Returns whether the function changed.
+  virtual bool run(ir::Function &function) = 0;
+
+  // Interprocedural passes override this to see the whole module; by
+  // default every defined function is transformed on its own.
+  virtual bool runOnModule(ir::Module &module) {
+    bool changed{false};
+    for (std::unique_ptr<ir::Function> &function : module.functions)
+      if (!function->external)
+        changed |= run(*function);
+    return changed;
+  }
+
+  // A fresh instance for transforming other functions at the same time, on
+  // other threads. Passes that need to see the whole module have none.
+  virtual std::unique_ptr<Pass> clone() const { return nullptr; }
+
+  // Adds what the pass found to the optimisation report.
+  virtual void report(std::ostream &) const {}
+};
+
+} // namespace opt
+
+#endif
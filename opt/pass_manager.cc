@@ -0,0 +1,185 @@
+#include "pass_manager.hpp"
+#include "const_eval.hpp"
+#include "copy_propagation.hpp"
+#include "dce.hpp"
+#include "escape_analysis.hpp"
+#include "global_dce.hpp"
+#include "global_promotion.hpp"
+#include "gvn.hpp"
+#include "inliner.hpp"
+#include "licm.hpp"
+#include "sccp.hpp"
+#include "strength_reduction.hpp"
+#include "tail_recursion.hpp"
+#include "vectorizer.hpp"
+#include <chrono>
+#include <functional>
+#include <format>
+
+namespace opt {
+
+size_t instructionCount(const ir::Module &module) {
+  size_t count{0};
+  for (const std::unique_ptr<ir::Function> &function : module.functions)
+    count += function->instructionCount();
+  return count;
+}
+
+static void addScalarPasses(PassManager &manager) {
+  manager.add(std::make_unique<Sccp>());
+  manager.add(std::make_unique<GlobalValueNumbering>());
+  manager.add(std::make_unique<CopyPropagation>());
+  manager.add(std::make_unique<DeadCodeElimination>());
+}
+
+static void addLoopPasses(PassManager &manager) {
+  manager.add(std::make_unique<LoopInvariantCodeMotion>());
+  // vector loops address their elements like the scalar loops do, so the
+  // strength reduction after it serves both
+  manager.add(std::make_unique<Vectorizer>());
+  manager.add(std::make_unique<StrengthReduction>());
+  manager.add(std::make_unique<CopyPropagation>());
+  manager.add(std::make_unique<DeadCodeElimination>());
+}
+
+void addPipeline(PassManager &manager, int level, bool loopPasses) {
+  if (level < 1)
+    return;
+  addScalarPasses(manager);
+  if (level < 2)
+    return;
+  // calls to pure functions are folded while their arguments are still
+  // plain constants; callees are cleaned up before their size is judged,
+  // and the inlined code is folded again in its new context
+  manager.add(std::make_unique<ConstantEvaluation>());
+  manager.add(std::make_unique<TailRecursion>());
+  manager.add(std::make_unique<Inliner>());
+  // the whole-program passes see the call graph left after inlining
+  manager.add(std::make_unique<GlobalPromotion>());
+  manager.add(std::make_unique<GlobalDeadCodeElimination>());
+  manager.add(std::make_unique<EscapeAnalysis>());
+  addScalarPasses(manager);
+  if (loopPasses)
+    addLoopPasses(manager);
+}
+
+void addFunctionPipeline(PassManager &manager, int level) {
+  if (level < 1)
+    return;
+  addScalarPasses(manager);
+  if (level >= 2)
+    addLoopPasses(manager);
+}
+
+void PassManager::add(std::unique_ptr<Pass> pass) {
+  passes.push_back(std::move(pass));
+}
+
+void PassManager::run(ir::Module &module, support::ThreadPool *pool) {
+  statistics.assign(passes.size(), {});
+  for (size_t i = 0; i < passes.size();) {
+    // a run of passes that work function by function goes to the pool as
+    // one task per function
+    size_t end{i};
+    while (pool != nullptr && end < passes.size() && passes[end]->clone())
+      end++;
+    if (end > i) {
+      runInParallel(module, i, end, *pool);
+      i = end;
+      continue;
+    }
+
+    Statistics &stats{statistics[i]};
+    stats.before = instructionCount(module);
+    auto start{std::chrono::steady_clock::now()};
+    passes[i]->runOnModule(module);
+    stats.microseconds =
+        std::chrono::duration_cast<std::chrono::microseconds>(
+            std::chrono::steady_clock::now() - start)
+            .count();
+    stats.after = instructionCount(module);
+    i++;
+  }
+}
+
+void PassManager::run(ir::Function &function) {
+  statistics.resize(passes.size());
+  for (size_t i = 0; i < passes.size(); i++) {
+    Statistics &stats{statistics[i]};
+    stats.before += function.instructionCount();
+    auto start{std::chrono::steady_clock::now()};
+    passes[i]->run(function);
+    stats.microseconds +=
+        std::chrono::duration_cast<std::chrono::microseconds>(
+            std::chrono::steady_clock::now() - start)
+            .count();
+    stats.after += function.instructionCount();
+  }
+}
+
+// Every task runs passes [first, last) over one function with instances of
+// its own. The times reported add up the time spent on every function.
+void PassManager::runInParallel(ir::Module &module, size_t first, size_t last,
+                                support::ThreadPool &pool) {
+  size_t count{module.functions.size()};
+  std::vector<std::vector<Statistics>> perFunction(
+      count, std::vector<Statistics>(last - first));
+  std::vector<std::function<void()>> tasks;
+  for (size_t f = 0; f < count; f++) {
+    if (module.functions[f]->external)
+      continue;
+    tasks.push_back([&, f] {
+      ir::Function &function{*module.functions[f]};
+      for (size_t i = first; i < last; i++) {
+        std::unique_ptr<Pass> pass{passes[i]->clone()};
+        Statistics &stats{perFunction[f][i - first]};
+        stats.before = function.instructionCount();
+        auto start{std::chrono::steady_clock::now()};
+        pass->run(function);
+        stats.microseconds =
+            std::chrono::duration_cast<std::chrono::microseconds>(
+                std::chrono::steady_clock::now() - start)
+                .count();
+        stats.after = function.instructionCount();
+      }
+    });
+  }
+  pool.run(std::move(tasks));
+
+  for (const std::vector<Statistics> &function : perFunction)
+    for (size_t i = first; i < last; i++) {
+      const Statistics &stats{function[i - first]};
+      statistics[i].before += stats.before;
+      statistics[i].after += stats.after;
+      statistics[i].microseconds += stats.microseconds;
+    }
+}
+
+void PassManager::report(std::ostream &out) const {
+  out << std::format("{:<20} {:>10} {:>22}\n", "Pass", "Time (us)",
+                     "Instructions");
+  int64_t total{0};
+  for (size_t i = 0; i < passes.size(); i++) {
+    const Statistics &stats{statistics[i]};
+    total += stats.microseconds;
+    out << std::format("{:<20} {:>10} {:>22}\n", passes[i]->name(),
+                       stats.microseconds,
+                       std::format("{} -> {}", stats.before, stats.after));
+  }
+  if (statistics.empty())
+    return;
+
+  size_t before{statistics.front().before};
+  size_t after{statistics.back().after};
+  // inlining may well grow the code
+  double change{before == 0 ? 0.0
+                            : 100.0 * (static_cast<double>(after) -
+                                       static_cast<double>(before)) /
+                                  static_cast<double>(before)};
+  out << std::format("Total: {} us, {} -> {} instructions ({:+.1f}%)\n", total,
+                     before, after, change);
+  for (const std::unique_ptr<Pass> &pass : passes)
+    pass->report(out);
+}
+
+} // namespace opt
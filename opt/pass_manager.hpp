@@ -0,0 +1,53 @@
+#ifndef PASS_MANAGER_H
+#define PASS_MANAGER_H
+
+#include "../ir/ir.hpp"
+#include "../support/thread_pool.hpp"
+#include "pass.hpp"
+#include <cstdint>
+#include <memory>
+#include <ostream>
+#include <vector>
+
+namespace opt {
+
+// Runs passes in order over every defined function of a module, recording
+// how long each pass took and how many instructions it removed. Given a
+// thread pool, consecutive passes that transform one function at a time run
+// on all functions in parallel; interprocedural passes wait for them.
+class PassManager {
+private:
+  struct Statistics {
+    int64_t microseconds{0};
+    size_t before{0};
+    size_t after{0};
+  };
+
+  std::vector<std::unique_ptr<Pass>> passes;
+  std::vector<Statistics> statistics;
+
+  void runInParallel(ir::Module &module, size_t first, size_t last,
+                     support::ThreadPool &pool);
+
+public:
+  void add(std::unique_ptr<Pass> pass);
+  void run(ir::Module &module, support::ThreadPool *pool = nullptr);
+  // Runs the passes on one function on its own, for pipelines that need
+  // nothing else (addFunctionPipeline). Statistics add up over the calls.
+  void run(ir::Function &function);
+  void report(std::ostream &out) const;
+};
+
+// Adds the passes of optimisation level `level` (0 adds none). The loop
+// passes of -O2 can be left out to measure what they gain.
+void addPipeline(PassManager &manager, int level, bool loopPasses = true);
+// Adds the passes of optimisation level `level` that transform a function
+// without looking at any other, for compiling functions one at a time before
+// the rest of the program is known.
+void addFunctionPipeline(PassManager &manager, int level);
+
+size_t instructionCount(const ir::Module &module);
+
+} // namespace opt
+
+#endif
@@ -0,0 +1,241 @@
+#include "sccp.hpp"
+#include "fold.hpp"
+
+namespace opt {
+
+using ir::BlockId;
+using ir::Op;
+using ir::Value;
+using Kind = Sccp::Lattice::Kind;
+
+static Sccp::Lattice constant(int64_t value) {
+  return {Kind::CONSTANT, value};
+}
+
+static constexpr Sccp::Lattice BOTTOM{Kind::BOTTOM, 0};
+
+bool Sccp::run(ir::Function &fn) {
+  function = &fn;
+  lattice.assign(fn.insts.size(), {});
+  executableBlocks.assign(fn.blocks.size(), false);
+  executableEdges.assign(fn.blocks.size(), {});
+  for (BlockId block = 0; block < fn.blocks.size(); block++)
+    executableEdges[block].assign(fn.blocks[block].preds.size(), false);
+  flowWorklist.clear();
+  ssaWorklist.clear();
+
+  buildUsers();
+  solve();
+  return rewrite();
+}
+
+void Sccp::buildUsers() {
+  userStart.assign(function->insts.size() + 1, 0);
+  for (const ir::Block &block : function->blocks)
+    for (Value value : block.insts)
+      function->forEachOperand(
+          value, [&](Value operand) { userStart[operand + 1]++; });
+  for (size_t i = 1; i < userStart.size(); i++)
+    userStart[i] += userStart[i - 1];
+
+  users.assign(userStart.back(), ir::NO_VALUE);
+  std::vector<uint32_t> fill(userStart.begin(), userStart.end() - 1);
+  for (const ir::Block &block : function->blocks)
+    for (Value value : block.insts)
+      function->forEachOperand(
+          value, [&](Value operand) { users[fill[operand]++] = value; });
+}
+
+void Sccp::markEdge(BlockId from, BlockId to) {
+  flowWorklist.emplace_back(from, to);
+}
+
+Sccp::Lattice Sccp::evaluate(const ir::Inst &inst) const {
+  if (inst.type == ir::Type::VEC)
+    return BOTTOM;
+  switch (inst.op) {
+  case Op::CONST:
+    return constant(inst.imm);
+  case Op::ADD:
+  case Op::SUB:
+  case Op::MUL:
+  case Op::DIV:
+  case Op::REM:
+  case Op::EQ:
+  case Op::NE:
+  case Op::LT:
+  case Op::LE:
+  case Op::GT:
+  case Op::GE: {
+    Lattice lhs{lattice[inst.a]};
+    Lattice rhs{lattice[inst.b]};
+    if (lhs.kind == Kind::BOTTOM || rhs.kind == Kind::BOTTOM)
+      return BOTTOM;
+    if (lhs.kind == Kind::TOP || rhs.kind == Kind::TOP)
+      return {};
+
+    // trapping divisions are left to run time
+    std::optional<int64_t> folded{
+        foldBinary(inst.op, inst.type, lhs.value, rhs.value)};
+    return folded ? constant(*folded) : BOTTOM;
+  }
+  case Op::SEXT:
+  case Op::COPY:
+    // narrow constants are already held sign-extended
+    return lattice[inst.a];
+  case Op::TRUNC: {
+    Lattice operand{lattice[inst.a]};
+    if (operand.kind != Kind::CONSTANT)
+      return operand;
+    return constant(wrap(inst.type, static_cast<uint64_t>(operand.value)));
+  }
+  default:
+    // parameters, addresses, loads and calls are not known
+    return BOTTOM;
+  }
+}
+
+void Sccp::visitPhi(Value value) {
+  const ir::Inst &inst{function->insts[value]};
+  std::span<const Value> incoming{function->extraOperands(value)};
+  const std::vector<bool> &executable{executableEdges[inst.block]};
+
+  Lattice result{};
+  for (size_t i = 0; i < incoming.size() && result.kind != Kind::BOTTOM; i++) {
+    if (!executable[i])
+      continue;
+    Lattice operand{lattice[incoming[i]]};
+    if (operand.kind == Kind::TOP)
+      continue;
+    if (result.kind == Kind::TOP)
+      result = operand;
+    else if (result != operand)
+      result = BOTTOM;
+  }
+
+  if (result != lattice[value]) {
+    lattice[value] = result;
+    ssaWorklist.push_back(value);
+  }
+}
+
+void Sccp::visit(Value value) {
+  const ir::Inst &inst{function->insts[value]};
+  const std::vector<BlockId> &succs{function->blocks[inst.block].succs};
+
+  switch (inst.op) {
+  case Op::PHI:
+    visitPhi(value);
+    return;
+  case Op::BR:
+    markEdge(inst.block, succs[0]);
+    return;
+  case Op::CONDBR: {
+    Lattice condition{lattice[inst.a]};
+    if (condition.kind == Kind::CONSTANT)
+      markEdge(inst.block, succs[condition.value != 0 ? 0 : 1]);
+    else if (condition.kind == Kind::BOTTOM) {
+      markEdge(inst.block, succs[0]);
+      markEdge(inst.block, succs[1]);
+    }
+    return;
+  }
+  case Op::RET:
+  case Op::STORE:
+  case Op::MEMCPY:
+  case Op::NOP:
+    return;
+  default:
+    break;
+  }
+
+  Lattice result{evaluate(inst)};
+  if (result != lattice[value]) {
+    lattice[value] = result;
+    ssaWorklist.push_back(value);
+  }
+}
+
+void Sccp::solve() {
+  executableBlocks[0] = true;
+  for (Value value : function->blocks[0].insts)
+    visit(value);
+
+  while (!flowWorklist.empty() || !ssaWorklist.empty()) {
+    while (!flowWorklist.empty()) {
+      auto [from, to]{flowWorklist.back()};
+      flowWorklist.pop_back();
+
+      const std::vector<BlockId> &preds{function->blocks[to].preds};
+      bool fresh{false};
+      for (size_t i = 0; i < preds.size(); i++)
+        if (preds[i] == from && !executableEdges[to][i]) {
+          executableEdges[to][i] = true;
+          fresh = true;
+        }
+      if (!fresh)
+        continue;
+
+      // a newly executable block is evaluated in full, otherwise only its
+      // phis see a new incoming edge
+      bool first{!executableBlocks[to]};
+      executableBlocks[to] = true;
+      for (Value value : function->blocks[to].insts)
+        if (first || function->insts[value].op == Op::PHI)
+          visit(value);
+    }
+
+    while (!ssaWorklist.empty()) {
+      Value value{ssaWorklist.back()};
+      ssaWorklist.pop_back();
+      for (uint32_t i = userStart[value]; i < userStart[value + 1]; i++)
+        if (executableBlocks[function->insts[users[i]].block])
+          visit(users[i]);
+    }
+  }
+}
+
+bool Sccp::rewrite() {
+  bool changed{false};
+
+  for (BlockId block = 0; block < function->blocks.size(); block++) {
+    if (!executableBlocks[block])
+      continue;
+
+    bool phis{false};
+    for (Value value : function->blocks[block].insts) {
+      ir::Inst &inst{function->insts[value]};
+      if (inst.op == Op::CONST || !inst.hasResult() ||
+          lattice[value].kind != Kind::CONSTANT)
+        continue;
+      phis |= inst.op == Op::PHI;
+      inst.op = Op::CONST;
+      inst.a = ir::NO_VALUE;
+      inst.b = ir::NO_VALUE;
+      inst.count = 0;
+      inst.imm = lattice[value].value;
+      changed = true;
+    }
+    if (phis)
+      function->sortPhis(block);
+
+    Value terminator{function->terminator(block)};
+    ir::Inst &branch{function->insts[terminator]};
+    if (branch.op != Op::CONDBR || lattice[branch.a].kind != Kind::CONSTANT)
+      continue;
+    const std::vector<BlockId> &succs{function->blocks[block].succs};
+    BlockId taken{succs[lattice[branch.a].value != 0 ? 0 : 1]};
+    BlockId dropped{succs[lattice[branch.a].value != 0 ? 1 : 0]};
+    function->removeEdge(block, dropped);
+    function->blocks[block].succs = {taken};
+    branch.op = Op::BR;
+    branch.a = ir::NO_VALUE;
+    changed = true;
+  }
+
+  size_t blocks{function->blocks.size()};
+  function->removeUnreachableBlocks();
+  return changed || function->blocks.size() != blocks;
+}
+
+} // namespace opt
@@ -0,0 +1,57 @@
+#ifndef SCCP_H
+#define SCCP_H
+
+#include "pass.hpp"
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+namespace opt {
+
+// Sparse conditional constant propagation (Wegman and Zadeck). Values are
+// evaluated optimistically over the lattice TOP > constant > BOTTOM, only
+// along control-flow edges found to be executable, so constants flowing
+// around loops and through branches with constant conditions are found.
+// Constant values become CONST instructions, branches on constants become
+// jumps and blocks that never execute are deleted.
+class Sccp : public Pass {
+public:
+  struct Lattice {
+    enum class Kind : uint8_t { TOP, CONSTANT, BOTTOM };
+    Kind kind{Kind::TOP};
+    int64_t value{0};
+
+    bool operator==(const Lattice &) const = default;
+  };
+
+private:
+  ir::Function *function{nullptr};
+  std::vector<Lattice> lattice;
+  std::vector<bool> executableBlocks;
+  // Per block, whether the edge from each predecessor is executable.
+  std::vector<std::vector<bool>> executableEdges;
+  // Users of each value in compressed rows.
+  std::vector<uint32_t> userStart;
+  std::vector<ir::Value> users;
+  std::vector<std::pair<ir::BlockId, ir::BlockId>> flowWorklist;
+  std::vector<ir::Value> ssaWorklist;
+
+  void buildUsers();
+  void markEdge(ir::BlockId from, ir::BlockId to);
+  void visit(ir::Value value);
+  void visitPhi(ir::Value value);
+  Lattice evaluate(const ir::Inst &inst) const;
+  void solve();
+  bool rewrite();
+
+public:
+  std::string_view name() const override { return "sccp"; }
+  bool run(ir::Function &function) override;
+  std::unique_ptr<Pass> clone() const override {
+    return std::make_unique<Sccp>();
+  }
+};
+
+} // namespace opt
+
+#endif
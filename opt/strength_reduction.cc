@@ -0,0 +1,197 @@
+#include "strength_reduction.hpp"
+#include <algorithm>
+
+namespace opt {
+
+using ir::BlockId;
+using ir::Op;
+using ir::Type;
+using ir::Value;
+
+static bool isConstant(const ir::Function &function, Value value) {
+  return function.insts[value].op == Op::CONST;
+}
+
+bool StrengthReduction::run(ir::Function &function) {
+  bool changed{insertPreheaders(function)};
+  info.analyse(function);
+  for (const Loop &loop : info.getLoops())
+    changed |= reduce(function, loop);
+  return changed;
+}
+
+// Splits an I32 index into an induction variable plus a constant offset.
+Value StrengthReduction::indexOffset(const ir::Function &function, Value index,
+                                     int64_t &offset) const {
+  offset = 0;
+  if (inductions.contains(index))
+    return index;
+
+  const ir::Inst &inst{function.insts[index]};
+  if (inst.op != Op::ADD && inst.op != Op::SUB)
+    return ir::NO_VALUE;
+  if (inductions.contains(inst.a) && isConstant(function, inst.b)) {
+    offset = function.insts[inst.b].imm;
+    if (inst.op == Op::SUB)
+      offset = -offset;
+    return inst.a;
+  }
+  if (inst.op == Op::ADD && inductions.contains(inst.b) &&
+      isConstant(function, inst.a)) {
+    offset = function.insts[inst.a].imm;
+    return inst.b;
+  }
+  return ir::NO_VALUE;
+}
+
+// Recognises `base + sext(index) * scale` as lowered for array accesses.
+bool StrengthReduction::match(const ir::Function &function, const Loop &loop,
+                              Value address, Key &key) const {
+  const ir::Inst &inst{function.insts[address]};
+  if (inst.op != Op::ADD || inst.type != Type::PTR)
+    return false;
+
+  for (auto [base, offset] : {std::pair{inst.a, inst.b}, {inst.b, inst.a}}) {
+    if (loop.contains(function.insts[base].block))
+      continue;
+
+    Value extended{offset};
+    int64_t scale{1};
+    const ir::Inst &product{function.insts[offset]};
+    if (product.op == Op::MUL) {
+      if (isConstant(function, product.b)) {
+        extended = product.a;
+        scale = function.insts[product.b].imm;
+      } else if (isConstant(function, product.a)) {
+        extended = product.b;
+        scale = function.insts[product.a].imm;
+      }
+    }
+    if (function.insts[extended].op != Op::SEXT)
+      continue;
+
+    int64_t constant;
+    Value variable{indexOffset(function, function.insts[extended].a, constant)};
+    if (variable == ir::NO_VALUE)
+      continue;
+    key = {base, variable, scale, constant};
+    return true;
+  }
+  return false;
+}
+
+bool StrengthReduction::reduce(ir::Function &function, const Loop &loop) {
+  const ir::Block &header{function.blocks[loop.header]};
+  if (loop.preheader == ir::NO_BLOCK || loop.latches.size() != 1 ||
+      header.preds.size() != 2)
+    return false;
+  BlockId preheader{loop.preheader};
+  BlockId latch{loop.latches[0]};
+  size_t entering{header.preds[0] == preheader ? size_t{0} : size_t{1}};
+
+  inductions.clear();
+  pointers.clear();
+  for (Value value : header.insts) {
+    const ir::Inst &phi{function.insts[value]};
+    if (phi.op != Op::PHI)
+      break;
+    if (phi.type != Type::I32)
+      continue;
+    std::span<const Value> incoming{function.extraOperands(value)};
+    const ir::Inst &next{function.insts[incoming[1 - entering]]};
+    if (next.op == Op::ADD && next.a == value && isConstant(function, next.b))
+      inductions[value] = {incoming[entering], function.insts[next.b].imm};
+    else if (next.op == Op::ADD && next.b == value &&
+             isConstant(function, next.a))
+      inductions[value] = {incoming[entering], function.insts[next.a].imm};
+    else if (next.op == Op::SUB && next.a == value &&
+             isConstant(function, next.b))
+      inductions[value] = {incoming[entering], -function.insts[next.b].imm};
+  }
+  if (inductions.empty())
+    return false;
+
+  auto insert{[&](BlockId block, ir::Inst inst) {
+    inst.block = block;
+    Value value{function.create(inst)};
+    std::vector<Value> &insts{function.blocks[block].insts};
+    insts.insert(insts.end() - 1, value);
+    return value;
+  }};
+  auto pointerConstant{[&](int64_t value) {
+    return insert(preheader,
+                  {.op = Op::CONST, .type = Type::PTR, .imm = value});
+  }};
+
+  bool changed{false};
+  for (BlockId block : loop.blocks) {
+    // instructions get added to the header and the latch on the way
+    std::vector<Value> insts{function.blocks[block].insts};
+    for (Value value : insts) {
+      Key key;
+      if (!match(function, loop, value, key))
+        continue;
+
+      auto [found, fresh]{pointers.try_emplace(key, ir::NO_VALUE)};
+      Value &pointer{found->second};
+      if (fresh) {
+        auto [base, variable, scale, offset]{key};
+        const Induction &induction{inductions.at(variable)};
+
+        // the address in the first iteration
+        Value start{base};
+        const ir::Inst &initial{function.insts[induction.start]};
+        if (initial.op == Op::CONST) {
+          int64_t bytes{(initial.imm + offset) * scale};
+          if (bytes != 0)
+            start = insert(preheader, {.op = Op::ADD,
+                                       .type = Type::PTR,
+                                       .a = base,
+                                       .b = pointerConstant(bytes)});
+        } else {
+          Value index{insert(preheader, {.op = Op::SEXT,
+                                         .type = Type::PTR,
+                                         .a = induction.start})};
+          if (offset != 0)
+            index = insert(preheader, {.op = Op::ADD,
+                                       .type = Type::PTR,
+                                       .a = index,
+                                       .b = pointerConstant(offset)});
+          if (scale != 1)
+            index = insert(preheader, {.op = Op::MUL,
+                                       .type = Type::PTR,
+                                       .a = index,
+                                       .b = pointerConstant(scale)});
+          start = insert(preheader, {.op = Op::ADD,
+                                     .type = Type::PTR,
+                                     .a = base,
+                                     .b = index});
+        }
+
+        pointer = function.create(
+            {.op = Op::PHI, .type = Type::PTR, .block = loop.header});
+        Value advanced{insert(latch, {.op = Op::ADD,
+                                      .type = Type::PTR,
+                                      .a = pointer,
+                                      .b = pointerConstant(induction.step *
+                                                           scale)})};
+        std::vector<Value> incoming(2);
+        incoming[entering] = start;
+        incoming[1 - entering] = advanced;
+        function.setExtraOperands(pointer, incoming);
+        std::vector<Value> &headerInsts{function.blocks[loop.header].insts};
+        headerInsts.insert(headerInsts.begin(), pointer);
+      }
+
+      // users keep referring to the address, now a copy of the pointer
+      function.insts[value] = {.op = Op::COPY,
+                               .type = Type::PTR,
+                               .block = block,
+                               .a = pointer};
+      changed = true;
+    }
+  }
+  return changed;
+}
+
+} // namespace opt
@@ -0,0 +1,48 @@
+#ifndef STRENGTH_REDUCTION_H
+#define STRENGTH_REDUCTION_H
+
+#include "loops.hpp"
+#include "pass.hpp"
+#include <cstdint>
+#include <map>
+#include <tuple>
+
+namespace opt {
+
+// Induction variable strength reduction for array walks. A basic induction
+// variable is a header phi stepped by a constant once per iteration; an
+// address `base + sext(i + c) * scale` with a loop-invariant base then
+// advances by step * scale per iteration, so it becomes a pointer phi of
+// its own that is incremented in the latch, and the multiply and sign
+// extension in the loop body die.
+class StrengthReduction : public Pass {
+private:
+  // base, induction variable, scale and offset
+  using Key = std::tuple<ir::Value, ir::Value, int64_t, int64_t>;
+
+  struct Induction {
+    ir::Value start;
+    int64_t step;
+  };
+
+  LoopInfo info;
+  std::map<ir::Value, Induction> inductions;
+  std::map<Key, ir::Value> pointers;
+
+  bool reduce(ir::Function &function, const Loop &loop);
+  bool match(const ir::Function &function, const Loop &loop, ir::Value address,
+             Key &key) const;
+  ir::Value indexOffset(const ir::Function &function, ir::Value index,
+                        int64_t &offset) const;
+
+public:
+  std::string_view name() const override { return "strength-reduction"; }
+  bool run(ir::Function &function) override;
+  std::unique_ptr<Pass> clone() const override {
+    return std::make_unique<StrengthReduction>();
+  }
+};
+
+} // namespace opt
+
+#endif
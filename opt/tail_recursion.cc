@@ -0,0 +1,208 @@
+#include "tail_recursion.hpp"
+#include <algorithm>
+
+namespace opt {
+
+using ir::BlockId;
+using ir::Op;
+using ir::Value;
+
+// Instructions that may run before the recursive call instead of after it:
+// they neither touch memory nor trap.
+static bool isMovable(Op op) {
+  switch (op) {
+  case Op::CONST:
+  case Op::GLOBAL:
+  case Op::STRING:
+  case Op::ADD:
+  case Op::SUB:
+  case Op::MUL:
+  case Op::EQ:
+  case Op::NE:
+  case Op::LT:
+  case Op::LE:
+  case Op::GT:
+  case Op::GE:
+  case Op::SEXT:
+  case Op::TRUNC:
+  case Op::COPY:
+    return true;
+  default:
+    return false;
+  }
+}
+
+bool TailRecursion::runOnModule(ir::Module &mod) {
+  module = &mod;
+  return Pass::runOnModule(mod);
+}
+
+bool TailRecursion::findSite(const ir::Function &function, BlockId block,
+                             uint32_t self, Op &accumulator) {
+  const std::vector<Value> &insts{function.blocks[block].insts};
+  const ir::Inst &ret{function.insts[insts.back()]};
+  if (ret.op != Op::RET)
+    return false;
+
+  size_t position{insts.size() - 1};
+  while (position-- > 0 && function.insts[insts[position]].op != Op::CALL)
+    ;
+  if (position >= insts.size() || function.insts[insts[position]].imm != self)
+    return false;
+  Value call{insts[position]};
+
+  // everything between the call and the return must be movable in front of
+  // the call, and at most one add or multiply may use its result
+  Value combine{ir::NO_VALUE};
+  for (size_t i = position + 1; i + 1 < insts.size(); i++) {
+    const ir::Inst &inst{function.insts[insts[i]]};
+    if (!isMovable(inst.op))
+      return false;
+    if (combine != ir::NO_VALUE && (inst.a == combine || inst.b == combine))
+      return false;
+    if (inst.a != call && inst.b != call)
+      continue;
+    if (combine != ir::NO_VALUE || (inst.op != Op::ADD && inst.op != Op::MUL) ||
+        inst.type != ir::Type::I32 || inst.a == inst.b)
+      return false;
+    combine = insts[i];
+  }
+
+  if (combine == ir::NO_VALUE) {
+    Value result{function.insts[call].hasResult() ? call : ir::NO_VALUE};
+    if (ret.a != result)
+      return false;
+  } else {
+    Op op{function.insts[combine].op};
+    if (ret.a != combine || (accumulator != Op::NOP && accumulator != op))
+      return false;
+    accumulator = op;
+  }
+
+  sites.push_back({block, call, combine});
+  return true;
+}
+
+void TailRecursion::transform(ir::Function &function, Op accumulator) {
+  // the entry block keeps the parameters and everything else moves into the
+  // new loop header
+  BlockId header{function.newBlock()};
+  ir::Block &entry{function.blocks[0]};
+  ir::Block &loop{function.blocks[header]};
+  std::vector<Value> params;
+  for (Value value : entry.insts) {
+    if (function.insts[value].op == Op::PARAM) {
+      params.push_back(value);
+      continue;
+    }
+    loop.insts.push_back(value);
+    function.insts[value].block = header;
+  }
+  entry.insts = params;
+  loop.succs = std::move(entry.succs);
+  entry.succs.clear();
+  // the header runs once per call as the entry did, recursive ones included
+  loop.count = entry.count;
+  loop.taken = entry.taken;
+  entry.taken = ir::NO_COUNT;
+  for (BlockId succ : loop.succs)
+    std::ranges::replace(function.blocks[succ].preds, BlockId{0}, header);
+
+  std::vector<Value> rename(function.insts.size(), ir::NO_VALUE);
+  std::vector<Value> phis;
+  std::vector<std::vector<Value>> incoming;
+  for (Value param : params) {
+    rename[param] = function.create({.op = Op::PHI,
+                                     .type = function.insts[param].type,
+                                     .block = header});
+    phis.push_back(rename[param]);
+    incoming.push_back({param});
+  }
+  for (const ir::Block &block : function.blocks)
+    for (Value value : block.insts)
+      function.forEachOperand(value, [&](Value &operand) {
+        if (rename[operand] != ir::NO_VALUE)
+          operand = rename[operand];
+      });
+
+  Value sum{ir::NO_VALUE};
+  if (accumulator != Op::NOP) {
+    Value identity{function.append(0, {.op = Op::CONST,
+                                       .type = ir::Type::I32,
+                                       .imm = accumulator == Op::ADD ? 0 : 1})};
+    sum = function.create(
+        {.op = Op::PHI, .type = ir::Type::I32, .block = header});
+    phis.push_back(sum);
+    incoming.push_back({identity});
+
+    // returns that leave the recursion add what the callers still owe
+    for (BlockId block = 0; block < function.blocks.size(); block++) {
+      Value terminator{function.terminator(block)};
+      if (terminator == ir::NO_VALUE ||
+          function.insts[terminator].op != Op::RET ||
+          std::ranges::any_of(
+              sites, [&](const Site &site) { return site.block == block; }))
+        continue;
+      Value combined{function.create({.op = accumulator,
+                                      .type = ir::Type::I32,
+                                      .block = block,
+                                      .a = sum,
+                                      .b = function.insts[terminator].a})};
+      std::vector<Value> &insts{function.blocks[block].insts};
+      insts.insert(insts.end() - 1, combined);
+      function.insts[terminator].a = combined;
+    }
+  }
+  std::vector<Value> &loopInsts{function.blocks[header].insts};
+  loopInsts.insert(loopInsts.begin(), phis.begin(), phis.end());
+  function.append(0, {.op = Op::BR});
+  function.addEdge(0, header);
+
+  for (const Site &site : sites) {
+    std::span<const Value> args{function.extraOperands(site.call)};
+    for (size_t i = 0; i < args.size(); i++)
+      incoming[i].push_back(args[i]);
+    if (sum != ir::NO_VALUE) {
+      if (site.combine != ir::NO_VALUE) {
+        // the call's result is replaced by the accumulator
+        ir::Inst &combine{function.insts[site.combine]};
+        (combine.a == site.call ? combine.a : combine.b) = sum;
+        incoming.back().push_back(site.combine);
+      } else
+        incoming.back().push_back(sum);
+    }
+
+    function.remove(function.terminator(site.block));
+    function.remove(site.call);
+    function.append(site.block, {.op = Op::BR});
+    function.addEdge(site.block, header);
+  }
+
+  for (size_t i = 0; i < phis.size(); i++)
+    function.setExtraOperands(phis[i], incoming[i]);
+}
+
+bool TailRecursion::run(ir::Function &function) {
+  // a loop back to the entry would need phis there already
+  if (!function.blocks[0].preds.empty())
+    return false;
+  // frames may not share stack slots whose addresses could be passed on
+  for (const ir::Block &block : function.blocks)
+    for (Value value : block.insts)
+      if (function.insts[value].op == Op::ALLOCA)
+        return false;
+
+  uint32_t self{module->functionIndex.at(function.name)};
+  sites.clear();
+  Op accumulator{Op::NOP};
+  for (BlockId block = 0; block < function.blocks.size(); block++)
+    if (!function.blocks[block].insts.empty())
+      findSite(function, block, self, accumulator);
+  if (sites.empty())
+    return false;
+
+  transform(function, accumulator);
+  return true;
+}
+
+} // namespace opt
@@ -0,0 +1,44 @@
+#ifndef TAIL_RECURSION_H
+#define TAIL_RECURSION_H
+
+#include "pass.hpp"
+#include <vector>
+
+namespace opt {
+
+// Turns self-recursive calls in tail position into jumps back to the top of
+// the function, so that such functions run in constant stack space. A new
+// loop header takes phis for the parameters; the entry block keeps only the
+// parameters and jumps to it.
+//
+// Calls whose result is combined with another value by an add or multiply
+// just before returning (`n * f(n - 1)`, `f(n - 1) + f(n - 2)`) are handled
+// too: the other operand is folded into an accumulator phi that starts at
+// the operation's identity, and every remaining return combines its value
+// with the accumulator. Both operations wrap, so reassociating is exact.
+class TailRecursion : public Pass {
+private:
+  struct Site {
+    ir::BlockId block;
+    ir::Value call;
+    // Add or multiply combining the call's result, NO_VALUE for a plain
+    // tail call.
+    ir::Value combine;
+  };
+
+  ir::Module *module{nullptr};
+  std::vector<Site> sites;
+
+  bool findSite(const ir::Function &function, ir::BlockId block,
+                uint32_t self, ir::Op &accumulator);
+  void transform(ir::Function &function, ir::Op accumulator);
+
+public:
+  std::string_view name() const override { return "tail-recursion"; }
+  bool run(ir::Function &function) override;
+  bool runOnModule(ir::Module &module) override;
+};
+
+} // namespace opt
+
+#endif
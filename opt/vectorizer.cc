@@ -0,0 +1,605 @@
+#include "vectorizer.hpp"
+#include <algorithm>
+
+namespace opt {
+
+using ir::BlockId;
+using ir::Op;
+using ir::Type;
+using ir::Value;
+
+static constexpr int VECTOR_BYTES = 16;
+// beyond this many pointer pairs the checks cost more than they are likely
+// to save
+static constexpr size_t MAX_CHECKS = 8;
+
+static bool isConstant(const ir::Function &function, Value value) {
+  return function.insts[value].op == Op::CONST;
+}
+
+// The stack slot or global an address points into, or NO_VALUE if unknown.
+static Value underlyingObject(const ir::Function &function, Value address) {
+  while (function.insts[address].op == Op::ADD)
+    address = function.insts[address].a;
+  Op op{function.insts[address].op};
+  return op == Op::ALLOCA || op == Op::GLOBAL ? address : ir::NO_VALUE;
+}
+
+static bool sameObject(const ir::Function &function, Value a, Value b) {
+  const ir::Inst &first{function.insts[a]};
+  const ir::Inst &second{function.insts[b]};
+  if (first.op == Op::GLOBAL && second.op == Op::GLOBAL)
+    return first.imm == second.imm;
+  return a == b;
+}
+
+bool Vectorizer::run(ir::Function &target) {
+  function = &target;
+  bool changed{insertPreheaders(target)};
+
+  // the analysis is redone after each loop, as its blocks change; the
+  // original loop is kept as the epilogue and must not be widened again
+  std::vector<BlockId> visited;
+  bool progress{true};
+  while (progress) {
+    progress = false;
+    info.analyse(target);
+    for (const Loop &candidate : info.getLoops()) {
+      if (std::ranges::find(visited, candidate.header) != visited.end())
+        continue;
+      visited.push_back(candidate.header);
+      if (vectorize(candidate)) {
+        changed = progress = true;
+        break;
+      }
+    }
+  }
+  return changed;
+}
+
+bool Vectorizer::isInvariant(Value value) const {
+  return !loop->contains(function->insts[value].block) ||
+         roles[value] == Role::INVARIANT;
+}
+
+bool Vectorizer::vectorize(const Loop &candidate) {
+  loop = &candidate;
+  if (candidate.blocks.size() != 2 || candidate.preheader == ir::NO_BLOCK ||
+      candidate.latches.size() != 1 ||
+      candidate.latches[0] != candidate.blocks[1])
+    return false;
+
+  const ir::Block &header{function->blocks[candidate.header]};
+  Value branch{function->terminator(candidate.header)};
+  const ir::Inst &condbr{function->insts[branch]};
+  if (header.preds.size() != 2 || condbr.op != Op::CONDBR ||
+      header.succs[0] != candidate.blocks[1])
+    return false;
+
+  // the header holds nothing but its phis and the exit test
+  size_t phis{0};
+  while (function->insts[header.insts[phis]].op == Op::PHI)
+    phis++;
+  if (header.insts.size() != phis + 2 || header.insts[phis] != condbr.a)
+    return false;
+
+  const ir::Inst &compare{function->insts[condbr.a]};
+  Value bound;
+  if (compare.op == Op::LT) {
+    induction = compare.a;
+    bound = compare.b;
+  } else if (compare.op == Op::GT) {
+    induction = compare.b;
+    bound = compare.a;
+  } else
+    return false;
+  const ir::Inst &phi{function->insts[induction]};
+  if (phi.op != Op::PHI || phi.block != candidate.header ||
+      phi.type != Type::I32 || loop->contains(function->insts[bound].block))
+    return false;
+
+  if (!analyse(condbr.a))
+    return false;
+  transform(bound);
+  return true;
+}
+
+// Splits an I32 index into the induction variable plus a constant offset.
+bool Vectorizer::matchIndex(Value index, int64_t &offset) const {
+  offset = 0;
+  if (index == induction)
+    return true;
+  const ir::Inst &inst{function->insts[index]};
+  if ((inst.op == Op::ADD || inst.op == Op::SUB) && inst.a == induction &&
+      isConstant(*function, inst.b)) {
+    offset = function->insts[inst.b].imm;
+    if (inst.op == Op::SUB)
+      offset = -offset;
+    return true;
+  }
+  if (inst.op == Op::ADD && inst.b == induction &&
+      isConstant(*function, inst.a)) {
+    offset = function->insts[inst.a].imm;
+    return true;
+  }
+  return false;
+}
+
+// Recognises `base + sext(i + c) * width` as lowered for array accesses.
+bool Vectorizer::matchAddress(Value address, Access &access) {
+  const ir::Inst &inst{function->insts[address]};
+  if (inst.op != Op::ADD || inst.type != Type::PTR ||
+      !loop->contains(inst.block))
+    return false;
+
+  for (auto [base, offset] : {std::pair{inst.a, inst.b}, {inst.b, inst.a}}) {
+    if (loop->contains(function->insts[base].block) &&
+        !isConstant(*function, base))
+      continue;
+
+    Value extended{offset};
+    Value product{ir::NO_VALUE};
+    int64_t scale{1};
+    const ir::Inst &multiply{function->insts[offset]};
+    if (multiply.op == Op::MUL) {
+      product = offset;
+      if (isConstant(*function, multiply.b)) {
+        extended = multiply.a;
+        scale = function->insts[multiply.b].imm;
+      } else if (isConstant(*function, multiply.a)) {
+        extended = multiply.b;
+        scale = function->insts[multiply.a].imm;
+      }
+    }
+    int64_t constant;
+    if (function->insts[extended].op != Op::SEXT || scale != width ||
+        !matchIndex(function->insts[extended].a, constant))
+      continue;
+
+    roles[address] = roles[extended] = Role::ADDRESS;
+    if (product != ir::NO_VALUE)
+      roles[product] = Role::ADDRESS;
+    roles[function->insts[extended].a] = Role::INDEX;
+    access.base = base;
+    access.offset = constant;
+    return true;
+  }
+  return false;
+}
+
+bool Vectorizer::analyse(Value compare) {
+  const ir::Block &header{function->blocks[loop->header]};
+  BlockId body{loop->blocks[1]};
+  size_t entering{header.preds[0] == loop->preheader ? size_t{0} : size_t{1}};
+
+  roles.assign(function->insts.size(), Role::NONE);
+  reductions.clear();
+  accesses.clear();
+  checks.clear();
+  increment = ir::NO_VALUE;
+  roles[compare] = roles[induction] = Role::INDEX;
+
+  for (Value value : header.insts) {
+    const ir::Inst &phi{function->insts[value]};
+    if (phi.op != Op::PHI)
+      break;
+    std::span<const Value> incoming{function->extraOperands(value)};
+    Value next{incoming[1 - entering]};
+    const ir::Inst &update{function->insts[next]};
+    if (update.block != body)
+      return false;
+
+    int64_t step;
+    if (value == induction) {
+      if (!matchIndex(next, step) || step != 1)
+        return false;
+      increment = next;
+      roles[next] = Role::INDEX;
+    } else if (phi.type == Type::I32 && update.type == Type::I32 &&
+               ((update.op == Op::ADD &&
+                 (update.a == value) != (update.b == value)) ||
+                (update.op == Op::SUB && update.a == value &&
+                 update.b != value))) {
+      reductions.push_back({value, next, incoming[entering]});
+      roles[value] = roles[next] = Role::REDUCTION;
+    } else
+      return false;
+  }
+  if (increment == ir::NO_VALUE)
+    return false;
+
+  // all accesses are to elements of one width, at unit stride
+  const std::vector<Value> &insts{function->blocks[body].insts};
+  width = 0;
+  for (Value value : insts) {
+    const ir::Inst &inst{function->insts[value]};
+    if (inst.op != Op::LOAD && inst.op != Op::STORE)
+      continue;
+    if (inst.type != Type::I8 && inst.type != Type::I32)
+      return false;
+    if (width != 0 && width != ir::sizeOf(inst.type))
+      return false;
+    width = ir::sizeOf(inst.type);
+  }
+  // char sums would need wider lanes than the chars they add up
+  if (width == 0 || (width == 1 && !reductions.empty()))
+    return false;
+
+  for (Value value : insts) {
+    const ir::Inst &inst{function->insts[value]};
+    if (inst.op != Op::LOAD && inst.op != Op::STORE)
+      continue;
+    Access access{value, ir::NO_VALUE, 0, inst.op == Op::STORE};
+    if (!matchAddress(inst.a, access))
+      return false;
+    accesses.push_back(access);
+  }
+
+  for (Value value : insts)
+    if (value != insts.back() && !classify(value))
+      return false;
+  return checkUsers() && checkDependences();
+}
+
+bool Vectorizer::classify(Value value) {
+  const ir::Inst &inst{function->insts[value]};
+  Role &role{roles[value]};
+  auto isData{[&](Value operand) {
+    return roles[operand] == Role::DATA || isInvariant(operand);
+  }};
+
+  switch (role) {
+  case Role::INDEX:
+  case Role::ADDRESS:
+    return true;
+  case Role::REDUCTION: {
+    bool first{roles[inst.a] == Role::REDUCTION &&
+               function->insts[inst.a].op == Op::PHI};
+    return isData(first ? inst.b : inst.a);
+  }
+  default:
+    break;
+  }
+
+  switch (inst.op) {
+  case Op::CONST:
+    role = Role::INVARIANT;
+    return true;
+  case Op::LOAD:
+    role = Role::DATA;
+    return true;
+  case Op::STORE:
+    role = Role::DATA;
+    return isData(inst.b);
+  case Op::ADD:
+  case Op::SUB:
+    // char arithmetic is done in ints and truncated, which only the low
+    // byte of every lane needs to get right
+    if (inst.type != Type::I32 && (inst.type != Type::I8 || width != 1))
+      return false;
+    role = Role::DATA;
+    return isData(inst.a) && isData(inst.b);
+  case Op::SEXT:
+    role = Role::DATA;
+    return width == 1 && inst.type == Type::I32 && isData(inst.a);
+  case Op::TRUNC:
+    role = Role::DATA;
+    return width == 1 && inst.type == Type::I8 && isData(inst.a);
+  default:
+    return false;
+  }
+}
+
+// Values in the loop may only be used the way they are going to be
+// rewritten: indices and addresses by address computations and as the
+// address of accesses, data lane-wise and each reduction by its update.
+bool Vectorizer::checkUsers() {
+  auto allowed{[&](Value user, Value operand) {
+    const ir::Inst &inst{function->insts[user]};
+    Role role{roles[user]};
+    bool address{(inst.op == Op::LOAD || inst.op == Op::STORE) &&
+                 inst.a == operand && inst.b != operand};
+    switch (roles[operand]) {
+    case Role::INVARIANT:
+      return true;
+    case Role::INDEX:
+    case Role::ADDRESS:
+      return role == Role::INDEX || role == Role::ADDRESS || address ||
+             inst.isTerminator();
+    case Role::DATA:
+      return !address && (role == Role::DATA ||
+                          (role == Role::REDUCTION && inst.op != Op::PHI));
+    case Role::REDUCTION:
+      for (const Reduction &reduction : reductions) {
+        if (reduction.phi == operand)
+          return user == reduction.update;
+        if (reduction.update == operand)
+          return user == reduction.phi;
+      }
+      return false;
+    default:
+      return false;
+    }
+  }};
+
+  for (BlockId block : loop->blocks)
+    for (Value user : function->blocks[block].insts) {
+      bool valid{true};
+      std::as_const(*function).forEachOperand(user, [&](Value operand) {
+        if (loop->contains(function->insts[operand].block))
+          valid &= allowed(user, operand);
+      });
+      if (!valid)
+        return false;
+    }
+  return true;
+}
+
+// A vector iteration does each access for all of its lanes before the next
+// one, which only reorders accesses to the same element made by one access
+// of an earlier scalar iteration and an access before it in the body.
+bool Vectorizer::checkDependences() {
+  int64_t lanes{VECTOR_BYTES / width};
+  for (size_t x = 0; x < accesses.size(); x++)
+    for (size_t y = x + 1; y < accesses.size(); y++) {
+      const Access &first{accesses[x]};
+      const Access &second{accesses[y]};
+      if (!first.store && !second.store)
+        continue;
+      if (first.base == second.base) {
+        int64_t distance{second.offset - first.offset};
+        if (distance > 0 && distance < lanes)
+          return false;
+        continue;
+      }
+      Value a{underlyingObject(*function, first.base)};
+      Value b{underlyingObject(*function, second.base)};
+      if (a != ir::NO_VALUE && b != ir::NO_VALUE &&
+          !sameObject(*function, a, b))
+        continue;
+      checks.emplace_back(x, y);
+    }
+  return checks.size() <= MAX_CHECKS;
+}
+
+void Vectorizer::transform(Value bound) {
+  ir::Function &f{*function};
+  BlockId preheader{loop->preheader};
+  BlockId header{loop->header};
+  BlockId body{loop->blocks[1]};
+  size_t entering{f.blocks[header].preds[0] == preheader ? size_t{0}
+                                                          : size_t{1}};
+  int64_t lanes{VECTOR_BYTES / width};
+  uint16_t lane{static_cast<uint16_t>(width)};
+
+  auto hoist{[&](ir::Inst inst) {
+    inst.block = preheader;
+    Value value{f.create(inst)};
+    std::vector<Value> &insts{f.blocks[preheader].insts};
+    insts.insert(insts.end() - 1, value);
+    return value;
+  }};
+  auto constant{[&](Type type, int64_t value) {
+    return hoist({.op = Op::CONST, .type = type, .imm = value});
+  }};
+  // constants left in the loop are rematerialised where they are needed
+  auto outside{[&](Value value) {
+    const ir::Inst &inst{f.insts[value]};
+    return loop->contains(inst.block) ? constant(inst.type, inst.imm) : value;
+  }};
+  auto start{[&](const Access &access) {
+    Value base{outside(access.base)};
+    if (access.offset == 0)
+      return base;
+    return hoist({.op = Op::ADD,
+                  .type = Type::PTR,
+                  .a = base,
+                  .b = constant(Type::PTR, access.offset * width)});
+  }};
+
+  Value first{f.extraOperands(induction)[entering]};
+
+  // the vector loop runs while all of its lanes pass the exit test, which
+  // is compared in 64 bits so that the adjusted bound cannot wrap
+  Value wideBound{hoist({.op = Op::SEXT, .type = Type::PTR, .a = bound})};
+  Value limit{hoist({.op = Op::SUB,
+                     .type = Type::PTR,
+                     .a = wideBound,
+                     .b = constant(Type::PTR, lanes - 1)})};
+  std::vector<Value> distances;
+  for (auto [x, y] : checks)
+    distances.push_back(hoist({.op = Op::SUB,
+                               .type = Type::PTR,
+                               .a = start(accesses[x]),
+                               .b = start(accesses[y])}));
+  Value zero{ir::NO_VALUE};
+  if (!reductions.empty())
+    zero = hoist({.op = Op::SPLAT,
+                  .type = Type::VEC,
+                  .aux = 4,
+                  .a = constant(Type::I32, 0)});
+
+  BlockId vectorHeader{f.newBlock()};
+  BlockId vectorBody{f.newBlock()};
+  BlockId vectorExit{f.newBlock()};
+  f.blocks[preheader].succs.clear();
+  f.blocks[header].preds[entering] = vectorExit;
+
+  // overlapping accesses less than a vector apart go to the scalar loop
+  BlockId from{preheader};
+  for (size_t k = 0; k < distances.size(); k++) {
+    BlockId above{f.newBlock()};
+    BlockId below{f.newBlock()};
+    f.addEdge(from, above);
+    Value ahead{f.append(above, {.op = Op::GE,
+                                 .type = Type::I32,
+                                 .a = distances[k],
+                                 .b = constant(Type::PTR, VECTOR_BYTES)})};
+    f.append(above, {.op = Op::CONDBR, .a = ahead});
+    Value behind{f.append(below, {.op = Op::LE,
+                                  .type = Type::I32,
+                                  .a = distances[k],
+                                  .b = constant(Type::PTR, -VECTOR_BYTES)})};
+    f.append(below, {.op = Op::CONDBR, .a = behind});
+    BlockId next{k + 1 < distances.size() ? f.newBlock() : vectorHeader};
+    f.addEdge(above, next);
+    f.addEdge(above, below);
+    f.addEdge(below, next);
+    f.addEdge(below, vectorExit);
+    if (next != vectorHeader) {
+      // both ways past this check meet before the next one
+      f.append(next, {.op = Op::BR});
+      from = next;
+    }
+  }
+  if (distances.empty())
+    f.addEdge(preheader, vectorHeader);
+
+  Value index{f.append(vectorHeader, {.op = Op::PHI, .type = Type::I32})};
+  std::vector<Value> accumulators;
+  for (size_t k = 0; k < reductions.size(); k++)
+    accumulators.push_back(f.append(
+        vectorHeader, {.op = Op::PHI, .type = Type::VEC, .aux = 4}));
+  Value wide{f.append(vectorHeader,
+                      {.op = Op::SEXT, .type = Type::PTR, .a = index})};
+  Value test{f.append(vectorHeader, {.op = Op::LT,
+                                     .type = Type::I32,
+                                     .a = wide,
+                                     .b = limit})};
+  f.append(vectorHeader, {.op = Op::CONDBR, .a = test});
+  f.addEdge(vectorHeader, vectorBody);
+  f.addEdge(vectorHeader, vectorExit);
+
+  std::map<Value, Value> vectors;
+  std::map<Value, Value> splats;
+  std::map<std::pair<Value, int64_t>, Value> addresses;
+  auto vector{[&](Value scalar) {
+    if (auto found{vectors.find(scalar)}; found != vectors.end())
+      return found->second;
+    auto [found, fresh]{splats.try_emplace(scalar, ir::NO_VALUE)};
+    if (fresh)
+      found->second = hoist({.op = Op::SPLAT,
+                             .type = Type::VEC,
+                             .aux = lane,
+                             .a = outside(scalar)});
+    return found->second;
+  }};
+  auto address{[&](Value value) {
+    const Access &access{*std::ranges::find(accesses, value, &Access::inst)};
+    auto [found, fresh]{
+        addresses.try_emplace({access.base, access.offset}, ir::NO_VALUE)};
+    if (fresh) {
+      Value offset{index};
+      if (access.offset != 0)
+        offset = f.append(vectorBody,
+                          {.op = Op::ADD,
+                           .type = Type::I32,
+                           .a = index,
+                           .b = constant(Type::I32, access.offset)});
+      offset = f.append(vectorBody,
+                        {.op = Op::SEXT, .type = Type::PTR, .a = offset});
+      if (width != 1)
+        offset = f.append(vectorBody, {.op = Op::MUL,
+                                       .type = Type::PTR,
+                                       .a = offset,
+                                       .b = constant(Type::PTR, width)});
+      found->second = f.append(vectorBody, {.op = Op::ADD,
+                                            .type = Type::PTR,
+                                            .a = outside(access.base),
+                                            .b = offset});
+    }
+    return found->second;
+  }};
+
+  std::vector<Value> updates(reductions.size(), ir::NO_VALUE);
+  std::vector<Value> insts{f.blocks[body].insts};
+  for (Value value : insts) {
+    ir::Inst inst{f.insts[value]};
+    if (roles[value] == Role::REDUCTION) {
+      size_t k{0};
+      while (reductions[k].update != value)
+        k++;
+      Value other{inst.a == reductions[k].phi ? inst.b : inst.a};
+      updates[k] = f.append(vectorBody, {.op = inst.op,
+                                         .type = Type::VEC,
+                                         .aux = 4,
+                                         .a = accumulators[k],
+                                         .b = vector(other)});
+      continue;
+    }
+    if (roles[value] != Role::DATA)
+      continue;
+
+    switch (inst.op) {
+    case Op::LOAD:
+      vectors[value] = f.append(vectorBody, {.op = Op::LOAD,
+                                             .type = Type::VEC,
+                                             .aux = lane,
+                                             .a = address(value)});
+      break;
+    case Op::STORE:
+      f.append(vectorBody, {.op = Op::STORE,
+                            .type = Type::VEC,
+                            .aux = lane,
+                            .a = address(value),
+                            .b = vector(inst.b)});
+      break;
+    case Op::ADD:
+    case Op::SUB:
+      vectors[value] = f.append(vectorBody, {.op = inst.op,
+                                             .type = Type::VEC,
+                                             .aux = lane,
+                                             .a = vector(inst.a),
+                                             .b = vector(inst.b)});
+      break;
+    default:
+      // extensions and truncations leave the low byte of the lanes alone
+      vectors[value] = vector(inst.a);
+    }
+  }
+  Value next{f.append(vectorBody, {.op = Op::ADD,
+                                   .type = Type::I32,
+                                   .a = index,
+                                   .b = constant(Type::I32, lanes)})};
+  f.append(vectorBody, {.op = Op::BR});
+  f.addEdge(vectorBody, vectorHeader);
+
+  auto setIncoming{[&](Value phi, BlockId block, BlockId loopPred,
+                       Value carried, Value initial) {
+    std::vector<Value> incoming;
+    for (BlockId pred : f.blocks[block].preds)
+      incoming.push_back(pred == loopPred ? carried : initial);
+    f.setExtraOperands(phi, incoming);
+  }};
+  setIncoming(index, vectorHeader, vectorBody, next, first);
+  for (size_t k = 0; k < reductions.size(); k++)
+    setIncoming(accumulators[k], vectorHeader, vectorBody, updates[k], zero);
+
+  // the scalar loop carries on from where the vector loop stopped, or
+  // from the start if a check failed
+  Value last{index};
+  std::vector<Value> partial{accumulators};
+  if (f.blocks[vectorExit].preds.size() > 1) {
+    last = f.append(vectorExit, {.op = Op::PHI, .type = Type::I32});
+    setIncoming(last, vectorExit, vectorHeader, index, first);
+    for (size_t k = 0; k < reductions.size(); k++) {
+      partial[k] = f.append(vectorExit,
+                            {.op = Op::PHI, .type = Type::VEC, .aux = 4});
+      setIncoming(partial[k], vectorExit, vectorHeader, accumulators[k], zero);
+    }
+  }
+  f.extraOperands(induction)[entering] = last;
+  for (size_t k = 0; k < reductions.size(); k++) {
+    Value sum{f.append(vectorExit,
+                       {.op = Op::REDUCE, .type = Type::I32, .a = partial[k]})};
+    f.extraOperands(reductions[k].phi)[entering] =
+        f.append(vectorExit, {.op = Op::ADD,
+                              .type = Type::I32,
+                              .a = reductions[k].start,
+                              .b = sum});
+  }
+  f.append(vectorExit, {.op = Op::BR});
+  f.blocks[vectorExit].succs.push_back(header);
+}
+
+} // namespace opt
@@ -0,0 +1,80 @@
+#ifndef VECTORIZER_H
+#define VECTORIZER_H
+
+#include "loops.hpp"
+#include "pass.hpp"
+#include <cstdint>
+#include <map>
+#include <utility>
+#include <vector>
+
+namespace opt {
+
+// Loop vectorization for counted loops over int and char arrays. A loop made
+// of a header testing `i < n` and one body block advancing i by one is
+// widened to 128-bit vectors of 4 ints or 16 chars: unit-stride loads and
+// stores become vector ones, additions and subtractions work lane-wise, and
+// an int sum carried around the loop is kept as a vector of partial sums
+// that is added up when the vector loop is done. The original loop stays
+// behind it and runs the remaining iterations. Accesses through pointers
+// that may overlap are guarded by run-time distance checks falling back to
+// the scalar loop.
+class Vectorizer : public Pass {
+private:
+  // what an instruction of the loop becomes in the vector loop
+  enum class Role : uint8_t {
+    NONE,
+    INVARIANT,
+    INDEX,     // the induction variable plus a constant, used in addresses
+    ADDRESS,   // rebuilt from the vector loop's induction variable
+    DATA,      // lane-wise
+    REDUCTION, // a sum's phi and update
+  };
+
+  // `base + (i + offset) * width` accessed in the loop body.
+  struct Access {
+    ir::Value inst;
+    ir::Value base;
+    int64_t offset;
+    bool store;
+  };
+
+  struct Reduction {
+    ir::Value phi;
+    ir::Value update;
+    ir::Value start;
+  };
+
+  LoopInfo info;
+  ir::Function *function{nullptr};
+  const Loop *loop{nullptr};
+  ir::Value induction{ir::NO_VALUE};
+  ir::Value increment{ir::NO_VALUE};
+  int width{0};
+  std::vector<Role> roles;
+  std::vector<Access> accesses;
+  std::vector<Reduction> reductions;
+  // pairs of accesses whose distance is checked before the vector loop
+  std::vector<std::pair<size_t, size_t>> checks;
+
+  bool vectorize(const Loop &candidate);
+  bool analyse(ir::Value compare);
+  bool classify(ir::Value value);
+  bool checkUsers();
+  bool checkDependences();
+  bool matchIndex(ir::Value index, int64_t &offset) const;
+  bool matchAddress(ir::Value address, Access &access);
+  bool isInvariant(ir::Value value) const;
+  void transform(ir::Value bound);
+
+public:
+  std::string_view name() const override { return "vectorize"; }
+  bool run(ir::Function &function) override;
+  std::unique_ptr<Pass> clone() const override {
+    return std::make_unique<Vectorizer>();
+  }
+};
+
+} // namespace opt
+
+#endif
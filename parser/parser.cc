@@ -0,0 +1,569 @@
+#include "parser.hpp"
+#include <charconv>
+#include <format>
+#include <iostream>
+
+namespace parser {
+
+using lexer::Token;
+using lexer::TokenClass;
+
+int Parser::getErrorCount() { return errors; }
+
+void Parser::error(std::string_view msg) {
+  const lexer::Position pos{peek().position};
+  if (pos.x == lastError.x && pos.y == lastError.y)
+    return;
+  lastError = pos;
+  errors++;
+  std::cout << msg << std::endl;
+}
+
+const Token &Parser::peek(size_t k) {
+  while (lookahead.size() <= k) {
+    if (!lookahead.empty() && lookahead.back().type == TokenClass::END) {
+      lookahead.push_back(lookahead.back());
+      continue;
+    }
+    lookahead.push_back(tokeniser.nextToken());
+  }
+  return lookahead[k];
+}
+
+Token Parser::next() {
+  peek();
+  Token token{lookahead.front()};
+  if (token.type != TokenClass::END) {
+    lookahead.pop_front();
+    // the class and text of every token, each followed by a separator
+    auto mix{[&](uint8_t byte) {
+      tokenHash ^= byte;
+      tokenHash *= 1099511628211u;
+    }};
+    mix(static_cast<uint8_t>(token.type));
+    for (char c : token.str)
+      mix(static_cast<uint8_t>(c));
+    mix(0);
+  }
+  return token;
+}
+
+bool Parser::accept(TokenClass type) {
+  if (peek().type != type)
+    return false;
+  next();
+  return true;
+}
+
+Token Parser::expect(TokenClass type) {
+  const Token &token{peek()};
+  if (token.type == type)
+    return next();
+  error(std::format("Parsing error: expected ({}) but found ({}) at {}:{}!",
+                    lexer::toString(type), token.str, token.position.x,
+                    token.position.y));
+  return Token{type, "", token.position.x, token.position.y};
+}
+
+// Skips tokens until the end of the current statement or declaration.
+void Parser::recover() {
+  while (true) {
+    TokenClass type{peek().type};
+    if (type == TokenClass::END || type == TokenClass::RBRA)
+      return;
+    next();
+    if (type == TokenClass::SC)
+      return;
+  }
+}
+
+bool Parser::isTypeStart(int k) {
+  TokenClass type{peek(k).type};
+  return type == TokenClass::INT || type == TokenClass::CHAR ||
+         type == TokenClass::VOID || type == TokenClass::STRUCT;
+}
+
+std::unique_ptr<ast::Program> Parser::parse() {
+  auto program{std::make_unique<ast::Program>()};
+  parseIncludes(*program);
+  while (parseDeclaration(*program))
+    ;
+  return program;
+}
+
+void Parser::parseIncludes(ast::Program &program) {
+  while (peek().type == TokenClass::INCLUDE)
+    parseInclude(program);
+}
+
+bool Parser::parseDeclaration(ast::Program &program) {
+  if (peek().type == TokenClass::END)
+    return false;
+
+  tokenHash = 14695981039346656037u;
+  if (peek().type == TokenClass::STRUCT &&
+      peek(1).type == TokenClass::IDENTIFIER &&
+      peek(2).type == TokenClass::LBRA) {
+    program.structs.push_back(parseStructDecl());
+    program.structs.back()->tokenHash = tokenHash;
+    return true;
+  }
+
+  if (!isTypeStart()) {
+    const Token &token{peek()};
+    error(std::format("Parsing error: expected declaration but found ({}) "
+                      "at {}:{}!",
+                      token.str, token.position.x, token.position.y));
+    next();
+    return true;
+  }
+
+  ast::TypeSpec spec{parseType()};
+  Token name{expect(TokenClass::IDENTIFIER)};
+
+  if (peek().type == TokenClass::LPAR) {
+    program.functions.push_back(parseFunDecl(std::move(spec), name));
+    program.functions.back()->tokenHash = tokenHash;
+    return true;
+  }
+
+  auto var{std::make_unique<ast::VarDecl>()};
+  var->typeSpec = std::move(spec);
+  parseArrayDims(var->typeSpec);
+  var->name = name.str;
+  var->pos = name.position;
+  var->isGlobal = true;
+  if (peek().type != TokenClass::SC) {
+    expect(TokenClass::SC);
+    recover();
+  } else
+    next();
+  var->tokenHash = tokenHash;
+  program.globals.push_back(std::move(var));
+  return true;
+}
+
+void Parser::parseInclude(ast::Program &program) {
+  expect(TokenClass::INCLUDE);
+  Token path{expect(TokenClass::STRING_LITERAL)};
+  program.includes.push_back(path.str);
+}
+
+ast::TypeSpec Parser::parseType() {
+  ast::TypeSpec spec;
+  Token token{next()};
+
+  switch (token.type) {
+  case TokenClass::INT:
+    spec.base = ast::BaseType::INT;
+    break;
+  case TokenClass::CHAR:
+    spec.base = ast::BaseType::CHAR;
+    break;
+  case TokenClass::VOID:
+    spec.base = ast::BaseType::VOID;
+    break;
+  case TokenClass::STRUCT:
+    spec.base = ast::BaseType::STRUCT;
+    spec.structName = expect(TokenClass::IDENTIFIER).str;
+    break;
+  default:
+    error(std::format("Parsing error: expected type but found ({}) at {}:{}!",
+                      token.str, token.position.x, token.position.y));
+  }
+
+  while (accept(TokenClass::ASTERIX))
+    spec.pointerDepth++;
+  return spec;
+}
+
+void Parser::parseArrayDims(ast::TypeSpec &spec) {
+  while (accept(TokenClass::LSBR)) {
+    Token size{expect(TokenClass::INT_LITERAL)};
+    int value{0};
+    std::from_chars(size.str.data(), size.str.data() + size.str.size(), value);
+    spec.arrayDims.push_back(value);
+    expect(TokenClass::RSBR);
+  }
+}
+
+ast::StructDeclPtr Parser::parseStructDecl() {
+  auto decl{std::make_unique<ast::StructDecl>()};
+  decl->pos = peek().position;
+  expect(TokenClass::STRUCT);
+  decl->name = expect(TokenClass::IDENTIFIER).str;
+  expect(TokenClass::LBRA);
+
+  do {
+    if (!isTypeStart()) {
+      const Token &token{peek()};
+      error(std::format("Parsing error: expected field declaration but found "
+                        "({}) at {}:{}!",
+                        token.str, token.position.x, token.position.y));
+      recover();
+      break;
+    }
+    decl->fields.push_back(parseVarDecl());
+  } while (isTypeStart());
+
+  expect(TokenClass::RBRA);
+  expect(TokenClass::SC);
+  return decl;
+}
+
+ast::VarDeclPtr Parser::parseVarDecl() {
+  auto var{std::make_unique<ast::VarDecl>()};
+  var->typeSpec = parseType();
+  Token name{expect(TokenClass::IDENTIFIER)};
+  var->name = name.str;
+  var->pos = name.position;
+  parseArrayDims(var->typeSpec);
+  if (peek().type != TokenClass::SC) {
+    expect(TokenClass::SC);
+    recover();
+  } else
+    next();
+  return var;
+}
+
+ast::FunDeclPtr Parser::parseFunDecl(ast::TypeSpec returnSpec, Token name) {
+  auto fun{std::make_unique<ast::FunDecl>()};
+  fun->returnSpec = std::move(returnSpec);
+  fun->name = name.str;
+  fun->pos = name.position;
+
+  expect(TokenClass::LPAR);
+  if (peek().type != TokenClass::RPAR) {
+    do {
+      auto param{std::make_unique<ast::VarDecl>()};
+      param->typeSpec = parseType();
+      Token paramName{expect(TokenClass::IDENTIFIER)};
+      param->name = paramName.str;
+      param->pos = paramName.position;
+      parseArrayDims(param->typeSpec);
+      fun->params.push_back(std::move(param));
+    } while (accept(TokenClass::COMMA));
+  }
+  expect(TokenClass::RPAR);
+
+  if (bodies)
+    fun->body = parseBlock();
+  else
+    skipBlock();
+  return fun;
+}
+
+std::unique_ptr<ast::Block> Parser::parseBlock() {
+  auto block{std::make_unique<ast::Block>(peek().position)};
+  expect(TokenClass::LBRA);
+
+  while (isTypeStart())
+    block->vars.push_back(parseVarDecl());
+
+  while (peek().type != TokenClass::RBRA && peek().type != TokenClass::END) {
+    const Token &start{peek()};
+    lexer::Position startPos{start.position};
+    block->stmts.push_back(parseStmt());
+    // guarantee progress so that a malformed statement cannot loop forever
+    if (peek().position.x == startPos.x && peek().position.y == startPos.y)
+      next();
+  }
+
+  expect(TokenClass::RBRA);
+  return block;
+}
+
+// Skips a block and the blocks nested in it by counting braces.
+void Parser::skipBlock() {
+  expect(TokenClass::LBRA);
+  int depth{1};
+  while (depth > 0 && peek().type != TokenClass::END) {
+    TokenClass type{next().type};
+    if (type == TokenClass::LBRA)
+      depth++;
+    else if (type == TokenClass::RBRA)
+      depth--;
+  }
+  if (depth > 0)
+    expect(TokenClass::RBRA);
+}
+
+ast::StmtPtr Parser::parseStmt() {
+  lexer::Position pos{peek().position};
+
+  switch (peek().type) {
+  case TokenClass::LBRA:
+    return parseBlock();
+
+  case TokenClass::WHILE: {
+    next();
+    expect(TokenClass::LPAR);
+    ast::ExprPtr cond{parseExpr()};
+    expect(TokenClass::RPAR);
+    ast::StmtPtr body{parseStmt()};
+    return std::make_unique<ast::While>(std::move(cond), std::move(body), pos);
+  }
+
+  case TokenClass::IF: {
+    next();
+    expect(TokenClass::LPAR);
+    ast::ExprPtr cond{parseExpr()};
+    expect(TokenClass::RPAR);
+    ast::StmtPtr then{parseStmt()};
+    ast::StmtPtr otherwise;
+    if (accept(TokenClass::ELSE))
+      otherwise = parseStmt();
+    return std::make_unique<ast::If>(std::move(cond), std::move(then),
+                                     std::move(otherwise), pos);
+  }
+
+  case TokenClass::RETURN: {
+    next();
+    ast::ExprPtr value;
+    if (peek().type != TokenClass::SC)
+      value = parseExpr();
+    expect(TokenClass::SC);
+    return std::make_unique<ast::Return>(std::move(value), pos);
+  }
+
+  default:
+    break;
+  }
+
+  ast::ExprPtr expr{parseExpr()};
+  if (accept(TokenClass::ASSIGN)) {
+    ast::ExprPtr rhs{parseExpr()};
+    if (peek().type != TokenClass::SC) {
+      expect(TokenClass::SC);
+      recover();
+    } else
+      next();
+    return std::make_unique<ast::Assign>(std::move(expr), std::move(rhs), pos);
+  }
+
+  if (peek().type != TokenClass::SC) {
+    expect(TokenClass::SC);
+    recover();
+  } else
+    next();
+  return std::make_unique<ast::ExprStmt>(std::move(expr), pos);
+}
+
+ast::ExprPtr Parser::parseExpr() { return parseLogOr(); }
+
+ast::ExprPtr Parser::parseLogOr() {
+  ast::ExprPtr lhs{parseLogAnd()};
+  while (peek().type == TokenClass::LOGOR) {
+    lexer::Position pos{next().position};
+    lhs = std::make_unique<ast::BinOp>(ast::BinOpKind::OR, std::move(lhs),
+                                       parseLogAnd(), pos);
+  }
+  return lhs;
+}
+
+ast::ExprPtr Parser::parseLogAnd() {
+  ast::ExprPtr lhs{parseEquality()};
+  while (peek().type == TokenClass::LOGAND) {
+    lexer::Position pos{next().position};
+    lhs = std::make_unique<ast::BinOp>(ast::BinOpKind::AND, std::move(lhs),
+                                       parseEquality(), pos);
+  }
+  return lhs;
+}
+
+ast::ExprPtr Parser::parseEquality() {
+  ast::ExprPtr lhs{parseRelational()};
+  while (true) {
+    ast::BinOpKind op;
+    if (peek().type == TokenClass::EQ)
+      op = ast::BinOpKind::EQ;
+    else if (peek().type == TokenClass::NE)
+      op = ast::BinOpKind::NE;
+    else
+      return lhs;
+    lexer::Position pos{next().position};
+    lhs = std::make_unique<ast::BinOp>(op, std::move(lhs), parseRelational(),
+                                       pos);
+  }
+}
+
+ast::ExprPtr Parser::parseRelational() {
+  ast::ExprPtr lhs{parseAdditive()};
+  while (true) {
+    ast::BinOpKind op;
+    switch (peek().type) {
+    case TokenClass::LT:
+      op = ast::BinOpKind::LT;
+      break;
+    case TokenClass::LE:
+      op = ast::BinOpKind::LE;
+      break;
+    case TokenClass::GT:
+      op = ast::BinOpKind::GT;
+      break;
+    case TokenClass::GE:
+      op = ast::BinOpKind::GE;
+      break;
+    default:
+      return lhs;
+    }
+    lexer::Position pos{next().position};
+    lhs =
+        std::make_unique<ast::BinOp>(op, std::move(lhs), parseAdditive(), pos);
+  }
+}
+
+ast::ExprPtr Parser::parseAdditive() {
+  ast::ExprPtr lhs{parseMultiplicative()};
+  while (true) {
+    ast::BinOpKind op;
+    if (peek().type == TokenClass::PLUS)
+      op = ast::BinOpKind::ADD;
+    else if (peek().type == TokenClass::MINUS)
+      op = ast::BinOpKind::SUB;
+    else
+      return lhs;
+    lexer::Position pos{next().position};
+    lhs = std::make_unique<ast::BinOp>(op, std::move(lhs),
+                                       parseMultiplicative(), pos);
+  }
+}
+
+ast::ExprPtr Parser::parseMultiplicative() {
+  ast::ExprPtr lhs{parseUnary()};
+  while (true) {
+    ast::BinOpKind op;
+    if (peek().type == TokenClass::ASTERIX)
+      op = ast::BinOpKind::MUL;
+    else if (peek().type == TokenClass::DIV)
+      op = ast::BinOpKind::DIV;
+    else if (peek().type == TokenClass::REM)
+      op = ast::BinOpKind::MOD;
+    else
+      return lhs;
+    lexer::Position pos{next().position};
+    lhs = std::make_unique<ast::BinOp>(op, std::move(lhs), parseUnary(), pos);
+  }
+}
+
+ast::ExprPtr Parser::parseUnary() {
+  lexer::Position pos{peek().position};
+
+  switch (peek().type) {
+  case TokenClass::MINUS: {
+    // unary minus is sugar for (0 - e)
+    next();
+    return std::make_unique<ast::BinOp>(
+        ast::BinOpKind::SUB, std::make_unique<ast::IntLiteral>(0, pos),
+        parseUnary(), pos);
+  }
+
+  case TokenClass::ASTERIX:
+    next();
+    return std::make_unique<ast::ValueAt>(parseUnary(), pos);
+
+  case TokenClass::AND:
+    next();
+    return std::make_unique<ast::AddressOf>(parseUnary(), pos);
+
+  case TokenClass::SIZEOF: {
+    next();
+    expect(TokenClass::LPAR);
+    ast::TypeSpec spec{parseType()};
+    expect(TokenClass::RPAR);
+    return std::make_unique<ast::SizeOf>(std::move(spec), pos);
+  }
+
+  case TokenClass::LPAR:
+    if (isTypeStart(1)) {
+      next();
+      ast::TypeSpec spec{parseType()};
+      expect(TokenClass::RPAR);
+      return std::make_unique<ast::TypeCast>(std::move(spec), parseUnary(),
+                                             pos);
+    }
+    break;
+
+  default:
+    break;
+  }
+
+  return parsePostfix();
+}
+
+ast::ExprPtr Parser::parsePostfix() {
+  ast::ExprPtr expr{parsePrimary()};
+
+  while (true) {
+    lexer::Position pos{peek().position};
+    if (accept(TokenClass::LSBR)) {
+      ast::ExprPtr index{parseExpr()};
+      expect(TokenClass::RSBR);
+      expr = std::make_unique<ast::ArrayAccess>(std::move(expr),
+                                                std::move(index), pos);
+    } else if (accept(TokenClass::DOT)) {
+      Token field{expect(TokenClass::IDENTIFIER)};
+      expr = std::make_unique<ast::FieldAccess>(std::move(expr), field.str,
+                                                pos);
+    } else
+      return expr;
+  }
+}
+
+ast::ExprPtr Parser::parsePrimary() {
+  const Token &token{peek()};
+  lexer::Position pos{token.position};
+
+  switch (token.type) {
+  case TokenClass::INT_LITERAL: {
+    Token literal{next()};
+    int64_t value{0};
+    auto [ptr, ec] = std::from_chars(
+        literal.str.data(), literal.str.data() + literal.str.size(), value);
+    if (ec != std::errc{} || value > INT32_MAX)
+      error(std::format("Parsing error: integer literal ({}) out of range at "
+                        "{}:{}!",
+                        literal.str, pos.x, pos.y));
+    return std::make_unique<ast::IntLiteral>(value, pos);
+  }
+
+  case TokenClass::CHAR_LITERAL: {
+    Token literal{next()};
+    return std::make_unique<ast::CharLiteral>(
+        literal.str.empty() ? '\0' : literal.str[0], pos);
+  }
+
+  case TokenClass::STRING_LITERAL:
+    return std::make_unique<ast::StringLiteral>(next().str, pos);
+
+  case TokenClass::IDENTIFIER: {
+    Token name{next()};
+    if (!accept(TokenClass::LPAR))
+      return std::make_unique<ast::VarExpr>(name.str, pos);
+
+    std::vector<ast::ExprPtr> args;
+    if (peek().type != TokenClass::RPAR) {
+      do
+        args.push_back(parseExpr());
+      while (accept(TokenClass::COMMA));
+    }
+    expect(TokenClass::RPAR);
+    return std::make_unique<ast::FunCall>(name.str, std::move(args), pos);
+  }
+
+  case TokenClass::LPAR: {
+    next();
+    ast::ExprPtr expr{parseExpr()};
+    expect(TokenClass::RPAR);
+    return expr;
+  }
+
+  default:
+    error(std::format("Parsing error: expected expression but found ({}) at "
+                      "{}:{}!",
+                      token.str, pos.x, pos.y));
+    return std::make_unique<ast::IntLiteral>(0, pos);
+  }
+}
+
+} // namespace parser
@@ -0,0 +1,72 @@
+#ifndef PARSER_H
+#define PARSER_H
+
+#include "../ast/ast.hpp"
+#include "../lexer/tokeniser.hpp"
+#include <deque>
+#include <memory>
+#include <string_view>
+
+namespace parser {
+
+// Recursive descent parser producing an ast::Program from the token stream.
+class Parser {
+private:
+  lexer::Tokeniser &tokeniser;
+  std::deque<lexer::Token> lookahead;
+  int errors{0};
+  // Position of the last reported error, used to avoid reporting a cascade of
+  // errors for the same token.
+  lexer::Position lastError{-1, -1};
+  // FNV-1a hash of the tokens consumed since the current top-level
+  // declaration started.
+  uint64_t tokenHash{0};
+  // Function bodies are skipped rather than parsed (see skipBodies).
+  bool bodies{true};
+
+  void error(std::string_view msg);
+
+  const lexer::Token &peek(size_t k = 0);
+  lexer::Token next();
+  bool accept(lexer::TokenClass type);
+  lexer::Token expect(lexer::TokenClass type);
+  void recover();
+
+  bool isTypeStart(int k = 0);
+  ast::TypeSpec parseType();
+  void parseArrayDims(ast::TypeSpec &spec);
+  void parseInclude(ast::Program &program);
+  ast::StructDeclPtr parseStructDecl();
+  ast::VarDeclPtr parseVarDecl();
+  ast::FunDeclPtr parseFunDecl(ast::TypeSpec returnSpec, lexer::Token name);
+  std::unique_ptr<ast::Block> parseBlock();
+  void skipBlock();
+  ast::StmtPtr parseStmt();
+
+  ast::ExprPtr parseExpr();
+  ast::ExprPtr parseLogOr();
+  ast::ExprPtr parseLogAnd();
+  ast::ExprPtr parseEquality();
+  ast::ExprPtr parseRelational();
+  ast::ExprPtr parseAdditive();
+  ast::ExprPtr parseMultiplicative();
+  ast::ExprPtr parseUnary();
+  ast::ExprPtr parsePostfix();
+  ast::ExprPtr parsePrimary();
+
+public:
+  Parser(lexer::Tokeniser &tokeniser) : tokeniser(tokeniser) {}
+
+  std::unique_ptr<ast::Program> parse();
+  // For compiling a file a declaration at a time: the includes at its top,
+  // then each call adds the next top-level declaration to `program` and
+  // returns false at the end of the file.
+  void parseIncludes(ast::Program &program);
+  bool parseDeclaration(ast::Program &program);
+  // Leaves the body of every function null, reading only the declarations.
+  void skipBodies() { bodies = false; }
+  int getErrorCount();
+};
+} // namespace parser
+
+#endif
@@ -0,0 +1,226 @@
+#include "profile.hpp"
+#include <format>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <vector>
+
+namespace profile {
+
+using ir::BlockId;
+using ir::Op;
+using ir::Type;
+using ir::Value;
+
+// First word of a profile file, followed by the checksum and the number of
+// counters on the first line and then one count per line.
+constexpr std::string_view MAGIC{"minic-profile"};
+
+// FNV-1a over the shape of every function defined in the module.
+static uint32_t checksum(const ir::Module &module) {
+  uint32_t hash{2166136261u};
+  auto mix{[&](uint64_t value) {
+    for (int byte = 0; byte < 8; byte++) {
+      hash ^= static_cast<uint32_t>((value >> (8 * byte)) & 0xff);
+      hash *= 16777619u;
+    }
+  }};
+  for (const std::unique_ptr<ir::Function> &function : module.functions) {
+    if (function->external)
+      continue;
+    for (char c : function->name)
+      mix(static_cast<unsigned char>(c));
+    mix(function->blocks.size());
+    for (const ir::Block &block : function->blocks)
+      mix(block.insts.size());
+  }
+  return hash;
+}
+
+// One counter per block, followed by one for the branch ending it if that
+// is a CONDBR.
+static bool isConditional(const ir::Function &function, BlockId block) {
+  Value terminator{function.terminator(block)};
+  return terminator != ir::NO_VALUE &&
+         function.insts[terminator].op == Op::CONDBR;
+}
+
+static size_t counterCount(const ir::Module &module) {
+  size_t count{0};
+  for (const std::unique_ptr<ir::Function> &function : module.functions) {
+    if (function->external)
+      continue;
+    for (BlockId block = 0; block < function->blocks.size(); block++)
+      count += isConditional(*function, block) ? 2 : 1;
+  }
+  return count;
+}
+
+// Where instrumentation goes at the start of a block: behind its phis and
+// parameters.
+static size_t firstPosition(const ir::Function &function, BlockId block) {
+  const std::vector<Value> &insts{function.blocks[block].insts};
+  size_t position{0};
+  while (position < insts.size() &&
+         (function.insts[insts[position]].op == Op::PHI ||
+          function.insts[insts[position]].op == Op::PARAM))
+    position++;
+  return position;
+}
+
+// Inserts `inst` into `block` at `position` and moves past it.
+static Value insert(ir::Function &function, BlockId block, size_t &position,
+                    ir::Inst inst) {
+  inst.block = block;
+  Value value{function.create(inst)};
+  std::vector<Value> &insts{function.blocks[block].insts};
+  insts.insert(insts.begin() + static_cast<ptrdiff_t>(position++), value);
+  return value;
+}
+
+void instrument(ir::Module &module, const std::filesystem::path &file) {
+  size_t total{counterCount(module)};
+  auto main{module.functionIndex.find("main")};
+  if (total == 0 || main == module.functionIndex.end() ||
+      module.functions[main->second]->external)
+    return;
+  uint32_t hash{checksum(module)};
+
+  uint32_t counters{static_cast<uint32_t>(module.globals.size())};
+  module.globals.push_back({"__minic_profile_counters",
+                            static_cast<int>(total * 8), 8});
+  uint32_t path{static_cast<uint32_t>(module.strings.size())};
+  module.strings.push_back(file.string());
+  uint32_t start{module.declareFunction(START_FUNCTION)};
+  module.functions[start]->params = {Type::PTR, Type::I32, Type::I32,
+                                     Type::PTR};
+
+  int64_t next{0};
+  for (const std::unique_ptr<ir::Function> &pointer : module.functions) {
+    ir::Function &function{*pointer};
+    if (function.external)
+      continue;
+
+    for (BlockId block = 0; block < function.blocks.size(); block++) {
+      size_t position;
+      auto add{[&](ir::Inst inst) {
+        return insert(function, block, position, inst);
+      }};
+      // counter += amount, or one
+      auto increment{[&](Value amount) {
+        Value address{add({.op = Op::ADD,
+                           .type = Type::PTR,
+                           .a = add({.op = Op::GLOBAL,
+                                     .type = Type::PTR,
+                                     .imm = counters}),
+                           .b = add({.op = Op::CONST,
+                                     .type = Type::PTR,
+                                     .imm = next++ * 8})})};
+        Value count{add({.op = Op::LOAD, .type = Type::PTR, .a = address})};
+        if (amount == ir::NO_VALUE)
+          amount = add({.op = Op::CONST, .type = Type::PTR, .imm = 1});
+        Value sum{
+            add({.op = Op::ADD, .type = Type::PTR, .a = count, .b = amount})};
+        add({.op = Op::STORE, .type = Type::PTR, .a = address, .b = sum});
+      }};
+
+      position = firstPosition(function, block);
+      increment(ir::NO_VALUE);
+      if (!isConditional(function, block))
+        continue;
+
+      // the taken counter grows by the condition tested as 0 or 1
+      position = function.blocks[block].insts.size() - 1;
+      Value condition{function.insts[function.terminator(block)].a};
+      Value zero{
+          add({.op = Op::CONST, .type = function.insts[condition].type})};
+      Value test{
+          add({.op = Op::NE, .type = Type::I32, .a = condition, .b = zero})};
+      increment(add({.op = Op::SEXT, .type = Type::PTR, .a = test}));
+    }
+  }
+
+  // main hands the counters over before anything else
+  ir::Function &function{*module.functions[main->second]};
+  size_t position{firstPosition(function, 0)};
+  auto add{[&](ir::Inst inst) {
+    return insert(function, 0, position, inst);
+  }};
+  std::vector<Value> args{
+      add({.op = Op::GLOBAL, .type = Type::PTR, .imm = counters}),
+      add({.op = Op::CONST,
+           .type = Type::I32,
+           .imm = static_cast<int64_t>(total)}),
+      add({.op = Op::CONST,
+           .type = Type::I32,
+           .imm = static_cast<int32_t>(hash)}),
+      add({.op = Op::STRING, .type = Type::PTR, .imm = path})};
+  Value call{add({.op = Op::CALL, .type = Type::VOID, .imm = start})};
+  function.setExtraOperands(call, args);
+}
+
+bool annotate(ir::Module &module, const std::filesystem::path &file) {
+  std::ifstream in(file);
+  if (!in.is_open()) {
+    std::cout << std::format("Cannot read profile {}!", file.string())
+              << std::endl;
+    return false;
+  }
+
+  std::string magic;
+  uint32_t hash{0};
+  size_t total{0};
+  in >> magic >> hash >> total;
+  std::vector<uint64_t> counts(in && total == counterCount(module) ? total
+                                                                   : 0);
+  for (uint64_t &count : counts)
+    in >> count;
+  if (!in || magic != MAGIC || hash != checksum(module) || counts.empty()) {
+    std::cout << std::format("Profile {} does not match the program!",
+                             file.string())
+              << std::endl;
+    return false;
+  }
+
+  size_t next{0};
+  for (const std::unique_ptr<ir::Function> &function : module.functions) {
+    if (function->external)
+      continue;
+    function->profiled = true;
+    for (BlockId block = 0; block < function->blocks.size(); block++) {
+      function->blocks[block].count = counts[next++];
+      if (isConditional(*function, block))
+        function->blocks[block].taken = counts[next++];
+    }
+  }
+  return true;
+}
+
+// The counters of the program running in-process.
+struct Registration {
+  const uint64_t *counters{nullptr};
+  int count{0};
+  uint32_t checksum{0};
+  std::string file;
+};
+
+static Registration registration;
+
+void start(const uint64_t *counters, int count, int checksum,
+           const char *file) {
+  registration = {counters, count, static_cast<uint32_t>(checksum), file};
+}
+
+bool flush() {
+  if (registration.counters == nullptr)
+    return true;
+  std::ofstream out(registration.file);
+  out << std::format("{} {} {}\n", MAGIC, registration.checksum,
+                     registration.count);
+  for (int i = 0; i < registration.count; i++)
+    out << registration.counters[i] << '\n';
+  registration = {};
+  return static_cast<bool>(out);
+}
+
+} // namespace profile
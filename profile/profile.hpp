@@ -0,0 +1,48 @@
+#ifndef PROFILE_H
+#define PROFILE_H
+
+#include "../ir/ir.hpp"
+#include <cstdint>
+#include <filesystem>
+#include <string_view>
+
+namespace profile {
+
+// Profile-guided optimisation. A program built with -profile-generate counts
+// how often each block runs and how often each conditional branch is taken,
+// and writes the counts to a profile file when it is done. Building it again
+// with -profile-use reads them back into the block counts of the IR, which
+// the inliner and the code generator consult.
+//
+// Counters are numbered over the module as lowered, before any pass runs,
+// so a profile fits every build of the same source whatever the level of
+// optimisation; a checksum of the lowered module catches other sources.
+
+// Builtin called at the start of an instrumented main with the counters,
+// their number, the checksum and the profile file. The runtime library
+// writes the profile at exit; code run in-process calls `start` below.
+constexpr std::string_view START_FUNCTION{"__minic_profile_start"};
+
+constexpr std::string_view DEFAULT_FILE{"minic.profile"};
+
+// Adds the counters to a freshly lowered module. The program writes them to
+// `file` on exit.
+void instrument(ir::Module &module, const std::filesystem::path &file);
+
+// Sets the block counts of a freshly lowered module from a profile written
+// by its instrumented build. Reports on stdout and leaves the module alone
+// if the profile cannot be read or was made from another program.
+bool annotate(ir::Module &module, const std::filesystem::path &file);
+
+// START_FUNCTION for the JIT and the interpreter: remembers the counters of
+// the running program until `flush`.
+void start(const uint64_t *counters, int count, int checksum,
+           const char *file);
+// Writes the profile of the program run in-process, if it was instrumented.
+// Must be called while its memory is still around. Returns false if the
+// file could not be written.
+bool flush();
+
+} // namespace profile
+
+#endif
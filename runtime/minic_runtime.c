@@ -0,0 +1,153 @@
+// Runtime library for the MiniC builtins, linked into the executables the
+// compiler builds. It replaces the one stdio call per builtin of
+// examples/minic-stdlib.h: output collects in a large buffer that is written
+// when it fills, before any read (so that prompts show) and at exit, and
+// input is read in blocks. Integers are formatted and parsed by hand. Reads
+// at the end of the input return 0.
+//
+// Programs built with -profile-generate also hand their counters over here
+// and have them written to the profile file at exit.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#define OUTPUT_SIZE (1 << 16)
+#define INPUT_SIZE (1 << 16)
+
+static char output[OUTPUT_SIZE];
+static size_t outputLength;
+static int flushAtExit;
+
+static char input[INPUT_SIZE];
+static size_t inputPosition;
+static size_t inputLength;
+
+static void flush(void) {
+  size_t written = 0;
+  while (written < outputLength) {
+    ssize_t count = write(1, output + written, outputLength - written);
+    if (count <= 0)
+      break;
+    written += (size_t)count;
+  }
+  outputLength = 0;
+}
+
+// Makes room for `size` more bytes of output.
+static void reserve(size_t size) {
+  if (!flushAtExit) {
+    atexit(flush);
+    flushAtExit = 1;
+  }
+  if (outputLength + size > OUTPUT_SIZE)
+    flush();
+}
+
+// Returns the next input byte without consuming it, or -1 at the end.
+static int peek(void) {
+  if (inputPosition == inputLength) {
+    ssize_t count = read(0, input, INPUT_SIZE);
+    if (count <= 0)
+      return -1;
+    inputPosition = 0;
+    inputLength = (size_t)count;
+  }
+  return (unsigned char)input[inputPosition];
+}
+
+static void skipSpace(void) {
+  int c = peek();
+  while (c == ' ' || (c >= '\t' && c <= '\r')) {
+    inputPosition++;
+    c = peek();
+  }
+}
+
+void print_s(const char *s) {
+  while (*s != '\0') {
+    reserve(1);
+    size_t room = OUTPUT_SIZE - outputLength;
+    while (room > 0 && *s != '\0') {
+      output[outputLength++] = *s++;
+      room--;
+    }
+  }
+}
+
+void print_i(int i) {
+  char digits[11];
+  size_t count = 0;
+  unsigned int magnitude = i < 0 ? 0u - (unsigned int)i : (unsigned int)i;
+  do {
+    digits[count++] = (char)('0' + magnitude % 10);
+    magnitude /= 10;
+  } while (magnitude != 0);
+
+  reserve(count + 1);
+  if (i < 0)
+    output[outputLength++] = '-';
+  while (count > 0)
+    output[outputLength++] = digits[--count];
+}
+
+void print_c(char c) {
+  reserve(1);
+  output[outputLength++] = c;
+}
+
+char read_c(void) {
+  flush();
+  skipSpace();
+  int c = peek();
+  if (c < 0)
+    return 0;
+  inputPosition++;
+  return (char)c;
+}
+
+int read_i(void) {
+  flush();
+  skipSpace();
+  int negative = 0;
+  int c = peek();
+  if (c == '-' || c == '+') {
+    negative = c == '-';
+    inputPosition++;
+    c = peek();
+  }
+  unsigned int value = 0;
+  while (c >= '0' && c <= '9') {
+    value = value * 10 + (unsigned int)(c - '0');
+    inputPosition++;
+    c = peek();
+  }
+  return (int)(negative ? 0u - value : value);
+}
+
+void *mcmalloc(int size) { return malloc((size_t)size); }
+
+static const unsigned long long *profileCounters;
+static int profileCount;
+static unsigned int profileChecksum;
+static const char *profileFile;
+
+// Same format as profile::flush in the compiler.
+static void writeProfile(void) {
+  FILE *file = fopen(profileFile, "w");
+  if (file == NULL)
+    return;
+  fprintf(file, "minic-profile %u %d\n", profileChecksum, profileCount);
+  for (int i = 0; i < profileCount; i++)
+    fprintf(file, "%llu\n", profileCounters[i]);
+  fclose(file);
+}
+
+void __minic_profile_start(const unsigned long long *counters, int count,
+                           int checksum, const char *file) {
+  profileCounters = counters;
+  profileCount = count;
+  profileChecksum = (unsigned int)checksum;
+  profileFile = file;
+  atexit(writeProfile);
+}
@@ -0,0 +1,135 @@
+#include "runtime.hpp"
+#include <cstdlib>
+#include <format>
+#include <fstream>
+#include <functional>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace runtime {
+
+std::string_view source() {
+  static constexpr std::string_view SOURCE{
+#include "runtime/runtime_source.inc"
+  };
+  return SOURCE;
+}
+
+// Whether `path` is of `type` itself rather than a link to one, belongs to
+// this user and cannot be written by anyone else.
+static bool isPrivate(const std::filesystem::path &path, mode_t type) {
+  struct stat status;
+  return lstat(path.c_str(), &status) == 0 &&
+         (status.st_mode & S_IFMT) == type && status.st_uid == getuid() &&
+         (status.st_mode & (S_IWGRP | S_IWOTH)) == 0;
+}
+
+// minic under $XDG_CACHE_HOME or ~/.cache, created private to this user, or
+// an empty path if there is no such directory that only this user controls.
+static std::filesystem::path cacheDirectory() {
+  std::filesystem::path base;
+  if (const char *cache{std::getenv("XDG_CACHE_HOME")};
+      cache != nullptr && *cache != '\0')
+    base = cache;
+  else if (const char *home{std::getenv("HOME")};
+           home != nullptr && *home != '\0')
+    base = std::filesystem::path{home} / ".cache";
+  else
+    return {};
+
+  std::error_code error;
+  std::filesystem::create_directories(base, error);
+  std::filesystem::path directory{base / "minic"};
+  mkdir(directory.c_str(), 0700);
+  return isPrivate(directory, S_IFDIR) ? directory : std::filesystem::path{};
+}
+
+// A new file in `directory` named after `prefix` and `suffix`, created by
+// mkstemps so that no one else can have made it first, or an empty path.
+static std::filesystem::path
+createUnique(const std::filesystem::path &directory, std::string_view prefix,
+             std::string_view suffix) {
+  std::string name{
+      (directory / std::format("{}XXXXXX{}", prefix, suffix)).string()};
+  int fd{mkstemps(name.data(), static_cast<int>(suffix.size()))};
+  if (fd < 0)
+    return {};
+  close(fd);
+  return name;
+}
+
+// The runtime library compiled into `directory`, under a name given by a
+// hash of its source, unless it is there already and nobody else could have
+// put it there or changed it. It is compiled under a name of its own and
+// renamed into place, so a concurrent link never sees half an object.
+// Returns an empty path if it cannot be compiled.
+static std::filesystem::path
+compiledRuntime(const std::filesystem::path &directory) {
+  std::filesystem::path object{
+      directory / std::format("minic-runtime-{:016x}.o",
+                              std::hash<std::string_view>{}(source()))};
+  if (isPrivate(object, S_IFREG))
+    return object;
+
+  std::filesystem::path runtime{
+      createUnique(directory, "minic-runtime-", ".c")};
+  std::filesystem::path partial{
+      createUnique(directory, "minic-runtime-", ".o")};
+  bool compiled{false};
+  if (!runtime.empty() && !partial.empty()) {
+    {
+      std::ofstream file{runtime};
+      file << source();
+      compiled = static_cast<bool>(file);
+    }
+    compiled = compiled &&
+               std::system(std::format("cc -O2 -c -o '{}' -x c '{}'",
+                                       partial.string(), runtime.string())
+                               .c_str()) == 0;
+  }
+  // whatever the umask, the object must pass isPrivate to be reused
+  std::error_code error;
+  compiled = compiled && chmod(partial.c_str(), 0644) == 0;
+  if (compiled)
+    std::filesystem::rename(partial, object, error);
+  compiled = compiled && !error;
+  for (const std::filesystem::path &staged : {runtime, partial})
+    if (!staged.empty())
+      std::filesystem::remove(staged, error);
+  return compiled ? object : std::filesystem::path{};
+}
+
+bool link(const std::filesystem::path &executable,
+          const std::filesystem::path &object,
+          const std::filesystem::path &library) {
+  if (!library.empty())
+    return std::system(std::format("cc -O2 -o '{}' '{}' -x c '{}'",
+                                   executable.string(), object.string(),
+                                   library.string())
+                           .c_str()) == 0;
+
+  // without a cache of its own the runtime is compiled afresh, in a
+  // directory of its own
+  std::filesystem::path directory{cacheDirectory()};
+  bool temporary{directory.empty()};
+  if (temporary) {
+    std::string name{
+        (std::filesystem::temp_directory_path() / "minic-runtime-XXXXXX")
+            .string()};
+    if (mkdtemp(name.data()) == nullptr)
+      return false;
+    directory = name;
+  }
+
+  std::filesystem::path runtime{compiledRuntime(directory)};
+  bool linked{!runtime.empty() &&
+              std::system(std::format("cc -o '{}' '{}' '{}'",
+                                      executable.string(), object.string(),
+                                      runtime.string())
+                              .c_str()) == 0};
+  if (temporary)
+    std::filesystem::remove_all(directory);
+  return linked;
+}
+
+} // namespace runtime
@@ -0,0 +1,25 @@
+#ifndef RUNTIME_H
+#define RUNTIME_H
+
+#include <filesystem>
+#include <string_view>
+
+namespace runtime {
+
+// C source of the buffered runtime library for the MiniC builtins
+// (minic_runtime.c).
+std::string_view source();
+
+// Links `object` into `executable` with the system C compiler, against the
+// runtime library unless `library` names another C file defining the
+// builtins (such as examples/minic-stdlib.h). The runtime library is only
+// compiled by the first link, which leaves its object in a cache directory
+// private to the user ($XDG_CACHE_HOME/minic or ~/.cache/minic) for the
+// rest. Returns whether it succeeded.
+bool link(const std::filesystem::path &executable,
+          const std::filesystem::path &object,
+          const std::filesystem::path &library = {});
+
+} // namespace runtime
+
+#endif
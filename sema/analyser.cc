@@ -0,0 +1,565 @@
+#include "analyser.hpp"
+#include <format>
+#include <iostream>
+
+namespace sema {
+
+int Analyser::getErrorCount() { return errors; }
+
+void Analyser::error(std::string_view msg) {
+  errors++;
+  std::cout << msg << std::endl;
+}
+
+void Analyser::analyse(ast::Program &program) {
+  declare(program);
+  for (ast::FunDeclPtr &fun : program.functions)
+    checkFunction(*fun);
+  symbols.exitScope();
+}
+
+void Analyser::declare(ast::Program &program) {
+  symbols.enterScope();
+  declareBuiltins(program);
+
+  // struct tags are registered up front so that pointers to structs declared
+  // later in the file resolve; by-value fields still need a complete type
+  for (ast::StructDeclPtr &decl : program.structs) {
+    if (!structs.emplace(decl->name, decl.get()).second) {
+      error(std::format("Semantic error: struct {} redeclared at {}:{}!",
+                        decl->name, decl->pos.x, decl->pos.y));
+      continue;
+    }
+    decl->type = types.structType(decl->name);
+  }
+  for (ast::StructDeclPtr &decl : program.structs)
+    if (decl->type != nullptr && structs.at(decl->name) == decl.get())
+      checkStruct(*decl);
+
+  for (ast::VarDeclPtr &var : program.globals)
+    checkVarDecl(*var);
+
+  // functions may call functions defined further down the file
+  for (ast::FunDeclPtr &fun : program.functions)
+    declareFunction(*fun);
+
+  // functions read without their bodies are never checked, but calls to
+  // them need their parameter types all the same
+  for (ast::FunDeclPtr &fun : program.functions)
+    if (fun->body == nullptr)
+      for (ast::VarDeclPtr &param : fun->params) {
+        param->type = resolve(param->typeSpec, param->pos);
+        if (param->type->isArray())
+          param->type = types.pointerTo(param->type->element);
+      }
+}
+
+void Analyser::checkDefinition(ast::FunDecl &fun) {
+  fun.returnType = resolve(fun.returnSpec, fun.pos);
+  checkFunction(fun);
+}
+
+void Analyser::declareBuiltins(ast::Program &program) {
+  auto builtin{[&](std::string_view name, ast::TypeSpec returnSpec,
+                   std::vector<ast::TypeSpec> paramSpecs) {
+    auto fun{std::make_unique<ast::FunDecl>()};
+    fun->name = name;
+    fun->returnSpec = std::move(returnSpec);
+    fun->isBuiltin = true;
+    fun->pos = {0, 0};
+    for (size_t i = 0; i < paramSpecs.size(); i++) {
+      auto param{std::make_unique<ast::VarDecl>()};
+      param->typeSpec = std::move(paramSpecs[i]);
+      param->name = std::format("arg{}", i);
+      param->type = resolve(param->typeSpec, fun->pos);
+      fun->params.push_back(std::move(param));
+    }
+    fun->returnType = resolve(fun->returnSpec, fun->pos);
+    symbols.declare({fun->name, SymbolKind::FUNCTION, nullptr, fun.get()});
+    program.builtins.push_back(std::move(fun));
+  }};
+
+  const ast::TypeSpec intSpec{ast::BaseType::INT, "", 0, {}};
+  const ast::TypeSpec charSpec{ast::BaseType::CHAR, "", 0, {}};
+  const ast::TypeSpec voidSpec{ast::BaseType::VOID, "", 0, {}};
+  const ast::TypeSpec stringSpec{ast::BaseType::CHAR, "", 1, {}};
+  const ast::TypeSpec voidPointerSpec{ast::BaseType::VOID, "", 1, {}};
+
+  builtin("print_s", voidSpec, {stringSpec});
+  builtin("print_i", voidSpec, {intSpec});
+  builtin("print_c", voidSpec, {charSpec});
+  builtin("read_c", charSpec, {});
+  builtin("read_i", intSpec, {});
+  builtin("mcmalloc", voidPointerSpec, {intSpec});
+}
+
+void Analyser::checkStruct(ast::StructDecl &decl) {
+  std::vector<Field> fields;
+  fields.reserve(decl.fields.size());
+
+  for (ast::VarDeclPtr &field : decl.fields) {
+    field->type = resolve(field->typeSpec, field->pos);
+
+    for (const Field &other : fields)
+      if (other.name == field->name)
+        error(std::format("Semantic error: duplicate field {} in struct {} at "
+                          "{}:{}!",
+                          field->name, decl.name, field->pos.x, field->pos.y));
+
+    // by-value struct fields (possibly inside arrays) must be complete
+    const Type *base{field->type};
+    while (base->isArray())
+      base = base->element;
+    if (base->kind == TypeKind::VOID)
+      error(std::format("Semantic error: field {} cannot have type void at "
+                        "{}:{}!",
+                        field->name, field->pos.x, field->pos.y));
+    else if (base->isStruct() && !base->isDefined())
+      error(std::format("Semantic error: field {} has incomplete type {} at "
+                        "{}:{}!",
+                        field->name, base->toString(), field->pos.x,
+                        field->pos.y));
+
+    fields.push_back({field->name, field->type});
+  }
+
+  types.defineStruct(decl.type, std::move(fields));
+}
+
+const Type *Analyser::resolve(const ast::TypeSpec &spec, ast::Position pos) {
+  const Type *type;
+
+  switch (spec.base) {
+  case ast::BaseType::INT:
+    type = types.intType();
+    break;
+  case ast::BaseType::CHAR:
+    type = types.charType();
+    break;
+  case ast::BaseType::VOID:
+    type = types.voidType();
+    break;
+  case ast::BaseType::STRUCT:
+    if (!structs.contains(spec.structName)) {
+      error(std::format("Semantic error: undeclared struct {} at {}:{}!",
+                        spec.structName, pos.x, pos.y));
+      return types.errorType();
+    }
+    type = types.structType(spec.structName);
+    break;
+  default:
+    return types.errorType();
+  }
+
+  for (int i = 0; i < spec.pointerDepth; i++)
+    type = types.pointerTo(type);
+
+  // `T x[2][3]` is an array of 2 arrays of 3 T
+  for (auto dim = spec.arrayDims.rbegin(); dim != spec.arrayDims.rend();
+       ++dim) {
+    if (*dim <= 0) {
+      error(std::format("Semantic error: array size must be positive at "
+                        "{}:{}!",
+                        pos.x, pos.y));
+      return types.errorType();
+    }
+    type = types.arrayOf(type, *dim);
+  }
+
+  return type;
+}
+
+void Analyser::checkVarDecl(ast::VarDecl &var) {
+  var.type = resolve(var.typeSpec, var.pos);
+
+  const Type *base{var.type};
+  while (base->isArray())
+    base = base->element;
+  if (base->kind == TypeKind::VOID)
+    error(std::format("Semantic error: variable {} cannot have type void at "
+                      "{}:{}!",
+                      var.name, var.pos.x, var.pos.y));
+  else if (base->isStruct() && !base->isDefined())
+    error(std::format("Semantic error: variable {} has incomplete type {} at "
+                      "{}:{}!",
+                      var.name, base->toString(), var.pos.x, var.pos.y));
+
+  if (!symbols.declare({var.name, SymbolKind::VARIABLE, &var, nullptr}))
+    error(std::format("Semantic error: {} redeclared at {}:{}!", var.name,
+                      var.pos.x, var.pos.y));
+}
+
+void Analyser::declareFunction(ast::FunDecl &fun) {
+  fun.returnType = resolve(fun.returnSpec, fun.pos);
+  if (fun.returnType->isArray())
+    error(std::format("Semantic error: function {} cannot return an array at "
+                      "{}:{}!",
+                      fun.name, fun.pos.x, fun.pos.y));
+
+  if (!symbols.declare({fun.name, SymbolKind::FUNCTION, nullptr, &fun}))
+    error(std::format("Semantic error: {} redeclared at {}:{}!", fun.name,
+                      fun.pos.x, fun.pos.y));
+}
+
+void Analyser::checkFunction(ast::FunDecl &fun) {
+  currentFunction = &fun;
+  symbols.enterScope();
+
+  for (ast::VarDeclPtr &param : fun.params) {
+    checkVarDecl(*param);
+    // array parameters decay to pointers as in C
+    if (param->type->isArray())
+      param->type = types.pointerTo(param->type->element);
+  }
+
+  // parameters and the outermost block share a scope
+  checkBlock(*fun.body, false);
+
+  symbols.exitScope();
+  currentFunction = nullptr;
+}
+
+void Analyser::checkBlock(ast::Block &block, bool newScope) {
+  if (newScope)
+    symbols.enterScope();
+
+  for (ast::VarDeclPtr &var : block.vars)
+    checkVarDecl(*var);
+  for (ast::StmtPtr &stmt : block.stmts)
+    checkStmt(*stmt);
+
+  if (newScope)
+    symbols.exitScope();
+}
+
+void Analyser::checkStmt(ast::Stmt &stmt) {
+  switch (stmt.kind) {
+  case ast::StmtKind::BLOCK:
+    checkBlock(stmt.as<ast::Block>(), true);
+    return;
+
+  case ast::StmtKind::WHILE: {
+    ast::While &loop{stmt.as<ast::While>()};
+    const Type *cond{checkExpr(*loop.cond)};
+    if (cond != types.intType() && !cond->isError())
+      error(std::format("Semantic error: while condition must be int but is "
+                        "{} at {}:{}!",
+                        cond->toString(), loop.pos.x, loop.pos.y));
+    checkStmt(*loop.body);
+    return;
+  }
+
+  case ast::StmtKind::IF: {
+    ast::If &branch{stmt.as<ast::If>()};
+    const Type *cond{checkExpr(*branch.cond)};
+    if (cond != types.intType() && !cond->isError())
+      error(std::format("Semantic error: if condition must be int but is {} "
+                        "at {}:{}!",
+                        cond->toString(), branch.pos.x, branch.pos.y));
+    checkStmt(*branch.then);
+    if (branch.otherwise)
+      checkStmt(*branch.otherwise);
+    return;
+  }
+
+  case ast::StmtKind::RETURN: {
+    ast::Return &ret{stmt.as<ast::Return>()};
+    const Type *expected{currentFunction->returnType};
+    if (!ret.value) {
+      if (expected != types.voidType())
+        error(std::format("Semantic error: {} must return a value of type {} "
+                          "at {}:{}!",
+                          currentFunction->name, expected->toString(),
+                          ret.pos.x, ret.pos.y));
+      return;
+    }
+    const Type *actual{checkExpr(*ret.value)};
+    if (expected == types.voidType())
+      error(std::format("Semantic error: void function {} cannot return a "
+                        "value at {}:{}!",
+                        currentFunction->name, ret.pos.x, ret.pos.y));
+    else if (actual != expected && !actual->isError() && !expected->isError())
+      error(std::format("Semantic error: {} returns {} but {} was given at "
+                        "{}:{}!",
+                        currentFunction->name, expected->toString(),
+                        actual->toString(), ret.pos.x, ret.pos.y));
+    return;
+  }
+
+  case ast::StmtKind::ASSIGN: {
+    ast::Assign &assign{stmt.as<ast::Assign>()};
+    const Type *lhs{checkExpr(*assign.lhs)};
+    const Type *rhs{checkExpr(*assign.rhs)};
+    if (lhs->isError() || rhs->isError())
+      return;
+    if (!isLvalue(*assign.lhs))
+      error(std::format("Semantic error: cannot assign to an rvalue at {}:{}!",
+                        assign.pos.x, assign.pos.y));
+    else if (lhs->isArray() || lhs->kind == TypeKind::VOID)
+      error(std::format("Semantic error: cannot assign to a value of type {} "
+                        "at {}:{}!",
+                        lhs->toString(), assign.pos.x, assign.pos.y));
+    else if (lhs != rhs)
+      error(std::format("Semantic error: cannot assign {} to {} at {}:{}!",
+                        rhs->toString(), lhs->toString(), assign.pos.x,
+                        assign.pos.y));
+    return;
+  }
+
+  case ast::StmtKind::EXPR:
+    checkExpr(*stmt.as<ast::ExprStmt>().expr);
+    return;
+  }
+}
+
+bool Analyser::isLvalue(const ast::Expr &expr) {
+  return expr.kind == ast::ExprKind::VAR ||
+         expr.kind == ast::ExprKind::FIELD_ACCESS ||
+         expr.kind == ast::ExprKind::ARRAY_ACCESS ||
+         expr.kind == ast::ExprKind::VALUE_AT;
+}
+
+// Variable whose storage an lvalue expression lives in, if any.
+static ast::VarDecl *rootVariable(ast::Expr &expr) {
+  switch (expr.kind) {
+  case ast::ExprKind::VAR:
+    return expr.as<ast::VarExpr>().decl;
+  case ast::ExprKind::FIELD_ACCESS:
+    return rootVariable(*expr.as<ast::FieldAccess>().object);
+  case ast::ExprKind::ARRAY_ACCESS: {
+    ast::Expr &array{*expr.as<ast::ArrayAccess>().array};
+    return array.type != nullptr && array.type->isArray() ? rootVariable(array)
+                                                          : nullptr;
+  }
+  default:
+    return nullptr;
+  }
+}
+
+const Type *Analyser::checkExpr(ast::Expr &expr) {
+  const Type *type{types.errorType()};
+
+  switch (expr.kind) {
+  case ast::ExprKind::INT_LITERAL:
+    type = types.intType();
+    break;
+
+  case ast::ExprKind::CHAR_LITERAL:
+    type = types.charType();
+    break;
+
+  case ast::ExprKind::STRING_LITERAL:
+    type = types.arrayOf(
+        types.charType(),
+        static_cast<int>(expr.as<ast::StringLiteral>().value.size()) + 1);
+    break;
+
+  case ast::ExprKind::VAR: {
+    ast::VarExpr &var{expr.as<ast::VarExpr>()};
+    const Symbol *symbol{symbols.lookup(var.name)};
+    if (symbol == nullptr)
+      error(std::format("Semantic error: undeclared identifier {} at {}:{}!",
+                        var.name, var.pos.x, var.pos.y));
+    else if (symbol->kind != SymbolKind::VARIABLE)
+      error(std::format("Semantic error: {} is a function, not a variable at "
+                        "{}:{}!",
+                        var.name, var.pos.x, var.pos.y));
+    else {
+      var.decl = symbol->var;
+      type = var.decl->type;
+    }
+    break;
+  }
+
+  case ast::ExprKind::FUN_CALL: {
+    ast::FunCall &call{expr.as<ast::FunCall>()};
+    std::vector<const Type *> argTypes;
+    argTypes.reserve(call.args.size());
+    for (ast::ExprPtr &arg : call.args)
+      argTypes.push_back(checkExpr(*arg));
+
+    const Symbol *symbol{symbols.lookup(call.name)};
+    if (symbol == nullptr) {
+      error(std::format("Semantic error: undeclared function {} at {}:{}!",
+                        call.name, call.pos.x, call.pos.y));
+      break;
+    }
+    if (symbol->kind != SymbolKind::FUNCTION) {
+      error(std::format("Semantic error: {} is not a function at {}:{}!",
+                        call.name, call.pos.x, call.pos.y));
+      break;
+    }
+
+    call.decl = symbol->fun;
+    type = call.decl->returnType;
+
+    if (call.args.size() != call.decl->params.size()) {
+      error(std::format("Semantic error: {} expects {} arguments but {} were "
+                        "given at {}:{}!",
+                        call.name, call.decl->params.size(), call.args.size(),
+                        call.pos.x, call.pos.y));
+      break;
+    }
+    for (size_t i = 0; i < argTypes.size(); i++) {
+      const Type *param{call.decl->params[i]->type};
+      if (argTypes[i] != param && !argTypes[i]->isError() &&
+          !param->isError())
+        error(std::format("Semantic error: argument {} of {} must be {} but "
+                          "is {} at {}:{}!",
+                          i + 1, call.name, param->toString(),
+                          argTypes[i]->toString(), call.args[i]->pos.x,
+                          call.args[i]->pos.y));
+    }
+    break;
+  }
+
+  case ast::ExprKind::BIN_OP:
+    type = checkBinOp(expr.as<ast::BinOp>());
+    break;
+
+  case ast::ExprKind::ARRAY_ACCESS: {
+    ast::ArrayAccess &access{expr.as<ast::ArrayAccess>()};
+    const Type *array{checkExpr(*access.array)};
+    const Type *index{checkExpr(*access.index)};
+    if (array->isError() || index->isError())
+      break;
+    if (!array->isArray() && !array->isPointer())
+      error(std::format("Semantic error: cannot index a value of type {} at "
+                        "{}:{}!",
+                        array->toString(), access.pos.x, access.pos.y));
+    else if (index != types.intType())
+      error(std::format("Semantic error: array index must be int but is {} "
+                        "at {}:{}!",
+                        index->toString(), access.pos.x, access.pos.y));
+    else if (array->element->kind == TypeKind::VOID)
+      error(std::format("Semantic error: cannot index a void pointer at "
+                        "{}:{}!",
+                        access.pos.x, access.pos.y));
+    else
+      type = array->element;
+    break;
+  }
+
+  case ast::ExprKind::FIELD_ACCESS: {
+    ast::FieldAccess &access{expr.as<ast::FieldAccess>()};
+    const Type *object{checkExpr(*access.object)};
+    if (object->isError())
+      break;
+    if (!object->isStruct()) {
+      error(std::format("Semantic error: field access on non-struct type {} "
+                        "at {}:{}!",
+                        object->toString(), access.pos.x, access.pos.y));
+      break;
+    }
+    access.fieldIndex = object->fieldIndex(access.field);
+    if (access.fieldIndex < 0)
+      error(std::format("Semantic error: {} has no field {} at {}:{}!",
+                        object->toString(), access.field, access.pos.x,
+                        access.pos.y));
+    else
+      type = object->getFields()[access.fieldIndex].type;
+    break;
+  }
+
+  case ast::ExprKind::VALUE_AT: {
+    ast::ValueAt &deref{expr.as<ast::ValueAt>()};
+    const Type *pointer{checkExpr(*deref.pointer)};
+    if (pointer->isError())
+      break;
+    if (!pointer->isPointer() || pointer->element->kind == TypeKind::VOID)
+      error(std::format("Semantic error: cannot dereference a value of type {} "
+                        "at {}:{}!",
+                        pointer->toString(), deref.pos.x, deref.pos.y));
+    else
+      type = pointer->element;
+    break;
+  }
+
+  case ast::ExprKind::ADDRESS_OF: {
+    ast::AddressOf &addressOf{expr.as<ast::AddressOf>()};
+    const Type *operand{checkExpr(*addressOf.operand)};
+    if (operand->isError())
+      break;
+    if (!isLvalue(*addressOf.operand)) {
+      error(std::format("Semantic error: cannot take the address of an rvalue "
+                        "at {}:{}!",
+                        addressOf.pos.x, addressOf.pos.y));
+      break;
+    }
+    if (ast::VarDecl *root{rootVariable(*addressOf.operand)})
+      root->addressTaken = true;
+    type = types.pointerTo(operand);
+    break;
+  }
+
+  case ast::ExprKind::SIZEOF: {
+    ast::SizeOf &size{expr.as<ast::SizeOf>()};
+    size.operandType = resolve(size.typeSpec, size.pos);
+    type = types.intType();
+    break;
+  }
+
+  case ast::ExprKind::TYPECAST:
+    type = checkCast(expr.as<ast::TypeCast>());
+    break;
+  }
+
+  expr.type = type;
+  return type;
+}
+
+const Type *Analyser::checkBinOp(ast::BinOp &binOp) {
+  const Type *lhs{checkExpr(*binOp.lhs)};
+  const Type *rhs{checkExpr(*binOp.rhs)};
+  if (lhs->isError() || rhs->isError())
+    return types.errorType();
+
+  if (binOp.op == ast::BinOpKind::EQ || binOp.op == ast::BinOpKind::NE) {
+    if (lhs != rhs || !lhs->isScalar()) {
+      error(std::format("Semantic error: cannot compare {} with {} at {}:{}!",
+                        lhs->toString(), rhs->toString(), binOp.pos.x,
+                        binOp.pos.y));
+      return types.errorType();
+    }
+    return types.intType();
+  }
+
+  if (lhs != types.intType() || rhs != types.intType()) {
+    error(std::format("Semantic error: operands must be int but are {} and {} "
+                      "at {}:{}!",
+                      lhs->toString(), rhs->toString(), binOp.pos.x,
+                      binOp.pos.y));
+    return types.errorType();
+  }
+  return types.intType();
+}
+
+const Type *Analyser::checkCast(ast::TypeCast &cast) {
+  const Type *from{checkExpr(*cast.operand)};
+  const Type *to{resolve(cast.typeSpec, cast.pos)};
+  if (from->isError() || to->isError())
+    return types.errorType();
+
+  bool valid{false};
+  if (from == to)
+    valid = true;
+  // char <-> int
+  else if ((from == types.charType() && to == types.intType()) ||
+           (from == types.intType() && to == types.charType()))
+    valid = true;
+  // arrays decay to a pointer to their element type
+  else if (from->isArray() && to->isPointer() && from->element == to->element)
+    valid = true;
+  else if (from->isPointer() && to->isPointer())
+    valid = true;
+
+  if (!valid) {
+    error(std::format("Semantic error: cannot cast {} to {} at {}:{}!",
+                      from->toString(), to->toString(), cast.pos.x,
+                      cast.pos.y));
+    return types.errorType();
+  }
+  return to;
+}
+
+} // namespace sema
@@ -0,0 +1,54 @@
+#ifndef ANALYSER_H
+#define ANALYSER_H
+
+#include "../ast/ast.hpp"
+#include "symbol_table.hpp"
+#include "types.hpp"
+#include <string_view>
+#include <unordered_map>
+
+namespace sema {
+
+// Name resolution and type checking. Annotates the AST in place: every
+// expression gets its interned type, variable and call expressions get their
+// declarations and field accesses get their field index.
+class Analyser {
+private:
+  TypeTable &types;
+  SymbolTable symbols;
+  std::unordered_map<std::string_view, ast::StructDecl *> structs;
+  ast::FunDecl *currentFunction{nullptr};
+  int errors{0};
+
+  void error(std::string_view msg);
+
+  void declareBuiltins(ast::Program &program);
+  void checkStruct(ast::StructDecl &decl);
+  const Type *resolve(const ast::TypeSpec &spec, ast::Position pos);
+  void checkVarDecl(ast::VarDecl &var);
+  void declareFunction(ast::FunDecl &fun);
+  void checkFunction(ast::FunDecl &fun);
+
+  void checkStmt(ast::Stmt &stmt);
+  void checkBlock(ast::Block &block, bool newScope);
+  const Type *checkExpr(ast::Expr &expr);
+  const Type *checkBinOp(ast::BinOp &binOp);
+  const Type *checkCast(ast::TypeCast &cast);
+  bool isLvalue(const ast::Expr &expr);
+
+public:
+  Analyser(TypeTable &types) : types(types) {}
+
+  void analyse(ast::Program &program);
+  // For checking a file a function at a time: `declare` takes the structs,
+  // globals and function declarations of the whole program, and
+  // `checkDefinition` then checks the body of each function, parsed again
+  // on its own, against them.
+  void declare(ast::Program &program);
+  void checkDefinition(ast::FunDecl &fun);
+  int getErrorCount();
+};
+
+} // namespace sema
+
+#endif
@@ -0,0 +1,99 @@
+#include "layout.hpp"
+#include <format>
+
+namespace sema {
+
+static int alignTo(int offset, int align) {
+  return (offset + align - 1) / align * align;
+}
+
+const Layout &LayoutEngine::layout(const Type *type) {
+  auto found{cache.find(type)};
+  if (found != cache.end())
+    return found->second;
+
+  Layout result{0, 1, {}};
+
+  switch (type->kind) {
+  case TypeKind::INT:
+    result = {4, 4, {}};
+    break;
+  case TypeKind::CHAR:
+    result = {1, 1, {}};
+    break;
+  case TypeKind::POINTER:
+    result = {8, 8, {}};
+    break;
+  case TypeKind::ARRAY: {
+    const Layout &element{layout(type->element)};
+    result = {element.size * type->length, element.align, {}};
+    break;
+  }
+  case TypeKind::STRUCT: {
+    int offset{0};
+    result.offsets.reserve(type->getFields().size());
+    for (const Field &field : type->getFields()) {
+      const Layout &fieldLayout{layout(field.type)};
+      offset = alignTo(offset, fieldLayout.align);
+      result.offsets.push_back(offset);
+      offset += fieldLayout.size;
+      result.align = std::max(result.align, fieldLayout.align);
+    }
+    result.size = alignTo(offset, result.align);
+    break;
+  }
+  case TypeKind::VOID:
+  case TypeKind::ERROR:
+    break;
+  }
+
+  // element references stay valid across rehashing, so the nested layouts
+  // computed above can be inserted before this one
+  return cache.emplace(type, std::move(result)).first->second;
+}
+
+void LayoutEngine::report(std::ostream &out, const Type *structType) {
+  const Layout &structLayout{layout(structType)};
+  const std::vector<Field> &fields{structType->getFields()};
+
+  out << std::format("{}: size {}, align {}, {} cache line(s)\n",
+                     structType->toString(), structLayout.size,
+                     structLayout.align,
+                     (structLayout.size + CACHE_LINE_SIZE - 1) /
+                         CACHE_LINE_SIZE);
+  out << std::format("  {:>6} {:>6}  {}\n", "offset", "size", "field");
+
+  int padding{0};
+  int holes{0};
+  int straddling{0};
+  int end{0};
+
+  auto hole{[&](int from, int to) {
+    out << std::format("  {:>6} {:>6}  <padding>\n", from, to - from);
+    padding += to - from;
+    holes++;
+  }};
+
+  for (size_t i = 0; i < fields.size(); i++) {
+    int offset{structLayout.offsets[i]};
+    int size{sizeOf(fields[i].type)};
+    if (offset > end)
+      hole(end, offset);
+
+    bool straddles{size > 0 && offset / CACHE_LINE_SIZE !=
+                                   (offset + size - 1) / CACHE_LINE_SIZE};
+    out << std::format("  {:>6} {:>6}  {} {}{}\n", offset, size,
+                       fields[i].type->toString(), fields[i].name,
+                       straddles ? "  <straddles cache line>" : "");
+    straddling += straddles;
+    end = offset + size;
+  }
+  if (structLayout.size > end)
+    hole(end, structLayout.size);
+
+  out << std::format("  padding: {} byte(s) in {} hole(s), {} field(s) "
+                     "straddling a {}-byte cache line\n",
+                     padding, holes, straddling, CACHE_LINE_SIZE);
+}
+
+} // namespace sema
@@ -0,0 +1,42 @@
+#ifndef LAYOUT_H
+#define LAYOUT_H
+
+#include "types.hpp"
+#include <ostream>
+#include <unordered_map>
+#include <vector>
+
+namespace sema {
+
+constexpr int CACHE_LINE_SIZE = 64;
+
+struct Layout {
+  int size;
+  int align;
+  // Byte offset of each field, for STRUCT types only.
+  std::vector<int> offsets;
+};
+
+// Computes x86-64 (System V) sizes, alignments and field offsets. Each type
+// is laid out once and memoized, so sizeof and offset queries after the first
+// are a single hash lookup.
+class LayoutEngine {
+private:
+  std::unordered_map<const Type *, Layout> cache;
+
+public:
+  const Layout &layout(const Type *type);
+  int sizeOf(const Type *type) { return layout(type).size; }
+  int alignOf(const Type *type) { return layout(type).align; }
+  int fieldOffset(const Type *structType, int field) {
+    return layout(structType).offsets[field];
+  }
+
+  // Prints the struct's fields with their offsets, padding holes and fields
+  // straddling a cache line boundary.
+  void report(std::ostream &out, const Type *structType);
+};
+
+} // namespace sema
+
+#endif
@@ -0,0 +1,42 @@
+#include "symbol_table.hpp"
+
+namespace sema {
+
+void SymbolTable::enterScope() { scopeStarts.push_back(symbols.size()); }
+
+void SymbolTable::exitScope() {
+  size_t start{scopeStarts.back()};
+  scopeStarts.pop_back();
+
+  while (symbols.size() > start) {
+    const Symbol &symbol{symbols.back()};
+    if (symbol.shadowed == -1)
+      innermost.erase(symbol.name);
+    else
+      innermost[symbol.name] = symbol.shadowed;
+    symbols.pop_back();
+  }
+}
+
+bool SymbolTable::declare(Symbol symbol) {
+  symbol.depth = depth();
+  auto [found, inserted] = innermost.try_emplace(
+      symbol.name, static_cast<int>(symbols.size()));
+
+  if (!inserted) {
+    if (symbols[found->second].depth == symbol.depth)
+      return false;
+    symbol.shadowed = found->second;
+    found->second = static_cast<int>(symbols.size());
+  }
+
+  symbols.push_back(symbol);
+  return true;
+}
+
+const Symbol *SymbolTable::lookup(std::string_view name) const {
+  auto found{innermost.find(name)};
+  return found == innermost.end() ? nullptr : &symbols[found->second];
+}
+
+} // namespace sema
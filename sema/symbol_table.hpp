@@ -0,0 +1,48 @@
+#ifndef SYMBOL_TABLE_H
+#define SYMBOL_TABLE_H
+
+#include "../ast/ast.hpp"
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+namespace sema {
+
+enum class SymbolKind { VARIABLE, FUNCTION };
+
+struct Symbol {
+  std::string_view name;
+  SymbolKind kind;
+  ast::VarDecl *var{nullptr};
+  ast::FunDecl *fun{nullptr};
+  // Scope depth the symbol was declared at (0 is the global scope).
+  int depth{0};
+  // Index of the binding this symbol shadows, or -1.
+  int shadowed{-1};
+};
+
+// Flat scoped symbol table. All live bindings sit in a single vector and a
+// hash map points each name at its innermost binding, so lookups are O(1)
+// regardless of nesting depth. Leaving a scope pops its bindings and restores
+// whatever they shadowed.
+class SymbolTable {
+private:
+  std::vector<Symbol> symbols;
+  std::unordered_map<std::string_view, int> innermost;
+  std::vector<size_t> scopeStarts;
+
+public:
+  SymbolTable() { symbols.reserve(64); }
+
+  void enterScope();
+  void exitScope();
+  int depth() const { return static_cast<int>(scopeStarts.size()); }
+
+  // Returns false if the name is already bound in the current scope.
+  bool declare(Symbol symbol);
+  const Symbol *lookup(std::string_view name) const;
+};
+
+} // namespace sema
+
+#endif
@@ -0,0 +1,92 @@
+#include "types.hpp"
+#include <format>
+
+namespace sema {
+
+int Type::fieldIndex(std::string_view fieldName) const {
+  for (size_t i = 0; i < fields.size(); i++)
+    if (fields[i].name == fieldName)
+      return static_cast<int>(i);
+  return -1;
+}
+
+std::string Type::toString() const {
+  switch (kind) {
+  case TypeKind::INT:
+    return "int";
+  case TypeKind::CHAR:
+    return "char";
+  case TypeKind::VOID:
+    return "void";
+  case TypeKind::POINTER:
+    return element->toString() + "*";
+  case TypeKind::ARRAY: {
+    // print dimensions outermost first, e.g. char*[2][3][4]
+    const Type *base{this};
+    std::string dims;
+    while (base->kind == TypeKind::ARRAY) {
+      dims += std::format("[{}]", base->length);
+      base = base->element;
+    }
+    return base->toString() + dims;
+  }
+  case TypeKind::STRUCT:
+    return std::format("struct {}", name);
+  case TypeKind::ERROR:
+    return "<error>";
+  }
+  return "<error>";
+}
+
+TypeTable::TypeTable() {
+  intType_ = intern({TypeKind::INT, nullptr, 0, {}});
+  charType_ = intern({TypeKind::CHAR, nullptr, 0, {}});
+  voidType_ = intern({TypeKind::VOID, nullptr, 0, {}});
+  errorType_ = intern({TypeKind::ERROR, nullptr, 0, {}});
+}
+
+Type *TypeTable::intern(const Key &key) {
+  auto found{interned.find(key)};
+  if (found != interned.end())
+    return found->second;
+
+  Type &type{
+      storage.emplace_back(key.kind, key.element, key.length, key.name)};
+  interned.emplace(key, &type);
+  return &type;
+}
+
+const Type *TypeTable::pointerTo(const Type *pointee) {
+  return intern({TypeKind::POINTER, pointee, 0, {}});
+}
+
+const Type *TypeTable::arrayOf(const Type *element, int length) {
+  return intern({TypeKind::ARRAY, element, length, {}});
+}
+
+const Type *TypeTable::structType(std::string_view name) {
+  Key key{TypeKind::STRUCT, nullptr, 0, name};
+  auto found{interned.find(key)};
+  if (found != interned.end())
+    return found->second;
+
+  // the table owns struct tags so types outlive the AST that named them
+  key.name = names.emplace_back(name);
+  return intern(key);
+}
+
+const Type *TypeTable::findStruct(std::string_view name) const {
+  auto found{interned.find({TypeKind::STRUCT, nullptr, 0, name})};
+  return found == interned.end() ? nullptr : found->second;
+}
+
+void TypeTable::defineStruct(const Type *structType,
+                             std::vector<Field> fields) {
+  Type *type{interned.at({TypeKind::STRUCT, nullptr, 0, structType->name})};
+  for (Field &field : fields)
+    field.name = names.emplace_back(field.name);
+  type->fields = std::move(fields);
+  type->defined = true;
+}
+
+} // namespace sema
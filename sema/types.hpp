@@ -0,0 +1,117 @@
+#ifndef TYPES_H
+#define TYPES_H
+
+#include <cstddef>
+#include <deque>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+namespace sema {
+
+enum class TypeKind { INT, CHAR, VOID, POINTER, ARRAY, STRUCT, ERROR };
+
+class Type;
+
+struct Field {
+  std::string_view name;
+  const Type *type;
+};
+
+// Types are hash-consed by TypeTable: two structurally identical types are
+// always the same object, so type equality is a pointer comparison.
+class Type {
+private:
+  friend class TypeTable;
+
+  std::vector<Field> fields;
+  bool defined{false};
+
+public:
+  const TypeKind kind;
+  // Pointee for POINTER, element for ARRAY, null otherwise.
+  const Type *const element;
+  // Number of elements for ARRAY, 0 otherwise.
+  const int length;
+  // Tag name for STRUCT, empty otherwise.
+  const std::string_view name;
+
+  Type(TypeKind kind, const Type *element, int length, std::string_view name)
+      : kind(kind), element(element), length(length), name(name) {}
+
+  bool isStruct() const { return kind == TypeKind::STRUCT; }
+  bool isPointer() const { return kind == TypeKind::POINTER; }
+  bool isArray() const { return kind == TypeKind::ARRAY; }
+  bool isError() const { return kind == TypeKind::ERROR; }
+  // int, char and pointers fit in a register.
+  bool isScalar() const {
+    return kind == TypeKind::INT || kind == TypeKind::CHAR ||
+           kind == TypeKind::POINTER;
+  }
+
+  // Only meaningful for STRUCT types.
+  bool isDefined() const { return defined; }
+  const std::vector<Field> &getFields() const { return fields; }
+  int fieldIndex(std::string_view fieldName) const;
+
+  std::string toString() const;
+};
+
+class TypeTable {
+private:
+  struct Key {
+    TypeKind kind;
+    const Type *element;
+    int length;
+    std::string_view name;
+
+    bool operator==(const Key &) const = default;
+  };
+
+  struct KeyHash {
+    size_t operator()(const Key &key) const {
+      size_t hash{std::hash<const void *>{}(key.element)};
+      hash ^= static_cast<size_t>(key.kind) * 0x9e3779b97f4a7c15ull;
+      hash ^= static_cast<size_t>(key.length) * 0xc2b2ae3d27d4eb4full;
+      if (!key.name.empty())
+        hash ^= std::hash<std::string_view>{}(key.name);
+      return hash;
+    }
+  };
+
+  std::deque<Type> storage;
+  std::deque<std::string> names;
+  std::unordered_map<Key, Type *, KeyHash> interned;
+
+  const Type *intType_;
+  const Type *charType_;
+  const Type *voidType_;
+  const Type *errorType_;
+
+  Type *intern(const Key &key);
+
+public:
+  TypeTable();
+  TypeTable(const TypeTable &) = delete;
+  TypeTable &operator=(const TypeTable &) = delete;
+
+  const Type *intType() const { return intType_; }
+  const Type *charType() const { return charType_; }
+  const Type *voidType() const { return voidType_; }
+  const Type *errorType() const { return errorType_; }
+
+  const Type *pointerTo(const Type *pointee);
+  const Type *arrayOf(const Type *element, int length);
+  // Returns the (possibly not yet defined) struct type with the given tag.
+  const Type *structType(std::string_view name);
+  // Returns the struct type with the given tag or null if it was never named.
+  const Type *findStruct(std::string_view name) const;
+  void defineStruct(const Type *structType, std::vector<Field> fields);
+
+  size_t size() const { return storage.size(); }
+};
+
+} // namespace sema
+
+#endif
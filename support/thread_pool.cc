@@ -0,0 +1,100 @@
+#include "thread_pool.hpp"
+#include <algorithm>
+
+namespace support {
+
+ThreadPool::ThreadPool(unsigned threads) {
+  threads = std::max(threads, 1u);
+  for (unsigned i = 0; i < threads; i++)
+    queues.push_back(std::make_unique<Queue>());
+  for (size_t i = 1; i < threads; i++)
+    workers.emplace_back([this, i] { work(i); });
+}
+
+ThreadPool::~ThreadPool() {
+  {
+    std::lock_guard lock{mutex};
+    stopping = true;
+  }
+  wake.notify_all();
+  for (std::thread &worker : workers)
+    worker.join();
+}
+
+unsigned ThreadPool::defaultThreads() {
+  return std::max(std::thread::hardware_concurrency(), 1u);
+}
+
+// Own deque from the back, then the others' from the front.
+bool ThreadPool::take(size_t self, Task &task) {
+  for (size_t i = 0; i < queues.size(); i++) {
+    Queue &queue{*queues[(self + i) % queues.size()]};
+    std::lock_guard lock{queue.mutex};
+    if (queue.tasks.empty())
+      continue;
+    if (i == 0) {
+      task = std::move(queue.tasks.back());
+      queue.tasks.pop_back();
+    } else {
+      task = std::move(queue.tasks.front());
+      queue.tasks.pop_front();
+    }
+    queued--;
+    return true;
+  }
+  return false;
+}
+
+void ThreadPool::work(size_t self) {
+  Task task;
+  while (true) {
+    if (take(self, task)) {
+      task();
+      task = nullptr;
+      if (--pending == 0) {
+        std::lock_guard lock{mutex};
+        finished.notify_all();
+      }
+      continue;
+    }
+    std::unique_lock lock{mutex};
+    wake.wait(lock, [&] { return stopping || queued > 0; });
+    if (stopping)
+      return;
+  }
+}
+
+void ThreadPool::run(std::vector<Task> tasks) {
+  if (tasks.empty())
+    return;
+  if (queues.size() == 1) {
+    for (Task &task : tasks)
+      task();
+    return;
+  }
+
+  pending += tasks.size();
+  for (size_t i = 0; i < tasks.size(); i++) {
+    Queue &queue{*queues[i % queues.size()]};
+    std::lock_guard lock{queue.mutex};
+    queue.tasks.push_back(std::move(tasks[i]));
+    queued++;
+  }
+  // a worker tests `queued` while holding the lock, so taking it here
+  // means it either sees the new tasks or is already waiting for the signal
+  {
+    std::lock_guard lock{mutex};
+  }
+  wake.notify_all();
+
+  Task task;
+  while (take(0, task)) {
+    task();
+    task = nullptr;
+    pending--;
+  }
+  std::unique_lock lock{mutex};
+  finished.wait(lock, [&] { return pending == 0; });
+}
+
+} // namespace support
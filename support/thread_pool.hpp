@@ -0,0 +1,60 @@
+#ifndef THREAD_POOL_H
+#define THREAD_POOL_H
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace support {
+
+// A fixed set of worker threads with a task deque each. `run` deals a batch
+// of independent tasks out over the deques and blocks until all of them
+// have finished, with the calling thread working on the batch too. A thread
+// takes the newest task of its own deque first and, once that is empty,
+// steals the oldest task of another one, so uneven tasks still keep every
+// thread busy. Tasks must not throw.
+class ThreadPool {
+private:
+  using Task = std::function<void()>;
+
+  struct Queue {
+    std::mutex mutex;
+    std::deque<Task> tasks;
+  };
+
+  // the caller's deque comes first, then one per worker
+  std::vector<std::unique_ptr<Queue>> queues;
+  std::vector<std::thread> workers;
+
+  std::mutex mutex;
+  std::condition_variable wake;
+  std::condition_variable finished;
+  // tasks waiting in some deque, and tasks of the batch not yet finished
+  std::atomic<size_t> queued{0};
+  std::atomic<size_t> pending{0};
+  bool stopping{false};
+
+  bool take(size_t self, Task &task);
+  void work(size_t self);
+
+public:
+  // With a single thread everything runs on the caller.
+  explicit ThreadPool(unsigned threads = defaultThreads());
+  ~ThreadPool();
+  ThreadPool(const ThreadPool &) = delete;
+  ThreadPool &operator=(const ThreadPool &) = delete;
+
+  static unsigned defaultThreads();
+  unsigned size() const { return static_cast<unsigned>(queues.size()); }
+
+  void run(std::vector<Task> tasks);
+};
+
+} // namespace support
+
+#endif